@@ -0,0 +1,85 @@
+#pragma once
+
+#include "common.h"
+
+#include <future>
+
+namespace surf {
+
+// Reads a file front to back in large aligned chunks, keeping up to queue_depth - 1 reads in
+// flight while the caller works on the current chunk. An alternative to MappedReadOnlyFile for
+// storage where page faults serialize badly (cold files over NFS): reads are explicit and large,
+// and memory is bounded by the buffer pool instead of growing with the page cache.
+class SURF_EXPORT ChunkedFileReader {
+public:
+    enum class Backend : uint8_t {
+        pread,
+        // falls back to pread if surf was built without liburing or the kernel refuses the ring
+        io_uring,
+    };
+
+    struct Options {
+        // rounded up to a multiple of alignment
+        size_t chunk_size = size_t{4} * 1024 * 1024;
+        uint32_t queue_depth = 4;
+        Backend backend = Backend::io_uring;
+        // O_DIRECT, bypassing the page cache, if the filesystem supports it
+        bool direct = false;
+        // evict consumed chunks from the page cache
+        bool drop_behind = true;
+    };
+
+    SURF_SCA alignment = size_t{4096};
+
+    struct Chunk {
+        uint64_t offset;
+        std::string_view data;
+    };
+
+    ChunkedFileReader(const std::filesystem::path &path, Options options);
+    explicit ChunkedFileReader(const std::filesystem::path &path);
+    ~ChunkedFileReader();
+    ChunkedFileReader(const ChunkedFileReader &)            = delete;
+    ChunkedFileReader &operator=(const ChunkedFileReader &) = delete;
+
+    // the next chunk in file order, empty data at the end of the file. The data stays valid until
+    // the next call.
+    Chunk next();
+    // the backend in use, after any fallback
+    Backend backend() const;
+    size_t chunk_size() const;
+    uint64_t size() const;
+    const std::filesystem::path &path() const;
+
+private:
+    struct Slot {
+        std::unique_ptr<char, decltype(&std::free)> buf{nullptr, &std::free};
+        uint64_t offset{};
+        size_t len{};
+        int64_t res{};
+        bool in_flight{};
+        // pread backend, declared after buf so the read finishes before buf is freed
+        std::future<int64_t> pending;
+    };
+    struct Ring;
+
+    void submit(Slot &slot);
+    void wait(Slot &slot);
+    // reads what an interrupted or short read left of the slot
+    void complete_short_read(Slot &slot);
+    // waits out the reads in flight, then releases the ring and the fd
+    void close_file();
+
+    const std::filesystem::path m_path;
+    int m_fd{-1};
+    uint64_t m_size{};
+    Options m_options;
+    std::vector<Slot> m_slots;
+    // slot of the chunk handed out by the last next(), its buffer is reused by the next call
+    size_t m_cur{};
+    bool m_have_cur{};
+    uint64_t m_submit_offset{};
+    std::unique_ptr<Ring> m_ring;
+};
+
+} // namespace surf
@@ -0,0 +1,264 @@
+#pragma once
+
+#include "common.h"
+#include "idcode.h"
+#include "rank-select.h"
+#include "varbit.h"
+#include "zone-map.h"
+
+#include <iterator>
+#include <span>
+#include <variant>
+
+namespace surf {
+
+namespace VCDTypes {
+struct Comment;
+struct Tick;
+struct Change;
+struct Declarations;
+struct Document;
+// same as in vcd.h
+using SimCmd = std::variant<Comment, Tick, Change>;
+}; // namespace VCDTypes
+
+class Trace;
+
+// 2-bit four state scalar value
+enum class Logic : uint8_t {
+    v0 = 0b00,
+    v1 = 0b01,
+    vX = 0b10,
+    vZ = 0b11
+};
+
+enum class SignalKind : uint8_t {
+    scalar,
+    vector,
+    real
+};
+
+class SignalChange;
+class SignalChangeRange;
+
+// All changes of a single signal in tick order. Ticks and values live in separate contiguous
+// arrays so time lookups are a binary search over the ticks alone.
+class SURF_EXPORT SignalColumn {
+public:
+    SURF_SCA logics_per_byte = CHAR_BIT / 2;
+
+    SignalColumn(SignalKind kind, varbit::sz_t bitsize);
+
+    SignalKind kind() const;
+    varbit::sz_t bitsize() const;
+    size_t size() const;
+    const std::vector<uint64_t> &ticks() const;
+    uint64_t tick(size_t idx) const;
+
+    // kind() == scalar
+    Logic logic(size_t idx) const;
+    // kind() == vector
+    bitview bits(size_t idx) const;
+    // X/Z plane of a vector value, a set bit makes the matching value bit X (1) or Z (0). nullopt
+    // if the value has no X or Z bits.
+    std::optional<bitview> xz(size_t idx) const;
+    VarBit varbit(size_t idx) const;
+    // per block value summaries, kind() == vector
+    const ZoneMap &zones() const;
+    // the first change at or after index first whose value has no X or Z bits and lies in
+    // [lo, hi], skipping the blocks the zone map rules out and scanning the rest with SIMD
+    // compares. kind() == vector and bitsize() <= 64.
+    std::optional<size_t> find_in_range(size_t first, uint64_t lo, uint64_t hi) const;
+    // the first change at or after index first with X or Z bits, kind() == vector
+    std::optional<size_t> find_xz(size_t first) const;
+    // kind() == real
+    double real(size_t idx) const;
+    // changes a and b hold the same value, reals compare bitwise
+    bool same_value(size_t a, size_t b) const;
+    // change idx is the first one or changes the value
+    bool is_edge(size_t idx) const {
+        return m_edges[idx];
+    }
+    // is_edge of every change, built as changes are appended
+    const RankSelect &edges() const;
+    // edges among changes [first, last), two rank queries
+    size_t num_edges(size_t first, size_t last) const {
+        return m_edges.count1(first, last);
+    }
+
+    // index of the last change at or before tick, nullopt if the signal first changes after it
+    std::optional<size_t> index_at(uint64_t tick) const;
+    // [first, last) indices of the changes with start <= tick <= end
+    std::pair<size_t, size_t> index_range(uint64_t start, uint64_t end) const;
+
+    // Point queries, a binary search over the ticks each. Safe to call from many threads at once
+    // as long as nothing is appended.
+    // the change in effect at tick, nullopt if the signal first changes after it
+    std::optional<SignalChange> value_at(uint64_t tick) const;
+    // the first change after tick
+    std::optional<SignalChange> next_change(uint64_t tick) const;
+    // the last change before tick
+    std::optional<SignalChange> prev_change(uint64_t tick) const;
+    // the changes with start <= tick <= end, visited lazily
+    SignalChangeRange changes_in(uint64_t start, uint64_t end) const;
+    // edges with start <= tick <= end
+    size_t edges_in(uint64_t start, uint64_t end) const;
+    // the first edge after tick, skipping changes that rewrite the same value
+    std::optional<SignalChange> next_edge(uint64_t tick) const;
+    // the last edge before tick
+    std::optional<SignalChange> prev_edge(uint64_t tick) const;
+
+    void reserve(size_t num_changes);
+    void append_logic(uint64_t tick, Logic logic);
+    // a narrower xz with a leading X or Z extends it to the full width
+    void append_bits(uint64_t tick, bitview bits, std::optional<bitview> xz = std::nullopt);
+    void append_real(uint64_t tick, double real);
+
+private:
+    // appends is_edge of the change just appended
+    void push_edge();
+
+    SignalKind m_kind;
+    varbit::sz_t m_bitsize;
+    varbit::sz_t m_stride;
+    std::vector<uint64_t> m_ticks;
+    // scalar: logics_per_byte Logic codes per byte, vector: m_stride bytes per change
+    std::vector<uint8_t> m_values;
+    // vector: X/Z planes laid out like m_values, empty until the first value with X or Z bits
+    std::vector<uint8_t> m_xz;
+    std::vector<double> m_reals;
+    RankSelect m_edges;
+    ZoneMap m_zones;
+};
+
+// A change of a signal, valid as long as its column is and nothing is appended to it.
+class SURF_EXPORT SignalChange {
+public:
+    SignalChange(const SignalColumn &column, size_t idx) : m_column{&column}, m_idx{idx} {}
+
+    const SignalColumn &column() const {
+        return *m_column;
+    }
+    size_t index() const {
+        return m_idx;
+    }
+    uint64_t tick() const {
+        return m_column->tick(m_idx);
+    }
+    // column().kind() == scalar
+    Logic logic() const {
+        return m_column->logic(m_idx);
+    }
+    // column().kind() == vector
+    bitview bits() const {
+        return m_column->bits(m_idx);
+    }
+    VarBit varbit() const {
+        return m_column->varbit(m_idx);
+    }
+    // column().kind() == real
+    double real() const {
+        return m_column->real(m_idx);
+    }
+    bool operator==(const SignalChange &other) const = default;
+
+private:
+    const SignalColumn *m_column;
+    size_t m_idx;
+};
+
+// [first, last) changes of a column, SignalChange handles are made as the range is iterated
+class SURF_EXPORT SignalChangeRange {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = SignalChange;
+        using difference_type   = ptrdiff_t;
+
+        iterator() = default;
+        iterator(const SignalColumn *column, size_t idx) : m_column{column}, m_idx{idx} {}
+        SignalChange operator*() const {
+            return {*m_column, m_idx};
+        }
+        iterator &operator++() {
+            ++m_idx;
+            return *this;
+        }
+        iterator operator++(int) {
+            auto res = *this;
+            ++m_idx;
+            return res;
+        }
+        bool operator==(const iterator &other) const = default;
+
+    private:
+        const SignalColumn *m_column{};
+        size_t m_idx{};
+    };
+
+    SignalChangeRange(const SignalColumn &column, size_t first, size_t last)
+        : m_column{&column}, m_first{first}, m_last{last} {}
+
+    iterator begin() const {
+        return {m_column, m_first};
+    }
+    iterator end() const {
+        return {m_column, m_last};
+    }
+    size_t size() const {
+        return m_last - m_first;
+    }
+    bool empty() const {
+        return m_first == m_last;
+    }
+    // [first, last) indices into the column
+    std::pair<size_t, size_t> indices() const {
+        return {m_first, m_last};
+    }
+
+private:
+    const SignalColumn *m_column;
+    size_t m_first;
+    size_t m_last;
+};
+
+class SURF_EXPORT SignalColumns {
+public:
+    // Transposes the interleaved tick/change stream of a parsed document into one column per
+    // signal index.
+    static SignalColumns from_document(const VCDTypes::Document &doc);
+    static SignalColumns from_trace(const Trace &trace);
+    // empty columns to append_sim_cmds to
+    static SignalColumns from_declarations(const VCDTypes::Declarations &decls);
+
+    // appends in place, for changes parsed after the columns were built
+    // arenas: the per signal arenas wide values were parsed into, empty if there are none
+    void append_sim_cmds(std::span<const VCDTypes::SimCmd> cmds,
+                         std::span<const VarBitArena> arenas = {});
+
+    size_t size() const;
+    const SignalColumn &operator[](IDCodeTable::sig_t sig) const;
+    const std::vector<SignalColumn> &signals() const;
+    uint64_t start() const;
+    uint64_t end() const;
+
+    // the SignalColumn queries of signal sig
+    std::optional<SignalChange> value_at(IDCodeTable::sig_t sig, uint64_t tick) const;
+    std::optional<SignalChange> next_change(IDCodeTable::sig_t sig, uint64_t tick) const;
+    std::optional<SignalChange> prev_change(IDCodeTable::sig_t sig, uint64_t tick) const;
+    SignalChangeRange changes_in(IDCodeTable::sig_t sig, uint64_t start, uint64_t end) const;
+    size_t edges_in(IDCodeTable::sig_t sig, uint64_t start, uint64_t end) const;
+    std::optional<SignalChange> next_edge(IDCodeTable::sig_t sig, uint64_t tick) const;
+    std::optional<SignalChange> prev_edge(IDCodeTable::sig_t sig, uint64_t tick) const;
+
+private:
+    void append_sim_cmd(const VCDTypes::SimCmd &cmd, std::span<const VarBitArena> arenas);
+
+    std::vector<SignalColumn> m_signals;
+    uint64_t m_start{};
+    uint64_t m_end{};
+    bool m_seen_tick{};
+};
+
+} // namespace surf
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "common.h"
+
+#include <limits>
+#include <unordered_map>
+
+namespace surf {
+
+// Interns VCD identifier codes into dense signal indices.
+// Simulators hand out id codes by counting in base 94 over the printable ASCII range ('!' to '~'),
+// least significant digit first. Those codes decode arithmetically to a small integer that
+// indexes a flat table. Codes that are too long or decode too sparsely go in a hash map instead.
+class SURF_EXPORT IDCodeTable {
+public:
+    using sig_t                 = uint32_t;
+    SURF_SCA invalid_sig        = std::numeric_limits<sig_t>::max();
+    SURF_SCA max_decoded_digits = 8; // 94^8 < 2^64
+
+    // Returns the index for idcode, assigning the next free one if it hasn't been seen before.
+    sig_t intern(std::string_view idcode);
+    // Returns the index for idcode or invalid_sig if it was never interned.
+    sig_t lookup(std::string_view idcode) const;
+    sig_t size() const;
+
+    // Bijective base-94 decode so that "!" and "!!" map to different numbers.
+    static std::optional<uint64_t> decode(std::string_view idcode);
+
+private:
+    struct sv_hash {
+        using is_transparent = void;
+        size_t operator()(std::string_view sv) const {
+            return std::hash<std::string_view>{}(sv);
+        }
+    };
+
+    std::vector<sig_t> m_dense;
+    std::unordered_map<std::string, sig_t, sv_hash, std::equal_to<>> m_sparse;
+    sig_t m_num_sigs{};
+};
+
+} // namespace surf
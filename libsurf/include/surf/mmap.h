@@ -1,22 +1,61 @@
 #pragma once
 
+#include "chunked-reader.h"
 #include "common.h"
 
+#include <thread>
+
 namespace surf {
 
+// How the kernel is told the mapping will be accessed. The advice is best effort, kernels and
+// filesystems that don't support it map the file the same as normal.
+enum class MapPolicy : uint8_t {
+    // no hints
+    normal,
+    // front to back scans: aggressive readahead, advance() reads ahead of the cursor and drops
+    // the pages behind it
+    sequential,
+    // seeks and point lookups: no readahead
+    random,
+    // transparent huge pages, faulted in while mapping
+    huge_pages,
+};
+
 class SURF_EXPORT MappedReadOnlyFile {
 public:
-    MappedReadOnlyFile(const std::filesystem::path &path, const void *preferred_addr = nullptr);
+    SURF_SCA readahead_window = size_t{64} * 1024 * 1024;
+
+    MappedReadOnlyFile(const std::filesystem::path &path, const void *preferred_addr = nullptr,
+                       MapPolicy policy = MapPolicy::normal);
+    MappedReadOnlyFile(const std::filesystem::path &path, MapPolicy policy);
+    // Reads the file into private anonymous memory with a ChunkedFileReader instead of mapping it,
+    // for storage where page faults serialize badly. The policy is normal, nothing is dropped.
+    MappedReadOnlyFile(const std::filesystem::path &path,
+                       const ChunkedFileReader::Options &read_options);
     ~MappedReadOnlyFile();
     const uint8_t *data() const;
     size_t size() const;
     std::string_view string_view() const;
     const std::filesystem::path &path() const;
+    MapPolicy policy() const;
+
+    // Sequential policy: everything before offset has been consumed. The pages behind it are
+    // dropped and the next readahead_window after it is read ahead. The dropped pages stay valid,
+    // they are read from the file again if touched. No-op for the other policies.
+    void advance(size_t offset);
+    // faults the whole file in on a background thread, like MAP_POPULATE without blocking the
+    // constructor. Stopped by the destructor.
+    void prefetch_async();
 
 private:
     const std::filesystem::path m_path;
     const uint8_t *m_mapping;
     size_t m_size;
+    MapPolicy m_policy;
+    // page aligned end of the dropped pages and of the pages read ahead
+    size_t m_dropped_end{};
+    size_t m_readahead_end{};
+    std::jthread m_prefetch_thread;
 };
 
 }; // namespace surf
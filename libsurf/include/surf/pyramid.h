@@ -0,0 +1,84 @@
+#pragma once
+
+#include "columns.h"
+#include "common.h"
+
+namespace surf {
+
+// Summary of the changes of one signal inside a power of two wide, tick aligned time bucket.
+struct PyramidBucket {
+    SURF_SCA max_seen      = 4;
+    SURF_SCA seen_overflow = UINT8_MAX;
+
+    // tick >> PyramidLevel::shift
+    uint64_t bucket;
+    // column index of the first change in the bucket, the last one is first_change + num_changes - 1
+    uint64_t first_change;
+    uint32_t num_changes;
+    // distinct values changed to, seen_overflow once there are more than max_seen of them
+    uint8_t num_seen;
+    // scalar: bit n set if Logic n was seen
+    uint8_t logic_mask;
+    uint8_t reserved[2];
+    // vector/real: offsets from first_change of a change with each distinct value
+    uint32_t seen[max_seen];
+
+    uint64_t last_change() const {
+        return first_change + num_changes - 1;
+    }
+};
+static_assert(sizeof(PyramidBucket) == 40);
+
+struct PyramidLevel {
+    uint8_t shift;
+    // only the buckets holding changes, sorted
+    std::vector<PyramidBucket> buckets;
+
+    uint64_t bucket_ticks() const {
+        return uint64_t{1} << shift;
+    }
+    // index of the first bucket at or after tick
+    size_t lower_bound(uint64_t tick) const;
+};
+
+// Multi-resolution summary of a SignalColumn. Level 0 is the finest level whose buckets average
+// at least min_changes_per_bucket changes, every following level doubles the bucket width up to
+// the one holding all of the changes. A render at some zoom can then read one bucket summary per
+// pixel instead of every change.
+class SURF_EXPORT SignalPyramid {
+public:
+    SURF_SCA min_changes_per_bucket = 4;
+
+    static SignalPyramid build(const SignalColumn &col);
+
+    const std::vector<PyramidLevel> &levels() const;
+    // coarsest level with buckets no wider than ticks_per_pixel, nullptr if the changes themselves
+    // are the better resolution
+    const PyramidLevel *level_for(uint64_t ticks_per_pixel) const;
+
+private:
+    friend class SignalPyramids;
+
+    std::vector<PyramidLevel> m_levels;
+};
+
+class SURF_EXPORT SignalPyramids {
+public:
+    // num_threads: 0 for one per core
+    static SignalPyramids build(const SignalColumns &cols, uint32_t num_threads = 0);
+    // throws std::domain_error if the file is truncated or malformed, a well formed file can
+    // still be stale or belong to another trace so check it before rendering from it
+    static SignalPyramids load(const std::filesystem::path &path);
+    void save(const std::filesystem::path &path) const;
+    // throws std::domain_error unless there is a pyramid per column and every bucket lies within
+    // its column and holds the ticks of its changes
+    void check(const SignalColumns &cols) const;
+
+    size_t size() const;
+    const SignalPyramid &operator[](uint32_t sig) const;
+
+private:
+    std::vector<SignalPyramid> m_signals;
+};
+
+} // namespace surf
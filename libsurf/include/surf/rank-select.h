@@ -0,0 +1,43 @@
+#pragma once
+
+#include "common.h"
+
+namespace surf {
+
+// Append only bitvector with a rank/select directory kept in sync as bits are pushed. Every
+// block_bits bits store an absolute count of the ones before them and every sub_block_bits bits a
+// count relative to their block, about 4.7% on top of the bits. rank1 is two lookups plus at most
+// eight popcounts, select1 a binary search over the block counts followed by the same scan.
+class SURF_EXPORT RankSelect {
+public:
+    SURF_SCA block_bits     = size_t{4096};
+    SURF_SCA sub_block_bits = size_t{512};
+
+    void reserve(size_t num_bits);
+    void push_back(bool bit);
+
+    size_t size() const;
+    size_t num_ones() const;
+    bool operator[](size_t pos) const;
+    // ones in [0, pos), pos <= size()
+    size_t rank1(size_t pos) const;
+    // ones in [first, last)
+    size_t count1(size_t first, size_t last) const {
+        return rank1(last) - rank1(first);
+    }
+    // position of the one with rank k, k < num_ones()
+    size_t select1(size_t k) const;
+    // bits and directory
+    size_t memory_bytes() const;
+
+private:
+    std::vector<uint64_t> m_words;
+    // ones before each block
+    std::vector<uint64_t> m_block_ranks;
+    // ones between the start of its block and each sub block, < block_bits so 16 bits do
+    std::vector<uint16_t> m_sub_ranks;
+    size_t m_size{};
+    size_t m_num_ones{};
+};
+
+} // namespace surf
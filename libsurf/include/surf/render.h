@@ -1,19 +1,58 @@
 #pragma once
 
+#include "columns.h"
 #include "common.h"
+#include "pyramid.h"
 #include "time.h"
 #include "trace.h"
 
 namespace surf {
 
+// RGBA8 in memory order
+constexpr uint32_t rgba(uint8_t r, uint8_t g, uint8_t b, uint8_t a = UINT8_MAX) {
+    return (uint32_t)r | ((uint32_t)g << 8) | ((uint32_t)b << 16) | ((uint32_t)a << 24);
+}
+
+// Headless waveform rasterizer. Every signal gets an equal height lane, every pixel column of a
+// lane is classified as steady, a single edge or toggling beyond the resolution, changes that
+// rewrite the same value don't count as edges. Zoomed out far enough that a pixel is at least
+// as wide as the finest bucket of a signal's SignalPyramid, the lane is drawn from the bucket
+// summaries instead of searching the changes of every pixel. The image is split into tiles of
+// tile_lanes signals by tile_width pixels that are drawn in parallel.
 class SURF_EXPORT Renderer {
 public:
-    Renderer(const Trace &trace);
+    SURF_SCA tile_lanes = 16u;
+    SURF_SCA tile_width = 256u;
+
+    SURF_SCA bg_color     = rgba(0, 0, 0);
+    SURF_SCA value_color  = rgba(0, 255, 0);
+    SURF_SCA toggle_color = rgba(0, 100, 0);
+    SURF_SCA x_color      = rgba(255, 0, 0);
+    SURF_SCA z_color      = rgba(255, 255, 0);
+
+    // transposes the trace into SignalColumns first
+    // num_threads: 0 for one per core
+    Renderer(const Trace &trace, uint32_t num_threads = 0);
+    Renderer(const SignalColumns &columns, uint32_t num_threads = 0);
+    // pyramids have to be built from columns, or loaded and passed SignalPyramids::check
+    Renderer(const SignalColumns &columns, const SignalPyramids &pyramids,
+             uint32_t num_threads = 0);
+
     void render(const Time &start, const Time &end, uint32_t width, uint32_t height,
-                const std::filesystem::path &png_path);
+                const std::filesystem::path &png_path) const;
+    // width * height pixels, row major
+    std::vector<uint32_t> render_rgba(const Time &start, const Time &end, uint32_t width,
+                                      uint32_t height) const;
 
 private:
-    const Trace &m_trace;
+    // draws pixels [x0, x1) of the lane of sig
+    void render_signal(uint32_t sig, const Viewport &viewport, uint32_t x0, uint32_t x1,
+                       uint32_t y0, uint32_t lane_height, uint32_t *fb) const;
+
+    std::optional<SignalColumns> m_owned_columns;
+    const SignalColumns &m_columns;
+    const SignalPyramids *m_pyramids = nullptr;
+    uint32_t m_num_threads;
 };
 
 } // namespace surf
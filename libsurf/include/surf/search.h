@@ -0,0 +1,99 @@
+#pragma once
+
+#include "columns.h"
+
+namespace surf {
+
+// Finds the ticks at which a condition over signals holds, e.g.
+// "top.valid && top.ready && top.addr == 0x4000" or "isx(top.data)".
+//
+//   or      := and ('||' and)*
+//   and     := cmp ('&&' cmp)*
+//   cmp     := unary (('==' | '!=' | '<' | '<=' | '>' | '>=') unary)?
+//   unary   := '!' unary | primary
+//   primary := number | path | ('isx' | 'isz') '(' path ')' | '(' or ')'
+//
+// Paths are the dotted scope ids below the root followed by a var ref without its bit range.
+// Numbers are decimal, 0x hex or 0b binary. Values are unsigned and vectors at most 64 bits wide
+// outside of isx/isz, which are true if any bit of the signal is X or Z. A signal is true if it is
+// non-zero without X or Z bits, comparisons with an X or Z operand are false.
+//
+// The expression compiles to postfix bytecode, split at its top level &&s. next() and prev()
+// walk only the edges of the referenced signals and, whenever a term is false, jump straight to
+// the next edge of one of its own signals, so time in which the term can't change is skipped
+// with one binary search per signal. Going forward, a false term comparing one vector to a
+// constant, or asking for its X/Z bits, is looked up in the column's zone map instead.
+class SURF_EXPORT SignalSearch {
+public:
+    enum class Op : uint8_t {
+        push_signal,
+        push_const,
+        is_x,
+        is_z,
+        eq,
+        ne,
+        lt,
+        le,
+        gt,
+        ge,
+        logical_and,
+        logical_or,
+        logical_not,
+    };
+
+    struct Instr {
+        Op op;
+        // push_signal, is_x, is_z: index into signals(), push_const: the constant
+        uint64_t arg;
+    };
+
+    // throws std::invalid_argument on syntax errors and unknown paths, std::domain_error for real
+    // signals and vectors wider than 64 bits
+    SignalSearch(std::string_view expr, const VCDTypes::Declarations &decls,
+                 const SignalColumns &columns);
+
+    // the condition holds with the values in effect at tick
+    bool holds_at(uint64_t tick) const;
+    // the first tick after tick at which a referenced signal changes value and the condition
+    // holds
+    std::optional<uint64_t> next(uint64_t tick) const;
+    // the last such tick before tick
+    std::optional<uint64_t> prev(uint64_t tick) const;
+
+    const std::vector<Instr> &code() const;
+    // the referenced signals, in order of first use
+    const std::vector<IDCodeTable::sig_t> &signals() const;
+
+private:
+    // a top level && operand, the condition holds if all of them do
+    struct Term {
+        size_t code_begin;
+        size_t code_end;
+        // indices into m_signals
+        std::vector<uint32_t> slots;
+        // a vector compared to a constant, the values [first, second] that satisfy it
+        std::optional<std::pair<uint64_t, uint64_t>> value_range;
+        // a lone isx/isz of a vector
+        bool finds_xz{};
+    };
+    struct Operand {
+        uint64_t value;
+        bool unknown;
+    };
+
+    // cur: the change in effect of each signal, SIZE_MAX before the first
+    bool eval(const Term &term, std::span<const size_t> cur, std::vector<Operand> &stack) const;
+    void split_terms(size_t code_begin, size_t code_end);
+    // earliest tick at or after tick at which the single signal term can hold, scanning its
+    // changes from there on, no tick if none
+    uint64_t next_possible(const Term &term, std::span<size_t> cur, uint64_t tick,
+                           std::vector<Operand> &stack) const;
+
+    const SignalColumns *m_columns;
+    std::vector<Instr> m_code;
+    std::vector<IDCodeTable::sig_t> m_signals;
+    std::vector<Term> m_terms;
+    size_t m_max_depth{};
+};
+
+} // namespace surf
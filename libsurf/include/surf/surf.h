@@ -1,6 +1,17 @@
 #pragma once
 
+#include "chunked-reader.h"
+#include "columns.h"
+#include "idcode.h"
+#include "pyramid.h"
+#include "rank-select.h"
 #include "render.h"
+#include "search.h"
+#include "tick-index.h"
+#include "trace-writer.h"
 #include "trace.h"
 #include "varbit.h"
+#include "vcd-follow.h"
+#include "vcd-stream.h"
 #include "vcd.h"
+#include "zone-map.h"
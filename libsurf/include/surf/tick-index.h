@@ -0,0 +1,46 @@
+#pragma once
+
+#include "common.h"
+
+#include <stop_token>
+
+namespace surf {
+
+struct TickSeekEntry {
+    uint64_t tick;
+    // of the '#' in the VCD value change section
+    uint64_t offset;
+};
+
+// Sparse seek table over the value change section of a VCD: the first '#tick' line at or after
+// every stride bytes. A window of ticks can then be parsed out of the section without parsing
+// anything before it. Only '#' at the start of a line followed by a digit and outside of a
+// $comment counts as a tick.
+class SURF_EXPORT TickSeekIndex {
+public:
+    SURF_SCA default_stride = size_t{16} * 1024 * 1024;
+
+    // scans all of sim_cmds_str, a stop request returns early with an incomplete index
+    static TickSeekIndex build(std::string_view sim_cmds_str, size_t stride = default_stride,
+                               std::stop_token stop = {});
+    // cheap probes of the head and tail of the section for its time extent
+    static std::optional<TickSeekEntry> first_tick(std::string_view sim_cmds_str);
+    static std::optional<TickSeekEntry> last_tick(std::string_view sim_cmds_str);
+
+    const std::vector<TickSeekEntry> &entries() const;
+    uint64_t num_ticks() const;
+    // false if the build was stopped early
+    bool complete() const;
+    // [begin, end) byte range of the section holding every command with start <= tick <= end, give
+    // or take a stride. begin is 0 if no entry is before start, so the commands ahead of the first
+    // tick are included.
+    std::pair<size_t, size_t> byte_range(uint64_t start, uint64_t end) const;
+
+private:
+    std::vector<TickSeekEntry> m_entries;
+    uint64_t m_num_ticks{};
+    size_t m_size{};
+    bool m_complete{};
+};
+
+} // namespace surf
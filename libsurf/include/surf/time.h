@@ -2,8 +2,11 @@
 
 #include "common.h"
 
+#include <span>
+
 namespace surf {
 
+// A tick is 10^timebase_power seconds.
 class SURF_EXPORT Time {
 public:
     Time();
@@ -12,14 +15,47 @@ public:
     uint64_t ticks() const;
     double seconds() const;
     int timebase_power() const;
+    // rounds to the nearest tick, throws std::range_error for negative or unrepresentable times
     static uint64_t seconds_to_ticks(double seconds, int timebase_power);
-    static double ticks_to_seconds(uint64_t seconds, int timebase_power);
+    static double ticks_to_seconds(uint64_t ticks, int timebase_power);
 
 private:
     int m_timebase_power;
     uint64_t m_ticks;
 };
 
+// Maps the ticks [start, end] onto width pixel columns, pixel x covers the ticks
+// [pixel_tick(x), pixel_tick(x + 1)). Both directions are exact integer math so a tick lands in
+// the same column whether it is mapped on its own or in a batch.
+class SURF_EXPORT Viewport {
+public:
+    Viewport(uint64_t start, uint64_t end, uint32_t width);
+    Viewport(const Time &start, const Time &end, uint32_t width);
+
+    uint64_t start() const;
+    uint64_t end() const;
+    uint32_t width() const;
+    // width of the narrowest pixel, span / width
+    uint64_t ticks_per_pixel() const;
+
+    uint64_t pixel_tick(uint32_t x) const;
+    // ticks outside of [start, end] clamp to the first or last column
+    uint32_t pixel(uint64_t tick) const;
+    // pixels[i] = pixel(ticks[i]), sizes have to match
+    void pixels(std::span<const uint64_t> ticks, std::span<uint32_t> pixels) const;
+
+private:
+    uint64_t m_start;
+    uint64_t m_end;
+    uint64_t m_span;
+    uint32_t m_width;
+    // m_span / m_width and m_span % m_width
+    uint64_t m_ticks_per_pixel;
+    uint64_t m_ticks_rem;
+    // estimate of pixels per tick, pixel() corrects it
+    double m_scale;
+};
+
 } // namespace surf
 
 template <> struct fmt::formatter<surf::Time> {
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "common.h"
+#include "trace.h"
+#include "vcd.h"
+
+#include <span>
+
+namespace surf {
+
+struct TraceWriterOptions {
+    // zstd compress runs of tick_logs into seekable blocks, see trace_format::BlockIndexEntry
+    bool compress{};
+    int zstd_level{3};
+    // uncompressed size at which a block is closed
+    size_t block_size{1024 * 1024};
+};
+
+// Streams tick_logs out to an "Indexed" Surf trace. Ticks have to be added in increasing order,
+// changes before the first tick are logged at tick 0. The file only gets a valid header once
+// finish() succeeds, so a half written trace is never mistaken for a complete one.
+class SURF_EXPORT TraceWriter {
+public:
+    TraceWriter(const std::filesystem::path &path, int timebase_power,
+                std::vector<TraceSignal> signals, TraceWriterOptions options = {});
+    ~TraceWriter();
+
+    void add_tick(uint64_t tick);
+    void add_logic(uint32_t sig, Logic logic);
+    // values wider than the signal are truncated, narrower ones zero extended or, with a leading
+    // X or Z, X/Z extended
+    void add_bits(uint32_t sig, bitview bits, std::optional<bitview> xz = std::nullopt);
+    void add_real(uint32_t sig, double real);
+    // arena: the one a wide BinaryNum was parsed into, if any
+    void add_change(const VCDTypes::Change &change, const VarBitArena *arena = nullptr);
+    // ticks and changes, comments are skipped
+    // arenas: the per signal arenas wide values were parsed into, empty if there are none
+    void add_sim_cmds(std::span<const VCDTypes::SimCmd> cmds,
+                      std::span<const VarBitArena> arenas = {});
+    void finish();
+
+    static std::vector<TraceSignal> signals_from_declarations(const VCDTypes::Declarations &decls);
+    static void write_document(const VCDTypes::Document &doc, int timebase_power,
+                               const std::filesystem::path &path, TraceWriterOptions options = {});
+
+private:
+    void check_sig(uint32_t sig, SignalKind kind) const;
+    void append_bytes(bitview bits, varbit::sz_t bitsize);
+    void flush_tick_log();
+    void append_snapshot();
+    void update_state();
+    void flush_block();
+    void flush_out();
+
+    const std::filesystem::path m_path;
+    int m_fd;
+    int m_timebase_power;
+    TraceWriterOptions m_options;
+    std::vector<TraceSignal> m_signals;
+    std::vector<trace_format::TickIndexEntry> m_index;
+    uint64_t m_tick{};
+    bool m_seen_tick{};
+    bool m_finished{};
+    uint64_t m_num_ticks{};
+    uint64_t m_start_tick{};
+    // compressed: block under construction and the index of the finished ones
+    std::vector<uint8_t> m_block;
+    trace_format::BlockIndexEntry m_block_entry{};
+    std::vector<trace_format::BlockIndexEntry> m_blocks;
+    // compressed: last encoded value of every signal, empty before its first change
+    std::vector<std::vector<uint8_t>> m_state;
+    // tick_log under construction
+    std::vector<uint32_t> m_sigs;
+    std::vector<uint32_t> m_value_bit_offsets;
+    std::vector<uint8_t> m_value_buf;
+    size_t m_value_bits{};
+    // encoded tick_logs not yet written to m_fd
+    std::vector<uint8_t> m_out;
+    uint64_t m_file_off{};
+};
+
+} // namespace surf
@@ -1,23 +1,177 @@
 #pragma once
 
+#include "columns.h"
 #include "common.h"
+#include "mmap.h"
 #include "time.h"
 
+#include <mutex>
+#include <span>
+
 namespace surf {
 
+// On disk layout of the "Indexed" tick_log Surf trace, see doc/surf-trace-format.md.
+// Everything is little endian and 8 byte aligned so a mapping of the file can be used in place.
+namespace trace_format {
+
+SURF_SCA magic   = UINT64_C(0x0031435254465253); // "SRFTRC1\0"
+SURF_SCA version = 2u;
+
+// FileHeader::flags
+SURF_SCA file_flag_zstd = uint32_t{1 << 0};
+
+struct FileHeader {
+    uint64_t magic;
+    uint32_t version;
+    int32_t timebase_power;
+    uint64_t start_tick;
+    uint64_t end_tick;
+    uint32_t num_signals;
+    uint32_t flags;
+    uint64_t num_ticks;
+    uint64_t signals_offset;
+    // TickIndexEntry[num_ticks] or, with file_flag_zstd, BlockIndexEntry[num_blocks]
+    uint64_t index_offset;
+    // version >= 2
+    uint64_t num_blocks;
+};
+static_assert(sizeof(FileHeader) == 72);
+SURF_SCA file_header_v1_size = 64u;
+
+struct TickLogHeader {
+    uint64_t tick;
+    uint32_t num_changes;
+    uint32_t value_buf_size;
+    // uint32_t sigs[num_changes];
+    // uint32_t value_bit_offsets[num_changes];
+    // uint8_t value_buf[value_buf_size];
+    // padding to 8 bytes
+};
+static_assert(sizeof(TickLogHeader) == 16);
+
+struct TickIndexEntry {
+    uint64_t tick;
+    uint64_t offset;
+};
+static_assert(sizeof(TickIndexEntry) == 16);
+
+// A zstd compressed trace stores runs of tick_logs as independently decompressible blocks. Each
+// block starts with a sync snapshot tick_log holding the value of every signal that changed before
+// the block. In a block, the snapshot's tick is absolute and every following tick is a delta from
+// the one before it.
+struct BlockIndexEntry {
+    uint64_t first_tick;
+    uint64_t last_tick;
+    uint64_t first_tick_idx;
+    uint64_t offset;
+    uint32_t compressed_size;
+    uint32_t decompressed_size;
+    uint32_t num_ticks;
+    uint32_t reserved;
+};
+static_assert(sizeof(BlockIndexEntry) == 48);
+
+// leading byte of an encoded vector value
+SURF_SCA vector_flag_xz = uint8_t{1 << 0};
+
+}; // namespace trace_format
+
+struct TraceSignal {
+    uint32_t bitsize;
+    SignalKind kind;
+    uint8_t reserved[3];
+};
+static_assert(sizeof(TraceSignal) == 8);
+
+// Zero copy view of one encoded tick_log inside a mapped trace or a decompressed block. owner
+// keeps a decompressed block alive for as long as the view is.
+class SURF_EXPORT TickLog {
+public:
+    TickLog(const uint8_t *log, const TraceSignal *signals,
+            std::shared_ptr<const void> owner = nullptr);
+
+    uint64_t tick() const;
+    uint32_t num_changes() const;
+    std::span<const uint32_t> sigs() const;
+    uint32_t sig(size_t idx) const;
+    const TraceSignal &signal(size_t idx) const;
+
+    // signal(idx).kind == scalar
+    Logic logic(size_t idx) const;
+    // signal(idx).kind == vector
+    bitview bits(size_t idx) const;
+    // X/Z plane of a vector value, a set bit makes the matching value bit X (1) or Z (0)
+    std::optional<bitview> xz(size_t idx) const;
+    // signal(idx).kind == real
+    double real(size_t idx) const;
+
+    // encoded size including padding
+    size_t size() const;
+
+private:
+    const trace_format::TickLogHeader *m_hdr;
+    const uint32_t *m_sigs;
+    const uint32_t *m_value_bit_offsets;
+    const uint8_t *m_value_buf;
+    const TraceSignal *m_signals;
+    std::shared_ptr<const void> m_owner;
+};
+
+struct TraceBlock;
+class TraceBlockCache;
+
 class SURF_EXPORT Trace {
 public:
-    Trace(const std::filesystem::path &path);
+    SURF_SCA default_block_cache_sz = 64;
+
+    // block_cache_sz: decompressed blocks kept around for a compressed trace
+    Trace(const std::filesystem::path &path, size_t block_cache_sz = default_block_cache_sz);
+    ~Trace();
+    const std::filesystem::path &path() const;
     int timebase_power() const;
     Time start() const;
     Time end() const;
+    uint32_t num_signals() const;
+    std::span<const TraceSignal> signals() const;
+    size_t num_ticks() const;
+    TickLog tick_log(size_t idx) const;
+    // index of the last tick_log at or before tick, nullopt if the trace starts after it
+    std::optional<size_t> tick_log_index(uint64_t tick) const;
+    // [first, last) indices of the tick_logs with start <= tick <= end, only the blocks holding
+    // the two boundaries are decompressed
+    std::pair<size_t, size_t> tick_log_range(uint64_t start, uint64_t end) const;
+
+    bool compressed() const;
+    size_t num_blocks() const;
+    // index of the block holding tick_log tick_idx
+    size_t block_index(size_t tick_idx) const;
+    // values of all the signals that changed before block block_idx, at its first tick
+    TickLog block_snapshot(size_t block_idx) const;
+
+    // Per signal columns of the whole trace for value_at/next_change/prev_change/changes_in
+    // queries, transposed on first use. Safe to query from many threads at once.
+    const SignalColumns &columns() const;
 
 private:
-    const std::filesystem::path m_path;
-    int m_fd;
+    // the tick_log at log, which has avail bytes after it. Throws std::domain_error if it runs
+    // past them or refers to a signal the trace doesn't have.
+    TickLog checked_tick_log(const uint8_t *log, size_t avail,
+                             std::shared_ptr<const void> owner = nullptr) const;
+    std::shared_ptr<const TraceBlock> block(size_t block_idx) const;
+    std::shared_ptr<const TraceBlock> decompress_block(size_t block_idx) const;
+
+    MappedReadOnlyFile m_mapped_file;
+    const trace_format::FileHeader *m_hdr;
+    const TraceSignal *m_signals;
+    const trace_format::TickIndexEntry *m_index;
+    const trace_format::BlockIndexEntry *m_block_index;
+    size_t m_num_blocks;
+    std::unique_ptr<TraceBlockCache> m_block_cache;
     int m_timebase_power;
     Time m_start;
     Time m_end;
+    mutable std::once_flag m_columns_once_flag;
+    mutable std::optional<SignalColumns> m_columns;
 };
 
 } // namespace surf
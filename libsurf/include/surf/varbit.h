@@ -2,7 +2,8 @@
 
 #include "common.h"
 
-#include <arm_neon.h>
+#include <cassert>
+#include <cstring>
 
 // TODO: optimize/remove/#ifguard masking off of bits
 
@@ -18,6 +19,7 @@ public:
         assert(bitsz > 0);
     }
     template <typename T>
+        requires(!std::is_pointer_v<T>)
     bitview(const T &buf, varbit::sz_t bitsz) : m_buf{(const uint8_t *)&buf}, m_size{bitsz} {
         assert(bitsz > 0 && bitsz <= sizeof(T) * CHAR_BIT);
     }
@@ -37,98 +39,28 @@ private:
     varbit::sz_t m_size;
 };
 
-class bitarray4 {
-public:
-    bitarray4(uint8_t bits, uint8_t bitsz) : m_buf{bits}, m_size{bitsz} {
-        assert(m_size > 0 && m_size <= 4);
-    }
-    bitarray4(bitview bv) : m_buf{*bv.data()}, m_size{(uint8_t)bv.bitsize()} {
-        assert(m_size > 0 && m_size <= 4);
-    }
-
-    bitview bitview() const {
-        return surf::bitview{data(), bitsize()};
-    }
-    const uint8_t *data() const {
-        return &m_buf;
-    }
-    varbit::sz_t bitsize() const {
-        return m_size;
-    }
-    varbit::sz_t bytesize() const {
-        return sizeof(m_buf);
-    }
-
-private:
-    uint8_t m_buf;
-    uint8_t m_size;
-};
-
-class bitarray10 {
-public:
-    bitarray10(uint16_t bits, uint8_t bitsz) : m_buf{bits}, m_size{bitsz} {
-        assert(m_size > 0 && m_size <= 10);
-    }
-    bitarray10(bitview bv) : m_size{(uint8_t)bv.bitsize()} {
-        assert(m_size > 0 && m_size <= 10);
-        memcpy(&m_buf, bv.data(), bv.bytesize());
-    }
-
-    bitview bitview() const {
-        return surf::bitview{data(), bitsize()};
-    }
-    const uint8_t *data() const {
-        return (uint8_t *)&m_buf;
-    }
-    varbit::sz_t bitsize() const {
-        return m_size;
-    }
-    varbit::sz_t bytesize() const {
-        return sizeof(m_buf);
-    }
-
-private:
-    uint16_t m_buf;
-    uint8_t m_size;
-};
-
-std::string bitview2string(bitview bv) {
-    std::string bitstring;
-    const auto data        = bv.data();
-    const auto bitsize     = bv.bitsize();
-    const ssize_t bytesize = (ssize_t)bv.bytesize();
-    if (bitsize == 0) {
-        return "";
-    }
-    if (bitsize == 1) {
-        return (*bv.data() & 1) ? "1" : "0";
-    }
-    bitstring.reserve(bytesize * 8);
-    const uint64x2_t magic       = {0x8040201008040201ull, 0x8040201008040201ull};
-    const uint64x2_t mask        = {0x8080808080808080ull, 0x8080808080808080ull};
-    const uint64x2_t ascii_zeros = {0x3030303030303030ull, 0x3030303030303030ull};
-    ssize_t i                    = 0;
-#pragma clang loop unroll_count(4)
-    for (; i <= bytesize - (ssize_t)sizeof(uint16_t); i += sizeof(uint16_t)) {
-        // MCA_BEGIN("bitview2string_inner_loop");
-        const uint64x2_t words               = {*(uint8_t *)(data + i), *(uint8_t *)(data + i + 1)};
-        const uint64x2_t ones_or_zeros       = ((magic * words) & mask) >> 7;
-        const uint64x2_t ones_or_zeros_ascii = ones_or_zeros + ascii_zeros;
-        const auto ts =
-            std::string_view{(const char *)&ones_or_zeros_ascii, sizeof(ones_or_zeros_ascii)};
-        bitstring += ts;
-        // MCA_END("bitview2string_inner_loop");
-    }
-    for (; i < bytesize; ++i) {
-        uint8_t byte = data[i];
-        for (int8_t j = 7; j >= 0; --j) {
-            const auto bit = (byte >> j) & 1;
-            bitstring.push_back(bit ? '1' : '0');
-        }
-    }
-    bitstring.erase(bitstring.begin(), bitstring.begin() + (bytesize * CHAR_BIT - bitsize));
-    return bitstring;
-}
+// digits most significant first, SIMD kernels picked at compile time
+std::string bitview2string(bitview bv);
+// lower case, (bitsize + 3) / 4 digits
+std::string bitview2hex(bitview bv);
+
+// Bulk operations on whole values, SIMD kernels picked at compile time like the string
+// conversions. Bits past bitsize in the last byte are ignored on input and cleared in out, which
+// has to hold the bytesize of the result and must not overlap the inputs.
+
+// same width and bits
+bool bitview_equal(bitview a, bitview b);
+uint32_t bitview_popcount(bitview bv);
+// number of differing bits, a and b have to be the same width
+uint32_t bitview_hamming(bitview a, bitview b);
+// bits that differ, a and b have to be the same width
+void bitview_xor(bitview a, bitview b, uint8_t *out);
+// bits [lsb, lsb + bitsz) of bv, so [31:16] is lsb 16, bitsz 16
+void bitview_slice(bitview bv, varbit::sz_t lsb, varbit::sz_t bitsz, uint8_t *out);
+// {hi, lo}, lo in the least significant bits
+void bitview_concat(bitview hi, bitview lo, uint8_t *out);
+// bit i to bit bitsize - 1 - i
+void bitview_reverse(bitview bv, uint8_t *out);
 
 namespace varbit {
 
@@ -136,235 +68,11 @@ static constexpr sz_t bytesize4bitsize(sz_t bitsz) {
     return roundup_pow2_mul(bitsz, 8) / 8;
 }
 
-// bit 0: is_not_ptr
-enum class tag_ty : uint8_t {
-    ptr          = 0b00,
-    ptr_inline56 = 0b10,
-    inline4      = 0b01,
-    inline10     = 0b11
-};
-
-// bit 0: is_not_ptr
-enum class raw_buf_ptr_tag_ty : uint8_t {
-    ptr     = 0b0,
-    inlined = 0b1
-};
-
-enum class ptr_ty : uint8_t {
-    b10_inline72,
-    b10_heap,
-    b16_inline_120,
-    b16_heap,
-};
-
-class SURF_PACKED tag_byte_inline4 {
-public:
-    SURF_SCA tag_ty_bitpos        = 0;
-    SURF_SCA tag_ty_sz            = 2;
-    SURF_SCA nbits_minus_1_bitpos = 2;
-    SURF_SCA nbits_minus_1_sz     = 2;
-    SURF_SCA bits_bitpos          = 4;
-    SURF_SCA bits_sz              = 2;
-    static_assert(tag_ty_sz + nbits_minus_1_sz + bits_sz <= sizeof(uint8_t) * CHAR_BIT);
-
-    tag_byte_inline4(bitview bv) {
-        assert(bv.bitsize() > 0 && bv.bitsize() <= 4);
-        m_byte = (magic_enum::enum_integer(tag_ty::inline4) & pow2_mask(tag_ty_sz))
-                 << tag_ty_bitpos;
-        m_byte |= ((bv.bitsize() - 1) & pow2_mask(nbits_minus_1_sz)) << nbits_minus_1_bitpos;
-        m_byte |= (*bv.data() & pow2_mask(bits_sz)) << bits_bitpos;
-    }
-
-    uint8_t bitsize() const {
-        return 1 + ((m_byte >> nbits_minus_1_bitpos) & pow2_mask(nbits_minus_1_sz));
-    }
-    uint8_t bytesize() const {
-        return bytesize4bitsize(bitsize());
-    }
-
-    bitarray4 bitarray4() {
-        uint8_t bits = (m_byte >> bits_bitpos) & pow2_mask(bits_sz);
-        return surf::bitarray4(bits, bitsize());
-    }
-
-private:
-    uint8_t m_byte;
-};
-static_assert(sizeof(tag_byte_inline4) == sizeof(uint8_t));
-
-class SURF_PACKED tag_word_inline10 {
-public:
-    SURF_SCA tag_ty_bitpos = 0;
-    SURF_SCA tag_ty_sz     = 2;
-    SURF_SCA nbits_bitpos  = 2;
-    SURF_SCA nbits_sz      = 4;
-    SURF_SCA bits_bitpos   = 6;
-    SURF_SCA bits_sz       = 10;
-    static_assert(tag_ty_sz + nbits_sz + bits_sz <= sizeof(uint16_t) * CHAR_BIT);
-
-    tag_word_inline10(bitview bv) {
-        assert(bv.bitsize() > 0 && bv.bitsize() <= 10);
-        m_word = (magic_enum::enum_integer(tag_ty::inline10) & pow2_mask(tag_ty_sz))
-                 << tag_ty_bitpos;
-        m_word |= (bv.bitsize() & pow2_mask(nbits_sz)) << nbits_bitpos;
-        uint16_t bits;
-        memcpy(&bits, bv.data(), bv.bytesize());
-        m_word |= (bits & pow2_mask(bits_sz)) << bits_bitpos;
-    }
-
-    uint8_t bitsize() const {
-        return ((m_word >> nbits_bitpos) & pow2_mask(nbits_sz));
-    }
-    uint8_t bytesize() const {
-        return bytesize4bitsize(bitsize());
-    }
-
-    bitarray10 bitarray10() {
-        uint16_t bits = (m_word >> bits_bitpos) & pow2_mask(bits_sz);
-        return surf::bitarray10(bits, bitsize());
-    }
-
-private:
-    uint16_t m_word;
-};
-static_assert(sizeof(tag_word_inline10) == sizeof(uint16_t));
-
-class SURF_PACKED tagged_ptr_inline56 {
-public:
-    SURF_SCA tag_ty_bitpos = 0;
-    SURF_SCA tag_ty_sz     = 2;
-    SURF_SCA nbits_bitpos  = 2;
-    SURF_SCA nbits_sz      = 6;
-    static_assert(tag_ty_sz + nbits_sz <= sizeof(uint8_t) * CHAR_BIT);
-
-    tagged_ptr_inline56(bitview bv) {
-        assert(bv.bitsize() > 0 && bv.bitsize() <= 56);
-        m_tag_byte = (magic_enum::enum_integer(tag_ty::ptr_inline56) & pow2_mask(tag_ty_sz))
-                     << tag_ty_bitpos;
-        m_tag_byte |= (bv.bitsize() & pow2_mask(nbits_sz)) << nbits_bitpos;
-        memcpy(m_buf, bv.data(), bv.bytesize());
-    }
-
-    const uint8_t *data() const {
-        return m_buf;
-    }
-    uint8_t bitsize() const {
-        return ((m_tag_byte >> nbits_bitpos) & pow2_mask(nbits_sz));
-    }
-    uint8_t bytesize() const {
-        return bytesize4bitsize(bitsize());
-    }
-
-    bitview bitview() const {
-        return surf::bitview{data(), bitsize()};
-    }
-
-private:
-    uint8_t m_tag_byte;
-    uint8_t m_buf[7];
-};
-static_assert(sizeof(tagged_ptr_inline56) == sizeof(void *));
-
-union tagged_ptr {
-    const uintptr_t m_ptrint;
-    tagged_ptr_inline56 m_inline56;
-};
-
-class SURF_PACKED heap_array_b10_inline72 {
-public:
-    SURF_SCA raw_buf_ptr_tag_ty_bitpos = 0;
-    SURF_SCA raw_buf_ptr_tag_ty_sz     = 1;
-    SURF_SCA nbits_bitpos              = 1;
-    SURF_SCA nbits_sz                  = 7;
-    static_assert(raw_buf_ptr_tag_ty_bitpos + nbits_sz <= sizeof(uint8_t) * CHAR_BIT);
-
-    heap_array_b10_inline72(bitview bv) {
-        assert(bv.bitsize() > 0 && bv.bitsize() <= 72);
-        m_buf_tag = (magic_enum::enum_integer(raw_buf_ptr_tag_ty::inlined) &
-                     pow2_mask(raw_buf_ptr_tag_ty_sz))
-                    << raw_buf_ptr_tag_ty_bitpos;
-        m_buf_tag |= (bv.bitsize() & pow2_mask(nbits_sz)) << nbits_bitpos;
-        memcpy(m_buf, bv.data(), bv.bytesize());
-    }
-
-    const uint8_t *data() const {
-        return m_buf;
-    }
-    uint8_t bitsize() const {
-        return ((m_buf_tag >> nbits_bitpos) & pow2_mask(nbits_sz));
-    }
-    uint8_t bytesize() const {
-        return bytesize4bitsize(bitsize());
-    }
-
-    bitview bitview() const {
-        return surf::bitview{data(), bitsize()};
-    }
-
-private:
-    uint8_t m_buf_tag;
-    uint8_t m_buf[9];
-};
-static_assert(sizeof(heap_array_b10_inline72) == 10);
-
-struct SURF_PACKED heap_array_b10_ptr {
-    std::unique_ptr<uint8_t[]> m_buf;
-    sz_t m_size;
-};
-
-union heap_array_b10 {
-    uint8_t m_tag_byte;
-    heap_array_b10_inline72 m_inline72;
-    heap_array_b10_ptr m_buf_ptr;
-};
-
-class SURF_PACKED heap_array_b16_inline120 {
-public:
-    SURF_SCA raw_buf_ptr_tag_ty_bitpos = 0;
-    SURF_SCA raw_buf_ptr_tag_ty_sz     = 1;
-    SURF_SCA nbits_bitpos              = 1;
-    SURF_SCA nbits_sz                  = 7;
-    static_assert(raw_buf_ptr_tag_ty_bitpos + nbits_sz <= sizeof(uint8_t) * CHAR_BIT);
-
-    heap_array_b16_inline120(bitview bv) {
-        assert(bv.bitsize() > 0 && bv.bitsize() <= 120);
-        m_buf_tag = (magic_enum::enum_integer(raw_buf_ptr_tag_ty::inlined) &
-                     pow2_mask(raw_buf_ptr_tag_ty_sz))
-                    << raw_buf_ptr_tag_ty_bitpos;
-        m_buf_tag |= (bv.bitsize() & pow2_mask(nbits_sz)) << nbits_bitpos;
-        memcpy(m_buf, bv.data(), bv.bytesize());
-    }
-
-    const uint8_t *data() const {
-        return m_buf;
-    }
-    uint8_t bitsize() const {
-        return ((m_buf_tag >> nbits_bitpos) & pow2_mask(nbits_sz));
-    }
-    uint8_t bytesize() const {
-        return bytesize4bitsize(bitsize());
-    }
-
-    bitview bitview() const {
-        return surf::bitview{data(), bitsize()};
-    }
-
-private:
-    uint8_t m_buf_tag;
-    uint8_t m_buf[15];
-};
-static_assert(sizeof(heap_array_b16_inline120) == 16);
-
-struct SURF_PACKED heap_array_b16_ptr {
-    std::unique_ptr<uint8_t[]> m_buf;
-    sz_t m_size;
-};
-
-// bit 0: is_ptr
+// bit 0: is_inlined
 // bit 1: is_bit
-// if (!is_ptr && !is_bit)
-// bit 2-7: size (0 - 56 bytes)
-// else
+// if (is_inlined && !is_bit)
+// bit 2-7: size (1 - 56 bits), 0 for a reference into a VarBitArena
+// else if (is_bit)
 // bit 2: bitval
 class tag_byte {
 public:
@@ -379,6 +87,9 @@ public:
     static_assert(is_inlined_bitpos + is_bit_sz + size_sz <= sizeof(uint8_t) * CHAR_BIT);
 
     uint8_t bitsize() const {
+        if (is_bit()) {
+            return 1;
+        }
         return (m_byte >> size_bitpos) & pow2_mask(size_sz);
     }
     bool is_ptr() const {
@@ -387,6 +98,9 @@ public:
     bool is_bit() const {
         return (m_byte >> is_bit_bitpos) & pow2_mask(is_bit_sz);
     }
+    bool is_arena() const {
+        return m_byte == pow2(is_inlined_bitpos);
+    }
     SURF_SCA for_inlined(sz_t bitsz) {
         return tag_byte{bitsz};
     }
@@ -396,18 +110,21 @@ public:
     SURF_SCA for_bit(bool bit) {
         return tag_byte{bit};
     }
+    SURF_SCA for_arena() {
+        return tag_byte{sz_t{0}};
+    }
 
 private:
     constexpr tag_byte() : m_byte{} {}
 
-    constexpr tag_byte(sz_t bitsz) {
+    constexpr tag_byte(sz_t bitsz) : m_byte{} {
         assert(bitsz <= 56);
         assert(bitsz < pow2(size_sz));
         m_byte |= pow2(is_inlined_bitpos);
         m_byte |= bitsz << size_bitpos;
     }
 
-    constexpr tag_byte(bool bit) {
+    constexpr tag_byte(bool bit) : m_byte{} {
         m_byte |= pow2(is_inlined_bitpos);
         m_byte |= pow2(is_bit_bitpos);
         m_byte |= ((uint8_t)bit) << bitval_bitpos;
@@ -428,11 +145,16 @@ public:
     varbit_inline(bitview bv) : m_tag{tag_byte::for_inlined(bv.bitsize())} {
         std::copy(bv.data(), bv.data() + bv.bytesize(), m_buf);
     }
-    varbit_inline(bool bit) : m_tag{tag_byte::for_bit(bit)} {}
+    varbit_inline(bool bit) : m_tag{tag_byte::for_bit(bit)}, m_buf{(uint8_t)bit} {}
+    // zeroed bits
+    explicit varbit_inline(sz_t bitsz) : m_tag{tag_byte::for_inlined(bitsz)}, m_buf{} {}
 
     const uint8_t *data() const {
         return m_buf;
     }
+    uint8_t *data() {
+        return m_buf;
+    }
     bitview bitview() const {
         return surf::bitview{data(), bitsize()};
     }
@@ -452,19 +174,34 @@ private:
 };
 static_assert(sizeof(varbit_inline) == sizeof(void *));
 
+// Size header with the bits right behind it in the same allocation.
 class varbit_heap {
 public:
     constexpr static sz_t bytesize(sz_t bitsz) {
         return roundup_pow2_mul(bitsz, 8) / 8;
     }
 
-    varbit_heap(bitview bv) {
-        m_buf  = std::unique_ptr<uint8_t[]>{new uint8_t[bv.bytesize()]};
-        m_size = bv.bitsize();
-        std::copy(bv.data(), bv.data() + bv.bytesize(), m_buf.get());
+    static varbit_heap *create(bitview bv) {
+        auto *heap = create(bv.bitsize());
+        std::copy(bv.data(), bv.data() + bv.bytesize(), heap->data());
+        return heap;
+    }
+    // zeroed bits
+    static varbit_heap *create(sz_t bitsz) {
+        auto *mem = ::operator new(sizeof(varbit_heap) + bytesize(bitsz));
+        auto *heap = new (mem) varbit_heap{bitsz};
+        std::fill_n(heap->data(), bytesize(bitsz), 0);
+        return heap;
     }
+    static void destroy(varbit_heap *heap) {
+        ::operator delete(heap);
+    }
+
     const uint8_t *data() const {
-        return m_buf.get();
+        return (const uint8_t *)(this + 1);
+    }
+    uint8_t *data() {
+        return (uint8_t *)(this + 1);
     }
     bitview bitview() const {
         return surf::bitview{data(), bitsize()};
@@ -477,14 +214,67 @@ public:
     }
 
 private:
-    std::unique_ptr<uint8_t[]> m_buf;
+    explicit varbit_heap(sz_t bitsz) : m_size{bitsz} {}
+
+    // keeps the heap pointer's tag bit clear and the bits 8 byte aligned
+    alignas(uint64_t) sz_t m_size;
+};
+static_assert(sizeof(varbit_heap) == sizeof(uint64_t));
+
+// Reference to bits inside a VarBitArena.
+class SURF_PACKED varbit_arena_ref {
+public:
+    varbit_arena_ref(sz_t bitsz, uint32_t off)
+        : m_tag{tag_byte::for_arena()}, m_reserved{}, m_size{bitsz}, m_off{off} {}
+
+    sz_t bitsize() const {
+        return m_size;
+    }
+    uint32_t offset() const {
+        return m_off;
+    }
+
+private:
+    tag_byte m_tag;
+    uint8_t m_reserved;
     sz_t m_size;
+    uint32_t m_off;
 };
-static_assert(sizeof(varbit_heap) <= 16);
-static_assert(alignof(varbit_heap) >= alignof(void *));
+static_assert(sizeof(varbit_arena_ref) == sizeof(void *));
 
 }; // namespace varbit
 
+// Bump allocated slab for wide VarBits, typically one per signal. Values are 8 byte aligned and
+// referenced by a 32 bit offset in 8 byte units, so a million wide changes are a handful of
+// vector growths rather than a million mallocs. References stay valid as the slab grows, the
+// arena has to outlive every VarBit pointing into it.
+class SURF_EXPORT VarBitArena {
+public:
+    SURF_SCA granule_sz = sizeof(uint64_t);
+
+    // offset of bytesz zeroed bytes
+    uint32_t alloc(varbit::sz_t bytesz);
+    void reserve(size_t bytesz);
+    // bytes in use
+    size_t size() const;
+    // drops every value, leaving the VarBits pointing into the arena dangling. The capacity is
+    // kept for the next values.
+    void clear();
+
+    const uint8_t *data(uint32_t off) const {
+        return (const uint8_t *)(m_buf.data() + off);
+    }
+    uint8_t *data(uint32_t off) {
+        return (uint8_t *)(m_buf.data() + off);
+    }
+
+private:
+    std::vector<uint64_t> m_buf;
+};
+
+// Up to 56 bits live inline, wider values either in their own heap allocation or, when built
+// with an arena, in a VarBitArena. The arena form is a plain reference, copying it doesn't copy
+// the bits, and its bits can only be read through the arena.
 union SURF_EXPORT VarBit {
 public:
     constexpr static varbit::sz_t bytesize(varbit::sz_t bitsz) {
@@ -499,16 +289,71 @@ public:
                 m_inlined = varbit::varbit_inline{bv};
             }
         } else {
-            m_heap = new varbit::varbit_heap{bv};
+            m_heap = varbit::varbit_heap::create(bv);
         }
     }
+    // values too wide to inline go into arena
+    VarBit(bitview bv, VarBitArena &arena) : VarBit{zeroed(bv.bitsize(), arena)} {
+        std::copy(bv.data(), bv.data() + bv.bytesize(), data(arena));
+    }
+    VarBit(const VarBit &other) {
+        if (SURF_UNLIKELY(other.m_inlined.tag().is_ptr())) {
+            m_heap = varbit::varbit_heap::create(other.m_heap->bitview());
+        } else {
+            // inline bits or an arena reference
+            m_inlined = other.m_inlined;
+        }
+    }
+    VarBit(VarBit &&other) noexcept : m_heap{other.m_heap} {
+        // a null heap pointer is still tagged as a pointer, destroying it is a no-op
+        other.m_heap = nullptr;
+    }
+    VarBit &operator=(VarBit other) noexcept {
+        std::swap(m_heap, other.m_heap);
+        return *this;
+    }
     ~VarBit() {
         if (SURF_UNLIKELY(m_inlined.tag().is_ptr())) {
-            delete m_heap;
+            varbit::varbit_heap::destroy(m_heap);
         }
     }
 
+    // bitsz bits, all zero, to be filled in through data()
+    static VarBit zeroed(varbit::sz_t bitsz) {
+        assert(bitsz > 0);
+        VarBit res{nullptr};
+        if (SURF_LIKELY(bitsz <= 7 * CHAR_BIT)) {
+            res.m_inlined = varbit::varbit_inline{bitsz};
+        } else {
+            res.m_heap = varbit::varbit_heap::create(bitsz);
+        }
+        return res;
+    }
+    static VarBit zeroed(varbit::sz_t bitsz, VarBitArena &arena) {
+        assert(bitsz > 0);
+        VarBit res{nullptr};
+        if (SURF_LIKELY(bitsz <= 7 * CHAR_BIT)) {
+            res.m_inlined = varbit::varbit_inline{bitsz};
+        } else {
+            res.m_arena_ref = varbit::varbit_arena_ref{bitsz, arena.alloc(bytesize(bitsz))};
+        }
+        return res;
+    }
+
+    bool is_arena() const {
+        return m_inlined.tag().is_arena();
+    }
+
+    // !is_arena()
     const uint8_t *data() const {
+        assert(!is_arena());
+        if (SURF_LIKELY(!m_inlined.tag().is_ptr())) {
+            return m_inlined.data();
+        }
+        return m_heap->data();
+    }
+    uint8_t *data() {
+        assert(!is_arena());
         if (SURF_LIKELY(!m_inlined.tag().is_ptr())) {
             return m_inlined.data();
         }
@@ -517,7 +362,26 @@ public:
     bitview bitview() const {
         return surf::bitview{data(), bitsize()};
     }
+    // any form, arena is only read for an arena reference
+    const uint8_t *data(const VarBitArena &arena) const {
+        if (SURF_UNLIKELY(is_arena())) {
+            return arena.data(m_arena_ref.offset());
+        }
+        return data();
+    }
+    uint8_t *data(VarBitArena &arena) {
+        if (SURF_UNLIKELY(is_arena())) {
+            return arena.data(m_arena_ref.offset());
+        }
+        return data();
+    }
+    surf::bitview bitview(const VarBitArena &arena) const {
+        return surf::bitview{data(arena), bitsize()};
+    }
     varbit::sz_t bitsize() const {
+        if (SURF_UNLIKELY(is_arena())) {
+            return m_arena_ref.bitsize();
+        }
         if (SURF_LIKELY(!m_inlined.tag().is_ptr())) {
             return m_inlined.bitsize();
         }
@@ -528,11 +392,20 @@ public:
     }
 
 private:
+    explicit VarBit(std::nullptr_t) : m_heap{nullptr} {}
+
     varbit::varbit_heap *m_heap;
     varbit::varbit_inline m_inlined;
+    varbit::varbit_arena_ref m_arena_ref;
 };
 static_assert(sizeof(VarBit) == sizeof(void *));
 
+// the bitview operations above into a fresh VarBit
+VarBit bitview_xor(bitview a, bitview b);
+VarBit bitview_slice(bitview bv, varbit::sz_t lsb, varbit::sz_t bitsz);
+VarBit bitview_concat(bitview hi, bitview lo);
+VarBit bitview_reverse(bitview bv);
+
 }; // namespace surf
 
 template <> struct fmt::formatter<surf::bitview> {
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "columns.h"
+#include "common.h"
+#include "time.h"
+#include "vcd-stream.h"
+
+#include <chrono>
+
+namespace surf {
+
+// Follows a VCD that a simulator is still writing. Only the bytes appended since the last update
+// are read and parsed, their changes are appended to columns() in place. On Linux inotify wakes
+// follow() as soon as the file is written, elsewhere it checks every poll_interval. Not thread
+// safe, render from the thread that calls update()/follow().
+class SURF_EXPORT VCDFollower {
+public:
+    SURF_SCA poll_interval = std::chrono::milliseconds{50};
+
+    // reads what has been written so far
+    explicit VCDFollower(const std::filesystem::path &path);
+    ~VCDFollower();
+
+    // parses what was appended since the last update, returns whether anything was. Until the
+    // definitions are complete there are no columns and nothing is parsed.
+    bool update();
+    // waits up to timeout for the file to be written to, then updates
+    bool follow(std::chrono::milliseconds timeout);
+    // parses a trailing command not yet terminated by whitespace, for once the simulator is done
+    void finish();
+
+    bool has_declarations() const;
+    // has_declarations()
+    const VCDTypes::Declarations &declarations() const;
+    const SignalColumns &columns() const;
+    int timebase_power() const;
+    Time start() const;
+    // the last tick parsed so far
+    Time end() const;
+    const std::filesystem::path &path() const;
+
+private:
+    // true if there may be new data
+    bool wait(std::chrono::milliseconds timeout);
+    void close_fds();
+
+    const std::filesystem::path m_path;
+    int m_fd;
+    int m_inotify_fd{-1};
+    VCDStream m_stream;
+    const VCDTypes::Declarations *m_decls{};
+    std::optional<SignalColumns> m_columns;
+};
+
+} // namespace surf
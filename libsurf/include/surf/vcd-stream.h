@@ -0,0 +1,70 @@
+#pragma once
+
+#include "chunked-reader.h"
+#include "common.h"
+#include "vcd.h"
+
+#include <functional>
+#include <span>
+
+namespace surf {
+
+// Incremental VCD reader for inputs that can't be mapped: stdin, a named pipe fed by a running
+// simulator or the output of a decompressor. Input is read in fixed size chunks, the command a
+// chunk boundary cuts off is carried over to the front of the buffer and completed by the next
+// read, and every complete command is handed to a sink as soon as it is parsed.
+class SURF_EXPORT VCDStream {
+public:
+    SURF_SCA default_chunk_size = size_t{1024} * 1024;
+
+    // cmds, including the text of their comments, are only valid during the call. Wide vector
+    // values are in arenas, one per signal, which are reused once the call returns.
+    using Sink = std::function<void(std::span<const VCDTypes::SimCmd> cmds,
+                                    std::span<const VarBitArena> arenas)>;
+
+    // fd is read from but not closed, name is only used in error messages
+    VCDStream(int fd, std::string name = "<stream>", size_t chunk_size = default_chunk_size);
+    // reads the chunks of a file from reader instead, which must outlive the stream
+    explicit VCDStream(ChunkedFileReader &reader);
+
+    // reads up to the end of the definitions, throws std::domain_error if the input ends first
+    const VCDTypes::Declarations &declarations();
+    // reads what is available, nullptr if the definitions haven't all been written yet
+    const VCDTypes::Declarations *try_declarations();
+    int timebase_power();
+    // reads a chunk and passes the commands completed by it to sink. Returns false at the end of
+    // the input, also while the definitions are incomplete, a file that is still being written
+    // can be polled again once it has grown.
+    bool poll(const Sink &sink);
+    // parses what is left as the end of the input
+    void finish(const Sink &sink);
+    // polls until the end of the input, then finishes
+    void run(const Sink &sink);
+    uint64_t bytes_read() const;
+
+private:
+    // appends up to a chunk after compacting out the consumed bytes, 0 at the end of the input
+    size_t read_chunk();
+    void parse(const Sink &sink, bool is_final);
+    // parses the definitions if they are all buffered
+    bool parse_declarations();
+
+    int m_fd;
+    ChunkedFileReader *m_reader{};
+    std::string m_name;
+    size_t m_chunk_size;
+    std::vector<char> m_buf;
+    // unparsed input is [m_head, m_tail)
+    size_t m_head{};
+    size_t m_tail{};
+    // the text of the definitions, m_decls has views into it
+    std::string m_decls_str;
+    std::optional<VCDTypes::Declarations> m_decls;
+    // per signal, cleared after every sink call
+    std::vector<VarBitArena> m_arenas;
+    // where to resume looking for $enddefinitions
+    size_t m_decls_search_pos{};
+    uint64_t m_bytes_read{};
+};
+
+} // namespace surf
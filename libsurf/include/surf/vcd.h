@@ -1,24 +1,36 @@
 #pragma once
 
+#include "columns.h"
 #include "common.h"
+#include "idcode.h"
 #include "mmap.h"
+#include "pyramid.h"
+#include "tick-index.h"
 #include "time.h"
 #include "trace.h"
 
+#include <functional>
+#include <future>
+#include <mutex>
+#include <stop_token>
+
 namespace surf {
 
 namespace VCDTypes {
 
+// The text fields of the VCD types are views into the parsed text, which has to outlive them.
+// VCDFile keeps its mapping alive for as long as it is.
+
 struct Comment {
-    std::string comment;
+    std::string_view comment;
 };
 
 struct Date {
-    std::string date;
+    std::string_view date;
 };
 
 struct Version {
-    std::string version;
+    std::string_view version;
 };
 
 enum class TimeNumber : uint8_t {
@@ -58,10 +70,24 @@ enum class VarType : uint8_t {
 };
 
 struct Var {
-    std::string id;
-    std::string ref;
+    std::string_view id;
+    std::string_view ref;
     int size;
     VarType type;
+    IDCodeTable::sig_t sig = IDCodeTable::invalid_sig;
+};
+
+// per signal index info, shared by all the Vars aliasing the same id code
+struct Signal {
+    int size;
+    VarType type;
+
+    SignalKind kind() const {
+        if (type == VarType::real || type == VarType::realtime) {
+            return SignalKind::real;
+        }
+        return size == 1 ? SignalKind::scalar : SignalKind::vector;
+    }
 };
 
 enum class ScopeType : uint8_t {
@@ -78,11 +104,105 @@ struct ScopeDecl {
     ScopeType type;
 };
 
-struct Scope {
-    std::string id;
-    std::vector<Var> vars;
-    std::vector<Scope> subscopes;
-    ScopeType type;
+// The scope hierarchy as flat arrays linked by index: each scope has a parent, a first child and
+// a next sibling, and its vars form a list the same way. Scope names live in one string arena,
+// vars keep the views the parser made. A hash table on (parent, name) finds any child scope and
+// each scope has a small table of its own for its vars, so a dotted path resolves in O(path
+// length) and adding a var only touches memory near the rest of its scope. Scope 0 is the root,
+// paths start below it.
+class SURF_EXPORT ScopeTree {
+public:
+    using index_t = uint32_t;
+    SURF_SCA invalid = std::numeric_limits<index_t>::max();
+    SURF_SCA root    = index_t{0};
+
+    ScopeTree();
+
+    void reserve(size_t num_scopes, size_t num_vars);
+    // a child scope of parent, the existing one if the VCD reopens a scope of the same name
+    index_t add_scope(index_t parent, std::string_view name, ScopeType type);
+    // returns the var's index
+    index_t add_var(index_t scope, const Var &var);
+
+    size_t num_scopes() const;
+    size_t num_vars() const;
+    std::string_view name(index_t scope) const;
+    ScopeType type(index_t scope) const;
+    // invalid for the root
+    index_t parent(index_t scope) const;
+    // invalid ends the lists
+    index_t first_child(index_t scope) const;
+    index_t next_sibling(index_t scope) const;
+    index_t first_var(index_t scope) const;
+    index_t next_var(index_t var) const;
+    index_t var_scope(index_t var) const;
+    const Var &var(index_t var) const;
+    // ref without the bit range, "data [7:0]" -> "data"
+    static std::string_view var_name(const Var &var);
+
+    // dotted from below the root, "top.cpu" and "top.cpu.pc"
+    std::string path(index_t scope) const;
+    std::string var_path(index_t var) const;
+    // invalid if there is no such scope or var. Vars are found by var_name, the first one
+    // declared if several share it.
+    index_t find_scope(std::string_view path) const;
+    index_t find_var(std::string_view path) const;
+
+    // Vars whose path matches a glob, in declaration order: '*' is any run of characters within a
+    // component, '?' any one character and a "**" component any number of components. Components
+    // without wildcards are hash lookups and subtrees that can't match aren't visited.
+    std::vector<index_t> glob(std::string_view pattern) const;
+    // Vars whose path satisfies pred, e.g. a std::regex_match. The paths are built in one buffer
+    // while walking the tree, pred gets a view of it.
+    std::vector<index_t> filter(const std::function<bool(std::string_view path)> &pred) const;
+
+private:
+    struct Node {
+        uint32_t name_off;
+        uint32_t name_len;
+        index_t parent;
+        index_t first_child;
+        index_t last_child;
+        index_t next_sibling;
+        index_t first_var;
+        index_t last_var;
+        // the scope's var table, a power of two slots in m_var_slots
+        size_t var_slots_off;
+        size_t var_slots_cap;
+        uint32_t num_var_names;
+        ScopeType type;
+    };
+    // table slots hold a scope or var index with the top half of its hash above it, so most
+    // probes never touch the names and growing a table never hashes them again. An all ones slot
+    // is empty, indices stay below this.
+    SURF_SCA max_entries = index_t{1} << 31;
+
+    // invalid if none
+    index_t find_child(index_t parent, std::string_view name) const;
+    // leaves the table as is if the parent already has a child of the same name
+    void insert_child(index_t scope);
+    void rehash_children(size_t cap);
+    // invalid if none
+    index_t find_scope_var(index_t scope, std::string_view name) const;
+    // leaves the table as is if the scope already has a var of the same name
+    void insert_var(index_t var);
+    void grow_var_slots(index_t scope);
+    void glob_from(index_t scope, std::span<const std::string_view> comps,
+                   std::vector<index_t> &res) const;
+    void filter_from(index_t scope, std::string &buf,
+                     const std::function<bool(std::string_view path)> &pred,
+                     std::vector<index_t> &res) const;
+
+    std::vector<Node> m_scopes;
+    std::string m_names;
+    std::vector<Var> m_vars;
+    std::vector<index_t> m_var_scope;
+    std::vector<index_t> m_next_var;
+    // child scopes by (parent, name), a power of two at most half full
+    std::vector<uint64_t> m_children;
+    size_t m_num_children{};
+    // every scope's var table end to end, each at most half full
+    std::vector<uint64_t> m_var_slots;
 };
 
 struct UpScope {};
@@ -95,23 +215,25 @@ struct Timescale {
 using Declaration = std::variant<Comment, Date, Version, Timescale, ScopeDecl, Var, UpScope>;
 
 struct Declarations {
-    std::optional<std::vector<std::string>> comments;
-    std::optional<std::string> date;
-    std::optional<std::string> version;
-    Scope root_scope;
+    std::optional<std::vector<std::string_view>> comments;
+    std::optional<std::string_view> date;
+    std::optional<std::string_view> version;
+    ScopeTree scopes;
     std::optional<Timescale> timescale;
+    IDCodeTable idcodes;
+    std::vector<Signal> signals;
 };
 
 struct DeclsCommentsFmt {
-    std::optional<std::vector<std::string>> const &comments;
+    std::optional<std::vector<std::string_view>> const &comments;
 };
 
 struct DeclsDateFmt {
-    std::optional<std::string> const &date;
+    std::optional<std::string_view> const &date;
 };
 
 struct DeclsVersionFmt {
-    std::optional<std::string> const &version;
+    std::optional<std::string_view> const &version;
 };
 
 struct Tick {
@@ -166,13 +288,57 @@ public:
     bool z() const {
         return m_sve == ScalarValueEnum::vZ;
     }
+    Logic logic() const {
+        if (x()) {
+            return Logic::vX;
+        }
+        if (z()) {
+            return Logic::vZ;
+        }
+        return b() ? Logic::v1 : Logic::v0;
+    }
 
 private:
     ScalarValueEnum m_sve;
 };
 
+// A "b..." vector value, bitsize is the number of digits. An X or Z digit sets its bit in the xz
+// plane and reads as 1 (X) or 0 (Z) in bits, the same split as an encoded trace vector value.
 struct BinaryNum {
-    uint64_t num;
+    VarBit bits;
+    // absent if every digit is 0 or 1
+    std::optional<VarBit> xz;
+
+    BinaryNum(VarBit bits, std::optional<VarBit> xz = std::nullopt)
+        : bits{std::move(bits)}, xz{std::move(xz)} {}
+    // the significant bits of num
+    BinaryNum(uint64_t num)
+        : bits{bitview{num, (varbit::sz_t)std::max<int>(std::bit_width(num), 1)}} {}
+
+    // parses the digits after the 'b', 0, 1, x, X, z and Z, packing them 8 at a time. Values too
+    // wide to inline go into arena if there is one.
+    static BinaryNum from_digits(std::string_view digits, VarBitArena *arena = nullptr);
+
+    // arena: the one the value was parsed into, if any
+    bitview bits_view(const VarBitArena *arena = nullptr) const {
+        return arena ? bits.bitview(*arena) : bits.bitview();
+    }
+    std::optional<bitview> xz_view(const VarBitArena *arena = nullptr) const {
+        if (!xz) {
+            return std::nullopt;
+        }
+        return arena ? xz->bitview(*arena) : xz->bitview();
+    }
+    // value of bit 0, for a vector change to a scalar signal
+    Logic logic(const VarBitArena *arena = nullptr) const {
+        const auto bit = *bits_view(arena).data() & 1;
+        if (const auto xz_bits = xz_view(arena); xz_bits && (*xz_bits->data() & 1)) {
+            return bit ? Logic::vX : Logic::vZ;
+        }
+        return bit ? Logic::v1 : Logic::v0;
+    }
+    // "b..." digits, most significant first
+    std::string digits(const VarBitArena *arena = nullptr) const;
 };
 
 struct RealNum {
@@ -183,50 +349,96 @@ using Value = std::variant<ScalarValue, BinaryNum, RealNum>;
 
 struct Change {
     Value value;
-    std::string id;
+    IDCodeTable::sig_t sig;
 };
 
 using SimCmd = std::variant<Comment, Tick, Change>;
 
-struct DocumentRawDecls {
-    std::vector<Declaration> declarations;
-    std::vector<SimCmd> sim_cmds;
-};
-
 struct Document {
     Declarations declarations;
     std::vector<SimCmd> sim_cmds;
+    // backing for wide vector values when the changes were parsed with per signal arenas, indexed
+    // by signal, empty otherwise
+    std::vector<VarBitArena> arenas;
+
+    const VarBitArena *arena(IDCodeTable::sig_t sig) const {
+        return arenas.empty() ? nullptr : &arenas[sig];
+    }
 };
 
 }; // namespace VCDTypes
 
+// exponent of the tick length in seconds, 0 without a $timescale
+SURF_EXPORT int timebase_power_from_timescale(const std::optional<VCDTypes::Timescale> &timescale);
+
 class SURF_EXPORT VCDFile {
 public:
-    VCDFile(const std::filesystem::path &path);
+    // num_threads: threads used to parse the value changes, 0 for one per core
+    // Parses the declarations and probes the first and last tick, then indexes the ticks of the
+    // value changes on a background thread. The changes themselves are parsed on demand.
+    // map_policy: how the VCD is mapped, see MapPolicy. With MapPolicy::sequential document()
+    // drops the pages of the changes behind the parallel parse as its chunks complete in order.
+    VCDFile(const std::filesystem::path &path, uint32_t num_threads = 1,
+            MapPolicy map_policy = MapPolicy::normal);
+    // reads the VCD into memory with a ChunkedFileReader instead of mapping it, see
+    // MappedReadOnlyFile
+    VCDFile(const std::filesystem::path &path, uint32_t num_threads,
+            const ChunkedFileReader::Options &read_options);
+    ~VCDFile();
     const std::filesystem::path &path() const;
-    std::shared_ptr<Trace> surf_trace() const;
+    // Surf trace converted from this VCD, cached next to it as <path>.surf
+    std::shared_ptr<Trace> surf_trace();
     int timebase_power() const;
+    // first and last tick, probed from the head and tail of the file when it is opened and never
+    // written after, so safe to read while another thread parses
     Time start() const;
     Time end() const;
     const char *data() const;
     size_t size() const;
     std::string_view string_view() const;
+    // the value changes, everything after $enddefinitions
+    std::string_view sim_cmds_string_view() const;
+    // wide vector values are parsed into the per signal document().arenas, comment text is a
+    // view into the file and lives as long as the VCDFile
     const VCDTypes::Document &document();
     const VCDTypes::Declarations &declarations() const;
+    // document().sim_cmds
     const std::vector<VCDTypes::SimCmd> &sim_cmds();
+    // waits for the background tick index
+    const TickSeekIndex &seek_index() const;
+    bool seek_index_ready() const;
+    // parses only the part of the changes holding ticks [start, end], see
+    // TickSeekIndex::byte_range, without the values signals had at start
+    std::vector<VCDTypes::SimCmd> sim_cmds_window(uint64_t start, uint64_t end) const;
+    // per signal columns for value_at/next_change/prev_change/changes_in queries, parsed and
+    // transposed on first use. Safe to query from many threads at once.
+    const SignalColumns &columns();
+    // loaded from a <path>.pyr sidecar as long as it is newer than the VCD and matches columns(),
+    // built otherwise
+    const SignalPyramids &pyramids();
     void parse_test();
 
 private:
+    // also probes the first and last tick and starts the index thread
     void parse_declarations();
     void parse_changes();
 
     VCDTypes::Document m_document;
     std::string_view m_sim_cmds_str;
     std::once_flag m_parse_once_flag;
+    SignalColumns m_columns;
+    std::once_flag m_columns_once_flag;
+    SignalPyramids m_pyramids;
+    std::once_flag m_pyramids_once_flag;
+    std::once_flag m_trace_once_flag;
     MappedReadOnlyFile m_mapped_file;
+    uint32_t m_num_threads;
     Time m_start;
     Time m_end;
     std::shared_ptr<Trace> m_trace;
+    // last so the index thread, which reads the mapping, is joined first
+    std::stop_source m_index_stop;
+    std::shared_future<TickSeekIndex> m_seek_index;
 };
 
 }; // namespace surf
@@ -259,7 +471,11 @@ template <> struct fmt::formatter<surf::VCDTypes::BinaryNum> {
     template <typename FormatContext>
     auto format(surf::VCDTypes::BinaryNum const &bnum, FormatContext &ctx) const
         -> decltype(ctx.out()) {
-        return fmt::format_to(ctx.out(), "<BinaryNum {:#0b}>", bnum.num);
+        if (bnum.bits.is_arena()) {
+            return fmt::format_to(ctx.out(), "<BinaryNum [{:d} bits in arena]>",
+                                  bnum.bits.bitsize());
+        }
+        return fmt::format_to(ctx.out(), "<BinaryNum b{:s}>", bnum.digits());
     }
 };
 
@@ -293,7 +509,7 @@ template <> struct fmt::formatter<surf::VCDTypes::Change> {
     template <typename FormatContext>
     auto format(surf::VCDTypes::Change const &change, FormatContext &ctx) const
         -> decltype(ctx.out()) {
-        return fmt::format_to(ctx.out(), "<Change ID: '{:s}' V: {}>", change.id, change.value);
+        return fmt::format_to(ctx.out(), "<Change SIG: {:d} V: {}>", change.sig, change.value);
     }
 };
 
@@ -370,16 +586,33 @@ template <> struct fmt::formatter<surf::VCDTypes::ScopeDecl> {
     }
 };
 
-template <> struct fmt::formatter<surf::VCDTypes::Scope> {
+template <> struct fmt::formatter<surf::VCDTypes::ScopeTree> {
+    using ScopeTree = surf::VCDTypes::ScopeTree;
+
     constexpr auto parse(format_parse_context &ctx) {
         return ctx.begin();
     }
     template <typename FormatContext>
-    auto format(surf::VCDTypes::Scope const &scope, FormatContext &ctx) const
-        -> decltype(ctx.out()) {
-        return fmt::format_to(ctx.out(), "<Scope {:s} {:s} vars: [{}] subscopes: [{}]>",
-                              magic_enum::enum_name(scope.type), scope.id,
-                              fmt::join(scope.vars, ", "), fmt::join(scope.subscopes, ", "));
+    auto format(ScopeTree const &tree, FormatContext &ctx) const -> decltype(ctx.out()) {
+        return format_scope(tree, ScopeTree::root, ctx.out());
+    }
+    template <typename OutputIt>
+    static OutputIt format_scope(ScopeTree const &tree, ScopeTree::index_t scope, OutputIt out) {
+        out = fmt::format_to(out, "<Scope {:s} {:s} vars: [",
+                             magic_enum::enum_name(tree.type(scope)), tree.name(scope));
+        const auto first_var = tree.first_var(scope);
+        for (auto var = first_var; var != ScopeTree::invalid; var = tree.next_var(var)) {
+            out = fmt::format_to(out, "{:s}{}", var == first_var ? "" : ", ", tree.var(var));
+        }
+        out = fmt::format_to(out, "] subscopes: [");
+        for (auto child = tree.first_child(scope); child != ScopeTree::invalid;
+             child = tree.next_sibling(child)) {
+            if (child != tree.first_child(scope)) {
+                out = fmt::format_to(out, ", ");
+            }
+            out = format_scope(tree, child, out);
+        }
+        return fmt::format_to(out, "]>");
     }
 };
 
@@ -430,20 +663,7 @@ template <> struct fmt::formatter<surf::VCDTypes::Declarations> {
         -> decltype(ctx.out()) {
         return fmt::format_to(ctx.out(), "<Declarations: {}, <Version: {}> <Date: {}> {} {}>",
                               surf::VCDTypes::DeclsCommentsFmt{decls.comments}, decls.version,
-                              decls.date, decls.timescale, decls.root_scope);
-    }
-};
-
-template <> struct fmt::formatter<surf::VCDTypes::DocumentRawDecls> {
-    constexpr auto parse(format_parse_context &ctx) {
-        return ctx.begin();
-    }
-    template <typename FormatContext>
-    auto format(surf::VCDTypes::DocumentRawDecls const &doc_raw, FormatContext &ctx) const
-        -> decltype(ctx.out()) {
-        return fmt::format_to(ctx.out(), "<DocRaw <Decls [{}]> <SimCmds [{}]>>",
-                              fmt::join(doc_raw.declarations, ", "),
-                              fmt::join(doc_raw.sim_cmds, ", "));
+                              decls.date, decls.timescale, decls.scopes);
     }
 };
 
@@ -0,0 +1,239 @@
+#include <surf/chunked-reader.h>
+
+#include "common-internal.h"
+#include "utils.h"
+
+#include <cerrno>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef SURF_HAS_URING
+#include <liburing.h>
+#endif
+
+struct ChunkedFileReader::Ring {
+#ifdef SURF_HAS_URING
+    io_uring ring{};
+#endif
+};
+
+namespace {
+
+size_t align_up(size_t sz) {
+    return (sz + ChunkedFileReader::alignment - 1) / ChunkedFileReader::alignment *
+           ChunkedFileReader::alignment;
+}
+
+// reads until len bytes or the end of the file, the first done bytes of buf are already read.
+// Returns the bytes read in total, -errno on error. O_DIRECT needs the buffer, offset and length
+// aligned, buf and offset are and the buffer has room for an aligned length, so after a short read
+// the partial block is read again rather than resuming at an unaligned done.
+int64_t pread_full(int fd, char *buf, size_t len, uint64_t offset, size_t done = 0) {
+    const auto read_len = align_up(len);
+    while (done < len) {
+        const auto pos = done / ChunkedFileReader::alignment * ChunkedFileReader::alignment;
+        const auto res = pread(fd, buf + pos, read_len - pos, (off_t)(offset + pos));
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        // the end of the file, or it shrank
+        if (pos + (size_t)res <= done) {
+            break;
+        }
+        done = pos + (size_t)res;
+    }
+    return (int64_t)std::min(done, len);
+}
+
+int open_reader(const fs::path &path, bool direct) {
+#ifdef O_DIRECT
+    if (direct) {
+        const auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+        // tmpfs and friends refuse O_DIRECT, read through the page cache instead
+        if (fd >= 0 || errno != EINVAL) {
+            posix_check(fd, fmt::format("ChunkedFileReader open '{}'", path));
+            return fd;
+        }
+    }
+#else
+    (void)direct;
+#endif
+    const auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    posix_check(fd, fmt::format("ChunkedFileReader open '{}'", path));
+    return fd;
+}
+
+}; // namespace
+
+ChunkedFileReader::ChunkedFileReader(const fs::path &path, Options options)
+    : m_path{path}, m_options{options} {
+    if (!options.chunk_size || !options.queue_depth) {
+        throw std::range_error("ChunkedFileReader: zero chunk size or queue depth");
+    }
+    m_options.chunk_size = align_up(options.chunk_size);
+    m_fd                 = open_reader(path, options.direct);
+
+    try {
+        struct stat st{};
+        posix_check(fstat(m_fd, &st), "ChunkedFileReader fstat");
+        m_size = (uint64_t)st.st_size;
+
+#ifdef SURF_HAS_URING
+        if (m_options.backend == Backend::io_uring) {
+            m_ring = std::make_unique<Ring>();
+            if (io_uring_queue_init(m_options.queue_depth, &m_ring->ring, 0) < 0) {
+                m_ring.reset();
+            }
+        }
+#endif
+        if (!m_ring) {
+            m_options.backend = Backend::pread;
+        }
+
+        m_slots.resize(m_options.queue_depth);
+        for (auto &slot : m_slots) {
+            slot.buf.reset((char *)std::aligned_alloc(alignment, m_options.chunk_size));
+            if (!slot.buf) {
+                throw std::bad_alloc();
+            }
+        }
+        for (auto &slot : m_slots) {
+            submit(slot);
+        }
+    } catch (...) {
+        // reads submitted before the throw still write into the slot buffers
+        close_file();
+        throw;
+    }
+}
+
+ChunkedFileReader::ChunkedFileReader(const fs::path &path) : ChunkedFileReader(path, Options{}) {}
+
+ChunkedFileReader::~ChunkedFileReader() {
+    close_file();
+}
+
+void ChunkedFileReader::close_file() {
+    // the kernel may still be writing into the buffers
+    for (auto &slot : m_slots) {
+        if (slot.in_flight) {
+            try {
+                wait(slot);
+            } catch (const std::exception &) {
+            }
+        }
+    }
+#ifdef SURF_HAS_URING
+    if (m_ring) {
+        io_uring_queue_exit(&m_ring->ring);
+    }
+#endif
+    close(m_fd);
+}
+
+void ChunkedFileReader::submit(Slot &slot) {
+    slot.offset = m_submit_offset;
+    slot.len    = (size_t)std::min<uint64_t>(m_options.chunk_size, m_size - m_submit_offset);
+    slot.res    = 0;
+    if (!slot.len) {
+        return;
+    }
+    m_submit_offset += slot.len;
+#ifdef SURF_HAS_URING
+    if (m_ring) {
+        auto *sqe = io_uring_get_sqe(&m_ring->ring);
+        // never more reads than ring entries, one per slot
+        assert(sqe);
+        io_uring_prep_read(sqe, m_fd, slot.buf.get(), (unsigned)align_up(slot.len), slot.offset);
+        io_uring_sqe_set_data(sqe, &slot);
+        const auto submit_res = io_uring_submit(&m_ring->ring);
+        if (submit_res < 0) {
+            errno = -submit_res;
+            posix_check(-1, "ChunkedFileReader io_uring_submit");
+        }
+        // only once submitted, a slot that never went out would wait forever for its completion
+        slot.in_flight = true;
+        return;
+    }
+#endif
+    slot.pending   = std::async(std::launch::async, [fd = m_fd, &slot] {
+        return pread_full(fd, slot.buf.get(), slot.len, slot.offset);
+    });
+    slot.in_flight = true;
+}
+
+void ChunkedFileReader::wait(Slot &slot) {
+#ifdef SURF_HAS_URING
+    if (m_ring) {
+        // completions arrive in any order, file each under its slot until this one's shows up
+        while (slot.in_flight) {
+            io_uring_cqe *cqe;
+            const auto wait_res = io_uring_wait_cqe(&m_ring->ring, &cqe);
+            if (wait_res == -EINTR) {
+                continue;
+            }
+            if (wait_res < 0) {
+                errno = -wait_res;
+                posix_check(-1, "ChunkedFileReader io_uring_wait_cqe");
+            }
+            auto *done      = (Slot *)io_uring_cqe_get_data(cqe);
+            done->res       = cqe->res;
+            done->in_flight = false;
+            io_uring_cqe_seen(&m_ring->ring, cqe);
+        }
+        if (slot.res >= 0 && (size_t)slot.res < slot.len) {
+            complete_short_read(slot);
+        }
+    }
+#endif
+    if (slot.pending.valid()) {
+        slot.res       = slot.pending.get();
+        slot.in_flight = false;
+    }
+    if (slot.res < 0) {
+        errno = (int)-slot.res;
+        posix_check(-1, fmt::format("ChunkedFileReader read '{}'", m_path));
+    }
+}
+
+void ChunkedFileReader::complete_short_read(Slot &slot) {
+    slot.res = pread_full(m_fd, slot.buf.get(), slot.len, slot.offset, (size_t)slot.res);
+}
+
+ChunkedFileReader::Chunk ChunkedFileReader::next() {
+    if (m_have_cur) {
+        auto &done = m_slots[m_cur];
+#ifdef POSIX_FADV_DONTNEED
+        if (m_options.drop_behind && done.len) {
+            (void)posix_fadvise(m_fd, (off_t)done.offset, (off_t)done.len, POSIX_FADV_DONTNEED);
+        }
+#endif
+        submit(done);
+        m_cur = (m_cur + 1) % m_slots.size();
+    }
+    m_have_cur = true;
+    auto &slot = m_slots[m_cur];
+    // may have completed while waiting for another slot, still check it for errors
+    wait(slot);
+    return {.offset = slot.offset,
+            .data   = {slot.buf.get(), (size_t)std::max<int64_t>(slot.res, 0)}};
+}
+
+ChunkedFileReader::Backend ChunkedFileReader::backend() const {
+    return m_options.backend;
+}
+
+size_t ChunkedFileReader::chunk_size() const {
+    return m_options.chunk_size;
+}
+
+uint64_t ChunkedFileReader::size() const {
+    return m_size;
+}
+
+const fs::path &ChunkedFileReader::path() const {
+    return m_path;
+}
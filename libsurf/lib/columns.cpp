@@ -0,0 +1,619 @@
+#include <surf/columns.h>
+#include <surf/trace.h>
+#include <surf/vcd.h>
+
+#include "common-internal.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <bit>
+
+#include <visit.hpp>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SURF_COLUMNS_AVX2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SURF_COLUMNS_SSE2
+#endif
+
+using namespace VCDTypes;
+
+namespace {
+
+void append_change(SignalColumn &col, uint64_t tick, const Value &value,
+                   const VarBitArena *arena) {
+    rollbear::visit(overload(
+                        [&](ScalarValue sv) {
+                            if (col.kind() == SignalKind::scalar) {
+                                col.append_logic(tick, sv.logic());
+                            } else if (col.kind() == SignalKind::vector) {
+                                // same split as a BinaryNum digit: X reads 1, Z reads 0
+                                const uint64_t bit    = sv.b() || sv.x();
+                                const uint64_t xz_bit = sv.x() || sv.z();
+                                col.append_bits(tick, bitview{bit, 1},
+                                                xz_bit ? std::optional{bitview{xz_bit, 1}}
+                                                       : std::nullopt);
+                            } else {
+                                throw std::domain_error("scalar value for a real signal");
+                            }
+                        },
+                        [&](const BinaryNum &bnum) {
+                            if (col.kind() == SignalKind::scalar) {
+                                col.append_logic(tick, bnum.logic(arena));
+                            } else if (col.kind() == SignalKind::vector) {
+                                col.append_bits(tick, bnum.bits_view(arena), bnum.xz_view(arena));
+                            } else {
+                                throw std::domain_error("binary value for a real signal");
+                            }
+                        },
+                        [&](RealNum rnum) {
+                            if (col.kind() != SignalKind::real) {
+                                throw std::domain_error("real value for a non-real signal");
+                            }
+                            col.append_real(tick, rnum.num);
+                        }),
+                    value);
+}
+
+#if defined(SURF_COLUMNS_AVX2)
+using vec_t = __m256i;
+// SSE2 has no 64 bit compares
+SCA max_lane_sz = sizeof(uint64_t);
+#elif defined(SURF_COLUMNS_SSE2)
+using vec_t     = __m128i;
+SCA max_lane_sz = sizeof(uint32_t);
+#endif
+
+#if defined(SURF_COLUMNS_AVX2) || defined(SURF_COLUMNS_SSE2)
+template <typename T> SURF_INLINE vec_t splat(T v) {
+#if defined(SURF_COLUMNS_AVX2)
+    if constexpr (sizeof(T) == 1) {
+        return _mm256_set1_epi8((char)v);
+    } else if constexpr (sizeof(T) == 2) {
+        return _mm256_set1_epi16((short)v);
+    } else if constexpr (sizeof(T) == 4) {
+        return _mm256_set1_epi32((int)v);
+    } else {
+        return _mm256_set1_epi64x((long long)v);
+    }
+#else
+    if constexpr (sizeof(T) == 1) {
+        return _mm_set1_epi8((char)v);
+    } else if constexpr (sizeof(T) == 2) {
+        return _mm_set1_epi16((short)v);
+    } else {
+        return _mm_set1_epi32((int)v);
+    }
+#endif
+}
+
+// byte mask of the lanes of v outside [lo, lo + span]. There are no unsigned compares, v - lo
+// and span get their sign bits flipped and are compared signed instead.
+template <typename T>
+SURF_INLINE uint32_t out_of_range_mask(vec_t v, vec_t lo, vec_t span_flipped) {
+    const auto sign = splat<T>((T)(T{1} << (sizeof(T) * CHAR_BIT - 1)));
+#if defined(SURF_COLUMNS_AVX2)
+    if constexpr (sizeof(T) == 1) {
+        const auto d = _mm256_xor_si256(_mm256_sub_epi8(v, lo), sign);
+        return (uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(d, span_flipped));
+    } else if constexpr (sizeof(T) == 2) {
+        const auto d = _mm256_xor_si256(_mm256_sub_epi16(v, lo), sign);
+        return (uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi16(d, span_flipped));
+    } else if constexpr (sizeof(T) == 4) {
+        const auto d = _mm256_xor_si256(_mm256_sub_epi32(v, lo), sign);
+        return (uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi32(d, span_flipped));
+    } else {
+        const auto d = _mm256_xor_si256(_mm256_sub_epi64(v, lo), sign);
+        return (uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi64(d, span_flipped));
+    }
+#else
+    if constexpr (sizeof(T) == 1) {
+        const auto d = _mm_xor_si128(_mm_sub_epi8(v, lo), sign);
+        return (uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi8(d, span_flipped));
+    } else if constexpr (sizeof(T) == 2) {
+        const auto d = _mm_xor_si128(_mm_sub_epi16(v, lo), sign);
+        return (uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi16(d, span_flipped));
+    } else {
+        const auto d = _mm_xor_si128(_mm_sub_epi32(v, lo), sign);
+        return (uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi32(d, span_flipped));
+    }
+#endif
+}
+#endif
+
+// first of the changes [first, last) of sizeof(T) byte values with lo <= value <= hi, last if
+// none. lo <= hi and both fit in T.
+template <typename T>
+size_t scan_range(const uint8_t *values, size_t first, size_t last, uint64_t lo, uint64_t hi) {
+    const auto span = (T)(hi - lo);
+    auto idx        = first;
+#if defined(SURF_COLUMNS_AVX2) || defined(SURF_COLUMNS_SSE2)
+    if constexpr (sizeof(T) <= max_lane_sz) {
+        constexpr auto lanes    = sizeof(vec_t) / sizeof(T);
+        constexpr auto all_mask = (uint32_t)((uint64_t{1} << sizeof(vec_t)) - 1);
+        const auto lo_v         = splat<T>((T)lo);
+        const auto span_flipped = splat<T>((T)(span ^ (T)(T{1} << (sizeof(T) * CHAR_BIT - 1))));
+        for (; idx + lanes <= last; idx += lanes) {
+            vec_t v;
+            memcpy(&v, values + idx * sizeof(T), sizeof(v));
+            const auto in_range = ~out_of_range_mask<T>(v, lo_v, span_flipped) & all_mask;
+            if (in_range) {
+                return idx + (size_t)std::countr_zero(in_range) / sizeof(T);
+            }
+        }
+    }
+#endif
+    for (; idx < last; ++idx) {
+        T v;
+        memcpy(&v, values + idx * sizeof(T), sizeof(T));
+        if ((T)(v - (T)lo) <= span) {
+            return idx;
+        }
+    }
+    return last;
+}
+
+// scan_range for strides without a matching integer type
+size_t scan_range_bytes(const uint8_t *values, size_t stride, size_t first, size_t last,
+                        uint64_t lo, uint64_t hi) {
+    for (auto idx = first; idx < last; ++idx) {
+        uint64_t v{};
+        memcpy(&v, values + idx * stride, stride);
+        if (v - lo <= hi - lo) {
+            return idx;
+        }
+    }
+    return last;
+}
+
+}; // namespace
+
+SignalColumn::SignalColumn(SignalKind kind, varbit::sz_t bitsize)
+    : m_kind{kind}, m_bitsize{bitsize}, m_stride{varbit::bytesize4bitsize(bitsize)},
+      m_zones{bitsize} {
+    if (m_kind == SignalKind::vector && m_bitsize == 0) {
+        throw std::domain_error("SignalColumn: zero width vector signal");
+    }
+}
+
+SignalKind SignalColumn::kind() const {
+    return m_kind;
+}
+
+varbit::sz_t SignalColumn::bitsize() const {
+    return m_bitsize;
+}
+
+size_t SignalColumn::size() const {
+    return m_ticks.size();
+}
+
+const std::vector<uint64_t> &SignalColumn::ticks() const {
+    return m_ticks;
+}
+
+uint64_t SignalColumn::tick(size_t idx) const {
+    return m_ticks[idx];
+}
+
+Logic SignalColumn::logic(size_t idx) const {
+    const auto shift = (idx % logics_per_byte) * 2;
+    return (Logic)((m_values[idx / logics_per_byte] >> shift) & 0b11);
+}
+
+bitview SignalColumn::bits(size_t idx) const {
+    return bitview{m_values.data() + idx * m_stride, m_bitsize};
+}
+
+std::optional<bitview> SignalColumn::xz(size_t idx) const {
+    if (m_xz.empty()) {
+        return std::nullopt;
+    }
+    const auto *xz_bytes = m_xz.data() + idx * m_stride;
+    if (std::all_of(xz_bytes, xz_bytes + m_stride, [](uint8_t b) {
+            return !b;
+        })) {
+        return std::nullopt;
+    }
+    return bitview{xz_bytes, m_bitsize};
+}
+
+const ZoneMap &SignalColumn::zones() const {
+    return m_zones;
+}
+
+std::optional<size_t> SignalColumn::find_in_range(size_t first, uint64_t lo, uint64_t hi) const {
+    if (m_kind != SignalKind::vector || m_bitsize > 64) {
+        throw std::domain_error(
+            fmt::format("SignalColumn::find_in_range on a {:d} bit {:s} signal", m_bitsize,
+                        magic_enum::enum_name(m_kind)));
+    }
+    hi = std::min(hi, m_bitsize == 64 ? UINT64_MAX : (uint64_t{1} << m_bitsize) - 1);
+    if (lo > hi) {
+        return std::nullopt;
+    }
+    const auto *values = m_values.data();
+    for (auto blk = ZoneMap::block_of(first); blk < m_zones.num_blocks(); ++blk) {
+        if (lo == hi ? !m_zones.may_equal(blk, lo) : !m_zones.may_be_in(blk, lo, hi)) {
+            continue;
+        }
+        auto idx       = std::max(first, blk * ZoneMap::block_changes);
+        const auto end = std::min(size(), (blk + 1) * ZoneMap::block_changes);
+        while (idx < end) {
+            switch (m_stride) {
+            case 1:
+                idx = scan_range<uint8_t>(values, idx, end, lo, hi);
+                break;
+            case 2:
+                idx = scan_range<uint16_t>(values, idx, end, lo, hi);
+                break;
+            case 4:
+                idx = scan_range<uint32_t>(values, idx, end, lo, hi);
+                break;
+            case 8:
+                idx = scan_range<uint64_t>(values, idx, end, lo, hi);
+                break;
+            default:
+                idx = scan_range_bytes(values, m_stride, idx, end, lo, hi);
+                break;
+            }
+            // X reads as 1 and Z as 0 in the value bits, those matches are false
+            if (idx < end && (!m_zones.has_xz(blk) || !xz(idx))) {
+                return idx;
+            }
+            ++idx;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<size_t> SignalColumn::find_xz(size_t first) const {
+    if (m_kind != SignalKind::vector) {
+        throw std::domain_error("SignalColumn::find_xz on a non-vector signal");
+    }
+    for (auto blk = ZoneMap::block_of(first); blk < m_zones.num_blocks(); ++blk) {
+        if (!m_zones.has_xz(blk)) {
+            continue;
+        }
+        const auto end = std::min(size(), (blk + 1) * ZoneMap::block_changes);
+        for (auto idx = std::max(first, blk * ZoneMap::block_changes); idx < end; ++idx) {
+            if (xz(idx)) {
+                return idx;
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+VarBit SignalColumn::varbit(size_t idx) const {
+    return VarBit{bits(idx)};
+}
+
+double SignalColumn::real(size_t idx) const {
+    return m_reals[idx];
+}
+
+bool SignalColumn::same_value(size_t a, size_t b) const {
+    switch (m_kind) {
+    case SignalKind::scalar:
+        return logic(a) == logic(b);
+    case SignalKind::vector:
+        return bitview_equal(bits(a), bits(b)) &&
+               (m_xz.empty() || !memcmp(m_xz.data() + a * m_stride, m_xz.data() + b * m_stride,
+                                        m_stride));
+    case SignalKind::real:
+        return !memcmp(&m_reals[a], &m_reals[b], sizeof(double));
+    }
+    SURF_UNREACHABLE();
+}
+
+std::optional<size_t> SignalColumn::index_at(uint64_t tick) const {
+    const auto it = std::upper_bound(m_ticks.cbegin(), m_ticks.cend(), tick);
+    if (it == m_ticks.cbegin()) {
+        return std::nullopt;
+    }
+    return (size_t)(it - m_ticks.cbegin()) - 1;
+}
+
+std::pair<size_t, size_t> SignalColumn::index_range(uint64_t start, uint64_t end) const {
+    const auto first = std::lower_bound(m_ticks.cbegin(), m_ticks.cend(), start);
+    const auto last  = std::upper_bound(first, m_ticks.cend(), end);
+    return {(size_t)(first - m_ticks.cbegin()), (size_t)(last - m_ticks.cbegin())};
+}
+
+std::optional<SignalChange> SignalColumn::value_at(uint64_t tick) const {
+    const auto idx = index_at(tick);
+    if (!idx) {
+        return std::nullopt;
+    }
+    return SignalChange{*this, *idx};
+}
+
+std::optional<SignalChange> SignalColumn::next_change(uint64_t tick) const {
+    const auto it = std::upper_bound(m_ticks.cbegin(), m_ticks.cend(), tick);
+    if (it == m_ticks.cend()) {
+        return std::nullopt;
+    }
+    return SignalChange{*this, (size_t)(it - m_ticks.cbegin())};
+}
+
+std::optional<SignalChange> SignalColumn::prev_change(uint64_t tick) const {
+    const auto it = std::lower_bound(m_ticks.cbegin(), m_ticks.cend(), tick);
+    if (it == m_ticks.cbegin()) {
+        return std::nullopt;
+    }
+    return SignalChange{*this, (size_t)(it - m_ticks.cbegin()) - 1};
+}
+
+SignalChangeRange SignalColumn::changes_in(uint64_t start, uint64_t end) const {
+    const auto [first, last] = index_range(start, end);
+    return {*this, first, last};
+}
+
+const RankSelect &SignalColumn::edges() const {
+    return m_edges;
+}
+
+size_t SignalColumn::edges_in(uint64_t start, uint64_t end) const {
+    const auto [first, last] = index_range(start, end);
+    return num_edges(first, last);
+}
+
+std::optional<SignalChange> SignalColumn::next_edge(uint64_t tick) const {
+    const auto after = (size_t)(std::upper_bound(m_ticks.cbegin(), m_ticks.cend(), tick) -
+                                m_ticks.cbegin());
+    const auto rank  = m_edges.rank1(after);
+    if (rank == m_edges.num_ones()) {
+        return std::nullopt;
+    }
+    return SignalChange{*this, m_edges.select1(rank)};
+}
+
+std::optional<SignalChange> SignalColumn::prev_edge(uint64_t tick) const {
+    const auto before = (size_t)(std::lower_bound(m_ticks.cbegin(), m_ticks.cend(), tick) -
+                                 m_ticks.cbegin());
+    const auto rank   = m_edges.rank1(before);
+    if (!rank) {
+        return std::nullopt;
+    }
+    return SignalChange{*this, m_edges.select1(rank - 1)};
+}
+
+void SignalColumn::reserve(size_t num_changes) {
+    m_ticks.reserve(num_changes);
+    m_edges.reserve(num_changes);
+    switch (m_kind) {
+    case SignalKind::scalar:
+        m_values.reserve(roundup_pow2_mul(num_changes, logics_per_byte) / logics_per_byte);
+        break;
+    case SignalKind::vector:
+        m_values.reserve(num_changes * m_stride);
+        m_zones.reserve(num_changes);
+        break;
+    case SignalKind::real:
+        m_reals.reserve(num_changes);
+        break;
+    }
+}
+
+void SignalColumn::append_logic(uint64_t tick, Logic logic) {
+    const auto idx = m_ticks.size();
+    if (idx % logics_per_byte == 0) {
+        m_values.push_back(0);
+    }
+    m_values.back() |= (uint8_t)((uint8_t)logic << ((idx % logics_per_byte) * 2));
+    m_ticks.push_back(tick);
+    push_edge();
+}
+
+void SignalColumn::append_bits(uint64_t tick, bitview bits, std::optional<bitview> xz) {
+    const auto off = m_values.size();
+    m_values.resize(off + m_stride);
+    std::copy_n(bits.data(), std::min(bits.bytesize(), m_stride), m_values.data() + off);
+    if (xz && m_xz.empty()) {
+        m_xz.reserve(m_values.capacity());
+    }
+    if (xz || !m_xz.empty()) {
+        m_xz.resize(off + m_stride);
+    }
+    if (xz) {
+        std::copy_n(xz->data(), std::min(xz->bytesize(), m_stride), m_xz.data() + off);
+        // a narrower value with a leading X or Z extends it to the full width
+        const auto top = xz->bitsize() - 1;
+        if (xz->bitsize() < m_bitsize && (xz->data()[top / CHAR_BIT] >> (top % CHAR_BIT)) & 1) {
+            const bool top_bit = bits.bitsize() > top &&
+                                 ((bits.data()[top / CHAR_BIT] >> (top % CHAR_BIT)) & 1);
+            for (auto i = (size_t)top + 1; i < m_bitsize; ++i) {
+                const auto bit = (uint8_t)(1u << (i % CHAR_BIT));
+                m_xz[off + i / CHAR_BIT] |= bit;
+                if (top_bit) {
+                    m_values[off + i / CHAR_BIT] |= bit;
+                }
+            }
+        }
+    }
+    // values wider than the declaration are truncated
+    if (const auto partial_bits = m_bitsize % CHAR_BIT) {
+        m_values[off + m_stride - 1] &= pow2_mask(partial_bits);
+        if (!m_xz.empty()) {
+            m_xz[off + m_stride - 1] &= pow2_mask(partial_bits);
+        }
+    }
+    m_ticks.push_back(tick);
+    push_edge();
+    const auto idx = m_ticks.size() - 1;
+    m_zones.push_back(this->bits(idx), this->xz(idx).has_value());
+}
+
+void SignalColumn::append_real(uint64_t tick, double real) {
+    m_reals.push_back(real);
+    m_ticks.push_back(tick);
+    push_edge();
+}
+
+void SignalColumn::push_edge() {
+    const auto idx = m_ticks.size() - 1;
+    m_edges.push_back(!idx || !same_value(idx - 1, idx));
+}
+
+SignalColumns SignalColumns::from_document(const Document &doc) {
+    auto res = from_declarations(doc.declarations);
+
+    // count first so every column is allocated exactly once
+    std::vector<size_t> num_changes(res.size());
+    for (const auto &cmd : doc.sim_cmds) {
+        if (const auto *change = std::get_if<Change>(&cmd)) {
+            ++num_changes[change->sig];
+        }
+    }
+    for (size_t i = 0; i < res.size(); ++i) {
+        res.m_signals[i].reserve(num_changes[i]);
+    }
+
+    for (const auto &cmd : doc.sim_cmds) {
+        res.append_sim_cmd(cmd, doc.arenas);
+    }
+    return res;
+}
+
+SignalColumns SignalColumns::from_declarations(const Declarations &decls) {
+    SignalColumns res;
+    res.m_signals.reserve(decls.signals.size());
+    for (const auto &signal : decls.signals) {
+        if (signal.size <= 0 || signal.size > std::numeric_limits<varbit::sz_t>::max()) {
+            throw std::domain_error(fmt::format("Unsupported signal width: {:d}", signal.size));
+        }
+        res.m_signals.emplace_back(signal.kind(), (varbit::sz_t)signal.size);
+    }
+    return res;
+}
+
+void SignalColumns::append_sim_cmds(std::span<const SimCmd> cmds,
+                                    std::span<const VarBitArena> arenas) {
+    for (const auto &cmd : cmds) {
+        append_sim_cmd(cmd, arenas);
+    }
+}
+
+void SignalColumns::append_sim_cmd(const SimCmd &cmd, std::span<const VarBitArena> arenas) {
+    rollbear::visit(overload(
+                        [&](const Tick &tick) {
+                            if (!m_seen_tick) {
+                                m_start     = tick.tick;
+                                m_seen_tick = true;
+                            } else if (tick.tick < m_end) {
+                                throw std::domain_error(
+                                    fmt::format("Tick #{:d} goes back in time from #{:d}",
+                                                tick.tick, m_end));
+                            }
+                            // the current tick, changes before the first one are at 0
+                            m_end = tick.tick;
+                        },
+                        [&](const Change &change) {
+                            if (change.sig >= m_signals.size()) {
+                                throw std::range_error(
+                                    fmt::format("SignalColumns: unknown signal {:d}", change.sig));
+                            }
+                            append_change(m_signals[change.sig], m_end, change.value,
+                                          arenas.empty() ? nullptr : &arenas[change.sig]);
+                        },
+                        [](const Comment &) {}),
+                    cmd);
+}
+
+SignalColumns SignalColumns::from_trace(const Trace &trace) {
+    SignalColumns res;
+    const auto signals = trace.signals();
+    res.m_signals.reserve(signals.size());
+    for (const auto &signal : signals) {
+        if (signal.bitsize > std::numeric_limits<varbit::sz_t>::max()) {
+            throw std::domain_error(fmt::format("Unsupported signal width: {:d}", signal.bitsize));
+        }
+        res.m_signals.emplace_back(signal.kind, (varbit::sz_t)signal.bitsize);
+    }
+
+    std::vector<size_t> num_changes(signals.size());
+    for (size_t i = 0; i < trace.num_ticks(); ++i) {
+        for (const auto sig : trace.tick_log(i).sigs()) {
+            ++num_changes[sig];
+        }
+    }
+    for (size_t i = 0; i < signals.size(); ++i) {
+        res.m_signals[i].reserve(num_changes[i]);
+    }
+
+    for (size_t i = 0; i < trace.num_ticks(); ++i) {
+        const auto log  = trace.tick_log(i);
+        const auto tick = log.tick();
+        for (size_t j = 0; j < log.num_changes(); ++j) {
+            auto &col = res.m_signals[log.sig(j)];
+            switch (col.kind()) {
+            case SignalKind::scalar:
+                col.append_logic(tick, log.logic(j));
+                break;
+            case SignalKind::vector:
+                col.append_bits(tick, log.bits(j), log.xz(j));
+                break;
+            case SignalKind::real:
+                col.append_real(tick, log.real(j));
+                break;
+            }
+        }
+    }
+    res.m_start = trace.start().ticks();
+    res.m_end   = trace.end().ticks();
+    return res;
+}
+
+size_t SignalColumns::size() const {
+    return m_signals.size();
+}
+
+const SignalColumn &SignalColumns::operator[](IDCodeTable::sig_t sig) const {
+    return m_signals[sig];
+}
+
+const std::vector<SignalColumn> &SignalColumns::signals() const {
+    return m_signals;
+}
+
+uint64_t SignalColumns::start() const {
+    return m_start;
+}
+
+uint64_t SignalColumns::end() const {
+    return m_end;
+}
+
+std::optional<SignalChange> SignalColumns::value_at(IDCodeTable::sig_t sig, uint64_t tick) const {
+    return (*this)[sig].value_at(tick);
+}
+
+std::optional<SignalChange> SignalColumns::next_change(IDCodeTable::sig_t sig,
+                                                       uint64_t tick) const {
+    return (*this)[sig].next_change(tick);
+}
+
+std::optional<SignalChange> SignalColumns::prev_change(IDCodeTable::sig_t sig,
+                                                       uint64_t tick) const {
+    return (*this)[sig].prev_change(tick);
+}
+
+SignalChangeRange SignalColumns::changes_in(IDCodeTable::sig_t sig, uint64_t start,
+                                            uint64_t end) const {
+    return (*this)[sig].changes_in(start, end);
+}
+
+size_t SignalColumns::edges_in(IDCodeTable::sig_t sig, uint64_t start, uint64_t end) const {
+    return (*this)[sig].edges_in(start, end);
+}
+
+std::optional<SignalChange> SignalColumns::next_edge(IDCodeTable::sig_t sig, uint64_t tick) const {
+    return (*this)[sig].next_edge(tick);
+}
+
+std::optional<SignalChange> SignalColumns::prev_edge(IDCodeTable::sig_t sig, uint64_t tick) const {
+    return (*this)[sig].prev_edge(tick);
+}
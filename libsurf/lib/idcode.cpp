@@ -0,0 +1,73 @@
+#include <surf/idcode.h>
+
+#include "common-internal.h"
+
+namespace {
+
+SCA idcode_first = '!';
+SCA idcode_last  = '~';
+SCA idcode_base  = (uint64_t)(idcode_last - idcode_first + 1);
+// codes may decode this far past twice the number of signals and still land in the dense table
+SCA dense_slack = 1u << 16;
+
+}; // namespace
+
+std::optional<uint64_t> IDCodeTable::decode(std::string_view idcode) {
+    if (idcode.empty() || idcode.size() > max_decoded_digits) {
+        return std::nullopt;
+    }
+    uint64_t num   = 0;
+    uint64_t place = 1;
+    for (const auto c : idcode) {
+        if (c < idcode_first || c > idcode_last) {
+            return std::nullopt;
+        }
+        num += (uint64_t)(c - idcode_first + 1) * place;
+        place *= idcode_base;
+    }
+    return num - 1;
+}
+
+IDCodeTable::sig_t IDCodeTable::intern(std::string_view idcode) {
+    // lookup() inlined so the code is only decoded once
+    const auto decoded = decode(idcode);
+    if (decoded && *decoded < m_dense.size() && m_dense[*decoded] != invalid_sig) {
+        return m_dense[*decoded];
+    }
+    if (!m_sparse.empty()) {
+        if (const auto it = m_sparse.find(idcode); it != m_sparse.end()) {
+            return it->second;
+        }
+    }
+    if (SURF_UNLIKELY(m_num_sigs == invalid_sig)) {
+        throw std::overflow_error("IDCodeTable: too many signals");
+    }
+    const auto sig = m_num_sigs++;
+    if (decoded && *decoded < 2 * (uint64_t)m_num_sigs + dense_slack) {
+        // codes are usually handed out in order, growing by one at a time
+        while (m_dense.size() <= *decoded) {
+            m_dense.push_back(invalid_sig);
+        }
+        m_dense[*decoded] = sig;
+    } else {
+        m_sparse.emplace(std::string{idcode}, sig);
+    }
+    return sig;
+}
+
+IDCodeTable::sig_t IDCodeTable::lookup(std::string_view idcode) const {
+    if (const auto decoded = decode(idcode); SURF_LIKELY(decoded && *decoded < m_dense.size())) {
+        if (const auto sig = m_dense[*decoded]; SURF_LIKELY(sig != invalid_sig)) {
+            return sig;
+        }
+    }
+    if (m_sparse.empty()) {
+        return invalid_sig;
+    }
+    const auto it = m_sparse.find(idcode);
+    return it == m_sparse.end() ? invalid_sig : it->second;
+}
+
+IDCodeTable::sig_t IDCodeTable::size() const {
+    return m_num_sigs;
+}
@@ -5,9 +5,39 @@
 
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
-MappedReadOnlyFile::MappedReadOnlyFile(const fs::path &path, const void *preferred_addr)
-    : m_path(path) {
+namespace {
+
+size_t page_size() {
+    static const auto sz = (size_t)sysconf(_SC_PAGESIZE);
+    return sz;
+}
+
+// advice is only a hint, an old kernel rejecting it isn't an error
+void advise(const uint8_t *addr, size_t len, int advice) {
+    if (len) {
+        (void)madvise((void *)addr, len, advice);
+    }
+}
+
+int map_flags(MapPolicy policy, const void *preferred_addr) {
+    int flags = MAP_PRIVATE | (preferred_addr ? MAP_FIXED : 0);
+#ifdef MAP_POPULATE
+    if (policy == MapPolicy::huge_pages) {
+        flags |= MAP_POPULATE;
+    }
+#else
+    (void)policy;
+#endif
+    return flags;
+}
+
+}; // namespace
+
+MappedReadOnlyFile::MappedReadOnlyFile(const fs::path &path, const void *preferred_addr,
+                                       MapPolicy policy)
+    : m_path(path), m_policy(policy) {
     const auto fd_res = open(path.c_str(), O_RDONLY);
     posix_check(fd_res, "MappedReadOnlyFile open");
 
@@ -18,7 +48,7 @@ MappedReadOnlyFile::MappedReadOnlyFile(const fs::path &path, const void *preferr
     // sz + 1 to add a null terminator
     const auto *buf =
         (const uint8_t *)mmap((void *)preferred_addr, (size_t)st.st_size + 1, PROT_READ,
-                              MAP_PRIVATE | (preferred_addr ? MAP_FIXED : 0), fd_res, 0);
+                              map_flags(policy, preferred_addr), fd_res, 0);
     if (buf == MAP_FAILED) {
         throw std::system_error(
             std::make_error_code((std::errc)errno),
@@ -29,9 +59,60 @@ MappedReadOnlyFile::MappedReadOnlyFile(const fs::path &path, const void *preferr
 
     m_mapping = buf;
     m_size    = (size_t)st.st_size;
+
+    switch (policy) {
+    case MapPolicy::normal:
+        break;
+    case MapPolicy::sequential:
+        advise(m_mapping, m_size, MADV_SEQUENTIAL);
+        advance(0);
+        break;
+    case MapPolicy::random:
+        advise(m_mapping, m_size, MADV_RANDOM);
+        break;
+    case MapPolicy::huge_pages:
+#ifdef MADV_HUGEPAGE
+        // only takes for file mappings with CONFIG_READ_ONLY_THP_FOR_FS
+        advise(m_mapping, m_size, MADV_HUGEPAGE);
+#endif
+        break;
+    }
+}
+
+MappedReadOnlyFile::MappedReadOnlyFile(const fs::path &path, MapPolicy policy)
+    : MappedReadOnlyFile(path, nullptr, policy) {}
+
+MappedReadOnlyFile::MappedReadOnlyFile(const fs::path &path,
+                                       const ChunkedFileReader::Options &read_options)
+    : m_path(path), m_policy(MapPolicy::normal) {
+    ChunkedFileReader reader{path, read_options};
+    // sz + 1 for the null terminator, anonymous memory starts out zeroed
+    auto *buf = (uint8_t *)mmap(nullptr, (size_t)reader.size() + 1, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) {
+        throw std::system_error(
+            std::make_error_code((std::errc)errno),
+            fmt::format("MappedReadOnlyFile mmap error: {:s}", strerror(errno)));
+    }
+    try {
+        for (auto chunk = reader.next(); !chunk.data.empty(); chunk = reader.next()) {
+            std::copy(chunk.data.cbegin(), chunk.data.cend(), buf + chunk.offset);
+        }
+    } catch (...) {
+        munmap(buf, (size_t)reader.size() + 1);
+        throw;
+    }
+    posix_check(mprotect(buf, (size_t)reader.size() + 1, PROT_READ), "MappedReadOnlyFile mprotect");
+    m_mapping = buf;
+    m_size    = (size_t)reader.size();
 }
 
 MappedReadOnlyFile::~MappedReadOnlyFile() {
+    // the prefetch thread reads the mapping
+    if (m_prefetch_thread.joinable()) {
+        m_prefetch_thread.request_stop();
+        m_prefetch_thread.join();
+    }
     // sz + 1 for null terminator
     const auto munmap_res = munmap((void *)m_mapping, m_size + 1);
     posix_check(munmap_res, "MappedReadOnlyFile munmap");
@@ -51,4 +132,54 @@ const fs::path &MappedReadOnlyFile::path() const {
 
 std::string_view MappedReadOnlyFile::string_view() const {
     return {(const char *)data(), size()};
-}
\ No newline at end of file
+}
+
+MapPolicy MappedReadOnlyFile::policy() const {
+    return m_policy;
+}
+
+void MappedReadOnlyFile::advance(size_t offset) {
+    if (m_policy != MapPolicy::sequential) {
+        return;
+    }
+    offset = std::min(offset, m_size);
+    // only whole pages behind the cursor, the one it is in may still be read. Each drop is a TLB
+    // shootdown, batch them.
+    const auto drop_end = offset / page_size() * page_size();
+    if (drop_end >= m_dropped_end + readahead_window / 4 ||
+        (offset == m_size && drop_end > m_dropped_end)) {
+        advise(m_mapping + m_dropped_end, drop_end - m_dropped_end, MADV_DONTNEED);
+        m_dropped_end = drop_end;
+    }
+    // top up the readahead once the cursor is half way through it
+    if (offset + readahead_window / 2 >= m_readahead_end && m_readahead_end < m_size) {
+        const auto ra_begin = std::max(m_readahead_end, drop_end);
+        const auto ra_end   = std::min(offset + readahead_window, m_size);
+        if (ra_end > ra_begin) {
+            advise(m_mapping + ra_begin, ra_end - ra_begin, MADV_WILLNEED);
+        }
+        m_readahead_end = ra_end;
+    }
+}
+
+void MappedReadOnlyFile::prefetch_async() {
+    if (m_prefetch_thread.joinable()) {
+        return;
+    }
+    m_prefetch_thread = std::jthread{[this](std::stop_token stop) {
+        // blocks small enough to stop promptly
+        constexpr size_t block_sz = size_t{4} * 1024 * 1024;
+        for (size_t off = 0; off < m_size && !stop.stop_requested(); off += block_sz) {
+            const auto len = std::min(block_sz, m_size - off);
+#ifdef MADV_POPULATE_READ
+            if (!madvise((void *)(m_mapping + off), len, MADV_POPULATE_READ)) {
+                continue;
+            }
+#endif
+            // older kernels, fault each page in by touching it
+            for (size_t page = 0; page < len; page += page_size()) {
+                (void)*(const volatile uint8_t *)(m_mapping + off + page);
+            }
+        }
+    }};
+}
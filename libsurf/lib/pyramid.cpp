@@ -0,0 +1,293 @@
+#include <surf/mmap.h>
+#include <surf/pyramid.h>
+
+#include "common-internal.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <future>
+
+#include <BS_thread_pool.hpp>
+
+namespace {
+
+SCA file_magic        = UINT64_C(0x0031525950465253); // "SRFPYR1\0"
+SCA chunks_per_thread = 4;
+
+struct FileHeader {
+    uint64_t magic;
+    uint64_t num_signals;
+};
+
+struct LevelHeader {
+    uint64_t num_buckets;
+    uint8_t shift;
+    uint8_t reserved[7];
+};
+
+void add_seen(PyramidBucket &bucket, const SignalColumn &col, uint64_t idx) {
+    if (col.kind() == SignalKind::scalar) {
+        bucket.logic_mask |= (uint8_t)(1u << (uint8_t)col.logic(idx));
+        bucket.num_seen = (uint8_t)std::popcount(bucket.logic_mask);
+        return;
+    }
+    if (bucket.num_seen == PyramidBucket::seen_overflow) {
+        return;
+    }
+    for (uint8_t i = 0; i < bucket.num_seen; ++i) {
+        if (col.same_value(bucket.first_change + bucket.seen[i], idx)) {
+            return;
+        }
+    }
+    if (bucket.num_seen == PyramidBucket::max_seen) {
+        bucket.num_seen = PyramidBucket::seen_overflow;
+        return;
+    }
+    bucket.seen[bucket.num_seen++] = (uint32_t)(idx - bucket.first_change);
+}
+
+// next follows bucket in time
+void merge_bucket(PyramidBucket &bucket, const PyramidBucket &next, const SignalColumn &col) {
+    bucket.num_changes += next.num_changes;
+    if (col.kind() == SignalKind::scalar) {
+        bucket.logic_mask |= next.logic_mask;
+        bucket.num_seen = (uint8_t)std::popcount(bucket.logic_mask);
+        return;
+    }
+    if (next.num_seen == PyramidBucket::seen_overflow) {
+        bucket.num_seen = PyramidBucket::seen_overflow;
+        return;
+    }
+    for (uint8_t i = 0; i < next.num_seen; ++i) {
+        add_seen(bucket, col, next.first_change + next.seen[i]);
+    }
+}
+
+size_t count_buckets(const std::vector<uint64_t> &ticks, uint8_t shift) {
+    size_t num = 0;
+    for (size_t i = 0; i < ticks.size(); ++i) {
+        num += !i || (ticks[i] >> shift) != (ticks[i - 1] >> shift);
+    }
+    return num;
+}
+
+PyramidLevel level_from_changes(const SignalColumn &col, uint8_t shift) {
+    PyramidLevel level{.shift = shift};
+    const auto &ticks = col.ticks();
+    for (uint64_t i = 0; i < ticks.size(); ++i) {
+        const auto bucket_num = ticks[i] >> shift;
+        if (level.buckets.empty() || level.buckets.back().bucket != bucket_num) {
+            level.buckets.push_back(PyramidBucket{.bucket = bucket_num, .first_change = i});
+        }
+        auto &bucket = level.buckets.back();
+        ++bucket.num_changes;
+        add_seen(bucket, col, i);
+    }
+    return level;
+}
+
+PyramidLevel level_from_level(const PyramidLevel &prev, const SignalColumn &col) {
+    PyramidLevel level{.shift = (uint8_t)(prev.shift + 1)};
+    level.buckets.reserve(prev.buckets.size() / 2 + 1);
+    for (const auto &prev_bucket : prev.buckets) {
+        const auto bucket_num = prev_bucket.bucket >> 1;
+        if (level.buckets.empty() || level.buckets.back().bucket != bucket_num) {
+            level.buckets.push_back(prev_bucket);
+            level.buckets.back().bucket = bucket_num;
+        } else {
+            merge_bucket(level.buckets.back(), prev_bucket, col);
+        }
+    }
+    return level;
+}
+
+// off never passes the end of the file, so the bytes left can't underflow and the count is checked
+// by division instead of a multiply that a huge num would overflow
+template <typename T> const T *read_pod(const MappedReadOnlyFile &file, size_t &off, size_t num) {
+    if (num > (file.size() - off) / sizeof(T)) {
+        throw std::domain_error(fmt::format("Surf pyramid '{}' is truncated", file.path()));
+    }
+    const auto *res = (const T *)(file.data() + off);
+    off += num * sizeof(T);
+    return res;
+}
+
+}; // namespace
+
+size_t PyramidLevel::lower_bound(uint64_t tick) const {
+    const auto bucket_num = tick >> shift;
+    const auto it =
+        std::lower_bound(buckets.cbegin(), buckets.cend(), bucket_num,
+                         [](const PyramidBucket &b, uint64_t num) { return b.bucket < num; });
+    return (size_t)(it - buckets.cbegin());
+}
+
+SignalPyramid SignalPyramid::build(const SignalColumn &col) {
+    if (col.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::range_error(
+            fmt::format("SignalPyramid: {:d} changes overflow a bucket count", col.size()));
+    }
+    SignalPyramid res;
+    const auto num_changes = col.size();
+    // smallest shift whose buckets average min_changes_per_bucket changes, the number of buckets
+    // only shrinks as the shift grows
+    uint8_t lo = 0;
+    uint8_t hi = sizeofbits<uint64_t>();
+    while (lo < hi) {
+        const auto mid = (uint8_t)(lo + (hi - lo) / 2);
+        if (count_buckets(col.ticks(), mid) * min_changes_per_bucket <= num_changes) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    if (lo == sizeofbits<uint64_t>()) {
+        // too few changes for a summary to pay off
+        return res;
+    }
+    res.m_levels.push_back(level_from_changes(col, lo));
+    while (res.m_levels.back().buckets.size() > 1 &&
+           res.m_levels.back().shift < sizeofbits<uint64_t>() - 1) {
+        res.m_levels.push_back(level_from_level(res.m_levels.back(), col));
+    }
+    return res;
+}
+
+const std::vector<PyramidLevel> &SignalPyramid::levels() const {
+    return m_levels;
+}
+
+const PyramidLevel *SignalPyramid::level_for(uint64_t ticks_per_pixel) const {
+    for (auto it = m_levels.crbegin(); it != m_levels.crend(); ++it) {
+        if (it->bucket_ticks() <= ticks_per_pixel) {
+            return &*it;
+        }
+    }
+    return nullptr;
+}
+
+SignalPyramids SignalPyramids::build(const SignalColumns &cols, uint32_t num_threads) {
+    SignalPyramids res;
+    res.m_signals.resize(cols.size());
+    BS::thread_pool pool{num_threads ? num_threads : get_num_cores()};
+    const size_t num_chunks = std::max<size_t>(pool.get_thread_count() * chunks_per_thread, 1);
+    const auto chunk_sz     = std::max<size_t>((cols.size() + num_chunks - 1) / num_chunks, 1);
+    std::vector<std::future<void>> futures;
+    for (size_t start = 0; start < cols.size(); start += chunk_sz) {
+        const auto end = std::min(start + chunk_sz, cols.size());
+        futures.emplace_back(pool.submit([&res, &cols, start, end] {
+            for (auto sig = start; sig < end; ++sig) {
+                res.m_signals[sig] = SignalPyramid::build(cols[(uint32_t)sig]);
+            }
+        }));
+    }
+    for (auto &future : futures) {
+        future.get();
+    }
+    return res;
+}
+
+SignalPyramids SignalPyramids::load(const fs::path &path) {
+    const MappedReadOnlyFile file{path};
+    size_t off       = 0;
+    const auto *fhdr = read_pod<FileHeader>(file, off, 1);
+    if (fhdr->magic != file_magic) {
+        throw std::domain_error(fmt::format("'{}' is not a Surf pyramid", path));
+    }
+    const auto corrupt = [&](std::string_view why) {
+        return std::domain_error(fmt::format("Surf pyramid '{}' is corrupt: {:s}", path, why));
+    };
+    // every signal takes at least its level count, so the counts are bounded before allocating
+    if (fhdr->num_signals > (file.size() - off) / sizeof(uint64_t)) {
+        throw corrupt("more signals than the file holds");
+    }
+    SignalPyramids res;
+    res.m_signals.resize(fhdr->num_signals);
+    for (auto &signal : res.m_signals) {
+        const auto num_levels = *read_pod<uint64_t>(file, off, 1);
+        // a level per shift at most
+        if (num_levels > sizeofbits<uint64_t>()) {
+            throw corrupt(fmt::format("{:d} levels", num_levels));
+        }
+        signal.m_levels.resize(num_levels);
+        for (auto &level : signal.m_levels) {
+            const auto *lhdr    = read_pod<LevelHeader>(file, off, 1);
+            const auto *buckets = read_pod<PyramidBucket>(file, off, lhdr->num_buckets);
+            if (lhdr->shift >= sizeofbits<uint64_t>()) {
+                throw corrupt(fmt::format("a level shift of {:d}", lhdr->shift));
+            }
+            level.shift = lhdr->shift;
+            level.buckets.assign(buckets, buckets + lhdr->num_buckets);
+        }
+    }
+    return res;
+}
+
+void SignalPyramids::check(const SignalColumns &cols) const {
+    if (m_signals.size() != cols.size()) {
+        throw std::domain_error(fmt::format("SignalPyramids: {:d} pyramids for {:d} signals",
+                                            m_signals.size(), cols.size()));
+    }
+    for (uint32_t sig = 0; sig < m_signals.size(); ++sig) {
+        const auto &col    = cols[sig];
+        const auto &ticks  = col.ticks();
+        const auto corrupt = [&](const PyramidLevel &level, std::string_view why) {
+            return std::domain_error(fmt::format(
+                "SignalPyramids: signal {:d} shift {:d} {:s}", sig, level.shift, why));
+        };
+        for (const auto &level : m_signals[sig].m_levels) {
+            // the buckets of a level split the column's changes in order without gaps
+            uint64_t next_change = 0;
+            for (const auto &bucket : level.buckets) {
+                if (bucket.first_change != next_change || !bucket.num_changes ||
+                    bucket.num_changes > col.size() - next_change) {
+                    throw corrupt(level, "bucket changes are past the column");
+                }
+                next_change += bucket.num_changes;
+                if (ticks[bucket.first_change] >> level.shift != bucket.bucket ||
+                    ticks[bucket.last_change()] >> level.shift != bucket.bucket) {
+                    throw corrupt(level, "bucket doesn't hold the ticks of its changes");
+                }
+                if (bucket.num_seen == PyramidBucket::seen_overflow) {
+                    continue;
+                }
+                if (bucket.num_seen > PyramidBucket::max_seen ||
+                    (col.kind() != SignalKind::scalar &&
+                     !std::all_of(bucket.seen, bucket.seen + bucket.num_seen,
+                                  [&](uint32_t seen) { return seen < bucket.num_changes; }))) {
+                    throw corrupt(level, "bucket values are past its changes");
+                }
+            }
+            if (next_change != col.size()) {
+                throw corrupt(level, "buckets don't cover the column");
+            }
+        }
+    }
+}
+
+void SignalPyramids::save(const fs::path &path) const {
+    std::vector<uint8_t> out;
+    const FileHeader fhdr{.magic = file_magic, .num_signals = m_signals.size()};
+    append_pod(out, &fhdr, 1);
+    for (const auto &signal : m_signals) {
+        const uint64_t num_levels = signal.m_levels.size();
+        append_pod(out, &num_levels, 1);
+        for (const auto &level : signal.m_levels) {
+            const LevelHeader lhdr{.num_buckets = level.buckets.size(), .shift = level.shift};
+            append_pod(out, &lhdr, 1);
+            append_pod(out, level.buckets.data(), level.buckets.size());
+        }
+    }
+    const auto fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    posix_check(fd, "SignalPyramids save open");
+    write_all(fd, out.data(), out.size(), "SignalPyramids save write");
+    posix_check(close(fd), "SignalPyramids save close");
+}
+
+size_t SignalPyramids::size() const {
+    return m_signals.size();
+}
+
+const SignalPyramid &SignalPyramids::operator[](uint32_t sig) const {
+    return m_signals[sig];
+}
@@ -0,0 +1,104 @@
+#include <surf/rank-select.h>
+
+#include "common-internal.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace {
+
+SCA word_bits      = size_t{64};
+SCA words_per_sub  = RankSelect::sub_block_bits / word_bits;
+SCA subs_per_block = RankSelect::block_bits / RankSelect::sub_block_bits;
+static_assert(RankSelect::block_bits <= UINT16_MAX, "sub block ranks are 16 bit");
+
+// position of the one with rank k within word
+unsigned select_in_word(uint64_t word, unsigned k) {
+    for (unsigned i = 0; i < k; ++i) {
+        word &= word - 1;
+    }
+    return (unsigned)std::countr_zero(word);
+}
+
+}; // namespace
+
+void RankSelect::reserve(size_t num_bits) {
+    m_words.reserve((num_bits + word_bits - 1) / word_bits);
+    m_block_ranks.reserve((num_bits + block_bits - 1) / block_bits);
+    m_sub_ranks.reserve((num_bits + sub_block_bits - 1) / sub_block_bits);
+}
+
+void RankSelect::push_back(bool bit) {
+    if (m_size % block_bits == 0) {
+        m_block_ranks.emplace_back(m_num_ones);
+    }
+    if (m_size % sub_block_bits == 0) {
+        m_sub_ranks.emplace_back((uint16_t)(m_num_ones - m_block_ranks.back()));
+    }
+    if (m_size % word_bits == 0) {
+        m_words.emplace_back(0);
+    }
+    m_words.back() |= (uint64_t)bit << (m_size % word_bits);
+    m_num_ones += bit;
+    ++m_size;
+}
+
+size_t RankSelect::size() const {
+    return m_size;
+}
+
+size_t RankSelect::num_ones() const {
+    return m_num_ones;
+}
+
+bool RankSelect::operator[](size_t pos) const {
+    return (m_words[pos / word_bits] >> (pos % word_bits)) & 1;
+}
+
+size_t RankSelect::rank1(size_t pos) const {
+    if (pos >= m_size) {
+        return m_num_ones;
+    }
+    const auto sub = pos / sub_block_bits;
+    auto rank      = (size_t)m_block_ranks[pos / block_bits] + m_sub_ranks[sub];
+    for (auto word = sub * words_per_sub; word < pos / word_bits; ++word) {
+        rank += (size_t)std::popcount(m_words[word]);
+    }
+    const auto in_word = pos % word_bits;
+    if (in_word) {
+        rank += (size_t)std::popcount(m_words[pos / word_bits] << (word_bits - in_word));
+    }
+    return rank;
+}
+
+size_t RankSelect::select1(size_t k) const {
+    if (k >= m_num_ones) {
+        throw std::out_of_range(
+            fmt::format("RankSelect::select1 rank {:d} of {:d} ones", k, m_num_ones));
+    }
+    // last block starting with at most k ones before it
+    const auto block =
+        (size_t)(std::upper_bound(m_block_ranks.cbegin(), m_block_ranks.cend(), k) -
+                 m_block_ranks.cbegin()) -
+        1;
+    auto left      = k - m_block_ranks[block];
+    auto sub       = block * subs_per_block;
+    const auto end = std::min(sub + subs_per_block, m_sub_ranks.size());
+    while (sub + 1 < end && m_sub_ranks[sub + 1] <= left) {
+        ++sub;
+    }
+    left -= m_sub_ranks[sub];
+    for (auto word = sub * words_per_sub;; ++word) {
+        const auto ones = (size_t)std::popcount(m_words[word]);
+        if (left < ones) {
+            return word * word_bits + select_in_word(m_words[word], (unsigned)left);
+        }
+        left -= ones;
+    }
+}
+
+size_t RankSelect::memory_bytes() const {
+    return m_words.size() * sizeof(uint64_t) + m_block_ranks.size() * sizeof(uint64_t) +
+           m_sub_ranks.size() * sizeof(uint16_t);
+}
@@ -1,13 +1,268 @@
 #include <surf/render.h>
 
 #include "common-internal.h"
+#include "utils.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <future>
+#include <mutex>
+
+#include <BS_thread_pool.hpp>
 #include <fpng.h>
 
-Renderer::Renderer(const Trace &trace) : m_trace(trace) {}
+namespace {
+
+SCA chunks_per_thread = 4;
+SCA pixel_batch       = 1024u;
+
+struct Lane {
+    uint32_t *fb;
+    uint32_t width;
+    uint32_t hi;
+    uint32_t lo;
+
+    void fill(uint32_t x, uint32_t y_top, uint32_t y_bot, uint32_t color) const {
+        for (auto y = y_top; y <= y_bot; ++y) {
+            fb[(size_t)y * width + x] = color;
+        }
+    }
+    void dot(uint32_t x, uint32_t y, uint32_t color) const {
+        fb[(size_t)y * width + x] = color;
+    }
+};
+
+// index of the first tick >= tick at or after idx, exponential search since a tile usually only
+// moves the cursor a little
+size_t gallop(const std::vector<uint64_t> &ticks, size_t idx, uint64_t tick) {
+    size_t lo   = idx;
+    size_t hi   = idx;
+    size_t step = 1;
+    while (hi < ticks.size() && ticks[hi] < tick) {
+        lo = hi + 1;
+        hi = idx + step;
+        step *= 2;
+    }
+    hi = std::min(hi, ticks.size());
+    return (size_t)(std::lower_bound(ticks.cbegin() + lo, ticks.cbegin() + hi, tick) -
+                    ticks.cbegin());
+}
+
+void draw_steady(const Lane &lane, const SignalColumn &col, uint32_t x, size_t idx) {
+    if (col.kind() != SignalKind::scalar) {
+        lane.dot(x, lane.hi, Renderer::value_color);
+        lane.dot(x, lane.lo, Renderer::value_color);
+        return;
+    }
+    switch (col.logic(idx)) {
+    case Logic::v0:
+        lane.dot(x, lane.lo, Renderer::value_color);
+        break;
+    case Logic::v1:
+        lane.dot(x, lane.hi, Renderer::value_color);
+        break;
+    case Logic::vX:
+        lane.fill(x, lane.hi, lane.lo, Renderer::x_color);
+        break;
+    case Logic::vZ:
+        lane.dot(x, lane.hi + (lane.lo - lane.hi) / 2, Renderer::z_color);
+        break;
+    }
+}
+
+// edges among the changes of a whole bucket, saturating at 2 since that is all a pixel tells
+// apart. The seen values settle most buckets without touching the column: a single value can only
+// be an edge on the first change, three or more values need at least two edges.
+size_t bucket_edges(const PyramidBucket &bucket, const SignalColumn &col) {
+    if (bucket.num_seen == 1) {
+        return col.is_edge(bucket.first_change);
+    }
+    if (bucket.num_seen >= 3) {
+        return 2;
+    }
+    return col.num_edges(bucket.first_change, bucket.last_change() + 1);
+}
+
+uint64_t bucket_last_tick(const PyramidBucket &bucket, const PyramidLevel &level) {
+    return (bucket.bucket << level.shift) | (level.bucket_ticks() - 1);
+}
+
+}; // namespace
+
+Renderer::Renderer(const Trace &trace, uint32_t num_threads)
+    : m_owned_columns{SignalColumns::from_trace(trace)}, m_columns{*m_owned_columns},
+      m_num_threads{num_threads} {}
+
+Renderer::Renderer(const SignalColumns &columns, uint32_t num_threads)
+    : m_columns{columns}, m_num_threads{num_threads} {}
+
+Renderer::Renderer(const SignalColumns &columns, const SignalPyramids &pyramids,
+                   uint32_t num_threads)
+    : m_columns{columns}, m_pyramids{&pyramids}, m_num_threads{num_threads} {
+    if (pyramids.size() != columns.size()) {
+        throw std::range_error(fmt::format("Renderer: {:d} pyramids for {:d} signals",
+                                           pyramids.size(), columns.size()));
+    }
+}
 
 void Renderer::render(const Time &start, const Time &end, uint32_t width, uint32_t height,
-                      const fs::path &png_path) {
-    (void)m_trace;
-    return;
+                      const fs::path &png_path) const {
+    const auto fb = render_rgba(start, end, width, height);
+    static std::once_flag fpng_init_flag;
+    std::call_once(fpng_init_flag, [] {
+        fpng::fpng_init();
+    });
+    if (!fpng::fpng_encode_image_to_file(png_path.c_str(), fb.data(), width, height, 4)) {
+        throw std::runtime_error(fmt::format("Renderer: writing '{}' failed", png_path));
+    }
+}
+
+std::vector<uint32_t> Renderer::render_rgba(const Time &start, const Time &end, uint32_t width,
+                                            uint32_t height) const {
+    if (!width || !height) {
+        throw std::range_error(fmt::format("Renderer: empty {:d}x{:d} image", width, height));
+    }
+    if (start.ticks() > end.ticks()) {
+        throw std::range_error(fmt::format("Renderer: start {} after end {}", start, end));
+    }
+    const Viewport viewport{start, end, width};
+    std::vector<uint32_t> fb((size_t)width * height, bg_color);
+    const auto num_signals = (uint32_t)m_columns.size();
+    if (!num_signals) {
+        return fb;
+    }
+    // with more signals than rows only the first height signals are drawn
+    const auto lane_height = std::max(height / num_signals, 1u);
+    const auto num_lanes   = std::min(num_signals, height / lane_height);
+    // tiles of tile_lanes signals by tile_width pixels, every tile owns a disjoint part of fb
+    const auto tile_rows = (num_lanes + tile_lanes - 1) / tile_lanes;
+    const auto tile_cols = (width + tile_width - 1) / tile_width;
+    const auto num_tiles = (size_t)tile_rows * tile_cols;
+    const auto draw_tile = [&, this](size_t tile) {
+        const auto sig0 = (uint32_t)(tile / tile_cols) * tile_lanes;
+        const auto sig1 = std::min(sig0 + tile_lanes, num_lanes);
+        const auto x0   = (uint32_t)(tile % tile_cols) * tile_width;
+        const auto x1   = std::min(x0 + tile_width, width);
+        for (auto sig = sig0; sig < sig1; ++sig) {
+            render_signal(sig, viewport, x0, x1, sig * lane_height, lane_height, fb.data());
+        }
+    };
+
+    const auto num_threads = m_num_threads ? m_num_threads : get_num_cores();
+    if (num_threads == 1 || num_tiles == 1) {
+        for (size_t tile = 0; tile < num_tiles; ++tile) {
+            draw_tile(tile);
+        }
+        return fb;
+    }
+    // workers pull tiles off a shared counter so that signals with many changes don't stall a
+    // statically assigned share of the image
+    BS::thread_pool pool{num_threads};
+    std::atomic<size_t> next_tile{0};
+    const auto num_workers =
+        std::min<size_t>((size_t)pool.get_thread_count() * chunks_per_thread, num_tiles);
+    std::vector<std::future<void>> futures;
+    futures.reserve(num_workers);
+    for (size_t i = 0; i < num_workers; ++i) {
+        futures.emplace_back(pool.submit([&] {
+            for (auto tile = next_tile++; tile < num_tiles; tile = next_tile++) {
+                draw_tile(tile);
+            }
+        }));
+    }
+    for (auto &future : futures) {
+        future.get();
+    }
+    return fb;
+}
+
+void Renderer::render_signal(uint32_t sig, const Viewport &viewport, uint32_t x0, uint32_t x1,
+                             uint32_t y0, uint32_t lane_height, uint32_t *fb) const {
+    const auto &col   = m_columns[sig];
+    const auto &ticks = col.ticks();
+    // 1 pixel gap between lanes once they are tall enough
+    const auto margin = lane_height >= 4 ? 1u : 0u;
+    const Lane lane{.fb    = fb,
+                    .width = viewport.width(),
+                    .hi    = y0 + margin,
+                    .lo    = y0 + lane_height - 1 - margin};
+
+    // pixel x draws the changes in [pixel_tick(x), pixel_tick(x + 1)), so a change right at start
+    // is an edge of pixel 0 when it differs from the value before start
+    auto next = gallop(ticks, 0, viewport.pixel_tick(x0));
+    std::optional<size_t> cur;
+    if (next) {
+        cur = next - 1;
+    }
+    const auto draw = [&](uint32_t x, size_t num) {
+        if (num >= 2) {
+            lane.fill(x, lane.hi, lane.lo, toggle_color);
+        } else if (num == 1) {
+            lane.fill(x, lane.hi, lane.lo, value_color);
+        } else if (cur) {
+            draw_steady(lane, col, x, *cur);
+        }
+    };
+
+    const auto *level =
+        m_pyramids ? (*m_pyramids)[sig].level_for(viewport.ticks_per_pixel()) : nullptr;
+    if (level) {
+        // buckets are no wider than a pixel so each one straddles at most one pixel boundary,
+        // whole buckets are classified from their summary and only the changes of a straddling
+        // one are searched
+        const auto &buckets = level->buckets;
+        auto bi = next < ticks.size() ? level->lower_bound(ticks[next]) : buckets.size();
+        for (auto x = x0; x < x1; ++x) {
+            const auto px_end = viewport.pixel_tick(x + 1);
+            size_t num        = 0;
+            for (; bi < buckets.size() && bucket_last_tick(buckets[bi], *level) < px_end; ++bi) {
+                const auto &bucket = buckets[bi];
+                const auto after   = bucket.last_change() + 1;
+                // the first bucket of the tile may be partly drawn by the pixels before it
+                num += next == bucket.first_change ? bucket_edges(bucket, col)
+                                                   : col.num_edges(next, after);
+                next = after;
+                cur  = after - 1;
+            }
+            if (bi < buckets.size() && (buckets[bi].bucket << level->shift) < px_end) {
+                const auto after = (size_t)(std::lower_bound(
+                                                ticks.cbegin() + next,
+                                                ticks.cbegin() + buckets[bi].last_change() + 1,
+                                                px_end) -
+                                            ticks.cbegin());
+                if (after != next) {
+                    num += col.num_edges(next, after);
+                    next = after;
+                    cur  = after - 1;
+                }
+            }
+            draw(x, num);
+        }
+        return;
+    }
+
+    // the changes of the tile are mapped to pixels in batches, Viewport::pixels steps along the
+    // sorted ticks without dividing and every pixel draws once the first change past it shows up
+    const auto tile_end = gallop(ticks, next, viewport.pixel_tick(x1));
+    std::array<uint32_t, pixel_batch> pixels;
+    auto x     = x0;
+    size_t num = 0;
+    while (next < tile_end) {
+        const auto batch_sz = std::min<size_t>(pixel_batch, tile_end - next);
+        viewport.pixels({ticks.data() + next, batch_sz}, {pixels.data(), batch_sz});
+        for (size_t i = 0; i < batch_sz; ++i, ++next) {
+            for (; x < pixels[i]; ++x) {
+                draw(x, num);
+                num = 0;
+            }
+            // changes to the value already there aren't edges
+            num += col.is_edge(next);
+            cur = next;
+        }
+    }
+    for (; x < x1; ++x) {
+        draw(x, num);
+        num = 0;
+    }
 }
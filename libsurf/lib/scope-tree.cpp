@@ -0,0 +1,477 @@
+#include <surf/vcd.h>
+
+#include "common-internal.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cstring>
+
+using namespace VCDTypes;
+using index_t = ScopeTree::index_t;
+
+namespace {
+
+SCA fib_mul    = UINT64_C(0x9e3779b97f4a7c15);
+SCA empty_slot = std::numeric_limits<uint64_t>::max();
+// slots of a scope's first var table
+SCA min_var_slots = size_t{4};
+
+// Names are short, mixing them in 8 byte words inline is a good deal cheaper than std::hash's out
+// of line murmur, which shows when millions of vars go in.
+uint64_t name_hash(std::string_view name) {
+    uint64_t hash = name.size() * fib_mul;
+    size_t i      = 0;
+    for (; i + sizeof(uint64_t) <= name.size(); i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, name.data() + i, sizeof(word));
+        hash = std::rotl((hash ^ word) * fib_mul, 29);
+    }
+    // a variable length memcpy would be a call
+    uint64_t tail = 0;
+    for (auto j = name.size(); j > i; --j) {
+        tail = tail << CHAR_BIT | (uint8_t)name[j - 1];
+    }
+    hash ^= tail;
+    // murmur3's fmix64
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xff51afd7ed558ccd);
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xc4ceb9fe1a85ec53);
+    hash ^= hash >> 33;
+    return hash;
+}
+
+uint64_t child_hash(index_t parent, std::string_view name) {
+    return name_hash(name) ^ ((uint64_t)parent * fib_mul);
+}
+
+uint64_t slot_tag(uint64_t hash) {
+    return hash & ~UINT64_C(0xffffffff);
+}
+
+// A slot holds an entry below the top half of its hash, the top half also picks the home slot so
+// a table can grow without hashing any name again.
+size_t home_slot(uint64_t val, size_t mask) {
+    return (size_t)(val >> 32) & mask;
+}
+
+// The slot holding the entry with hash that is_match accepts, or the empty slot ending the probe.
+// is_match only sees entries whose tag matches.
+template <typename IsMatch>
+size_t probe(const uint64_t *slots, size_t cap, uint64_t hash, IsMatch &&is_match) {
+    const auto mask = cap - 1;
+    const auto tag  = slot_tag(hash);
+    for (auto slot = home_slot(hash, mask);; slot = (slot + 1) & mask) {
+        const auto val = slots[slot];
+        if (val == empty_slot || (slot_tag(val) == tag && is_match((index_t)val))) {
+            return slot;
+        }
+    }
+}
+
+// moves the entries of old into slots, which is empty
+void reinsert(std::span<const uint64_t> old, std::span<uint64_t> slots) {
+    const auto mask = slots.size() - 1;
+    for (const auto val : old) {
+        if (val != empty_slot) {
+            auto slot = home_slot(val, mask);
+            while (slots[slot] != empty_slot) {
+                slot = (slot + 1) & mask;
+            }
+            slots[slot] = val;
+        }
+    }
+}
+
+bool has_wildcard(std::string_view comp) {
+    return comp.find_first_of("*?") != std::string_view::npos;
+}
+
+// '*' matches any run of characters, '?' any one. Backtracks to the last '*' only, which is
+// enough since a later '*' can absorb anything an earlier one would have.
+bool wildcard_match(std::string_view pattern, std::string_view text) {
+    size_t p = 0, t = 0;
+    size_t star = std::string_view::npos, star_t = 0;
+    while (t < text.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t])) {
+            ++p;
+            ++t;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            star   = p++;
+            star_t = t;
+        } else if (star != std::string_view::npos) {
+            p = star + 1;
+            t = ++star_t;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+std::vector<std::string_view> split_path(std::string_view path) {
+    std::vector<std::string_view> comps;
+    for (auto dot = path.find('.'); dot != std::string_view::npos; dot = path.find('.')) {
+        comps.push_back(path.substr(0, dot));
+        path.remove_prefix(dot + 1);
+    }
+    comps.push_back(path);
+    return comps;
+}
+
+}; // namespace
+
+ScopeTree::ScopeTree() {
+    m_names = "root";
+    m_scopes.push_back({.name_off      = 0,
+                        .name_len      = (uint32_t)m_names.size(),
+                        .parent        = invalid,
+                        .first_child   = invalid,
+                        .last_child    = invalid,
+                        .next_sibling  = invalid,
+                        .first_var     = invalid,
+                        .last_var      = invalid,
+                        .var_slots_off = 0,
+                        .var_slots_cap = 0,
+                        .num_var_names = 0,
+                        .type          = ScopeType::root});
+}
+
+void ScopeTree::reserve(size_t num_scopes, size_t num_vars) {
+    m_scopes.reserve(num_scopes + 1);
+    // a few million vars fault in hundreds of MB, far fewer faults with huge pages
+    const auto reserve_huge = [](auto &vec, size_t num) {
+        if (num > vec.capacity()) {
+            const auto old_sz = vec.size();
+            vec.reserve(num);
+            advise_huge_pages(vec.data() + old_sz, (num - old_sz) * sizeof(vec[0]));
+        }
+    };
+    reserve_huge(m_vars, num_vars);
+    reserve_huge(m_var_scope, num_vars);
+    reserve_huge(m_next_var, num_vars);
+    // var tables are at most half full and double, so up to 4 slots per var
+    reserve_huge(m_var_slots, num_vars * 4);
+    const auto cap = std::max<size_t>(64, std::bit_ceil(num_scopes * 2));
+    if (cap > m_children.size()) {
+        rehash_children(cap);
+    }
+}
+
+index_t ScopeTree::add_scope(index_t parent, std::string_view name, ScopeType type) {
+    if (const auto existing = find_child(parent, name); existing != invalid) {
+        return existing;
+    }
+    if (m_scopes.size() >= max_entries) {
+        throw std::length_error("ScopeTree: over 2^31 scopes");
+    }
+    if (m_names.size() + name.size() > UINT32_MAX) {
+        throw std::length_error("ScopeTree: scope names over 4 GB");
+    }
+    const auto idx = (index_t)m_scopes.size();
+    m_scopes.push_back({.name_off      = (uint32_t)m_names.size(),
+                        .name_len      = (uint32_t)name.size(),
+                        .parent        = parent,
+                        .first_child   = invalid,
+                        .last_child    = invalid,
+                        .next_sibling  = invalid,
+                        .first_var     = invalid,
+                        .last_var      = invalid,
+                        .var_slots_off = 0,
+                        .var_slots_cap = 0,
+                        .num_var_names = 0,
+                        .type          = type});
+    m_names += name;
+    auto &p = m_scopes[parent];
+    if (p.last_child == invalid) {
+        p.first_child = idx;
+    } else {
+        m_scopes[p.last_child].next_sibling = idx;
+    }
+    p.last_child = idx;
+    insert_child(idx);
+    return idx;
+}
+
+index_t ScopeTree::add_var(index_t scope, const Var &var) {
+    if (m_vars.size() >= max_entries) {
+        throw std::length_error("ScopeTree: over 2^31 vars");
+    }
+    const auto idx = (index_t)m_vars.size();
+    m_vars.push_back(var);
+    m_var_scope.push_back(scope);
+    m_next_var.push_back(invalid);
+    auto &s = m_scopes[scope];
+    if (s.last_var == invalid) {
+        s.first_var = idx;
+    } else {
+        m_next_var[s.last_var] = idx;
+    }
+    s.last_var = idx;
+    insert_var(idx);
+    return idx;
+}
+
+size_t ScopeTree::num_scopes() const {
+    return m_scopes.size();
+}
+
+size_t ScopeTree::num_vars() const {
+    return m_vars.size();
+}
+
+std::string_view ScopeTree::name(index_t scope) const {
+    const auto &node = m_scopes[scope];
+    return std::string_view{m_names}.substr(node.name_off, node.name_len);
+}
+
+ScopeType ScopeTree::type(index_t scope) const {
+    return m_scopes[scope].type;
+}
+
+index_t ScopeTree::parent(index_t scope) const {
+    return m_scopes[scope].parent;
+}
+
+index_t ScopeTree::first_child(index_t scope) const {
+    return m_scopes[scope].first_child;
+}
+
+index_t ScopeTree::next_sibling(index_t scope) const {
+    return m_scopes[scope].next_sibling;
+}
+
+index_t ScopeTree::first_var(index_t scope) const {
+    return m_scopes[scope].first_var;
+}
+
+index_t ScopeTree::next_var(index_t var) const {
+    return m_next_var[var];
+}
+
+index_t ScopeTree::var_scope(index_t var) const {
+    return m_var_scope[var];
+}
+
+const Var &ScopeTree::var(index_t var) const {
+    return m_vars[var];
+}
+
+std::string_view ScopeTree::var_name(const Var &var) {
+    const auto end = std::find_if(var.ref.begin(), var.ref.end(), [](char c) {
+        return c == ' ' || c == '[';
+    });
+    return {var.ref.begin(), end};
+}
+
+std::string ScopeTree::path(index_t scope) const {
+    std::vector<index_t> chain;
+    for (; scope != root; scope = parent(scope)) {
+        chain.push_back(scope);
+    }
+    std::string res;
+    for (auto it = chain.crbegin(); it != chain.crend(); ++it) {
+        if (!res.empty()) {
+            res += '.';
+        }
+        res += name(*it);
+    }
+    return res;
+}
+
+std::string ScopeTree::var_path(index_t var) const {
+    auto res = path(var_scope(var));
+    if (!res.empty()) {
+        res += '.';
+    }
+    res += var_name(m_vars[var]);
+    return res;
+}
+
+index_t ScopeTree::find_scope(std::string_view path) const {
+    auto scope = root;
+    if (path.empty()) {
+        return scope;
+    }
+    for (const auto comp : split_path(path)) {
+        scope = find_child(scope, comp);
+        if (scope == invalid) {
+            break;
+        }
+    }
+    return scope;
+}
+
+index_t ScopeTree::find_var(std::string_view path) const {
+    const auto dot   = path.rfind('.');
+    const auto scope = dot == std::string_view::npos ? root : find_scope(path.substr(0, dot));
+    if (scope == invalid) {
+        return invalid;
+    }
+    return find_scope_var(scope, dot == std::string_view::npos ? path : path.substr(dot + 1));
+}
+
+std::vector<index_t> ScopeTree::glob(std::string_view pattern) const {
+    const auto comps = split_path(pattern);
+    std::vector<index_t> res;
+    glob_from(root, comps, res);
+    // "**" can reach a var more than one way
+    std::sort(res.begin(), res.end());
+    res.erase(std::unique(res.begin(), res.end()), res.end());
+    return res;
+}
+
+void ScopeTree::glob_from(index_t scope, std::span<const std::string_view> comps,
+                          std::vector<index_t> &res) const {
+    const auto comp = comps.front();
+    if (comps.size() == 1) {
+        for (auto var = first_var(scope); var != invalid; var = next_var(var)) {
+            if (comp == "**" || wildcard_match(comp, var_name(m_vars[var]))) {
+                res.push_back(var);
+            }
+        }
+        if (comp == "**") {
+            for (auto child = first_child(scope); child != invalid; child = next_sibling(child)) {
+                glob_from(child, comps, res);
+            }
+        }
+        return;
+    }
+    if (comp == "**") {
+        glob_from(scope, comps.subspan(1), res);
+        for (auto child = first_child(scope); child != invalid; child = next_sibling(child)) {
+            glob_from(child, comps, res);
+        }
+    } else if (has_wildcard(comp)) {
+        for (auto child = first_child(scope); child != invalid; child = next_sibling(child)) {
+            if (wildcard_match(comp, name(child))) {
+                glob_from(child, comps.subspan(1), res);
+            }
+        }
+    } else if (const auto child = find_child(scope, comp); child != invalid) {
+        glob_from(child, comps.subspan(1), res);
+    }
+}
+
+std::vector<index_t>
+ScopeTree::filter(const std::function<bool(std::string_view path)> &pred) const {
+    std::string buf;
+    std::vector<index_t> res;
+    filter_from(root, buf, pred, res);
+    std::sort(res.begin(), res.end());
+    return res;
+}
+
+void ScopeTree::filter_from(index_t scope, std::string &buf,
+                            const std::function<bool(std::string_view path)> &pred,
+                            std::vector<index_t> &res) const {
+    const auto len = buf.size();
+    for (auto var = first_var(scope); var != invalid; var = next_var(var)) {
+        if (len) {
+            buf += '.';
+        }
+        buf += var_name(m_vars[var]);
+        if (pred(buf)) {
+            res.push_back(var);
+        }
+        buf.resize(len);
+    }
+    for (auto child = first_child(scope); child != invalid; child = next_sibling(child)) {
+        if (len) {
+            buf += '.';
+        }
+        buf += name(child);
+        filter_from(child, buf, pred, res);
+        buf.resize(len);
+    }
+}
+
+index_t ScopeTree::find_child(index_t parent, std::string_view name) const {
+    if (m_children.empty()) {
+        return invalid;
+    }
+    const auto slot = probe(m_children.data(), m_children.size(), child_hash(parent, name),
+                            [&](index_t other) {
+                                return this->parent(other) == parent && this->name(other) == name;
+                            });
+    return m_children[slot] == empty_slot ? invalid : (index_t)m_children[slot];
+}
+
+void ScopeTree::insert_child(index_t scope) {
+    if ((m_num_children + 1) * 2 > m_children.size()) {
+        rehash_children(std::max<size_t>(64, m_children.size() * 2));
+    }
+    const auto parent = m_scopes[scope].parent;
+    const auto name   = this->name(scope);
+    const auto hash   = child_hash(parent, name);
+    const auto slot   = probe(m_children.data(), m_children.size(), hash, [&](index_t other) {
+        return this->parent(other) == parent && this->name(other) == name;
+    });
+    if (m_children[slot] == empty_slot) {
+        m_children[slot] = slot_tag(hash) | scope;
+        ++m_num_children;
+    }
+}
+
+void ScopeTree::rehash_children(size_t cap) {
+    std::vector<uint64_t> old;
+    old.reserve(cap);
+    // probes are spread over the whole table, with small pages nearly every one is a TLB miss
+    advise_huge_pages(old.data(), cap * sizeof(uint64_t));
+    old.assign(cap, empty_slot);
+    std::swap(m_children, old);
+    reinsert(old, m_children);
+}
+
+index_t ScopeTree::find_scope_var(index_t scope, std::string_view name) const {
+    const auto &node = m_scopes[scope];
+    if (!node.var_slots_cap) {
+        return invalid;
+    }
+    const auto *slots = m_var_slots.data() + node.var_slots_off;
+    const auto slot   = probe(slots, node.var_slots_cap, name_hash(name), [&](index_t other) {
+        return var_name(m_vars[other]) == name;
+    });
+    return slots[slot] == empty_slot ? invalid : (index_t)slots[slot];
+}
+
+void ScopeTree::insert_var(index_t var) {
+    const auto scope = m_var_scope[var];
+    auto &node       = m_scopes[scope];
+    if (((size_t)node.num_var_names + 1) * 2 > node.var_slots_cap) {
+        grow_var_slots(scope);
+    }
+    const auto name = var_name(m_vars[var]);
+    const auto hash = name_hash(name);
+    auto *slots     = m_var_slots.data() + node.var_slots_off;
+    const auto slot = probe(slots, node.var_slots_cap, hash, [&](index_t other) {
+        return var_name(m_vars[other]) == name;
+    });
+    // the first of several vars with the same name is the one found by name
+    if (slots[slot] == empty_slot) {
+        slots[slot] = slot_tag(hash) | var;
+        ++node.num_var_names;
+    }
+}
+
+void ScopeTree::grow_var_slots(index_t scope) {
+    auto &node           = m_scopes[scope];
+    const auto cap       = std::max(min_var_slots, node.var_slots_cap * 2);
+    const auto old_begin = m_var_slots.begin() + (ptrdiff_t)node.var_slots_off;
+    const std::vector<uint64_t> old(old_begin, old_begin + (ptrdiff_t)node.var_slots_cap);
+    // vars mostly arrive scope by scope, so the growing table is usually the last one and
+    // grows in place, other tables move to the end and leave a hole behind
+    if (node.var_slots_off + node.var_slots_cap == m_var_slots.size()) {
+        m_var_slots.resize(node.var_slots_off);
+    } else {
+        node.var_slots_off = m_var_slots.size();
+    }
+    m_var_slots.resize(node.var_slots_off + cap, empty_slot);
+    node.var_slots_cap = cap;
+    reinsert(old, {m_var_slots.data() + node.var_slots_off, cap});
+}
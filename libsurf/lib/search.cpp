@@ -0,0 +1,638 @@
+#include <surf/search.h>
+#include <surf/vcd.h>
+
+#include "common-internal.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <numeric>
+
+using namespace VCDTypes;
+
+namespace {
+
+using Op      = SignalSearch::Op;
+using Instr   = SignalSearch::Instr;
+SCA no_change = std::numeric_limits<size_t>::max();
+SCA no_tick   = std::numeric_limits<uint64_t>::max();
+
+// stack effect of an instruction
+int stack_delta(Op op) {
+    switch (op) {
+    case Op::push_signal:
+    case Op::push_const:
+    case Op::is_x:
+    case Op::is_z:
+        return 1;
+    case Op::logical_not:
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+bool is_path_char(char c) {
+    return std::isalnum((unsigned char)c) || c == '_' || c == '$' || c == '.';
+}
+
+// recursive descent straight to postfix, one function per grammar rule
+class Parser {
+public:
+    Parser(std::string_view expr, const Declarations &decls, const SignalColumns &columns,
+           std::vector<Instr> &code, std::vector<IDCodeTable::sig_t> &signals)
+        : m_expr{expr}, m_decls{decls}, m_columns{columns}, m_code{code}, m_signals{signals} {}
+
+    void parse() {
+        parse_or();
+        skip_ws();
+        if (m_pos != m_expr.size()) {
+            fail("unexpected character");
+        }
+    }
+
+private:
+    [[noreturn]] void fail(std::string_view msg) const {
+        throw std::invalid_argument(
+            fmt::format("SignalSearch: {:s} at offset {:d} of '{:s}'", msg, m_pos, m_expr));
+    }
+
+    void skip_ws() {
+        while (m_pos < m_expr.size() && std::isspace((unsigned char)m_expr[m_pos])) {
+            ++m_pos;
+        }
+    }
+
+    bool accept(std::string_view tok) {
+        skip_ws();
+        if (!m_expr.substr(m_pos).starts_with(tok)) {
+            return false;
+        }
+        m_pos += tok.size();
+        return true;
+    }
+
+    void expect(std::string_view tok) {
+        if (!accept(tok)) {
+            fail(fmt::format("expected '{:s}'", tok));
+        }
+    }
+
+    void parse_or() {
+        parse_and();
+        while (accept("||")) {
+            parse_and();
+            m_code.push_back({Op::logical_or, 0});
+        }
+    }
+
+    void parse_and() {
+        parse_cmp();
+        while (accept("&&")) {
+            parse_cmp();
+            m_code.push_back({Op::logical_and, 0});
+        }
+    }
+
+    void parse_cmp() {
+        parse_unary();
+        // two character operators first so "<=" isn't taken for "<"
+        static constexpr std::pair<std::string_view, Op> ops[] = {
+            {"==", Op::eq}, {"!=", Op::ne}, {"<=", Op::le},
+            {">=", Op::ge}, {"<", Op::lt},  {">", Op::gt},
+        };
+        for (const auto &[tok, op] : ops) {
+            if (accept(tok)) {
+                parse_unary();
+                m_code.push_back({op, 0});
+                return;
+            }
+        }
+    }
+
+    void parse_unary() {
+        skip_ws();
+        // not the start of "!="
+        if (m_pos + 1 < m_expr.size() && m_expr[m_pos] == '!' && m_expr[m_pos + 1] != '=') {
+            ++m_pos;
+            parse_unary();
+            m_code.push_back({Op::logical_not, 0});
+            return;
+        }
+        parse_primary();
+    }
+
+    void parse_primary() {
+        if (accept("(")) {
+            parse_or();
+            expect(")");
+            return;
+        }
+        skip_ws();
+        if (m_pos == m_expr.size()) {
+            fail("expected an operand");
+        }
+        if (std::isdigit((unsigned char)m_expr[m_pos])) {
+            m_code.push_back({Op::push_const, parse_number()});
+            return;
+        }
+        const auto path = parse_path();
+        if (path == "isx" || path == "isz") {
+            expect("(");
+            skip_ws();
+            const auto slot = signal_slot(parse_path(), false);
+            expect(")");
+            m_code.push_back({path == "isx" ? Op::is_x : Op::is_z, slot});
+            return;
+        }
+        m_code.push_back({Op::push_signal, signal_slot(path, true)});
+    }
+
+    uint64_t parse_number() {
+        unsigned base = 10;
+        if (accept("0x") || accept("0X")) {
+            base = 16;
+        } else if (accept("0b") || accept("0B")) {
+            base = 2;
+        }
+        const auto begin = m_pos;
+        uint64_t num{};
+        for (; m_pos < m_expr.size(); ++m_pos) {
+            const auto c = (char)std::tolower((unsigned char)m_expr[m_pos]);
+            if (c == '_') {
+                continue;
+            }
+            unsigned digit;
+            if (c >= '0' && c <= '9') {
+                digit = (unsigned)(c - '0');
+            } else if (c >= 'a' && c <= 'f') {
+                digit = (unsigned)(c - 'a' + 10);
+            } else {
+                break;
+            }
+            if (digit >= base) {
+                fail("bad digit");
+            }
+            if (num > (std::numeric_limits<uint64_t>::max() - digit) / base) {
+                fail("number wider than 64 bits");
+            }
+            num = num * base + digit;
+        }
+        if (m_pos == begin) {
+            fail("expected digits");
+        }
+        return num;
+    }
+
+    std::string_view parse_path() {
+        const auto begin = m_pos;
+        while (m_pos < m_expr.size() && is_path_char(m_expr[m_pos])) {
+            ++m_pos;
+        }
+        if (m_pos == begin) {
+            fail("expected a signal path");
+        }
+        return m_expr.substr(begin, m_pos - begin);
+    }
+
+    // value: the signal's value is read, not just its X/Z bits
+    uint32_t signal_slot(std::string_view path, bool value) {
+        const auto var = m_decls.scopes.find_var(path);
+        const auto sig =
+            var == ScopeTree::invalid ? IDCodeTable::invalid_sig : m_decls.scopes.var(var).sig;
+        if (sig == IDCodeTable::invalid_sig || sig >= m_columns.size()) {
+            m_pos -= path.size();
+            fail(fmt::format("unknown signal '{:s}'", path));
+        }
+        const auto &col = m_columns[sig];
+        if (col.kind() == SignalKind::real) {
+            throw std::domain_error(
+                fmt::format("SignalSearch: '{:s}' is a real, not a logic signal", path));
+        }
+        if (value && col.bitsize() > 64) {
+            throw std::domain_error(fmt::format(
+                "SignalSearch: '{:s}' is {:d} bits wide, values are limited to 64", path,
+                col.bitsize()));
+        }
+        const auto it = std::find(m_signals.cbegin(), m_signals.cend(), sig);
+        if (it != m_signals.cend()) {
+            return (uint32_t)(it - m_signals.cbegin());
+        }
+        m_signals.push_back(sig);
+        return (uint32_t)(m_signals.size() - 1);
+    }
+
+    std::string_view m_expr;
+    size_t m_pos{};
+    const Declarations &m_decls;
+    const SignalColumns &m_columns;
+    std::vector<Instr> &m_code;
+    std::vector<IDCodeTable::sig_t> &m_signals;
+};
+
+bool truthy(uint64_t value, bool unknown) {
+    return value && !unknown;
+}
+
+// any bit that is X (want_x) or Z
+bool any_xz(const SignalColumn &col, size_t idx, bool want_x) {
+    if (col.kind() == SignalKind::scalar) {
+        return col.logic(idx) == (want_x ? Logic::vX : Logic::vZ);
+    }
+    const auto xz = col.xz(idx);
+    if (!xz) {
+        return false;
+    }
+    const auto *bits = col.bits(idx).data();
+    for (size_t i = 0; i < xz->bytesize(); ++i) {
+        if (xz->data()[i] & (want_x ? bits[i] : (uint8_t)~bits[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// next edge of col after change cur, no_change if none
+size_t next_edge_after(const SignalColumn &col, size_t cur) {
+    const auto first = cur == no_change ? 0 : cur + 1;
+    // most changes are edges, look at a few before going to the directory
+    for (auto i = first; i < std::min(first + 4, col.size()); ++i) {
+        if (col.is_edge(i)) {
+            return i;
+        }
+    }
+    const auto &edges = col.edges();
+    const auto rank   = edges.rank1(first);
+    return rank < edges.num_ones() ? edges.select1(rank) : no_change;
+}
+
+// last edge of col before change index end, no_change if none
+size_t last_edge_before(const SignalColumn &col, size_t end) {
+    const auto rank = col.edges().rank1(end);
+    return rank ? col.edges().select1(rank - 1) : no_change;
+}
+
+// the values v with "v op c" true, lo > hi if none
+std::pair<uint64_t, uint64_t> cmp_range(Op op, uint64_t c) {
+    switch (op) {
+    case Op::eq:
+        return {c, c};
+    case Op::lt:
+        return c ? std::pair{uint64_t{0}, c - 1} : std::pair{uint64_t{1}, uint64_t{0}};
+    case Op::le:
+        return {0, c};
+    case Op::gt:
+        return c != UINT64_MAX ? std::pair{c + 1, UINT64_MAX} : std::pair{uint64_t{1}, uint64_t{0}};
+    case Op::ge:
+        return {c, UINT64_MAX};
+    default:
+        SURF_UNREACHABLE();
+    }
+}
+
+// the same comparison with its operands swapped
+Op mirror_cmp(Op op) {
+    switch (op) {
+    case Op::lt:
+        return Op::gt;
+    case Op::le:
+        return Op::ge;
+    case Op::gt:
+        return Op::lt;
+    case Op::ge:
+        return Op::le;
+    default:
+        return op;
+    }
+}
+
+bool is_range_cmp(Op op) {
+    return op == Op::eq || op == Op::lt || op == Op::le || op == Op::gt || op == Op::ge;
+}
+
+uint64_t tick_or(const SignalColumn &col, size_t idx, uint64_t none) {
+    return idx == no_change ? none : col.tick(idx);
+}
+
+}; // namespace
+
+SignalSearch::SignalSearch(std::string_view expr, const Declarations &decls,
+                           const SignalColumns &columns)
+    : m_columns{&columns} {
+    Parser{expr, decls, columns, m_code, m_signals}.parse();
+    int depth = 0;
+    for (const auto &instr : m_code) {
+        depth += stack_delta(instr.op);
+        m_max_depth = std::max(m_max_depth, (size_t)depth);
+    }
+    split_terms(0, m_code.size());
+    // order doesn't matter to the result, put the terms that fail fastest first
+    std::stable_sort(m_terms.begin(), m_terms.end(), [](const Term &a, const Term &b) {
+        return a.code_end - a.code_begin < b.code_end - b.code_begin;
+    });
+}
+
+void SignalSearch::split_terms(size_t code_begin, size_t code_end) {
+    if (m_code[code_end - 1].op == Op::logical_and) {
+        // the right operand is the shortest suffix that pushes exactly one value
+        auto right = code_end - 1;
+        int depth  = 0;
+        do {
+            depth += stack_delta(m_code[--right].op);
+        } while (depth != 1);
+        split_terms(code_begin, right);
+        split_terms(right, code_end - 1);
+        return;
+    }
+    Term term{.code_begin = code_begin, .code_end = code_end};
+    for (auto i = code_begin; i < code_end; ++i) {
+        const auto op = m_code[i].op;
+        if ((op == Op::push_signal || op == Op::is_x || op == Op::is_z) &&
+            std::find(term.slots.cbegin(), term.slots.cend(), m_code[i].arg) ==
+                term.slots.cend()) {
+            term.slots.push_back((uint32_t)m_code[i].arg);
+        }
+    }
+    // the shapes the zone maps can answer on vectors: "sig op const", "const op sig" and isx/isz
+    const auto *code = m_code.data() + code_begin;
+    const auto is_vector_slot = [&](uint64_t slot) {
+        return (*m_columns)[m_signals[slot]].kind() == SignalKind::vector;
+    };
+    if (code_end - code_begin == 3 && is_range_cmp(code[2].op)) {
+        if (code[0].op == Op::push_signal && code[1].op == Op::push_const &&
+            is_vector_slot(code[0].arg)) {
+            term.value_range = cmp_range(code[2].op, code[1].arg);
+        } else if (code[0].op == Op::push_const && code[1].op == Op::push_signal &&
+                   is_vector_slot(code[1].arg)) {
+            term.value_range = cmp_range(mirror_cmp(code[2].op), code[0].arg);
+        }
+    } else if (code_end - code_begin == 1 && (code[0].op == Op::is_x || code[0].op == Op::is_z) &&
+               is_vector_slot(code[0].arg)) {
+        term.finds_xz = true;
+    }
+    m_terms.push_back(std::move(term));
+}
+
+bool SignalSearch::eval(const Term &term, std::span<const size_t> cur,
+                        std::vector<Operand> &stack) const {
+    stack.clear();
+    for (auto i = term.code_begin; i < term.code_end; ++i) {
+        const auto &instr = m_code[i];
+        switch (instr.op) {
+        case Op::push_signal: {
+            const auto idx = cur[instr.arg];
+            if (idx == no_change) {
+                stack.push_back({0, true});
+                break;
+            }
+            const auto &col = (*m_columns)[m_signals[instr.arg]];
+            if (col.kind() == SignalKind::scalar) {
+                const auto logic = col.logic(idx);
+                stack.push_back({logic == Logic::v1, logic == Logic::vX || logic == Logic::vZ});
+            } else {
+                const auto bits = col.bits(idx);
+                uint64_t value{};
+                memcpy(&value, bits.data(), bits.bytesize());
+                stack.push_back({value, col.xz(idx).has_value()});
+            }
+            break;
+        }
+        case Op::push_const:
+            stack.push_back({instr.arg, false});
+            break;
+        case Op::is_x:
+        case Op::is_z: {
+            const auto idx = cur[instr.arg];
+            stack.push_back({idx != no_change && any_xz((*m_columns)[m_signals[instr.arg]], idx,
+                                                         instr.op == Op::is_x),
+                             false});
+            break;
+        }
+        case Op::logical_not:
+            stack.back() = {!truthy(stack.back().value, stack.back().unknown), false};
+            break;
+        default: {
+            const auto rhs = stack.back();
+            stack.pop_back();
+            auto &lhs = stack.back();
+            if (instr.op == Op::logical_and || instr.op == Op::logical_or) {
+                const auto l = truthy(lhs.value, lhs.unknown);
+                const auto r = truthy(rhs.value, rhs.unknown);
+                lhs          = {instr.op == Op::logical_and ? l && r : l || r, false};
+                break;
+            }
+            if (lhs.unknown || rhs.unknown) {
+                lhs = {0, false};
+                break;
+            }
+            bool res{};
+            switch (instr.op) {
+            case Op::eq:
+                res = lhs.value == rhs.value;
+                break;
+            case Op::ne:
+                res = lhs.value != rhs.value;
+                break;
+            case Op::lt:
+                res = lhs.value < rhs.value;
+                break;
+            case Op::le:
+                res = lhs.value <= rhs.value;
+                break;
+            case Op::gt:
+                res = lhs.value > rhs.value;
+                break;
+            case Op::ge:
+                res = lhs.value >= rhs.value;
+                break;
+            default:
+                SURF_UNREACHABLE();
+            }
+            lhs = {res, false};
+            break;
+        }
+        }
+    }
+    return truthy(stack.back().value, stack.back().unknown);
+}
+
+bool SignalSearch::holds_at(uint64_t tick) const {
+    std::vector<size_t> cur(m_signals.size());
+    for (size_t k = 0; k < m_signals.size(); ++k) {
+        cur[k] = (*m_columns)[m_signals[k]].index_at(tick).value_or(no_change);
+    }
+    std::vector<Operand> stack;
+    stack.reserve(m_max_depth);
+    return std::all_of(m_terms.cbegin(), m_terms.cend(), [&](const Term &term) {
+        return eval(term, cur, stack);
+    });
+}
+
+std::optional<uint64_t> SignalSearch::next(uint64_t tick) const {
+    const auto num_sigs = m_signals.size();
+    // per signal: the change in effect and the next edge after it
+    std::vector<size_t> cur(num_sigs), nxt(num_sigs);
+    for (size_t k = 0; k < num_sigs; ++k) {
+        const auto &col = (*m_columns)[m_signals[k]];
+        cur[k]          = col.index_at(tick).value_or(no_change);
+        nxt[k]          = next_edge_after(col, cur[k]);
+    }
+    const auto next_tick = [&](std::span<const uint32_t> slots) {
+        auto res = no_tick;
+        for (const auto k : slots) {
+            res = std::min(res, tick_or((*m_columns)[m_signals[k]], nxt[k], no_tick));
+        }
+        return res;
+    };
+    std::vector<uint32_t> all_slots(num_sigs);
+    std::vector<uint8_t> failed(m_terms.size());
+    std::iota(all_slots.begin(), all_slots.end(), 0);
+    std::vector<Operand> stack;
+    stack.reserve(m_max_depth);
+
+    for (auto at = next_tick(all_slots); at != no_tick;) {
+        for (size_t k = 0; k < num_sigs; ++k) {
+            const auto &col = (*m_columns)[m_signals[k]];
+            if (nxt[k] == no_change || col.tick(nxt[k]) > at) {
+                continue;
+            }
+            // the last change at or before at, past any rewrites of the same value
+            const auto &ticks = col.ticks();
+            if (nxt[k] + 1 == ticks.size() || ticks[nxt[k] + 1] > at) {
+                cur[k] = nxt[k];
+            } else {
+                cur[k] = (size_t)(std::upper_bound(ticks.cbegin() + (ptrdiff_t)nxt[k],
+                                                   ticks.cend(), at) -
+                                  ticks.cbegin()) -
+                         1;
+            }
+            nxt[k] = next_edge_after(col, cur[k]);
+        }
+        // a false term stays false until one of its signals changes, nothing can hold before
+        // the latest of those changes
+        auto skip_to = next_tick(all_slots);
+        bool holds   = true;
+        for (size_t i = 0; i < m_terms.size(); ++i) {
+            failed[i] = !eval(m_terms[i], cur, stack);
+            if (failed[i]) {
+                holds   = false;
+                skip_to = std::max(skip_to, next_tick(m_terms[i].slots));
+            }
+        }
+        if (holds) {
+            return at;
+        }
+        // a false term of one signal can look further ahead by itself, without the others
+        for (size_t i = 0; i < m_terms.size() && skip_to != no_tick; ++i) {
+            if (failed[i] && m_terms[i].slots.size() == 1) {
+                skip_to = std::max(skip_to, next_possible(m_terms[i], cur, skip_to, stack));
+            }
+        }
+        at = skip_to;
+    }
+    return std::nullopt;
+}
+
+uint64_t SignalSearch::next_possible(const Term &term, std::span<size_t> cur, uint64_t tick,
+                                     std::vector<Operand> &stack) const {
+    const auto k      = term.slots.front();
+    const auto &col   = (*m_columns)[m_signals[k]];
+    const auto &ticks = col.ticks();
+    const auto saved  = cur[k];
+    // the change in effect just before tick, then every one after it
+    auto idx = (size_t)(std::lower_bound(ticks.cbegin(), ticks.cend(), tick) - ticks.cbegin());
+    cur[k]   = idx ? idx - 1 : no_change;
+    auto res = no_tick;
+    if (eval(term, cur, stack)) {
+        res = tick;
+    } else if (term.value_range) {
+        const auto [lo, hi] = *term.value_range;
+        if (const auto found = col.find_in_range(idx, lo, hi)) {
+            res = ticks[*found];
+        }
+    } else if (term.finds_xz) {
+        for (auto found = col.find_xz(idx); found; found = col.find_xz(*found + 1)) {
+            cur[k] = *found;
+            if (eval(term, cur, stack)) {
+                res = ticks[*found];
+                break;
+            }
+        }
+    } else {
+        for (; idx < ticks.size(); ++idx) {
+            cur[k] = idx;
+            if (eval(term, cur, stack)) {
+                res = ticks[idx];
+                break;
+            }
+        }
+    }
+    cur[k] = saved;
+    return res;
+}
+
+std::optional<uint64_t> SignalSearch::prev(uint64_t tick) const {
+    const auto num_sigs = m_signals.size();
+    // per signal: the last edge before the search bound and the change in effect at the candidate
+    std::vector<size_t> edge(num_sigs), cur(num_sigs);
+    // exclusive, ticks before it are still candidates
+    auto bound = tick;
+    std::vector<Operand> stack;
+    stack.reserve(m_max_depth);
+
+    while (true) {
+        auto at = no_tick;
+        for (size_t k = 0; k < num_sigs; ++k) {
+            const auto &col   = (*m_columns)[m_signals[k]];
+            const auto &ticks = col.ticks();
+            const auto before =
+                (size_t)(std::lower_bound(ticks.cbegin(), ticks.cend(), bound) - ticks.cbegin());
+            edge[k] = last_edge_before(col, before);
+            if (edge[k] != no_change && (at == no_tick || col.tick(edge[k]) > at)) {
+                at = col.tick(edge[k]);
+            }
+        }
+        if (at == no_tick) {
+            return std::nullopt;
+        }
+        for (size_t k = 0; k < num_sigs; ++k) {
+            cur[k] = (*m_columns)[m_signals[k]].index_at(at).value_or(no_change);
+        }
+        // a false term had the same value back to the latest edge of its signals, nothing
+        // before that edge holds
+        bound      = at;
+        bool holds = true;
+        for (const auto &term : m_terms) {
+            if (eval(term, cur, stack)) {
+                continue;
+            }
+            holds         = false;
+            uint64_t from = 0;
+            bool any_edge = false;
+            for (const auto k : term.slots) {
+                const auto &col = (*m_columns)[m_signals[k]];
+                if (cur[k] != no_change) {
+                    from     = std::max(from, col.tick(last_edge_before(col, cur[k] + 1)));
+                    any_edge = true;
+                }
+            }
+            // constant, or every signal still before its first change
+            if (!any_edge) {
+                return std::nullopt;
+            }
+            bound = std::min(bound, from);
+        }
+        if (holds) {
+            return at;
+        }
+    }
+}
+
+const std::vector<SignalSearch::Instr> &SignalSearch::code() const {
+    return m_code;
+}
+
+const std::vector<IDCodeTable::sig_t> &SignalSearch::signals() const {
+    return m_signals;
+}
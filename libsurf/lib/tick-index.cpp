@@ -0,0 +1,176 @@
+#include <surf/tick-index.h>
+
+#include "common-internal.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+using namespace std::string_view_literals;
+
+SCA comment_kw = "$comment"sv;
+SCA end_kw     = "$end"sv;
+
+bool is_line_tick(std::string_view str, size_t pos) {
+    return str[pos] == '#' && (!pos || str[pos - 1] == '\n') && pos + 1 < str.size() &&
+           str[pos + 1] >= '0' && str[pos + 1] <= '9';
+}
+
+// a $comment command, ids can contain '$' but never start a command
+bool is_comment(std::string_view str, size_t pos) {
+    return (!pos || std::isspace((uint8_t)str[pos - 1])) && str.substr(pos).starts_with(comment_kw);
+}
+
+// offset of the first '$comment' in [pos, end), npos if none
+size_t find_comment(std::string_view str, size_t pos, size_t end) {
+    while (pos < end) {
+        const auto *dollar = (const char *)memchr(str.data() + pos, '$', end - pos);
+        if (!dollar) {
+            break;
+        }
+        pos = (size_t)(dollar - str.data());
+        if (is_comment(str, pos)) {
+            return pos;
+        }
+        ++pos;
+    }
+    return std::string_view::npos;
+}
+
+// offset of the first line tick at or after pos, npos if none. pos must be outside a $comment,
+// the '#' lines inside one are text. A $comment runs to the first "$end", as the scanner reads it.
+size_t next_line_tick(std::string_view str, size_t pos) {
+    while (pos < str.size()) {
+        auto tick = pos;
+        while (tick < str.size()) {
+            const auto *hash = (const char *)memchr(str.data() + tick, '#', str.size() - tick);
+            if (!hash) {
+                tick = std::string_view::npos;
+                break;
+            }
+            tick = (size_t)(hash - str.data());
+            if (is_line_tick(str, tick)) {
+                break;
+            }
+            ++tick;
+        }
+        const auto comment = find_comment(str, pos, std::min(tick, str.size()));
+        if (comment == std::string_view::npos) {
+            return tick < str.size() ? tick : std::string_view::npos;
+        }
+        const auto end = str.find(end_kw, comment + comment_kw.size());
+        if (end == std::string_view::npos) {
+            break;
+        }
+        pos = end + end_kw.size();
+    }
+    return std::string_view::npos;
+}
+
+// start of the $comment around the line tick at pos, npos if it's outside of one. Only reads ahead
+// to the next command, so probing the tail of the file stays cheap.
+size_t enclosing_comment(std::string_view str, size_t pos) {
+    for (; pos < str.size(); ++pos) {
+        const auto *dollar = (const char *)memchr(str.data() + pos, '$', str.size() - pos);
+        if (!dollar) {
+            break;
+        }
+        pos = (size_t)(dollar - str.data());
+        if (str.substr(pos).starts_with(end_kw)) {
+            return str.rfind(comment_kw, pos);
+        }
+        if (is_comment(str, pos)) {
+            break;
+        }
+    }
+    return std::string_view::npos;
+}
+
+uint64_t parse_tick(std::string_view str, size_t pos) {
+    uint64_t tick        = 0;
+    const auto [ptr, ec] = std::from_chars(str.data() + pos + 1, str.data() + str.size(), tick);
+    if (ec != std::errc{}) {
+        throw std::domain_error(fmt::format("VCD tick at byte {:d} overflows", pos));
+    }
+    return tick;
+}
+
+}; // namespace
+
+TickSeekIndex TickSeekIndex::build(std::string_view sim_cmds_str, size_t stride,
+                                   std::stop_token stop) {
+    if (!stride) {
+        throw std::range_error("TickSeekIndex: zero stride");
+    }
+    TickSeekIndex res;
+    res.m_size      = sim_cmds_str.size();
+    size_t next_pos = 0;
+    auto pos        = next_line_tick(sim_cmds_str, 0);
+    for (; pos != std::string_view::npos; pos = next_line_tick(sim_cmds_str, pos + 1)) {
+        ++res.m_num_ticks;
+        if (pos < next_pos) {
+            continue;
+        }
+        if (stop.stop_requested()) {
+            return res;
+        }
+        res.m_entries.push_back(
+            TickSeekEntry{.tick = parse_tick(sim_cmds_str, pos), .offset = pos});
+        next_pos = (pos / stride + 1) * stride;
+    }
+    res.m_complete = true;
+    return res;
+}
+
+std::optional<TickSeekEntry> TickSeekIndex::first_tick(std::string_view sim_cmds_str) {
+    const auto pos = next_line_tick(sim_cmds_str, 0);
+    if (pos == std::string_view::npos) {
+        return std::nullopt;
+    }
+    return TickSeekEntry{.tick = parse_tick(sim_cmds_str, pos), .offset = pos};
+}
+
+std::optional<TickSeekEntry> TickSeekIndex::last_tick(std::string_view sim_cmds_str) {
+    auto pos = sim_cmds_str.size();
+    while (pos && (pos = sim_cmds_str.rfind('#', pos - 1)) != std::string_view::npos) {
+        if (!is_line_tick(sim_cmds_str, pos)) {
+            continue;
+        }
+        if (const auto comment = enclosing_comment(sim_cmds_str, pos);
+            comment != std::string_view::npos) {
+            pos = comment;
+            continue;
+        }
+        return TickSeekEntry{.tick = parse_tick(sim_cmds_str, pos), .offset = pos};
+    }
+    return std::nullopt;
+}
+
+const std::vector<TickSeekEntry> &TickSeekIndex::entries() const {
+    return m_entries;
+}
+
+uint64_t TickSeekIndex::num_ticks() const {
+    return m_num_ticks;
+}
+
+bool TickSeekIndex::complete() const {
+    return m_complete;
+}
+
+std::pair<size_t, size_t> TickSeekIndex::byte_range(uint64_t start, uint64_t end) const {
+    // entries are in tick order since ticks never go back in time
+    const auto after_start =
+        std::lower_bound(m_entries.cbegin(), m_entries.cend(), start,
+                         [](const TickSeekEntry &e, uint64_t tick) { return e.tick < tick; });
+    const auto after_end =
+        std::upper_bound(m_entries.cbegin(), m_entries.cend(), end,
+                         [](uint64_t tick, const TickSeekEntry &e) { return tick < e.tick; });
+    const auto begin = after_start == m_entries.cbegin() ? 0 : std::prev(after_start)->offset;
+    const auto stop  = after_end == m_entries.cend() ? m_size : after_end->offset;
+    return {(size_t)begin, (size_t)stop};
+}
@@ -2,6 +2,34 @@
 
 #include "common-internal.h"
 
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+__extension__ typedef unsigned __int128 uint128_t;
+
+// every power of ten up to 10^22 is exact in a double
+constexpr auto pow10_table = [] {
+    std::array<double, 23> res{};
+    double p = 1;
+    for (auto &v : res) {
+        v = p;
+        p *= 10;
+    }
+    return res;
+}();
+
+double pow10(int power) {
+    const auto abs_power = (size_t)std::abs(power);
+    if (abs_power >= pow10_table.size()) {
+        throw std::range_error(fmt::format("Time: timebase power {:d} out of range", power));
+    }
+    return pow10_table[abs_power];
+}
+
+}; // namespace
+
 Time::Time() : m_timebase_power(0), m_ticks(0) {}
 
 Time::Time(uint64_t ticks, int timebase_power) : m_timebase_power(timebase_power), m_ticks(ticks) {}
@@ -22,9 +50,120 @@ int Time::timebase_power() const {
 }
 
 uint64_t Time::seconds_to_ticks(double seconds, int timebase_power) {
-    return 1;
+    // one correctly rounded multiply or divide by an exact power of ten
+    const auto ticks = std::round(timebase_power <= 0 ? seconds * pow10(timebase_power)
+                                                       : seconds / pow10(timebase_power));
+    // 2^64, also rejects NaN
+    if (!(ticks >= 0 && ticks < 18446744073709551616.0)) {
+        throw std::range_error(
+            fmt::format("Time: {:g} s is not a tick count at timebase power {:d}", seconds,
+                        timebase_power));
+    }
+    return (uint64_t)ticks;
 }
 
 double Time::ticks_to_seconds(uint64_t ticks, int timebase_power) {
-    return 1;
+    // dividing by 10^n rather than multiplying by the inexact 10^-n
+    return timebase_power <= 0 ? (double)ticks / pow10(timebase_power)
+                               : (double)ticks * pow10(timebase_power);
+}
+
+Viewport::Viewport(uint64_t start, uint64_t end, uint32_t width)
+    : m_start{start}, m_end{end}, m_span{end - start + 1}, m_width{width} {
+    if (!width) {
+        throw std::range_error("Viewport: zero width");
+    }
+    if (start > end || !m_span) {
+        throw std::range_error(fmt::format("Viewport: bad tick range [{:d}, {:d}]", start, end));
+    }
+    m_ticks_per_pixel = m_span / width;
+    m_ticks_rem       = m_span % width;
+    m_scale           = (double)width / (double)m_span;
+}
+
+Viewport::Viewport(const Time &start, const Time &end, uint32_t width)
+    : Viewport{start.ticks(), end.ticks(), width} {
+    if (start.timebase_power() != end.timebase_power()) {
+        throw std::domain_error(fmt::format("Viewport: mismatched timebases {} {}", start, end));
+    }
+}
+
+uint64_t Viewport::start() const {
+    return m_start;
+}
+
+uint64_t Viewport::end() const {
+    return m_end;
+}
+
+uint32_t Viewport::width() const {
+    return m_width;
+}
+
+uint64_t Viewport::ticks_per_pixel() const {
+    return m_ticks_per_pixel;
+}
+
+uint64_t Viewport::pixel_tick(uint32_t x) const {
+    // start + span * x / width, split so that nothing overflows 64 bits
+    return m_start + m_ticks_per_pixel * x + m_ticks_rem * x / m_width;
+}
+
+uint32_t Viewport::pixel(uint64_t tick) const {
+    if (tick < m_start) {
+        return 0;
+    }
+    if (tick >= m_end) {
+        return m_width - 1;
+    }
+    // pixel_tick(x) <= tick <=> span * x < (tick - start + 1) * width, so the floating point
+    // estimate is fixed up with multiplies only
+    const auto lim = (uint128_t)(tick - m_start + 1) * m_width;
+    auto x = std::min((uint32_t)((double)(tick - m_start) * m_scale), m_width - 1);
+    while (x + 1 < m_width && (uint128_t)m_span * (x + 1) < lim) {
+        ++x;
+    }
+    while ((uint128_t)m_span * x >= lim) {
+        --x;
+    }
+    return x;
+}
+
+void Viewport::pixels(std::span<const uint64_t> ticks, std::span<uint32_t> pixels) const {
+    if (ticks.size() != pixels.size()) {
+        throw std::range_error(fmt::format("Viewport: {:d} ticks for {:d} pixels", ticks.size(),
+                                           pixels.size()));
+    }
+    // sorted runs, like the ticks of a SignalColumn, step the end of the current pixel along
+    // Bresenham style without dividing, anything else falls back to pixel()
+    uint32_t x         = 0;
+    uint64_t next_tick = 0;
+    uint64_t rem       = 0;
+    const auto seek    = [&](uint32_t px) {
+        x         = px;
+        next_tick = pixel_tick(x + 1);
+        rem       = m_ticks_rem * (x + 1) % m_width;
+    };
+    // start at the first tick's pixel so that a batch from the middle of the viewport doesn't
+    // step over all of the pixels before it
+    seek(ticks.empty() ? 0 : pixel(ticks.front()));
+    uint64_t prev_tick = 0;
+    for (size_t i = 0; i < ticks.size(); ++i) {
+        const auto tick = ticks[i];
+        if (tick < prev_tick || tick < m_start || tick > m_end) {
+            seek(pixel(tick));
+        } else {
+            while (x + 1 < m_width && tick >= next_tick) {
+                ++x;
+                next_tick += m_ticks_per_pixel;
+                rem += m_ticks_rem;
+                if (rem >= m_width) {
+                    rem -= m_width;
+                    ++next_tick;
+                }
+            }
+        }
+        pixels[i] = x;
+        prev_tick = tick;
+    }
 }
@@ -0,0 +1,380 @@
+#include <surf/trace-writer.h>
+
+#include "common-internal.h"
+#include "utils.h"
+
+#include <algorithm>
+
+#include <visit.hpp>
+
+#ifdef SURF_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace trace_format;
+using namespace VCDTypes;
+
+namespace {
+
+SCA out_flush_sz = 1024 * 1024;
+// keeps every value bit offset of a tick_log representable in a uint32_t
+SCA max_value_buf_sz = std::numeric_limits<uint32_t>::max() / CHAR_BIT / 2;
+
+void append_tick_log(std::vector<uint8_t> &out, uint64_t tick, const std::vector<uint32_t> &sigs,
+                     const std::vector<uint32_t> &value_bit_offsets,
+                     const std::vector<uint8_t> &value_buf) {
+    const TickLogHeader hdr{.tick           = tick,
+                            .num_changes    = (uint32_t)sigs.size(),
+                            .value_buf_size = (uint32_t)value_buf.size()};
+    append_pod(out, &hdr, 1);
+    append_pod(out, sigs.data(), sigs.size());
+    append_pod(out, value_bit_offsets.data(), value_bit_offsets.size());
+    append_pod(out, value_buf.data(), value_buf.size());
+    out.resize(roundup_pow2_mul(out.size(), alignof(TickLogHeader)));
+}
+
+}; // namespace
+
+TraceWriter::TraceWriter(const fs::path &path, int timebase_power, std::vector<TraceSignal> signals,
+                         TraceWriterOptions options)
+    : m_path(path), m_timebase_power(timebase_power), m_options(options),
+      m_signals(std::move(signals)) {
+#ifndef SURF_HAS_ZSTD
+    if (m_options.compress) {
+        throw std::runtime_error("TraceWriter: libsurf was built without zstd");
+    }
+#endif
+    if (m_options.compress) {
+        m_state.resize(m_signals.size());
+    }
+    for (const auto &signal : m_signals) {
+        if (signal.kind == SignalKind::vector &&
+            (signal.bitsize == 0 || signal.bitsize > std::numeric_limits<varbit::sz_t>::max())) {
+            throw std::domain_error(
+                fmt::format("TraceWriter: unsupported vector width {:d}", signal.bitsize));
+        }
+    }
+    m_fd = open(m_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    posix_check(m_fd, "TraceWriter open");
+    // placeholder header, filled in by finish()
+    const FileHeader hdr{};
+    append_pod(m_out, &hdr, 1);
+    append_pod(m_out, m_signals.data(), m_signals.size());
+}
+
+TraceWriter::~TraceWriter() {
+    close(m_fd);
+}
+
+void TraceWriter::add_tick(uint64_t tick) {
+    if (m_seen_tick && tick < m_tick) {
+        throw std::domain_error(
+            fmt::format("TraceWriter: tick #{:d} goes back in time from #{:d}", tick, m_tick));
+    }
+    const bool log_open = m_seen_tick || !m_sigs.empty();
+    m_seen_tick         = true;
+    if (log_open && tick == m_tick) {
+        return;
+    }
+    if (log_open) {
+        flush_tick_log();
+    }
+    m_tick = tick;
+}
+
+void TraceWriter::add_logic(uint32_t sig, Logic logic) {
+    check_sig(sig, SignalKind::scalar);
+    const auto bit_off = m_value_bits;
+    if (bit_off % CHAR_BIT == 0) {
+        m_value_buf.push_back(0);
+    }
+    m_value_buf.back() |= (uint8_t)((uint8_t)logic << (bit_off % CHAR_BIT));
+    m_value_bits += 2;
+    m_sigs.push_back(sig);
+    m_value_bit_offsets.push_back((uint32_t)bit_off);
+}
+
+void TraceWriter::add_bits(uint32_t sig, bitview bits, std::optional<bitview> xz) {
+    check_sig(sig, SignalKind::vector);
+    const auto bitsize = (varbit::sz_t)m_signals[sig].bitsize;
+    const auto bit_off = m_value_buf.size() * CHAR_BIT;
+    m_value_buf.push_back(xz ? vector_flag_xz : 0);
+    const auto bits_off = m_value_buf.size();
+    append_bytes(bits, bitsize);
+    if (xz) {
+        const auto xz_off = m_value_buf.size();
+        append_bytes(*xz, bitsize);
+        // a narrower value with a leading X or Z extends it to the full width
+        const auto top = xz->bitsize() - 1;
+        if (xz->bitsize() < bitsize && (xz->data()[top / CHAR_BIT] >> (top % CHAR_BIT)) & 1) {
+            const bool top_bit = bits.bitsize() > top &&
+                                 ((bits.data()[top / CHAR_BIT] >> (top % CHAR_BIT)) & 1);
+            for (auto i = (size_t)top + 1; i < bitsize; ++i) {
+                const auto bit = (uint8_t)(1u << (i % CHAR_BIT));
+                m_value_buf[xz_off + i / CHAR_BIT] |= bit;
+                if (top_bit) {
+                    m_value_buf[bits_off + i / CHAR_BIT] |= bit;
+                }
+            }
+        }
+    }
+    m_value_bits = m_value_buf.size() * CHAR_BIT;
+    m_sigs.push_back(sig);
+    m_value_bit_offsets.push_back((uint32_t)bit_off);
+}
+
+void TraceWriter::add_real(uint32_t sig, double real) {
+    check_sig(sig, SignalKind::real);
+    const auto bit_off = m_value_buf.size() * CHAR_BIT;
+    m_value_buf.resize(m_value_buf.size() + sizeof(real));
+    memcpy(m_value_buf.data() + bit_off / CHAR_BIT, &real, sizeof(real));
+    m_value_bits = m_value_buf.size() * CHAR_BIT;
+    m_sigs.push_back(sig);
+    m_value_bit_offsets.push_back((uint32_t)bit_off);
+}
+
+void TraceWriter::add_change(const Change &change, const VarBitArena *arena) {
+    const auto sig = change.sig;
+    if (sig >= m_signals.size()) {
+        throw std::range_error(fmt::format("TraceWriter: unknown signal {:d}", sig));
+    }
+    const auto kind = m_signals[sig].kind;
+    rollbear::visit(overload(
+                        [&](ScalarValue sv) {
+                            if (kind != SignalKind::vector) {
+                                add_logic(sig, sv.logic());
+                                return;
+                            }
+                            const uint8_t bit    = sv.b() || sv.x();
+                            const uint8_t xz_bit = sv.x() || sv.z();
+                            add_bits(sig, bitview{bit, 1},
+                                     xz_bit ? std::optional{bitview{xz_bit, 1}} : std::nullopt);
+                        },
+                        [&](const BinaryNum &bnum) {
+                            if (kind == SignalKind::scalar) {
+                                add_logic(sig, bnum.logic(arena));
+                            } else {
+                                add_bits(sig, bnum.bits_view(arena), bnum.xz_view(arena));
+                            }
+                        },
+                        [&](RealNum rnum) {
+                            add_real(sig, rnum.num);
+                        }),
+                    change.value);
+}
+
+void TraceWriter::add_sim_cmds(std::span<const SimCmd> cmds,
+                               std::span<const VarBitArena> arenas) {
+    for (const auto &cmd : cmds) {
+        rollbear::visit(overload(
+                            [&](const Tick &tick) {
+                                add_tick(tick.tick);
+                            },
+                            [&](const Change &change) {
+                                add_change(change,
+                                           arenas.empty() ? nullptr : &arenas[change.sig]);
+                            },
+                            [](const Comment &) {}),
+                        cmd);
+    }
+}
+
+void TraceWriter::finish() {
+    if (m_finished) {
+        return;
+    }
+    if (m_seen_tick || !m_sigs.empty()) {
+        flush_tick_log();
+    }
+    if (m_options.compress) {
+        flush_block();
+    }
+    const auto index_off = m_file_off + m_out.size();
+    if (m_options.compress) {
+        append_pod(m_out, m_blocks.data(), m_blocks.size());
+    } else {
+        append_pod(m_out, m_index.data(), m_index.size());
+    }
+    flush_out();
+
+    FileHeader hdr{};
+    hdr.version        = version;
+    hdr.timebase_power = m_timebase_power;
+    hdr.start_tick     = m_start_tick;
+    hdr.end_tick       = m_num_ticks ? m_tick : 0;
+    hdr.num_signals    = (uint32_t)m_signals.size();
+    hdr.flags          = m_options.compress ? file_flag_zstd : 0;
+    hdr.num_ticks      = m_num_ticks;
+    hdr.signals_offset = sizeof(FileHeader);
+    hdr.index_offset   = index_off;
+    hdr.num_blocks     = m_blocks.size();
+    hdr.magic          = magic;
+    // the body is complete at this point so a valid header never fronts a partial trace
+    const auto pwrite_res = pwrite(m_fd, &hdr, sizeof(hdr), 0);
+    posix_check(pwrite_res < 0 ? -1 : 0, "TraceWriter header pwrite");
+    if (pwrite_res != sizeof(hdr)) {
+        throw std::runtime_error("TraceWriter: short header write");
+    }
+    m_finished = true;
+}
+
+std::vector<TraceSignal> TraceWriter::signals_from_declarations(const Declarations &decls) {
+    std::vector<TraceSignal> signals;
+    signals.reserve(decls.signals.size());
+    for (const auto &signal : decls.signals) {
+        const auto kind = signal.kind();
+        if (kind != SignalKind::real && signal.size <= 0) {
+            throw std::domain_error(fmt::format("Unsupported signal width: {:d}", signal.size));
+        }
+        const auto bitsize =
+            kind == SignalKind::real ? (uint32_t)sizeofbits<double>() : (uint32_t)signal.size;
+        signals.push_back(TraceSignal{.bitsize = bitsize, .kind = kind});
+    }
+    return signals;
+}
+
+void TraceWriter::write_document(const Document &doc, int timebase_power, const fs::path &path,
+                                 TraceWriterOptions options) {
+    TraceWriter writer{path, timebase_power, signals_from_declarations(doc.declarations), options};
+    writer.add_sim_cmds(doc.sim_cmds, doc.arenas);
+    writer.finish();
+}
+
+void TraceWriter::check_sig(uint32_t sig, SignalKind kind) const {
+    if (sig >= m_signals.size()) {
+        throw std::range_error(fmt::format("TraceWriter: unknown signal {:d}", sig));
+    }
+    if (m_signals[sig].kind != kind) {
+        throw std::domain_error(fmt::format("TraceWriter: {:s} value for {:s} signal {:d}",
+                                            magic_enum::enum_name(kind),
+                                            magic_enum::enum_name(m_signals[sig].kind), sig));
+    }
+    if (m_value_buf.size() > max_value_buf_sz) {
+        throw std::range_error("TraceWriter: tick_log value buffer overflow");
+    }
+}
+
+void TraceWriter::append_bytes(bitview bits, varbit::sz_t bitsize) {
+    const auto stride = varbit::bytesize4bitsize(bitsize);
+    const auto off    = m_value_buf.size();
+    m_value_buf.resize(off + stride);
+    std::copy_n(bits.data(), std::min(bits.bytesize(), stride), m_value_buf.data() + off);
+    if (const auto partial_bits = bitsize % CHAR_BIT) {
+        m_value_buf[off + stride - 1] &= pow2_mask(partial_bits);
+    }
+}
+
+void TraceWriter::flush_tick_log() {
+    if (!m_num_ticks) {
+        m_start_tick = m_tick;
+    }
+    ++m_num_ticks;
+    if (!m_options.compress) {
+        m_index.push_back(TickIndexEntry{.tick = m_tick, .offset = m_file_off + m_out.size()});
+        append_tick_log(m_out, m_tick, m_sigs, m_value_bit_offsets, m_value_buf);
+    } else {
+        if (m_block.empty()) {
+            m_block_entry = BlockIndexEntry{.first_tick     = m_tick,
+                                            .last_tick      = m_tick,
+                                            .first_tick_idx = m_num_ticks - 1};
+            append_snapshot();
+        }
+        append_tick_log(m_block, m_tick - m_block_entry.last_tick, m_sigs, m_value_bit_offsets,
+                        m_value_buf);
+        m_block_entry.last_tick = m_tick;
+        ++m_block_entry.num_ticks;
+        update_state();
+    }
+
+    m_sigs.clear();
+    m_value_bit_offsets.clear();
+    m_value_buf.clear();
+    m_value_bits = 0;
+    if (m_options.compress && m_block.size() >= m_options.block_size) {
+        flush_block();
+    }
+    if (m_out.size() >= out_flush_sz) {
+        flush_out();
+    }
+}
+
+void TraceWriter::append_snapshot() {
+    std::vector<uint32_t> sigs;
+    std::vector<uint32_t> value_bit_offsets;
+    std::vector<uint8_t> value_buf;
+    size_t value_bits = 0;
+    for (uint32_t sig = 0; sig < m_state.size(); ++sig) {
+        const auto &val = m_state[sig];
+        if (val.empty()) {
+            continue;
+        }
+        sigs.push_back(sig);
+        if (m_signals[sig].kind == SignalKind::scalar) {
+            if (value_bits % CHAR_BIT == 0) {
+                value_buf.push_back(0);
+            }
+            value_buf.back() |= (uint8_t)(val[0] << (value_bits % CHAR_BIT));
+            value_bit_offsets.push_back((uint32_t)value_bits);
+            value_bits += 2;
+        } else {
+            value_bit_offsets.push_back((uint32_t)(value_buf.size() * CHAR_BIT));
+            value_buf.insert(value_buf.end(), val.cbegin(), val.cend());
+            value_bits = value_buf.size() * CHAR_BIT;
+        }
+    }
+    // absolute tick, the first tick_log of the block follows with a delta of 0
+    append_tick_log(m_block, m_tick, sigs, value_bit_offsets, value_buf);
+}
+
+void TraceWriter::update_state() {
+    for (size_t i = 0; i < m_sigs.size(); ++i) {
+        const auto sig     = m_sigs[i];
+        const auto bit_off = m_value_bit_offsets[i];
+        const auto *val    = m_value_buf.data() + bit_off / CHAR_BIT;
+        auto &state        = m_state[sig];
+        switch (m_signals[sig].kind) {
+        case SignalKind::scalar:
+            state.assign(1, (uint8_t)((*val >> (bit_off % CHAR_BIT)) & 0b11));
+            break;
+        case SignalKind::vector: {
+            const auto bytesize = varbit::bytesize4bitsize((varbit::sz_t)m_signals[sig].bitsize);
+            state.assign(val, val + 1 + bytesize * ((*val & vector_flag_xz) ? 2 : 1));
+            break;
+        }
+        case SignalKind::real:
+            state.assign(val, val + sizeof(double));
+            break;
+        }
+    }
+}
+
+void TraceWriter::flush_block() {
+    if (m_block.empty()) {
+        return;
+    }
+#ifdef SURF_HAS_ZSTD
+    if (m_block.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::range_error("TraceWriter: block too large");
+    }
+    const auto out_off = m_out.size();
+    m_out.resize(out_off + ZSTD_compressBound(m_block.size()));
+    const auto res = ZSTD_compress(m_out.data() + out_off, m_out.size() - out_off, m_block.data(),
+                                   m_block.size(), m_options.zstd_level);
+    if (ZSTD_isError(res)) {
+        throw std::runtime_error(
+            fmt::format("TraceWriter: zstd compression failed: {:s}", ZSTD_getErrorName(res)));
+    }
+    m_out.resize(roundup_pow2_mul(out_off + res, alignof(BlockIndexEntry)));
+    m_block_entry.offset            = m_file_off + out_off;
+    m_block_entry.compressed_size   = (uint32_t)res;
+    m_block_entry.decompressed_size = (uint32_t)m_block.size();
+    m_blocks.push_back(m_block_entry);
+    m_block.clear();
+#endif
+}
+
+void TraceWriter::flush_out() {
+    write_all(m_fd, m_out.data(), m_out.size(), "TraceWriter write");
+    m_file_off += m_out.size();
+    m_out.clear();
+}
@@ -3,9 +3,174 @@
 #include "common-internal.h"
 #include "utils.h"
 
-Trace::Trace(const fs::path &path) : m_path(path) {
-    m_fd = open(m_path.c_str(), O_RDONLY);
-    posix_check(m_fd, "Surf trace open");
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef SURF_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace trace_format;
+
+namespace surf {
+
+struct TraceBlock {
+    std::vector<uint8_t> buf;
+    // offsets of the tick_logs in buf, [0] is the sync snapshot
+    std::vector<size_t> log_offsets;
+};
+
+// Least recently used set of decompressed blocks. An evicted block lives on until the last TickLog
+// pointing into it goes away.
+class TraceBlockCache {
+public:
+    TraceBlockCache(size_t capacity) : m_capacity{std::max<size_t>(capacity, 1)} {}
+
+    template <typename Load> std::shared_ptr<const TraceBlock> get(size_t block_idx, Load &&load) {
+        {
+            std::lock_guard lock{m_mutex};
+            if (auto block = lookup(block_idx)) {
+                return block;
+            }
+        }
+        // decompress without holding the lock, at worst a racing thread does the same block
+        std::shared_ptr<const TraceBlock> block = load();
+        std::lock_guard lock{m_mutex};
+        if (auto cached = lookup(block_idx)) {
+            return cached;
+        }
+        m_lru.emplace_front(block_idx, block);
+        m_map.emplace(block_idx, m_lru.begin());
+        if (m_lru.size() > m_capacity) {
+            m_map.erase(m_lru.back().first);
+            m_lru.pop_back();
+        }
+        return block;
+    }
+
+private:
+    using lru_t = std::list<std::pair<size_t, std::shared_ptr<const TraceBlock>>>;
+
+    std::shared_ptr<const TraceBlock> lookup(size_t block_idx) {
+        const auto it = m_map.find(block_idx);
+        if (it == m_map.end()) {
+            return nullptr;
+        }
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return it->second->second;
+    }
+
+    const size_t m_capacity;
+    std::mutex m_mutex;
+    lru_t m_lru;
+    std::unordered_map<size_t, lru_t::iterator> m_map;
+};
+
+}; // namespace surf
+
+TickLog::TickLog(const uint8_t *log, const TraceSignal *signals, std::shared_ptr<const void> owner)
+    : m_hdr{(const TickLogHeader *)log}, m_signals{signals}, m_owner{std::move(owner)} {
+    m_sigs              = (const uint32_t *)(log + sizeof(TickLogHeader));
+    m_value_bit_offsets = m_sigs + m_hdr->num_changes;
+    m_value_buf         = (const uint8_t *)(m_value_bit_offsets + m_hdr->num_changes);
+}
+
+uint64_t TickLog::tick() const {
+    return m_hdr->tick;
+}
+
+uint32_t TickLog::num_changes() const {
+    return m_hdr->num_changes;
+}
+
+std::span<const uint32_t> TickLog::sigs() const {
+    return {m_sigs, m_hdr->num_changes};
+}
+
+uint32_t TickLog::sig(size_t idx) const {
+    return m_sigs[idx];
+}
+
+const TraceSignal &TickLog::signal(size_t idx) const {
+    return m_signals[m_sigs[idx]];
+}
+
+Logic TickLog::logic(size_t idx) const {
+    // scalars are 2 bit aligned so they never straddle a byte
+    const auto bit_off = m_value_bit_offsets[idx];
+    return (Logic)((m_value_buf[bit_off / CHAR_BIT] >> (bit_off % CHAR_BIT)) & 0b11);
+}
+
+bitview TickLog::bits(size_t idx) const {
+    const auto *val = m_value_buf + m_value_bit_offsets[idx] / CHAR_BIT;
+    return bitview{val + 1, (varbit::sz_t)signal(idx).bitsize};
+}
+
+std::optional<bitview> TickLog::xz(size_t idx) const {
+    const auto *val = m_value_buf + m_value_bit_offsets[idx] / CHAR_BIT;
+    if (!(*val & vector_flag_xz)) {
+        return std::nullopt;
+    }
+    const auto bitsize = (varbit::sz_t)signal(idx).bitsize;
+    return bitview{val + 1 + varbit::bytesize4bitsize(bitsize), bitsize};
+}
+
+double TickLog::real(size_t idx) const {
+    double res;
+    memcpy(&res, m_value_buf + m_value_bit_offsets[idx] / CHAR_BIT, sizeof(res));
+    return res;
+}
+
+size_t TickLog::size() const {
+    return roundup_pow2_mul(sizeof(TickLogHeader) + 2 * sizeof(uint32_t) * m_hdr->num_changes +
+                                m_hdr->value_buf_size,
+                            alignof(TickLogHeader));
+}
+
+Trace::Trace(const fs::path &path, size_t block_cache_sz)
+    : m_mapped_file(path), m_block_cache{std::make_unique<TraceBlockCache>(block_cache_sz)} {
+    const auto *data = m_mapped_file.data();
+    const auto size  = m_mapped_file.size();
+    if (size < file_header_v1_size) {
+        throw std::domain_error(fmt::format("Surf trace '{}' is truncated", path));
+    }
+    m_hdr = (const FileHeader *)data;
+    if (m_hdr->magic != magic) {
+        throw std::domain_error(
+            fmt::format("'{}' is not a (completely written) Surf trace", path));
+    }
+    if (m_hdr->version < 1 || m_hdr->version > version) {
+        throw std::domain_error(fmt::format("Surf trace '{}' has unsupported version {:d}", path,
+                                            m_hdr->version));
+    }
+    m_num_blocks = m_hdr->version >= 2 ? m_hdr->num_blocks : 0;
+    const auto index_sz = compressed() ? m_num_blocks * sizeof(BlockIndexEntry)
+                                       : num_ticks() * sizeof(TickIndexEntry);
+    if (m_hdr->signals_offset + m_hdr->num_signals * sizeof(TraceSignal) > size ||
+        m_hdr->index_offset + index_sz > size) {
+        throw std::domain_error(fmt::format("Surf trace '{}' is truncated", path));
+    }
+#ifndef SURF_HAS_ZSTD
+    if (compressed()) {
+        throw std::runtime_error(fmt::format(
+            "Surf trace '{}' is zstd compressed but libsurf was built without zstd", path));
+    }
+#endif
+    const auto *index = data + m_hdr->index_offset;
+    m_signals         = (const TraceSignal *)(data + m_hdr->signals_offset);
+    m_index           = compressed() ? nullptr : (const TickIndexEntry *)index;
+    m_block_index     = compressed() ? (const BlockIndexEntry *)index : nullptr;
+    m_timebase_power  = m_hdr->timebase_power;
+    m_start           = Time{m_hdr->start_tick, m_timebase_power};
+    m_end             = Time{m_hdr->end_tick, m_timebase_power};
+}
+
+Trace::~Trace() = default;
+
+const fs::path &Trace::path() const {
+    return m_mapped_file.path();
 }
 
 int Trace::timebase_power() const {
@@ -19,3 +184,233 @@ Time Trace::start() const {
 Time Trace::end() const {
     return m_end;
 }
+
+uint32_t Trace::num_signals() const {
+    return m_hdr->num_signals;
+}
+
+std::span<const TraceSignal> Trace::signals() const {
+    return {m_signals, m_hdr->num_signals};
+}
+
+size_t Trace::num_ticks() const {
+    return m_hdr->num_ticks;
+}
+
+TickLog Trace::tick_log(size_t idx) const {
+    if (idx >= num_ticks()) {
+        throw std::range_error(
+            fmt::format("Trace tick_log index {:d} out of range ({:d})", idx, num_ticks()));
+    }
+    if (!compressed()) {
+        const auto off = m_index[idx].offset;
+        if (off > m_mapped_file.size()) {
+            throw std::domain_error(fmt::format("Surf trace '{}' tick_log {:d} is out of bounds",
+                                                path(), idx));
+        }
+        return checked_tick_log(m_mapped_file.data() + off, m_mapped_file.size() - off);
+    }
+    const auto block_idx = block_index(idx);
+    auto blk             = block(block_idx);
+    const auto log_off   = blk->log_offsets[idx - m_block_index[block_idx].first_tick_idx + 1];
+    const auto *log      = blk->buf.data() + log_off;
+    // blk is moved from in the same call, read it first
+    const auto avail = blk->buf.size() - log_off;
+    return checked_tick_log(log, avail, std::move(blk));
+}
+
+TickLog Trace::checked_tick_log(const uint8_t *log, size_t avail,
+                                std::shared_ptr<const void> owner) const {
+    const auto corrupt = [&](std::string_view why) {
+        return std::domain_error(fmt::format("Surf trace '{}' is corrupt: {:s}", path(), why));
+    };
+    if (avail < sizeof(TickLogHeader)) {
+        throw corrupt("truncated tick_log");
+    }
+    TickLog res{log, m_signals, std::move(owner)};
+    if (res.size() > avail) {
+        throw corrupt("truncated tick_log");
+    }
+    // the same layout TickLog's constructor walks
+    const auto num_changes        = res.num_changes();
+    const auto value_buf_size     = ((const TickLogHeader *)log)->value_buf_size;
+    const auto *value_bit_offsets = res.sigs().data() + num_changes;
+    const auto *value_buf         = (const uint8_t *)(value_bit_offsets + num_changes);
+    for (uint32_t i = 0; i < num_changes; ++i) {
+        const auto sig = res.sig(i);
+        if (sig >= num_signals()) {
+            throw corrupt(fmt::format("change to signal {:d} of {:d}", sig, num_signals()));
+        }
+        const auto off     = (size_t)value_bit_offsets[i] / CHAR_BIT;
+        const auto &signal = m_signals[sig];
+        size_t value_sz    = 1;
+        if (signal.kind == SignalKind::real) {
+            value_sz = sizeof(double);
+        } else if (signal.kind == SignalKind::vector) {
+            value_sz = 1 + varbit::bytesize4bitsize((varbit::sz_t)signal.bitsize);
+            if (off < value_buf_size && (value_buf[off] & vector_flag_xz)) {
+                value_sz += varbit::bytesize4bitsize((varbit::sz_t)signal.bitsize);
+            }
+        }
+        if (off + value_sz > value_buf_size) {
+            throw corrupt(fmt::format("value of signal {:d} out of bounds", sig));
+        }
+    }
+    return res;
+}
+
+std::optional<size_t> Trace::tick_log_index(uint64_t tick) const {
+    if (!compressed()) {
+        const auto *end = m_index + num_ticks();
+        const auto *it =
+            std::upper_bound(m_index, end, tick, [](uint64_t t, const TickIndexEntry &e) {
+                return t < e.tick;
+            });
+        if (it == m_index) {
+            return std::nullopt;
+        }
+        return (size_t)(it - m_index) - 1;
+    }
+
+    const auto *blocks_end = m_block_index + m_num_blocks;
+    const auto *bit =
+        std::upper_bound(m_block_index, blocks_end, tick, [](uint64_t t, const BlockIndexEntry &e) {
+            return t < e.first_tick;
+        });
+    if (bit == m_block_index) {
+        return std::nullopt;
+    }
+    --bit;
+    if (tick >= bit->last_tick) {
+        return bit->first_tick_idx + bit->num_ticks - 1;
+    }
+    // first_tick <= tick < last_tick, search the logs following the snapshot
+    const auto blk = block((size_t)(bit - m_block_index));
+    size_t lo = 1;
+    size_t hi = blk->log_offsets.size();
+    while (lo < hi) {
+        const auto mid = lo + (hi - lo) / 2;
+        if (((const TickLogHeader *)(blk->buf.data() + blk->log_offsets[mid]))->tick <= tick) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return bit->first_tick_idx + lo - 2;
+}
+
+std::pair<size_t, size_t> Trace::tick_log_range(uint64_t start, uint64_t end) const {
+    if (start > end) {
+        return {0, 0};
+    }
+    size_t first = 0;
+    if (start) {
+        if (const auto before = tick_log_index(start - 1)) {
+            first = *before + 1;
+        }
+    }
+    size_t last = 0;
+    if (const auto at_end = tick_log_index(end)) {
+        last = *at_end + 1;
+    }
+    return {first, std::max(first, last)};
+}
+
+bool Trace::compressed() const {
+    return m_hdr->flags & file_flag_zstd;
+}
+
+size_t Trace::num_blocks() const {
+    return m_num_blocks;
+}
+
+size_t Trace::block_index(size_t tick_idx) const {
+    if (!compressed()) {
+        throw std::logic_error("Trace::block_index on an uncompressed trace");
+    }
+    if (tick_idx >= num_ticks()) {
+        throw std::range_error(
+            fmt::format("Trace tick_log index {:d} out of range ({:d})", tick_idx, num_ticks()));
+    }
+    const auto *it = std::upper_bound(m_block_index, m_block_index + m_num_blocks, tick_idx,
+                                      [](size_t idx, const BlockIndexEntry &e) {
+                                          return idx < e.first_tick_idx;
+                                      });
+    return (size_t)(it - m_block_index) - 1;
+}
+
+TickLog Trace::block_snapshot(size_t block_idx) const {
+    if (!compressed()) {
+        throw std::logic_error("Trace::block_snapshot on an uncompressed trace");
+    }
+    if (block_idx >= m_num_blocks) {
+        throw std::range_error(
+            fmt::format("Trace block index {:d} out of range ({:d})", block_idx, m_num_blocks));
+    }
+    auto blk         = block(block_idx);
+    const auto *log  = blk->buf.data() + blk->log_offsets[0];
+    const auto avail = blk->buf.size() - blk->log_offsets[0];
+    return checked_tick_log(log, avail, std::move(blk));
+}
+
+const SignalColumns &Trace::columns() const {
+    std::call_once(m_columns_once_flag, [&] {
+        m_columns = SignalColumns::from_trace(*this);
+    });
+    return *m_columns;
+}
+
+std::shared_ptr<const TraceBlock> Trace::block(size_t block_idx) const {
+    return m_block_cache->get(block_idx, [&] {
+        return decompress_block(block_idx);
+    });
+}
+
+std::shared_ptr<const TraceBlock> Trace::decompress_block(size_t block_idx) const {
+    const auto &entry  = m_block_index[block_idx];
+    const auto corrupt = [&](std::string_view why) {
+        return std::domain_error(
+            fmt::format("Surf trace '{}' block {:d} is corrupt: {:s}", path(), block_idx, why));
+    };
+    if (entry.offset + entry.compressed_size > m_mapped_file.size()) {
+        throw corrupt("out of bounds");
+    }
+    auto blk  = std::make_shared<TraceBlock>();
+    auto &buf = blk->buf;
+    buf.resize(entry.decompressed_size);
+#ifdef SURF_HAS_ZSTD
+    const auto res = ZSTD_decompress(buf.data(), buf.size(), m_mapped_file.data() + entry.offset,
+                                     entry.compressed_size);
+    if (ZSTD_isError(res)) {
+        throw corrupt(ZSTD_getErrorName(res));
+    }
+    if (res != buf.size()) {
+        throw corrupt("short decompression");
+    }
+#else
+    throw std::runtime_error("libsurf was built without zstd");
+#endif
+
+    // undo the tick delta encoding in place
+    auto &log_offsets = blk->log_offsets;
+    log_offsets.reserve(entry.num_ticks + 1);
+    uint64_t tick = 0;
+    for (size_t off = 0; off < buf.size();) {
+        if (off + sizeof(TickLogHeader) > buf.size()) {
+            throw corrupt("truncated tick_log");
+        }
+        const auto log_sz = TickLog{buf.data() + off, m_signals}.size();
+        if (off + log_sz > buf.size()) {
+            throw corrupt("truncated tick_log");
+        }
+        auto *hdr = (TickLogHeader *)(buf.data() + off);
+        tick      = log_offsets.empty() ? hdr->tick : tick + hdr->tick;
+        hdr->tick = tick;
+        log_offsets.push_back(off);
+        off += log_sz;
+    }
+    if (log_offsets.size() != (size_t)entry.num_ticks + 1) {
+        throw corrupt("tick_log count mismatch");
+    }
+    return blk;
+}
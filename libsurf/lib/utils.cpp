@@ -3,6 +3,7 @@
 #include <cstdio>
 
 #if defined(SURF_LINUX) || defined(SURF_APPLE)
+#include <sys/mman.h>
 #include <unistd.h>
 #endif
 #ifdef SURF_APPLE
@@ -24,6 +25,16 @@ void posix_check(int retval, const std::string &msg) {
     }
 }
 
+void write_all(int fd, const void *buf, size_t sz, const std::string &msg) {
+    const auto *p = (const uint8_t *)buf;
+    while (sz) {
+        const auto res = write(fd, p, sz);
+        posix_check(res < 0 ? -1 : 0, msg);
+        p += res;
+        sz -= (size_t)res;
+    }
+}
+
 uint32_t get_num_cores() {
 #if defined(SURF_APPLE)
     uint32_t num;
@@ -45,4 +56,19 @@ bool can_use_term_colors() {
 #endif
 }
 
+void advise_huge_pages(void *buf, size_t sz) {
+#ifdef MADV_HUGEPAGE
+    SCA huge_page_sz = size_t{2} * 1024 * 1024;
+    const auto begin = ((uintptr_t)buf + huge_page_sz - 1) & ~(huge_page_sz - 1);
+    const auto end   = ((uintptr_t)buf + sz) & ~(huge_page_sz - 1);
+    if (end > begin) {
+        // only a hint, without THP it's rejected or ignored
+        (void)madvise((void *)begin, end - begin, MADV_HUGEPAGE);
+    }
+#else
+    (void)buf;
+    (void)sz;
+#endif
+}
+
 }; // namespace surf
@@ -36,10 +36,23 @@ namespace surf {
 
 void posix_check(int retval, const std::string &msg);
 
+// write(2) until all of buf is written, posix_check'ing each call with msg
+void write_all(int fd, const void *buf, size_t sz, const std::string &msg);
+
 unsigned int get_num_cores();
 
 bool can_use_term_colors();
 
+// Asks for transparent huge pages behind the 2 MB aligned part of buf. Worth it for large tables
+// probed at random, buf should not have been touched yet, e.g. just reserve()d.
+void advise_huge_pages(void *buf, size_t sz);
+
+// append the raw bytes of num trivially copyable objs
+template <typename T> void append_pod(std::vector<uint8_t> &out, const T *objs, size_t num) {
+    const auto *buf = (const uint8_t *)objs;
+    out.insert(out.end(), buf, buf + num * sizeof(T));
+}
+
 // for visit(overload(...case lambdas...), variant_var)
 template <typename... T> class overload : T... {
 public:
@@ -3,42 +3,503 @@
 #include "common-internal.h"
 #include "utils.h"
 
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SURF_VARBIT_AVX2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SURF_VARBIT_SSE2
+#elif defined(SURF_A64_NEON)
 #include <arm_neon.h>
+#define SURF_VARBIT_NEON
+#endif
+
+namespace surf {
+
+namespace {
+
+SCA ascii_zeros = UINT64_C(0x3030303030303030);
+// hex digit of a nibble: '0' + nibble, plus this for a-f
+SCA hex_letter_off = 'a' - '0' - 10;
+SCA hex_digits     = "0123456789abcdef"sv;
+
+// 8 digits of byte, most significant bit first. Multiplying by the magic puts bit 7 - k of byte at
+// the top of byte k of the product without any overlap or carries.
+SURF_INLINE void bin_byte(uint8_t byte, char *out) {
+    const auto digits = ((((uint64_t)byte * UINT64_C(0x8040201008040201)) &
+                          UINT64_C(0x8080808080808080)) >>
+                         7) +
+                        ascii_zeros;
+    memcpy(out, &digits, sizeof(digits));
+}
+
+SURF_INLINE void hex_byte(uint8_t byte, char *out) {
+    out[0] = hex_digits[byte >> 4];
+    out[1] = hex_digits[byte & 0xf];
+}
+
+#if defined(SURF_VARBIT_AVX2)
+// 32 digits of the 4 bytes at p, p[3] first
+SURF_INLINE void bin_bytes4(const uint8_t *p, char *out) {
+    uint32_t word;
+    memcpy(&word, p, sizeof(word));
+    // spread byte 3 over digits 0-7, byte 2 over 8-15 and so on, pshufb works on 128 bit lanes
+    const __m256i spread =
+        _mm256_setr_epi8(3, 3, 3, 3, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 0,
+                         0, 0, 0, 0, 0, 0, 0);
+    const __m256i bytes  = _mm256_shuffle_epi8(_mm256_set1_epi32((int)word), spread);
+    const __m256i bit    = _mm256_set1_epi64x((int64_t)UINT64_C(0x0102040810204080));
+    const __m256i is_set = _mm256_cmpeq_epi8(_mm256_and_si256(bytes, bit), bit);
+    // '0' - -1 is '1'
+    const __m256i digits = _mm256_sub_epi8(_mm256_set1_epi8('0'), is_set);
+    _mm256_storeu_si256((__m256i *)out, digits);
+}
+#elif defined(SURF_VARBIT_SSE2)
+// 16 digits of the 2 bytes at p, p[1] first
+SURF_INLINE void bin_bytes2(const uint8_t *p, char *out) {
+    __m128i bytes = _mm_cvtsi32_si128(p[1] | (p[0] << 8));
+    bytes         = _mm_unpacklo_epi8(bytes, bytes);
+    bytes         = _mm_unpacklo_epi16(bytes, bytes);
+    bytes         = _mm_unpacklo_epi32(bytes, bytes);
+    const __m128i bit    = _mm_set1_epi64x((int64_t)UINT64_C(0x0102040810204080));
+    const __m128i is_set = _mm_cmpeq_epi8(_mm_and_si128(bytes, bit), bit);
+    _mm_storeu_si128((__m128i *)out, _mm_sub_epi8(_mm_set1_epi8('0'), is_set));
+}
+#elif defined(SURF_VARBIT_NEON)
+// 16 digits of the 2 bytes at p, p[1] first
+SURF_INLINE void bin_bytes2(const uint8_t *p, char *out) {
+    const uint8x16_t bytes  = vcombine_u8(vdup_n_u8(p[1]), vdup_n_u8(p[0]));
+    const uint8x16_t bit    = {0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+                               0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01};
+    const uint8x16_t is_set = vtstq_u8(bytes, bit);
+    vst1q_u8((uint8_t *)out, vsubq_u8(vdupq_n_u8('0'), is_set));
+}
+#endif
+
+#if defined(SURF_VARBIT_AVX2) || defined(SURF_VARBIT_SSE2) || defined(SURF_VARBIT_NEON)
+// 16 hex digits of the 8 bytes at p, p[7] first
+SURF_INLINE void hex_bytes8(const uint8_t *p, char *out) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    word = __builtin_bswap64(word);
+#if defined(SURF_VARBIT_NEON)
+    const uint8x8_t bytes = vcreate_u8(word);
+    const uint8x8x2_t nibbles =
+        vzip_u8(vshr_n_u8(bytes, 4), vand_u8(bytes, vdup_n_u8(0xf)));
+    const uint8x16_t table = vld1q_u8((const uint8_t *)hex_digits.data());
+    vst1q_u8((uint8_t *)out,
+             vqtbl1q_u8(table, vcombine_u8(nibbles.val[0], nibbles.val[1])));
+#else
+    const __m128i bytes   = _mm_cvtsi64_si128((int64_t)word);
+    const __m128i lo_mask = _mm_set1_epi8(0xf);
+    const __m128i nibbles = _mm_unpacklo_epi8(
+        _mm_and_si128(_mm_srli_epi16(bytes, 4), lo_mask), _mm_and_si128(bytes, lo_mask));
+#if defined(SURF_VARBIT_AVX2)
+    const __m128i table = _mm_loadu_si128((const __m128i *)hex_digits.data());
+    _mm_storeu_si128((__m128i *)out, _mm_shuffle_epi8(table, nibbles));
+#else
+    const __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)),
+                                         _mm_set1_epi8(hex_letter_off));
+    _mm_storeu_si128((__m128i *)out,
+                     _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letter));
+#endif
+#endif
+}
+#endif
+
+// up to 8 bytes, the missing high ones zero
+SURF_INLINE uint64_t load_bytes(const uint8_t *p, size_t n) {
+    uint64_t word = 0;
+    memcpy(&word, p, std::min<size_t>(n, sizeof(word)));
+    return word;
+}
+
+SURF_INLINE void store_bytes(uint8_t *p, uint64_t word, size_t n) {
+    memcpy(p, &word, std::min<size_t>(n, sizeof(word)));
+}
+
+// mask for the used bits of the last byte of a bitsz wide value
+SURF_INLINE uint8_t last_byte_mask(varbit::sz_t bitsz) {
+    const auto partial_bits = bitsz % CHAR_BIT;
+    return partial_bits ? (uint8_t)pow2_mask((uint8_t)partial_bits) : UINT8_MAX;
+}
+
+// reverses the bits of every byte of word
+SURF_INLINE constexpr uint64_t swar_rev_bits(uint64_t word) {
+    word = ((word >> 1) & UINT64_C(0x5555555555555555)) |
+           ((word & UINT64_C(0x5555555555555555)) << 1);
+    word = ((word >> 2) & UINT64_C(0x3333333333333333)) |
+           ((word & UINT64_C(0x3333333333333333)) << 2);
+    return ((word >> 4) & UINT64_C(0x0f0f0f0f0f0f0f0f)) |
+           ((word & UINT64_C(0x0f0f0f0f0f0f0f0f)) << 4);
+}
+
+#if defined(SURF_VARBIT_AVX2)
+// per 64 bit lane popcounts of v, nibble lookup then a horizontal byte sum
+SURF_INLINE __m256i popcount256(__m256i v) {
+    const __m256i lut     = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1,
+                                             1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lo_mask = _mm256_set1_epi8(0xf);
+    const __m256i lo      = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, lo_mask));
+    const __m256i hi =
+        _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), lo_mask));
+    return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+SURF_INLINE uint64_t hsum256(__m256i v) {
+    return (uint64_t)_mm256_extract_epi64(v, 0) + (uint64_t)_mm256_extract_epi64(v, 1) +
+           (uint64_t)_mm256_extract_epi64(v, 2) + (uint64_t)_mm256_extract_epi64(v, 3);
+}
+#endif
+
+// the kernels below work on whole bytes, callers handle the partial last one
+
+bool bytes_equal(const uint8_t *a, const uint8_t *b, size_t n) {
+    size_t i = 0;
+#if defined(SURF_VARBIT_AVX2)
+    for (; i + 32 <= n; i += 32) {
+        const __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+        const __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        if ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)) != UINT32_MAX) {
+            return false;
+        }
+    }
+#elif defined(SURF_VARBIT_SSE2)
+    for (; i + 16 <= n; i += 16) {
+        const __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        const __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) != UINT16_MAX) {
+            return false;
+        }
+    }
+#elif defined(SURF_VARBIT_NEON)
+    for (; i + 16 <= n; i += 16) {
+        if (vmaxvq_u8(veorq_u8(vld1q_u8(a + i), vld1q_u8(b + i)))) {
+            return false;
+        }
+    }
+#endif
+    for (; i < n; i += sizeof(uint64_t)) {
+        if (load_bytes(a + i, n - i) != load_bytes(b + i, n - i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// popcount of a, or of a ^ b if b isn't null
+uint64_t popcount_bytes(const uint8_t *a, const uint8_t *b, size_t n) {
+    uint64_t num = 0;
+    size_t i     = 0;
+#if defined(SURF_VARBIT_AVX2)
+    __m256i sums = _mm256_setzero_si256();
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(a + i));
+        if (b) {
+            v = _mm256_xor_si256(v, _mm256_loadu_si256((const __m256i *)(b + i)));
+        }
+        sums = _mm256_add_epi64(sums, popcount256(v));
+    }
+    num += hsum256(sums);
+#elif defined(SURF_VARBIT_NEON)
+    uint16x8_t sums = vdupq_n_u16(0);
+    // at most 16 per u16 lane per iteration, sum before the lanes could overflow
+    for (size_t num_iter = 0; i + 16 <= n; i += 16) {
+        uint8x16_t v = vld1q_u8(a + i);
+        if (b) {
+            v = veorq_u8(v, vld1q_u8(b + i));
+        }
+        sums = vpadalq_u8(sums, vcntq_u8(v));
+        if (++num_iter == 4096) {
+            num += vaddlvq_u16(sums);
+            sums     = vdupq_n_u16(0);
+            num_iter = 0;
+        }
+    }
+    num += vaddlvq_u16(sums);
+#endif
+    for (; i < n; i += sizeof(uint64_t)) {
+        auto word = load_bytes(a + i, n - i);
+        if (b) {
+            word ^= load_bytes(b + i, n - i);
+        }
+        num += (uint64_t)std::popcount(word);
+    }
+    return num;
+}
+
+void xor_bytes(const uint8_t *a, const uint8_t *b, uint8_t *out, size_t n) {
+    size_t i = 0;
+#if defined(SURF_VARBIT_AVX2)
+    for (; i + 32 <= n; i += 32) {
+        _mm256_storeu_si256((__m256i *)(out + i),
+                            _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                             _mm256_loadu_si256((const __m256i *)(b + i))));
+    }
+#elif defined(SURF_VARBIT_SSE2)
+    for (; i + 16 <= n; i += 16) {
+        _mm_storeu_si128((__m128i *)(out + i),
+                         _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i)),
+                                       _mm_loadu_si128((const __m128i *)(b + i))));
+    }
+#elif defined(SURF_VARBIT_NEON)
+    for (; i + 16 <= n; i += 16) {
+        vst1q_u8(out + i, veorq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+    }
+#endif
+    for (; i < n; i += sizeof(uint64_t)) {
+        store_bytes(out + i, load_bytes(a + i, n - i) ^ load_bytes(b + i, n - i), n - i);
+    }
+}
+
+// out = the src_n bytes at src shifted down by bit_off bits, out_n bytes of it. Reads every source
+// byte before the store that could overwrite it, so out may be src.
+void shift_down(const uint8_t *src, size_t src_n, size_t bit_off, uint8_t *out, size_t out_n) {
+    const auto byte_off = bit_off / CHAR_BIT;
+    const auto shift    = bit_off % CHAR_BIT;
+    for (size_t i = 0; i < out_n; i += sizeof(uint64_t)) {
+        const auto off = byte_off + i;
+        auto word      = off < src_n ? load_bytes(src + off, src_n - off) : 0;
+        if (shift) {
+            const auto next = off + sizeof(uint64_t);
+            word >>= shift;
+            if (next < src_n) {
+                word |= (uint64_t)src[next] << (sizeofbits<uint64_t>() - shift);
+            }
+        }
+        store_bytes(out + i, word, out_n - i);
+    }
+}
+
+// out[i] = the bits of src[n - 1 - i] reversed
+void rev_bytes(const uint8_t *src, uint8_t *out, size_t n) {
+    size_t i = 0;
+#if defined(SURF_VARBIT_AVX2)
+    const __m256i rev_idx = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                             15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    const __m256i rev_lut = _mm256_setr_epi8(0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe, 0x1, 0x9, 0x5,
+                                             0xd, 0x3, 0xb, 0x7, 0xf, 0x0, 0x8, 0x4, 0xc, 0x2, 0xa,
+                                             0x6, 0xe, 0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf);
+    const __m256i lo_mask = _mm256_set1_epi8(0xf);
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + n - 32 - i));
+        // reverse the bytes within each 128 bit lane, then swap the lanes
+        v = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, rev_idx), 0x4e);
+        const __m256i lo = _mm256_shuffle_epi8(rev_lut, _mm256_and_si256(v, lo_mask));
+        const __m256i hi =
+            _mm256_shuffle_epi8(rev_lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), lo_mask));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_or_si256(_mm256_slli_epi16(lo, 4), hi));
+    }
+#elif defined(SURF_VARBIT_NEON)
+    for (; i + 16 <= n; i += 16) {
+        const uint8x16_t v = vrev64q_u8(vrbitq_u8(vld1q_u8(src + n - 16 - i)));
+        vst1q_u8(out + i, vextq_u8(v, v, 8));
+    }
+#endif
+    for (; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t)) {
+        const auto word = load_bytes(src + n - sizeof(uint64_t) - i, sizeof(uint64_t));
+        store_bytes(out + i, __builtin_bswap64(swar_rev_bits(word)), sizeof(uint64_t));
+    }
+    for (; i < n; ++i) {
+        out[i] = (uint8_t)swar_rev_bits(src[n - 1 - i]);
+    }
+}
+
+void check_same_width(bitview a, bitview b, const char *op) {
+    if (a.bitsize() != b.bitsize()) {
+        throw std::range_error(fmt::format("{:s}: {:d} and {:d} bit operands", op, a.bitsize(),
+                                           b.bitsize()));
+    }
+}
+
+}; // namespace
 
 std::string bitview2string(bitview bv) {
-    std::string bitstring;
-    const auto data        = bv.data();
-    const auto bitsize     = bv.bitsize();
-    const ssize_t bytesize = (ssize_t)bv.bytesize();
-    if (bitsize == 0) {
-        return "";
-    }
-    if (bitsize == 1) {
-        return (*bv.data() & 1) ? "1" : "0";
-    }
-    bitstring.reserve(bytesize * 8);
-    const uint64x2_t magic       = {0x8040201008040201ull, 0x8040201008040201ull};
-    const uint64x2_t mask        = {0x8080808080808080ull, 0x8080808080808080ull};
-    const uint64x2_t ascii_zeros = {0x3030303030303030ull, 0x3030303030303030ull};
-    ssize_t i                    = 0;
-#pragma clang loop unroll_count(4)
-    for (; i <= bytesize - (ssize_t)sizeof(uint16_t); i += sizeof(uint16_t)) {
-        // MCA_BEGIN("bitview2string_inner_loop");
-        const uint64x2_t words               = {*(uint8_t *)(data + i), *(uint8_t *)(data + i + 1)};
-        const uint64x2_t ones_or_zeros       = ((magic * words) & mask) >> 7;
-        const uint64x2_t ones_or_zeros_ascii = ones_or_zeros + ascii_zeros;
-        const auto ts =
-            std::string_view{(const char *)&ones_or_zeros_ascii, sizeof(ones_or_zeros_ascii)};
-        bitstring += ts;
-        // MCA_END("bitview2string_inner_loop");
-    }
-    for (; i < bytesize; ++i) {
-        uint8_t byte = data[i];
-        for (int8_t j = 7; j >= 0; --j) {
-            const auto bit = (byte >> j) & 1;
-            bitstring.push_back(bit ? '1' : '0');
-        }
-    }
-    bitstring.erase(bitstring.begin(), bitstring.begin() + (bytesize * CHAR_BIT - bitsize));
+    const auto data     = bv.data();
+    const auto bitsize  = bv.bitsize();
+    const auto bytesize = bv.bytesize();
+    std::string bitstring(bytesize * CHAR_BIT, '0');
+    auto out = bitstring.data();
+    // most significant byte first
+    size_t i = bytesize;
+#if defined(SURF_VARBIT_AVX2)
+    for (; i >= 4; i -= 4, out += 4 * CHAR_BIT) {
+        bin_bytes4(data + i - 4, out);
+    }
+#elif defined(SURF_VARBIT_SSE2) || defined(SURF_VARBIT_NEON)
+    for (; i >= 2; i -= 2, out += 2 * CHAR_BIT) {
+        bin_bytes2(data + i - 2, out);
+    }
+#endif
+    for (; i > 0; --i, out += CHAR_BIT) {
+        bin_byte(data[i - 1], out);
+    }
+    bitstring.erase(0, bytesize * CHAR_BIT - bitsize);
     return bitstring;
 }
+
+std::string bitview2hex(bitview bv) {
+    const auto data     = bv.data();
+    const auto bitsize  = bv.bitsize();
+    const auto bytesize = bv.bytesize();
+    std::string hexstring(bytesize * 2, '0');
+    auto out = hexstring.data();
+    size_t i = bytesize;
+#if defined(SURF_VARBIT_AVX2) || defined(SURF_VARBIT_SSE2) || defined(SURF_VARBIT_NEON)
+    for (; i >= 8; i -= 8, out += 16) {
+        hex_bytes8(data + i - 8, out);
+    }
+#endif
+    for (; i > 0; --i, out += 2) {
+        hex_byte(data[i - 1], out);
+    }
+    const auto num_digits = (bitsize + 3u) / 4;
+    hexstring.erase(0, bytesize * 2 - num_digits);
+    // the leading digit may hold bits past bitsize
+    if (const auto partial_bits = bitsize % 4) {
+        const auto top = num_digits - 1;
+        const auto nibble =
+            (data[top / 2] >> (top % 2 * 4)) & pow2_mask((uint8_t)partial_bits);
+        hexstring[0] = hex_digits[nibble];
+    }
+    return hexstring;
+}
+
+bool bitview_equal(bitview a, bitview b) {
+    if (a.bitsize() != b.bitsize()) {
+        return false;
+    }
+    const auto n = a.bytesize();
+    return bytes_equal(a.data(), b.data(), n - 1u) &&
+           !((a.data()[n - 1] ^ b.data()[n - 1]) & last_byte_mask(a.bitsize()));
+}
+
+uint32_t bitview_popcount(bitview bv) {
+    const auto n = bv.bytesize();
+    return (uint32_t)popcount_bytes(bv.data(), nullptr, n - 1u) +
+           (uint32_t)std::popcount((uint8_t)(bv.data()[n - 1] & last_byte_mask(bv.bitsize())));
+}
+
+uint32_t bitview_hamming(bitview a, bitview b) {
+    check_same_width(a, b, "bitview_hamming");
+    const auto n    = a.bytesize();
+    const auto last = (uint8_t)((a.data()[n - 1] ^ b.data()[n - 1]) & last_byte_mask(a.bitsize()));
+    return (uint32_t)popcount_bytes(a.data(), b.data(), n - 1u) + (uint32_t)std::popcount(last);
+}
+
+void bitview_xor(bitview a, bitview b, uint8_t *out) {
+    check_same_width(a, b, "bitview_xor");
+    const auto n = a.bytesize();
+    xor_bytes(a.data(), b.data(), out, n);
+    out[n - 1] &= last_byte_mask(a.bitsize());
+}
+
+void bitview_slice(bitview bv, varbit::sz_t lsb, varbit::sz_t bitsz, uint8_t *out) {
+    if (!bitsz || (size_t)lsb + bitsz > bv.bitsize()) {
+        throw std::range_error(fmt::format("bitview_slice: [{:d}:{:d}] of a {:d} bit value",
+                                           (size_t)lsb + bitsz - 1, lsb, bv.bitsize()));
+    }
+    const auto out_n = varbit::bytesize4bitsize(bitsz);
+    shift_down(bv.data(), bv.bytesize(), lsb, out, out_n);
+    out[out_n - 1] &= last_byte_mask(bitsz);
+}
+
+void bitview_concat(bitview hi, bitview lo, uint8_t *out) {
+    const size_t bitsz = (size_t)hi.bitsize() + lo.bitsize();
+    if (bitsz > std::numeric_limits<varbit::sz_t>::max()) {
+        throw std::range_error(fmt::format("bitview_concat: {:d} bits overflow a VarBit", bitsz));
+    }
+    const auto out_n = varbit::bytesize4bitsize((varbit::sz_t)bitsz);
+    const auto lo_n  = lo.bytesize();
+    std::copy_n(lo.data(), lo_n, out);
+    out[lo_n - 1] &= last_byte_mask(lo.bitsize());
+    std::fill(out + lo_n, out + out_n, 0);
+    // or in hi a word at a time, shifted up to the first bit after lo, its bits past its bitsize
+    // land past bitsz and are masked off below
+    const auto byte_off = lo.bitsize() / CHAR_BIT;
+    const auto shift    = lo.bitsize() % CHAR_BIT;
+    const auto hi_n     = hi.bytesize();
+    uint64_t carry      = 0;
+    size_t i            = 0;
+    for (; i < hi_n; i += sizeof(uint64_t)) {
+        const auto word = load_bytes(hi.data() + i, hi_n - i);
+        const auto off  = byte_off + i;
+        store_bytes(out + off, load_bytes(out + off, out_n - off) | (word << shift) | carry,
+                    out_n - off);
+        carry = shift ? word >> (sizeofbits<uint64_t>() - shift) : 0;
+    }
+    if (const auto off = byte_off + i; carry && off < out_n) {
+        store_bytes(out + off, load_bytes(out + off, out_n - off) | carry, out_n - off);
+    }
+    out[out_n - 1] &= last_byte_mask((varbit::sz_t)bitsz);
+}
+
+void bitview_reverse(bitview bv, uint8_t *out) {
+    const auto n = bv.bytesize();
+    rev_bytes(bv.data(), out, n);
+    // the padding bits of the last byte are now at the bottom
+    shift_down(out, n, n * CHAR_BIT - bv.bitsize(), out, n);
+    out[n - 1] &= last_byte_mask(bv.bitsize());
+}
+
+VarBit bitview_xor(bitview a, bitview b) {
+    auto res = VarBit::zeroed(a.bitsize());
+    bitview_xor(a, b, res.data());
+    return res;
+}
+
+VarBit bitview_slice(bitview bv, varbit::sz_t lsb, varbit::sz_t bitsz) {
+    if (!bitsz) {
+        throw std::range_error("bitview_slice: empty slice");
+    }
+    auto res = VarBit::zeroed(bitsz);
+    bitview_slice(bv, lsb, bitsz, res.data());
+    return res;
+}
+
+VarBit bitview_concat(bitview hi, bitview lo) {
+    const size_t bitsz = (size_t)hi.bitsize() + lo.bitsize();
+    if (bitsz > std::numeric_limits<varbit::sz_t>::max()) {
+        throw std::range_error(fmt::format("bitview_concat: {:d} bits overflow a VarBit", bitsz));
+    }
+    auto res = VarBit::zeroed((varbit::sz_t)bitsz);
+    bitview_concat(hi, lo, res.data());
+    return res;
+}
+
+VarBit bitview_reverse(bitview bv) {
+    auto res = VarBit::zeroed(bv.bitsize());
+    bitview_reverse(bv, res.data());
+    return res;
+}
+
+uint32_t VarBitArena::alloc(varbit::sz_t bytesz) {
+    const auto off          = m_buf.size();
+    const auto num_granules = (bytesz + granule_sz - 1) / granule_sz;
+    if (off + num_granules > std::numeric_limits<uint32_t>::max()) {
+        throw std::range_error(fmt::format("VarBitArena: {:d} bytes overflow a 32 bit offset",
+                                           (off + num_granules) * granule_sz));
+    }
+    // geometric growth, resize alone only guarantees amortized growth for push_back
+    if (off + num_granules > m_buf.capacity()) {
+        m_buf.reserve(std::max(m_buf.capacity() * 2, off + num_granules));
+    }
+    m_buf.resize(off + num_granules);
+    return (uint32_t)off;
+}
+
+void VarBitArena::reserve(size_t bytesz) {
+    m_buf.reserve((bytesz + granule_sz - 1) / granule_sz);
+}
+
+size_t VarBitArena::size() const {
+    return m_buf.size() * granule_sz;
+}
+
+void VarBitArena::clear() {
+    m_buf.clear();
+}
+
+}; // namespace surf
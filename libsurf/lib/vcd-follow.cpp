@@ -0,0 +1,138 @@
+#include <surf/vcd-follow.h>
+
+#include "common-internal.h"
+#include "utils.h"
+
+#include <cerrno>
+#include <poll.h>
+#include <thread>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
+
+using namespace VCDTypes;
+
+namespace {
+
+int open_checked(const fs::path &path) {
+    const auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    posix_check(fd, fmt::format("VCDFollower open '{}'", path));
+    return fd;
+}
+
+}; // namespace
+
+VCDFollower::VCDFollower(const fs::path &path)
+    : m_path{path}, m_fd{open_checked(path)}, m_stream{m_fd, path.string()} {
+    // the destructor doesn't run for a constructor that throws
+    try {
+#if defined(__linux__)
+        m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        posix_check(m_inotify_fd, "VCDFollower inotify_init1");
+        posix_check(inotify_add_watch(m_inotify_fd, path.c_str(), IN_MODIFY | IN_CLOSE_WRITE),
+                    "VCDFollower inotify_add_watch");
+#endif
+        update();
+    } catch (...) {
+        close_fds();
+        throw;
+    }
+}
+
+VCDFollower::~VCDFollower() {
+    close_fds();
+}
+
+void VCDFollower::close_fds() {
+    if (m_inotify_fd >= 0) {
+        close(m_inotify_fd);
+    }
+    close(m_fd);
+}
+
+bool VCDFollower::update() {
+    const auto bytes_before = m_stream.bytes_read();
+    if (!m_decls) {
+        m_decls = m_stream.try_declarations();
+        if (!m_decls) {
+            return false;
+        }
+        m_columns = SignalColumns::from_declarations(*m_decls);
+    }
+    const auto sink = [this](std::span<const SimCmd> cmds, std::span<const VarBitArena> arenas) {
+        m_columns->append_sim_cmds(cmds, arenas);
+    };
+    // the stream reads a chunk per poll, keep going until it is caught up with the writer
+    while (m_stream.poll(sink)) {
+    }
+    return m_stream.bytes_read() != bytes_before;
+}
+
+bool VCDFollower::follow(std::chrono::milliseconds timeout) {
+    return wait(timeout) && update();
+}
+
+void VCDFollower::finish() {
+    update();
+    if (m_decls) {
+        m_stream.finish([this](std::span<const SimCmd> cmds, std::span<const VarBitArena> arenas) {
+            m_columns->append_sim_cmds(cmds, arenas);
+        });
+    }
+}
+
+bool VCDFollower::wait(std::chrono::milliseconds timeout) {
+#if defined(__linux__)
+    pollfd pfd{.fd = m_inotify_fd, .events = POLLIN, .revents = 0};
+    int poll_res;
+    do {
+        poll_res = poll(&pfd, 1, (int)timeout.count());
+    } while (poll_res < 0 && errno == EINTR);
+    posix_check(poll_res, "VCDFollower poll");
+    if (!poll_res) {
+        return false;
+    }
+    // the events only say that something was written, drain them all
+    alignas(inotify_event) char events[4096];
+    while (read(m_inotify_fd, events, sizeof(events)) > 0) {
+    }
+    return true;
+#else
+    std::this_thread::sleep_for(std::min(timeout, poll_interval));
+    return true;
+#endif
+}
+
+bool VCDFollower::has_declarations() const {
+    return m_decls != nullptr;
+}
+
+const Declarations &VCDFollower::declarations() const {
+    if (!m_decls) {
+        throw std::logic_error(
+            fmt::format("VCDFollower: '{}' has no complete definitions yet", m_path));
+    }
+    return *m_decls;
+}
+
+const SignalColumns &VCDFollower::columns() const {
+    (void)declarations();
+    return *m_columns;
+}
+
+int VCDFollower::timebase_power() const {
+    return timebase_power_from_timescale(declarations().timescale);
+}
+
+Time VCDFollower::start() const {
+    return Time{columns().start(), timebase_power()};
+}
+
+Time VCDFollower::end() const {
+    return Time{columns().end(), timebase_power()};
+}
+
+const fs::path &VCDFollower::path() const {
+    return m_path;
+}
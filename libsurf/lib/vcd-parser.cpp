@@ -47,15 +47,34 @@ SCA all_chars    = dsl::ascii::character;
 SCA non_ws_chars = dsl::ascii::character - dsl::ascii::space;
 SCA val_chars    = LEXY_ASCII_ONE_OF("01xXzZ");
 SCA end_term     = dsl::terminator(dsl::token(ws + LEXY_LIT("$end")));
-SCA all_cap      = dsl::capture(all_chars);
 
 SCA cap_tok(auto rule) {
     return dsl::capture(dsl::token(rule));
 }
 
+// The text up to an end_term as a single lexeme instead of a capture per character. The lexeme
+// includes the terminator, text_before_end_term strips it. The text may be empty, "$comment $end",
+// as the scanner allows.
+SCA text_and_end = dsl::no_whitespace(cap_tok(end_term.opt_list(all_chars)));
+
+std::string_view text_before_end_term(str_lex lexeme) {
+    auto text = to_sv(lexeme);
+    text.remove_suffix("$end"sv.size());
+    // same set as dsl::ascii::space
+    const auto is_ws = [](char c) {
+        return c == ' ' || (uint8_t)(c - '\t') <= '\r' - '\t';
+    };
+    while (!text.empty() && is_ws(text.back())) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
 struct comment {
-    SCA rule  = LEXY_LIT("$comment") + dsl::no_whitespace(end_term.list(all_cap));
-    SCA value = lexy::as_string<std::string> >> lexy::construct<Comment>;
+    SCA rule  = LEXY_LIT("$comment") + text_and_end;
+    SCA value = lexy::callback<Comment>([](str_lex lexeme) {
+        return Comment{.comment = text_before_end_term(lexeme)};
+    });
 };
 
 struct tick {
@@ -68,6 +87,14 @@ struct id {
     SCA value = lexy::as_string<std::string>;
 };
 
+// same as id but interned through the IDCodeTable parse state instead of copied out
+struct idcode {
+    SCA rule  = dsl::identifier(non_ws_chars);
+    SCA value = lexy::callback<std::string_view>([](str_lex lexeme) {
+        return to_sv(lexeme);
+    });
+};
+
 struct scalar_value {
     SCA rule  = cap_tok(val_chars);
     SCA value = lexy::callback<ScalarValue>([](auto lexeme) {
@@ -80,8 +107,10 @@ struct scalar_value {
 };
 
 struct binary_number {
-    SCA rule  = LEXY_ASCII_ONE_OF("bB") + dsl::integer<decltype(BinaryNum{}.num), dsl::binary>;
-    SCA value = lexy::construct<BinaryNum>;
+    SCA rule  = LEXY_ASCII_ONE_OF("bB") + cap_tok(dsl::while_one(val_chars));
+    SCA value = lexy::callback<BinaryNum>([](str_lex lexeme) {
+        return BinaryNum::from_digits(to_sv(lexeme));
+    });
 };
 
 struct real_number {
@@ -124,7 +153,7 @@ struct any_value {
                (dsl::else_ >> dsl::error<val_error>);
     SCA value = lexy::callback<Value>(
         [](BinaryNum bnum) {
-            return Value{bnum};
+            return Value{std::move(bnum)};
         },
         [](RealNum rnum) {
             return Value{rnum};
@@ -135,10 +164,16 @@ struct any_value {
 };
 
 struct value_change {
-    SCA rule  = dsl::p<any_value> + dsl::p<id>;
-    SCA value = lexy::callback<Change>([](Value value, std::string &&id) {
-        return Change{.value = value, .id = std::move(id)};
-    });
+    SCA rule  = dsl::p<any_value> + dsl::p<idcode>;
+    SCA value = lexy::bind(
+        lexy::callback<Change>([](const IDCodeTable &idcodes, Value value, std::string_view id) {
+            const auto sig = idcodes.lookup(id);
+            if (sig == IDCodeTable::invalid_sig) {
+                throw std::domain_error(fmt::format("Undeclared VCD id code: '{:s}'", id));
+            }
+            return Change{.value = value, .sig = sig};
+        }),
+        lexy::parse_state, lexy::values);
 };
 
 struct sim_cmd {
@@ -158,13 +193,17 @@ struct sim_cmd {
 };
 
 struct date {
-    SCA rule  = LEXY_LIT("$date") + dsl::no_whitespace(end_term.list(dsl::capture(all_chars)));
-    SCA value = lexy::as_string<std::string> >> lexy::construct<Date>;
+    SCA rule  = LEXY_LIT("$date") + text_and_end;
+    SCA value = lexy::callback<Date>([](str_lex lexeme) {
+        return Date{.date = text_before_end_term(lexeme)};
+    });
 };
 
 struct version {
-    SCA rule  = LEXY_LIT("$version") + dsl::no_whitespace(end_term.list(dsl::capture(all_chars)));
-    SCA value = lexy::as_string<std::string> >> lexy::construct<Version>;
+    SCA rule  = LEXY_LIT("$version") + text_and_end;
+    SCA value = lexy::callback<Version>([](str_lex lexeme) {
+        return Version{.version = text_before_end_term(lexeme)};
+    });
 };
 
 struct time_number {
@@ -246,16 +285,18 @@ struct var_type {
 };
 
 struct reference_and_end {
-    SCA rule  = dsl::no_whitespace(end_term.list(all_cap));
-    SCA value = lexy::as_string<std::string>;
+    SCA rule  = text_and_end;
+    SCA value = lexy::callback<std::string_view>([](str_lex lexeme) {
+        return text_before_end_term(lexeme);
+    });
 };
 
 struct var {
-    SCA rule = LEXY_LIT("$var") + dsl::p<var_type> + dsl::integer<int> + dsl::p<id> +
+    SCA rule = LEXY_LIT("$var") + dsl::p<var_type> + dsl::integer<int> + dsl::p<idcode> +
                dsl::p<reference_and_end>;
-    SCA value =
-        lexy::callback<Var>([](VarType var_type, int size, std::string &&id, std::string &&ref) {
-            return Var{.id = std::move(id), .ref = std::move(ref), .size = size, .type = var_type};
+    SCA value = lexy::callback<Var>(
+        [](VarType var_type, int size, std::string_view id, std::string_view ref) {
+            return Var{.id = id, .ref = ref, .size = size, .type = var_type};
         });
 };
 
@@ -332,23 +373,20 @@ struct sim_cmd_eof_list {
     SCA whitespace = ws;
 };
 
-struct vcd_document {
-    SCA rule  = dsl::p<decl_list> + dsl::p<sim_cmd_eof_list>;
-    SCA value = lexy::callback<DocumentRawDecls>(
-        [](std::vector<Declaration> &&decls, std::vector<SimCmd> &&cmds) {
-            return DocumentRawDecls{.declarations = std::move(decls), .sim_cmds = std::move(cmds)};
-        });
-    SCA whitespace = ws;
-};
-
 }; // namespace grammar
 
 }; // namespace
 
 VCDTypes::Declarations decls_from_decl_list(std::vector<VCDTypes::Declaration> &&decl_list) {
     auto my_decl_list = std::move(decl_list);
-    Declarations decls{.root_scope = {.id = "root", .type = ScopeType::root}};
-    std::vector<Scope *> scopes{&decls.root_scope};
+    Declarations decls;
+    size_t num_scopes{}, num_vars{};
+    for (const auto &decl : my_decl_list) {
+        num_scopes += std::holds_alternative<ScopeDecl>(decl);
+        num_vars += std::holds_alternative<Var>(decl);
+    }
+    decls.scopes.reserve(num_scopes, num_vars);
+    std::vector<ScopeTree::index_t> scopes{ScopeTree::root};
     for (auto &decl : my_decl_list) {
         rollbear::visit(
             overload(
@@ -368,12 +406,15 @@ VCDTypes::Declarations decls_from_decl_list(std::vector<VCDTypes::Declaration> &
                     decls.timescale = {timescale};
                 },
                 [&](ScopeDecl &scope) {
-                    scopes.back()->subscopes.emplace_back(
-                        Scope{.id = scope.id, .type = scope.type});
-                    scopes.emplace_back(&scopes.back()->subscopes.back());
+                    scopes.emplace_back(
+                        decls.scopes.add_scope(scopes.back(), scope.id, scope.type));
                 },
                 [&](Var &var) {
-                    scopes.back()->vars.emplace_back(var);
+                    var.sig = decls.idcodes.intern(var.id);
+                    if (var.sig == decls.signals.size()) {
+                        decls.signals.emplace_back(Signal{.size = var.size, .type = var.type});
+                    }
+                    decls.scopes.add_var(scopes.back(), var);
                 },
                 [&](UpScope) {
                     if (scopes.size() <= 1) {
@@ -425,14 +466,16 @@ VCDParserDeclRet parse_vcd_declarations(std::string_view decls_str, fs::path pat
     return VCDParserDeclRet{.decls = std::move(decls_val.decls), .remaining = remaining};
 }
 
-std::vector<SimCmd> parse_vcd_sim_cmds(std::string_view sim_cmds_str, fs::path path,
+std::vector<SimCmd> parse_vcd_sim_cmds(std::string_view sim_cmds_str, const IDCodeTable &idcodes,
+                                       fs::path path,
                                        std::optional<lexy::visualization_options> opts) {
     auto input = lexy::string_input<lexy::ascii_encoding>(sim_cmds_str);
     std::string cmds_err;
-    auto cmds_parse_res =
-        lexy::parse<grammar::sim_cmd_eof_list>(input, lexy_ext::report_error.path(path.c_str())
-                                                          .to(std::back_insert_iterator(cmds_err))
-                                                          .opts(realize_opts(opts)));
+    auto cmds_parse_res = lexy::parse<grammar::sim_cmd_eof_list>(
+        input, idcodes,
+        lexy_ext::report_error.path(path.c_str())
+            .to(std::back_insert_iterator(cmds_err))
+            .opts(realize_opts(opts)));
     if (!cmds_parse_res.is_success() || !cmds_parse_res.has_value()) {
         throw std::logic_error("VCD commands (changes) parsing failed.\n" + cmds_err);
     }
@@ -442,12 +485,12 @@ std::vector<SimCmd> parse_vcd_sim_cmds(std::string_view sim_cmds_str, fs::path p
 Document parse_vcd_document(std::string_view vcd_str, const fs::path &path,
                             std::optional<lexy::visualization_options> opts) {
     auto decls_ret = parse_vcd_declarations(vcd_str, path, opts);
-    return {.declarations = decls_from_decl_list(std::move(decls_ret.decls)),
-            .sim_cmds     = parse_vcd_sim_cmds(decls_ret.remaining, path, opts)};
+    auto decls     = decls_from_decl_list(std::move(decls_ret.decls));
+    auto sim_cmds  = parse_vcd_sim_cmds(decls_ret.remaining, decls.idcodes, path, opts);
+    return {.declarations = std::move(decls), .sim_cmds = std::move(sim_cmds)};
 }
 
 void parse_vcd_document_test(std::string_view vcd_str, const fs::path &path) {
-    auto input = lexy::string_input<lexy::ascii_encoding>(vcd_str);
     // auto validate_res =
     //     lexy::validate<grammar::document>(input, lexy_ext::report_error.path(path.c_str()));
     // fmt::print("is_error: {}\n", validate_res.is_error());
@@ -476,29 +519,12 @@ void parse_vcd_document_test(std::string_view vcd_str, const fs::path &path) {
         fmt::print(stderr, "Error parsing VCD declarations:\n{:s}\n", decl_parse_error.what());
     }
     try {
-        res.sim_cmds = parse_vcd_sim_cmds(decls_ret.remaining, path);
+        res.sim_cmds = parse_vcd_sim_cmds(decls_ret.remaining, res.declarations.idcodes, path);
     } catch (const VCDSimCmdsParseError &cmds_parse_error) {
         fmt::print(stderr, "Error parsing VCD simulation commands:\n{:s}\n",
                    cmds_parse_error.what());
     }
     fmt::print("2-step doc: {}\n", res);
-
-    try {
-        auto doc_res =
-            lexy::parse<grammar::vcd_document>(input, lexy_ext::report_error.path(path.c_str()));
-        fmt::print("1-step doc success: {}\n", doc_res.is_success());
-        if (doc_res.is_success()) {
-            auto doc_val = doc_res.value();
-            res = Document{.declarations = decls_from_decl_list(std::move(doc_val.declarations)),
-                           .sim_cmds     = std::move(doc_val.sim_cmds)};
-        }
-        fmt::print("1-step doc: {}\n", res);
-    } catch (const VCDDeclParseError &decl_parse_error) {
-        fmt::print(stderr, "Error parsing VCD declarations:\n{:s}\n", decl_parse_error.what());
-    } catch (const VCDSimCmdsParseError &cmds_parse_error) {
-        fmt::print(stderr, "Error parsing VCD simulation commands:\n{:s}\n",
-                   cmds_parse_error.what());
-    }
 }
 
 }; // namespace surf
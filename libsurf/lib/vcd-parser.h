@@ -19,9 +19,11 @@ struct VCDParserDeclRet {
 VCDParserDeclRet parse_vcd_declarations(std::string_view decls_str, fs::path = "unknown",
                                         std::optional<lexy::visualization_options> opts = {});
 
+// Value changes carry the signal index that idcodes assigned to their id code. The reference
+// grammar, see parse_vcd_sim_cmds_parallel in vcd-scanner.h for the fast path.
 std::vector<VCDTypes::SimCmd>
-parse_vcd_sim_cmds(std::string_view sim_cmds_str, fs::path = "unknown",
-                   std::optional<lexy::visualization_options> opts = {});
+parse_vcd_sim_cmds(std::string_view sim_cmds_str, const IDCodeTable &idcodes,
+                   fs::path = "unknown", std::optional<lexy::visualization_options> opts = {});
 
 VCDTypes::Document parse_vcd_document(std::string_view vcd_str, fs::path path = "unknown",
                                       std::optional<lexy::visualization_options> opts = {});
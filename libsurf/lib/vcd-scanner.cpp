@@ -0,0 +1,919 @@
+#include "vcd-scanner.h"
+#include "common-internal.h"
+#include "utils.h"
+
+#include <BS_thread_pool.hpp>
+
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SURF_VCD_SCAN_AVX2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SURF_VCD_SCAN_SSE2
+#elif defined(SURF_A64_NEON)
+#include <arm_neon.h>
+#define SURF_VCD_SCAN_NEON
+#endif
+
+using namespace VCDTypes;
+
+namespace surf {
+
+namespace {
+
+// chunks smaller than this aren't worth handing to another thread
+SCA min_parallel_chunk_sz = 1024 * 1024;
+// more chunks than threads so a slow (dense) chunk doesn't stall the whole parse
+SCA chunks_per_thread = 4;
+
+SCA block_sz   = sizeof(uint64_t) * CHAR_BIT;
+SCA comment_kw = "$comment"sv;
+SCA end_kw     = "$end"sv;
+
+SURF_INLINE constexpr bool is_ws(char c) {
+    return c == ' ' || (uint8_t)(c - '\t') <= '\r' - '\t';
+}
+
+SURF_INLINE constexpr bool is_digit(char c) {
+    return (uint8_t)(c - '0') <= 9;
+}
+
+SURF_INLINE constexpr bool is_scalar_val(char c) {
+    return c == '0' || c == '1' || c == 'x' || c == 'X' || c == 'z' || c == 'Z';
+}
+
+#if defined(SURF_VCD_SCAN_NEON)
+SURF_INLINE uint64_t neon_movemask64(uint8x16_t m0, uint8x16_t m1, uint8x16_t m2, uint8x16_t m3) {
+    const uint8x16_t bit_mask = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+                                 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+    uint8x16_t sum0 = vpaddq_u8(vandq_u8(m0, bit_mask), vandq_u8(m1, bit_mask));
+    uint8x16_t sum1 = vpaddq_u8(vandq_u8(m2, bit_mask), vandq_u8(m3, bit_mask));
+    sum0            = vpaddq_u8(sum0, sum1);
+    sum0            = vpaddq_u8(sum0, sum0);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(sum0), 0);
+}
+#endif
+
+// bit i is set if p[i] is ASCII whitespace (same set as lexy::dsl::ascii::space)
+SURF_INLINE uint64_t ws_mask64(const char *p) {
+#if defined(SURF_VCD_SCAN_AVX2)
+    uint64_t res = 0;
+    for (size_t i = 0; i < block_sz; i += sizeof(__m256i)) {
+        const __m256i v     = _mm256_loadu_si256((const __m256i *)(p + i));
+        const __m256i space = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+        // '\t' through '\r' are contiguous: (c - '\t') <= 4 unsigned
+        const __m256i ctl_off = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+        const __m256i ctl     = _mm256_cmpeq_epi8(
+            _mm256_min_epu8(ctl_off, _mm256_set1_epi8('\r' - '\t')), ctl_off);
+        res |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(space, ctl)) << i;
+    }
+    return res;
+#elif defined(SURF_VCD_SCAN_SSE2)
+    uint64_t res = 0;
+    for (size_t i = 0; i < block_sz; i += sizeof(__m128i)) {
+        const __m128i v       = _mm_loadu_si128((const __m128i *)(p + i));
+        const __m128i space   = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+        const __m128i ctl_off = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+        const __m128i ctl =
+            _mm_cmpeq_epi8(_mm_min_epu8(ctl_off, _mm_set1_epi8('\r' - '\t')), ctl_off);
+        res |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_or_si128(space, ctl)) << i;
+    }
+    return res;
+#elif defined(SURF_VCD_SCAN_NEON)
+    uint8x16_t m[4];
+    for (size_t i = 0; i < 4; ++i) {
+        const uint8x16_t v = vld1q_u8((const uint8_t *)p + i * sizeof(uint8x16_t));
+        m[i]               = vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')),
+                                      vcleq_u8(vsubq_u8(v, vdupq_n_u8('\t')), vdupq_n_u8('\r' - '\t')));
+    }
+    return neon_movemask64(m[0], m[1], m[2], m[3]);
+#else
+    uint64_t res = 0;
+    for (size_t i = 0; i < block_sz; ++i) {
+        res |= (uint64_t)is_ws(p[i]) << i;
+    }
+    return res;
+#endif
+}
+
+// bit i is set if p[i] == c
+SURF_INLINE uint64_t eq_mask64(const char *p, char c) {
+#if defined(SURF_VCD_SCAN_AVX2)
+    uint64_t res = 0;
+    for (size_t i = 0; i < block_sz; i += sizeof(__m256i)) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+        res |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)))
+               << i;
+    }
+    return res;
+#elif defined(SURF_VCD_SCAN_SSE2)
+    uint64_t res = 0;
+    for (size_t i = 0; i < block_sz; i += sizeof(__m128i)) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        res |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c))) << i;
+    }
+    return res;
+#elif defined(SURF_VCD_SCAN_NEON)
+    uint8x16_t m[4];
+    for (size_t i = 0; i < 4; ++i) {
+        const uint8x16_t v = vld1q_u8((const uint8_t *)p + i * sizeof(uint8x16_t));
+        m[i]               = vceqq_u8(v, vdupq_n_u8((uint8_t)c));
+    }
+    return neon_movemask64(m[0], m[1], m[2], m[3]);
+#else
+    uint64_t res = 0;
+    for (size_t i = 0; i < block_sz; ++i) {
+        res |= (uint64_t)(p[i] == c) << i;
+    }
+    return res;
+#endif
+}
+
+// Returns a pointer to block_sz readable bytes starting at str[base]. Blocks running off the end
+// are copied into pad_buf and padded with spaces so we never read past the mapping.
+SURF_INLINE const char *load_block(std::string_view str, size_t base, char *pad_buf) {
+    if (SURF_LIKELY(str.size() - base >= block_sz)) {
+        return str.data() + base;
+    }
+    memset(pad_buf, ' ', block_sz);
+    memcpy(pad_buf, str.data() + base, str.size() - base);
+    return pad_buf;
+}
+
+size_t find_byte(std::string_view str, size_t pos, char c) {
+    char pad_buf[block_sz];
+    while (pos < str.size()) {
+        const auto mask = eq_mask64(load_block(str, pos, pad_buf), c);
+        if (mask) {
+            const auto res = pos + (size_t)std::countr_zero(mask);
+            return res < str.size() ? res : std::string_view::npos;
+        }
+        pos += block_sz;
+    }
+    return std::string_view::npos;
+}
+
+// Caches the whitespace bitmask of the 64 byte block around the cursor so that finding the end
+// of a token and the start of the next one usually costs a shift and a ctz.
+class ws_index {
+public:
+    ws_index(std::string_view str) : m_str{str} {}
+
+    // first whitespace at or after pos, size() if none
+    size_t next_ws(size_t pos) {
+        return find(pos, true);
+    }
+    // first non-whitespace at or after pos, size() if none
+    size_t next_non_ws(size_t pos) {
+        return find(pos, false);
+    }
+
+private:
+    size_t find(size_t pos, bool want_ws) {
+        while (pos < m_str.size()) {
+            if (pos < m_base || pos >= m_base + block_sz) {
+                m_base = pos;
+                m_ws   = ws_mask64(load_block(m_str, pos, m_pad_buf));
+            }
+            auto mask = want_ws ? m_ws : ~m_ws;
+            mask &= ~0ull << (pos - m_base);
+            if (mask) {
+                // padding past the end counts as whitespace
+                return std::min(m_base + (size_t)std::countr_zero(mask), m_str.size());
+            }
+            pos = m_base + block_sz;
+        }
+        return m_str.size();
+    }
+
+    std::string_view m_str;
+    size_t m_base = std::numeric_limits<size_t>::max();
+    uint64_t m_ws = 0;
+    char m_pad_buf[block_sz];
+};
+
+[[noreturn]] void scan_error(std::string_view sim_cmds_str, size_t pos, std::string_view msg) {
+    const auto line_end = sim_cmds_str.find('\n', pos);
+    const auto context  = sim_cmds_str.substr(pos, std::min<size_t>(line_end - pos, 32));
+    throw std::logic_error(
+        fmt::format("VCD commands (changes) scanning failed at offset {:d}: {:s} near '{:s}'", pos,
+                    msg, context));
+}
+
+[[noreturn]] void decl_scan_error(std::string_view decls_str, size_t pos, std::string_view msg) {
+    const auto line_end = decls_str.find('\n', pos);
+    const auto context  = decls_str.substr(pos, std::min<size_t>(line_end - pos, 32));
+    throw std::logic_error(
+        fmt::format("VCD declaration (header) scanning failed at offset {:d}: {:s} near '{:s}'",
+                    pos, msg, context));
+}
+
+SCA var_kw            = "$var"sv;
+SCA scope_kw          = "$scope"sv;
+SCA upscope_kw        = "$upscope"sv;
+SCA date_kw           = "$date"sv;
+SCA version_kw        = "$version"sv;
+SCA timescale_kw      = "$timescale"sv;
+SCA enddefinitions_kw = "$enddefinitions"sv;
+
+// the names the grammar's literal sets match
+SCA var_types = std::to_array<std::pair<std::string_view, VarType>>({
+    {"event", VarType::event},
+    {"integer", VarType::integer},
+    {"parameter", VarType::parameter},
+    {"real", VarType::real},
+    {"realtime", VarType::realtime},
+    {"reg", VarType::reg},
+    {"supply0", VarType::supply0},
+    {"supply1", VarType::supply1},
+    {"time", VarType::time},
+    {"tri", VarType::tri},
+    {"triand", VarType::triand},
+    {"trior", VarType::trior},
+    {"trireg", VarType::trireg},
+    {"tri0", VarType::tri0},
+    {"tri1", VarType::tri1},
+    {"wand", VarType::wand},
+    {"wire", VarType::wire},
+    {"wor", VarType::wor},
+});
+SCA scope_types = std::to_array<std::pair<std::string_view, ScopeType>>(
+    {{"begin", ScopeType::begin},
+     {"fork", ScopeType::fork},
+     {"function", ScopeType::function},
+     {"module", ScopeType::module},
+     {"task", ScopeType::task}});
+SCA time_units = std::to_array<std::pair<std::string_view, TimeUnit>>(
+    {{"fs", TimeUnit::fs},
+     {"ps", TimeUnit::ps},
+     {"ns", TimeUnit::ns},
+     {"us", TimeUnit::us},
+     {"ms", TimeUnit::ms},
+     {"s", TimeUnit::s}});
+
+template <typename T, size_t N>
+std::optional<T> lookup_name(const std::array<std::pair<std::string_view, T>, N> &names,
+                             std::string_view name) {
+    if (name.empty()) {
+        return std::nullopt;
+    }
+    // the size and last letter tell every var type apart, so one memcmp at most
+    for (const auto &[n, val] : names) {
+        if (n.size() == name.size() && n.back() == name.back() &&
+            !memcmp(n.data(), name.data(), n.size())) {
+            return val;
+        }
+    }
+    return std::nullopt;
+}
+
+// The $var and $scope keywords before the first $enddefinitions, so the scope tree can be sized
+// before the vars go in.
+std::pair<size_t, size_t> count_scopes_and_vars(std::string_view decls_str) {
+    size_t num_scopes = 0, num_vars = 0;
+    char pad_buf[block_sz];
+    for (size_t base = 0; base < decls_str.size(); base += block_sz) {
+        // the padding is spaces, no '$' past the end
+        for (auto mask = eq_mask64(load_block(decls_str, base, pad_buf), '$'); mask;
+             mask &= mask - 1) {
+            const auto rest = decls_str.substr(base + (size_t)std::countr_zero(mask));
+            if (rest.starts_with(var_kw)) {
+                ++num_vars;
+            } else if (rest.starts_with(scope_kw)) {
+                ++num_scopes;
+            } else if (rest.starts_with(enddefinitions_kw)) {
+                return {num_scopes, num_vars};
+            }
+        }
+    }
+    return {num_scopes, num_vars};
+}
+
+// Walks the declarations the way grammar::decl_list_remaining does, keywords and literals may
+// abut the text around them and whitespace between tokens is skipped.
+class decl_scanner {
+public:
+    decl_scanner(std::string_view str) : m_str{str} {}
+
+    size_t pos() const {
+        return m_pos;
+    }
+    // skips the whitespace, the offset of the next token. The tokens of a declaration are short,
+    // a byte at a time beats ws_index's block masks here. The loops work on copies of the
+    // members, a store to m_pos could alias m_str's size and force a reload every byte.
+    size_t skip_ws() {
+        const auto s  = m_str.data();
+        const auto sz = m_str.size();
+        auto pos      = m_pos;
+        while (pos < sz && is_ws(s[pos])) {
+            ++pos;
+        }
+        return m_pos = pos;
+    }
+    bool at_keyword(std::string_view kw) const {
+        return m_str.size() - m_pos >= kw.size() &&
+               !memcmp(m_str.data() + m_pos, kw.data(), kw.size());
+    }
+    void skip(size_t len) {
+        m_pos += len;
+    }
+    // the next run of non-whitespace
+    std::string_view token() {
+        const auto s     = m_str.data();
+        const auto sz    = m_str.size();
+        const auto start = skip_ws();
+        auto pos         = start;
+        while (pos < sz && !is_ws(s[pos])) {
+            ++pos;
+        }
+        m_pos = pos;
+        return {s + start, pos - start};
+    }
+    // the text up to the next "$end" without the whitespace around it, like text_and_end
+    std::string_view text_and_end(size_t decl_start) {
+        const auto start   = skip_ws();
+        const auto end_pos = m_str.find(end_kw, start);
+        if (end_pos == std::string_view::npos) {
+            decl_scan_error(m_str, decl_start, "missing $end");
+        }
+        auto text_end = end_pos;
+        while (text_end > start && is_ws(m_str[text_end - 1])) {
+            --text_end;
+        }
+        m_pos = end_pos + end_kw.size();
+        return {m_str.data() + start, text_end - start};
+    }
+    void expect_end(size_t decl_start) {
+        skip_ws();
+        if (!at_keyword(end_kw)) {
+            decl_scan_error(m_str, decl_start, "expected $end");
+        }
+        skip(end_kw.size());
+    }
+    template <typename T> T integer(size_t decl_start) {
+        const auto s     = m_str.data();
+        const auto sz    = m_str.size();
+        const auto start = skip_ws();
+        auto pos         = start;
+        T res{};
+        while (pos < sz && is_digit(s[pos])) {
+            if (SURF_UNLIKELY(__builtin_mul_overflow(res, 10, &res) ||
+                              __builtin_add_overflow(res, s[pos] - '0', &res))) {
+                decl_scan_error(m_str, decl_start, "number overflow");
+            }
+            ++pos;
+        }
+        if (pos == start) {
+            decl_scan_error(m_str, decl_start, "expected a decimal number");
+        }
+        m_pos = pos;
+        return res;
+    }
+
+private:
+    std::string_view m_str;
+    size_t m_pos = 0;
+};
+
+// SWAR helpers for 8 binary value digits loaded little endian, the first digit in the low byte
+SCA swar_ones = UINT64_C(0x0101010101010101);
+SCA swar_high = UINT64_C(0x8080808080808080);
+
+// 0x80 in every zero byte of word, exact unlike the usual haszero() bit hack
+SURF_INLINE constexpr uint64_t swar_zero_bytes(uint64_t word) {
+    const auto low7 = ~swar_high;
+    return ~(((word & low7) + low7) | word | low7);
+}
+
+SURF_INLINE constexpr bool swar_binary_digits(uint64_t word) {
+    // lower cased: 0/1 are 0x30/0x31, x/z are 0x78/0x7a
+    const auto lower     = word | (swar_ones * 0x20);
+    const auto is_binary = swar_zero_bytes((lower & (swar_ones * 0xfe)) ^ (swar_ones * 0x30));
+    const auto is_xz     = swar_zero_bytes((lower & (swar_ones * 0xfd)) ^ (swar_ones * 0x78));
+    return (is_binary | is_xz) == swar_high;
+}
+
+// bit 0 of every byte into a byte, the first digit becomes the most significant bit
+SURF_INLINE constexpr uint8_t swar_pack_bits(uint64_t word) {
+    return (uint8_t)(((word & swar_ones) * UINT64_C(0x8040201008040201)) >> 56);
+}
+
+// the xz bit is 0x40, set for the letters only. A value bit is bit 0 of a digit, or for a letter
+// set for X and clear for Z, told apart by 0x02.
+SURF_INLINE constexpr uint64_t swar_xz_bits(uint64_t word) {
+    return (word >> 6) & swar_ones;
+}
+
+SURF_INLINE constexpr uint64_t swar_value_bits(uint64_t word) {
+    return (word | (swar_xz_bits(word) & ~(word >> 1))) & swar_ones;
+}
+
+double real_digits_to_double(std::string_view digits) {
+    const auto whole_str = std::string{digits};
+    char *end;
+    errno    = 0;
+    double d = strtod(whole_str.c_str(), &end);
+    if (errno == ERANGE || d < std::numeric_limits<double>::lowest() ||
+        d > std::numeric_limits<double>::max()) {
+        throw std::range_error(fmt::format("real_number out of range: '{:s}'", whole_str));
+    }
+    return d;
+}
+
+// arena_for(sig): the arena for the wide values of sig, nullptr for the heap
+template <typename ArenaFor>
+std::vector<SimCmd> cmds_from_records(std::string_view sim_cmds_str,
+                                      const std::vector<SimRecord> &records, ArenaFor &&arena_for) {
+    std::vector<SimCmd> cmds;
+    cmds.reserve(records.size());
+    for (const auto &rec : records) {
+        // a tick record's data is the tick, not an offset
+        const auto val = rec.kind() == SimRecordKind::tick ? std::string_view{}
+                                                          : sim_cmds_str.substr(rec.data, rec.len);
+        switch (rec.kind()) {
+        case SimRecordKind::tick:
+            cmds.emplace_back(Tick{.tick = rec.data});
+            break;
+        case SimRecordKind::comment:
+            cmds.emplace_back(Comment{.comment = val});
+            break;
+        case SimRecordKind::scalar:
+            cmds.emplace_back(Change{.value = ScalarValue{val[0]}, .sig = rec.sig});
+            break;
+        case SimRecordKind::vector:
+            cmds.emplace_back(Change{.value = BinaryNum::from_digits(val, arena_for(rec.sig)),
+                                     .sig   = rec.sig});
+            break;
+        case SimRecordKind::real:
+            cmds.emplace_back(
+                Change{.value = RealNum{.num = real_digits_to_double(val)}, .sig = rec.sig});
+            break;
+        }
+    }
+    return cmds;
+}
+
+// copies the wide values of cmds out of the arena they were parsed into and into the arena of
+// their signal
+void move_to_signal_arenas(std::vector<SimCmd> &cmds, const VarBitArena &from,
+                           std::vector<VarBitArena> &arenas) {
+    for (auto &cmd : cmds) {
+        auto *change = std::get_if<Change>(&cmd);
+        auto *bnum   = change ? std::get_if<BinaryNum>(&change->value) : nullptr;
+        if (!bnum) {
+            continue;
+        }
+        auto &arena = arenas[change->sig];
+        if (bnum->bits.is_arena()) {
+            bnum->bits = VarBit{bnum->bits.bitview(from), arena};
+        }
+        if (bnum->xz && bnum->xz->is_arena()) {
+            bnum->xz = VarBit{bnum->xz->bitview(from), arena};
+        }
+    }
+}
+
+struct ChunkCmds {
+    std::vector<SimCmd> cmds;
+    VarBitArena arena;
+};
+
+}; // namespace
+
+VCDScannerDeclRet scan_vcd_declarations(std::string_view decls_str) {
+    VCDScannerDeclRet res;
+    auto &decls                       = res.decls;
+    const auto [num_scopes, num_vars] = count_scopes_and_vars(decls_str);
+    decls.scopes.reserve(num_scopes, num_vars);
+    decls.signals.reserve(num_vars);
+    std::vector<ScopeTree::index_t> scopes{ScopeTree::root};
+    decl_scanner scan{decls_str};
+    while (true) {
+        const auto decl_start = scan.skip_ws();
+        if (decl_start == decls_str.size()) {
+            decl_scan_error(decls_str, decl_start, "missing $enddefinitions");
+        }
+        if (scan.at_keyword(var_kw)) {
+            scan.skip(var_kw.size());
+            const auto type = lookup_name(var_types, scan.token());
+            if (!type) {
+                decl_scan_error(decls_str, decl_start, "bad var type");
+            }
+            const auto size = scan.integer<int>(decl_start);
+            const auto id   = scan.token();
+            if (id.empty()) {
+                decl_scan_error(decls_str, decl_start, "expected an id code");
+            }
+            Var var{.id = id, .ref = scan.text_and_end(decl_start), .size = size, .type = *type};
+            var.sig = decls.idcodes.intern(var.id);
+            if (var.sig == decls.signals.size()) {
+                decls.signals.emplace_back(Signal{.size = var.size, .type = var.type});
+            }
+            decls.scopes.add_var(scopes.back(), var);
+        } else if (scan.at_keyword(scope_kw)) {
+            scan.skip(scope_kw.size());
+            const auto type = lookup_name(scope_types, scan.token());
+            if (!type) {
+                decl_scan_error(decls_str, decl_start, "bad scope type");
+            }
+            const auto name = scan.token();
+            if (name.empty()) {
+                decl_scan_error(decls_str, decl_start, "expected a scope name");
+            }
+            scan.expect_end(decl_start);
+            scopes.emplace_back(decls.scopes.add_scope(scopes.back(), name, *type));
+        } else if (scan.at_keyword(upscope_kw)) {
+            scan.skip(upscope_kw.size());
+            scan.expect_end(decl_start);
+            if (scopes.size() <= 1) {
+                throw std::range_error(fmt::format(
+                    "Underflow in scope depth ({}) after an $upscope", scopes.size()));
+            }
+            scopes.pop_back();
+        } else if (scan.at_keyword(enddefinitions_kw)) {
+            scan.skip(enddefinitions_kw.size());
+            scan.expect_end(decl_start);
+            break;
+        } else if (scan.at_keyword(comment_kw)) {
+            scan.skip(comment_kw.size());
+            if (!decls.comments) {
+                decls.comments.emplace();
+            }
+            decls.comments->emplace_back(scan.text_and_end(decl_start));
+        } else if (scan.at_keyword(date_kw)) {
+            scan.skip(date_kw.size());
+            decls.date = scan.text_and_end(decl_start);
+        } else if (scan.at_keyword(version_kw)) {
+            scan.skip(version_kw.size());
+            decls.version = scan.text_and_end(decl_start);
+        } else if (scan.at_keyword(timescale_kw)) {
+            scan.skip(timescale_kw.size());
+            const auto num_start = scan.skip_ws();
+            const auto num       = scan.integer<uint64_t>(decl_start);
+            if (num != 1 && num != 10 && num != 100) {
+                decl_scan_error(decls_str, num_start, "bad time number");
+            }
+            scan.skip_ws();
+            const auto unit =
+                std::find_if(time_units.begin(), time_units.end(), [&](const auto &unit) {
+                    return scan.at_keyword(unit.first);
+                });
+            if (unit == time_units.end()) {
+                decl_scan_error(decls_str, scan.pos(), "bad time unit");
+            }
+            scan.skip(unit->first.size());
+            scan.expect_end(decl_start);
+            decls.timescale = Timescale{.time_number = (TimeNumber)num, .time_unit = unit->second};
+        } else {
+            decl_scan_error(decls_str, decl_start, "bad declaration");
+        }
+    }
+    if (scopes.size() != 1) {
+        throw std::domain_error(
+            fmt::format("Scopes stack should have 1 element, the root, but has {} elements "
+                        "instead. Missing $upscope.",
+                        scopes.size()));
+    }
+    res.remaining = decls_str.substr(scan.skip_ws());
+    return res;
+}
+
+size_t find_line_tick(std::string_view str, size_t pos) {
+    while ((pos = find_byte(str, pos, '#')) != std::string_view::npos) {
+        if (pos > 0 && str[pos - 1] == '\n' && pos + 1 < str.size() && is_digit(str[pos + 1])) {
+            return pos;
+        }
+        ++pos;
+    }
+    return std::string_view::npos;
+}
+
+size_t scan_vcd_sim_cmds(std::string_view sim_cmds_str, const IDCodeTable &idcodes,
+                         std::vector<SimRecord> &records, bool is_final) {
+    const auto sz = sim_cmds_str.size();
+    const auto s  = sim_cmds_str.data();
+    ws_index ws{sim_cmds_str};
+    size_t pos = ws.next_non_ws(0);
+    while (pos < sz) {
+        const auto cmd_start = pos;
+        const auto c         = s[pos];
+        SimRecord rec{};
+        if (c == '#') {
+            size_t digits_end = pos + 1;
+            uint64_t tick     = 0;
+            while (digits_end < sz && is_digit(s[digits_end])) {
+                if (SURF_UNLIKELY(__builtin_mul_overflow(tick, 10, &tick) ||
+                                  __builtin_add_overflow(tick, s[digits_end] - '0', &tick))) {
+                    scan_error(sim_cmds_str, cmd_start, "tick overflow");
+                }
+                ++digits_end;
+            }
+            if (digits_end == sz && !is_final) {
+                return cmd_start;
+            }
+            if (digits_end == pos + 1) {
+                scan_error(sim_cmds_str, cmd_start, "expected tick number");
+            }
+            rec = SimRecord{.data = tick, .kind_raw = (uint32_t)SimRecordKind::tick};
+            pos = digits_end;
+        } else if (c == '$') {
+            const auto rest = sim_cmds_str.substr(pos);
+            if (!rest.starts_with(comment_kw)) {
+                if (!is_final && rest.size() < comment_kw.size() && comment_kw.starts_with(rest)) {
+                    return cmd_start;
+                }
+                scan_error(sim_cmds_str, cmd_start, "unsupported command");
+            }
+            const auto text_start = ws.next_non_ws(pos + comment_kw.size());
+            auto end_pos          = text_start;
+            while ((end_pos = find_byte(sim_cmds_str, end_pos, '$')) != std::string_view::npos &&
+                   !sim_cmds_str.substr(end_pos).starts_with(end_kw)) {
+                ++end_pos;
+            }
+            if (end_pos == std::string_view::npos) {
+                if (!is_final) {
+                    return cmd_start;
+                }
+                scan_error(sim_cmds_str, cmd_start, "unterminated $comment");
+            }
+            auto text_end = end_pos;
+            while (text_end > text_start && is_ws(s[text_end - 1])) {
+                --text_end;
+            }
+            if (SURF_UNLIKELY(text_end - text_start > SimRecord::max_len)) {
+                scan_error(sim_cmds_str, cmd_start, "$comment too long");
+            }
+            rec = SimRecord{.data     = text_start,
+                            .len      = (uint32_t)(text_end - text_start),
+                            .kind_raw = (uint32_t)SimRecordKind::comment};
+            pos = end_pos + end_kw.size();
+        } else {
+            size_t val_start = pos + 1;
+            size_t val_end   = val_start;
+            if (c == 'b' || c == 'B') {
+                while (val_end < sz && is_scalar_val(s[val_end])) {
+                    ++val_end;
+                }
+                if (val_end == val_start && val_end < sz) {
+                    scan_error(sim_cmds_str, cmd_start, "expected binary digits");
+                }
+                rec.kind_raw = (uint32_t)SimRecordKind::vector;
+            } else if (is_scalar_val(c)) {
+                val_start = pos;
+                rec.kind_raw = (uint32_t)SimRecordKind::scalar;
+            } else if (c == 'r' || c == 'R') {
+                if (val_end < sz && (s[val_end] == '+' || s[val_end] == '-')) {
+                    ++val_end;
+                }
+                const auto int_start = val_end;
+                while (val_end < sz && is_digit(s[val_end])) {
+                    ++val_end;
+                }
+                if (val_end == int_start && val_end < sz) {
+                    scan_error(sim_cmds_str, cmd_start, "expected real number digits");
+                }
+                if (val_end < sz && s[val_end] == '.') {
+                    const auto frac_start = ++val_end;
+                    while (val_end < sz && is_digit(s[val_end])) {
+                        ++val_end;
+                    }
+                    if (val_end == frac_start && val_end < sz) {
+                        scan_error(sim_cmds_str, cmd_start, "expected real number fraction");
+                    }
+                }
+                rec.kind_raw = (uint32_t)SimRecordKind::real;
+            } else {
+                scan_error(sim_cmds_str, cmd_start, "bad value");
+            }
+            if (val_end == sz) {
+                if (!is_final) {
+                    return cmd_start;
+                }
+                scan_error(sim_cmds_str, cmd_start, "value without id");
+            }
+            const auto id_start = ws.next_non_ws(val_end);
+            const auto id_end   = ws.next_ws(id_start);
+            if (id_end == sz && !is_final) {
+                return cmd_start;
+            }
+            if (id_start == sz) {
+                scan_error(sim_cmds_str, cmd_start, "value without id");
+            }
+            if (SURF_UNLIKELY(val_end - val_start > SimRecord::max_len)) {
+                scan_error(sim_cmds_str, cmd_start, "value too long");
+            }
+            rec.sig = idcodes.lookup(sim_cmds_str.substr(id_start, id_end - id_start));
+            if (SURF_UNLIKELY(rec.sig == IDCodeTable::invalid_sig)) {
+                scan_error(sim_cmds_str, id_start, "undeclared id code");
+            }
+            rec.data = val_start;
+            rec.len  = (uint32_t)(val_end - val_start);
+            pos      = id_end;
+        }
+        records.emplace_back(rec);
+        pos = ws.next_non_ws(pos);
+    }
+    return sz;
+}
+
+BinaryNum BinaryNum::from_digits(std::string_view digits, VarBitArena *arena) {
+    if (digits.empty()) {
+        throw std::domain_error("binary value without digits");
+    }
+    if (digits.size() > std::numeric_limits<varbit::sz_t>::max()) {
+        throw std::range_error(
+            fmt::format("binary value of {:d} digits is too wide", digits.size()));
+    }
+    const auto bitsize = (varbit::sz_t)digits.size();
+    const auto zeroed = [&] {
+        return arena ? VarBit::zeroed(bitsize, *arena) : VarBit::zeroed(bitsize);
+    };
+    BinaryNum res{zeroed()};
+    // re-fetched after every allocation, growing the arena moves it
+    uint8_t *bits = arena ? res.bits.data(*arena) : res.bits.data();
+    uint8_t *xz   = nullptr;
+    // the xz plane only gets allocated once the first X or Z shows up
+    const auto set_xz = [&](size_t byte, uint8_t xz_byte) {
+        if (SURF_LIKELY(!xz_byte)) {
+            return;
+        }
+        if (!xz) {
+            res.xz.emplace(zeroed());
+            xz   = arena ? res.xz->data(*arena) : res.xz->data();
+            bits = arena ? res.bits.data(*arena) : res.bits.data();
+        }
+        xz[byte] = xz_byte;
+    };
+    // the last 8 digits hold the least significant byte
+    size_t byte = 0;
+    auto end    = digits.size();
+    for (; end >= sizeof(uint64_t); end -= sizeof(uint64_t), ++byte) {
+        uint64_t word;
+        memcpy(&word, digits.data() + end - sizeof(word), sizeof(word));
+        if (SURF_UNLIKELY(!swar_binary_digits(word))) {
+            throw std::domain_error(fmt::format("bad binary value digits: '{:s}'", digits));
+        }
+        bits[byte] = swar_pack_bits(swar_value_bits(word));
+        set_xz(byte, swar_pack_bits(swar_xz_bits(word)));
+    }
+    if (end) {
+        uint8_t bits_byte = 0;
+        uint8_t xz_byte   = 0;
+        for (size_t i = 0; i < end; ++i) {
+            const auto c = digits[i];
+            if (SURF_UNLIKELY(!is_scalar_val(c))) {
+                throw std::domain_error(fmt::format("bad binary value digits: '{:s}'", digits));
+            }
+            const ScalarValue sv{c};
+            bits_byte = (uint8_t)((bits_byte << 1) | (sv.b() || sv.x()));
+            xz_byte   = (uint8_t)((xz_byte << 1) | (sv.x() || sv.z()));
+        }
+        bits[byte] = bits_byte;
+        set_xz(byte, xz_byte);
+    }
+    return res;
+}
+
+std::string BinaryNum::digits(const VarBitArena *arena) const {
+    auto res = bitview2string(bits_view(arena));
+    if (const auto xz_bits = xz_view(arena)) {
+        const auto xz_digits = bitview2string(*xz_bits);
+        for (size_t i = 0; i < res.size(); ++i) {
+            if (xz_digits[i] == '1') {
+                res[i] = res[i] == '1' ? 'x' : 'z';
+            }
+        }
+    }
+    return res;
+}
+
+std::vector<SimCmd> sim_cmds_from_records(std::string_view sim_cmds_str,
+                                          const std::vector<SimRecord> &records,
+                                          std::vector<VarBitArena> *arenas) {
+    return cmds_from_records(sim_cmds_str, records, [arenas](IDCodeTable::sig_t sig) {
+        return arenas ? &(*arenas)[sig] : nullptr;
+    });
+}
+
+std::vector<SimCmd> sim_cmds_from_records(std::string_view sim_cmds_str,
+                                          const std::vector<SimRecord> &records,
+                                          VarBitArena &arena) {
+    return cmds_from_records(sim_cmds_str, records, [&arena](IDCodeTable::sig_t) {
+        return &arena;
+    });
+}
+
+std::vector<SimCmd> parse_vcd_sim_cmds_fast(std::string_view sim_cmds_str,
+                                            const IDCodeTable &idcodes,
+                                            std::vector<VarBitArena> *arenas) {
+    std::vector<SimRecord> records;
+    scan_vcd_sim_cmds(sim_cmds_str, idcodes, records);
+    if (arenas) {
+        arenas->resize(idcodes.size());
+    }
+    return sim_cmds_from_records(sim_cmds_str, records, arenas);
+}
+
+std::vector<std::string_view> split_vcd_sim_cmds(std::string_view sim_cmds_str, size_t num_chunks) {
+    std::vector<std::string_view> chunks;
+    const auto sz      = sim_cmds_str.size();
+    size_t chunk_start = 0;
+    for (size_t i = 1; i < num_chunks && chunk_start < sz; ++i) {
+        // only split on a '#' that starts a line and is followed by a digit, ids can contain '#'
+        const auto boundary =
+            find_line_tick(sim_cmds_str, std::max(chunk_start + 1, sz / num_chunks * i));
+        if (boundary == std::string_view::npos) {
+            break;
+        }
+        chunks.emplace_back(sim_cmds_str.substr(chunk_start, boundary - chunk_start));
+        chunk_start = boundary;
+    }
+    chunks.emplace_back(sim_cmds_str.substr(chunk_start));
+    return chunks;
+}
+
+std::vector<SimCmd>
+parse_vcd_sim_cmds_parallel(std::string_view sim_cmds_str, const IDCodeTable &idcodes,
+                            uint32_t num_threads, std::vector<VarBitArena> *arenas,
+                            const std::function<void(size_t parsed)> &on_parsed) {
+    const auto parse_serial = [&] {
+        auto cmds = parse_vcd_sim_cmds_fast(sim_cmds_str, idcodes, arenas);
+        if (on_parsed) {
+            on_parsed(sim_cmds_str.size());
+        }
+        return cmds;
+    };
+    const auto max_chunks = sim_cmds_str.size() / min_parallel_chunk_sz;
+    const auto num_chunks = std::min<size_t>((size_t)num_threads * chunks_per_thread, max_chunks);
+    if (num_threads <= 1 || num_chunks <= 1) {
+        return parse_serial();
+    }
+    const auto chunks = split_vcd_sim_cmds(sim_cmds_str, num_chunks);
+    if (chunks.size() == 1) {
+        return parse_serial();
+    }
+
+    // nothing else touches the per signal arenas before the first chunk is done, so it parses
+    // straight into them
+    BS::thread_pool pool{num_threads};
+    std::vector<std::future<ChunkCmds>> chunk_futures;
+    chunk_futures.reserve(chunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        chunk_futures.emplace_back(pool.submit([chunk = chunks[i], first = i == 0, &idcodes,
+                                                arenas] {
+            ChunkCmds res;
+            if (!arenas) {
+                res.cmds = parse_vcd_sim_cmds_fast(chunk, idcodes);
+            } else if (first) {
+                res.cmds = parse_vcd_sim_cmds_fast(chunk, idcodes, arenas);
+            } else {
+                std::vector<SimRecord> records;
+                scan_vcd_sim_cmds(chunk, idcodes, records);
+                res.cmds = sim_cmds_from_records(chunk, records, res.arena);
+            }
+            return res;
+        }));
+    }
+
+    std::vector<std::vector<SimCmd>> chunk_cmds;
+    chunk_cmds.reserve(chunks.size());
+    try {
+        // the chunks complete in any order, everything before the end of the ones collected so
+        // far is parsed
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            auto chunk = chunk_futures[i].get();
+            if (arenas && chunk.arena.size()) {
+                move_to_signal_arenas(chunk.cmds, chunk.arena, *arenas);
+            }
+            chunk_cmds.emplace_back(std::move(chunk.cmds));
+            if (on_parsed) {
+                on_parsed((size_t)(chunks[i].data() + chunks[i].size() - sim_cmds_str.data()));
+            }
+        }
+    } catch (const std::logic_error &) {
+        // A chunk boundary landed inside a command that spans lines, e.g. a $comment containing
+        // a line starting with '#<digit>'. The chunk before it can't terminate so it always fails
+        // to scan. Redo it serially so both the result and any error location are exact.
+        pool.wait_for_tasks();
+        if (arenas) {
+            arenas->clear();
+        }
+        return parse_serial();
+    }
+
+    size_t num_cmds = 0;
+    for (const auto &cmds : chunk_cmds) {
+        num_cmds += cmds.size();
+    }
+    std::vector<SimCmd> res;
+    res.reserve(num_cmds);
+    for (auto &cmds : chunk_cmds) {
+        std::move(cmds.begin(), cmds.end(), std::back_inserter(res));
+        cmds = {};
+    }
+    return res;
+}
+
+}; // namespace surf
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "common-internal.h"
+#include <surf/vcd.h>
+
+#include <functional>
+
+namespace surf {
+
+enum class SimRecordKind : uint8_t {
+    tick,
+    comment,
+    scalar,
+    vector,
+    real
+};
+
+// Compact, allocation free form of a VCDTypes::SimCmd. Offsets are relative to the start of the
+// scanned string, which has to outlive the records.
+struct SimRecord {
+    SURF_SCA len_bits = 29;
+    SURF_SCA max_len  = pow2(len_bits) - 1;
+
+    // tick: tick number, otherwise: offset of the value digits (or comment text)
+    uint64_t data;
+    // interned signal index of a value change
+    IDCodeTable::sig_t sig;
+    // length of the value digits (or comment text)
+    uint32_t len : len_bits;
+    uint32_t kind_raw : 3;
+
+    SimRecordKind kind() const {
+        return (SimRecordKind)kind_raw;
+    }
+};
+static_assert(sizeof(SimRecord) == 16);
+
+struct VCDScannerDeclRet {
+    VCDTypes::Declarations decls;
+    std::string_view remaining;
+};
+// Hand written fast path equivalent of parse_vcd_declarations followed by decls_from_decl_list,
+// without the intermediate list of declarations. The text fields are views into decls_str.
+VCDScannerDeclRet scan_vcd_declarations(std::string_view decls_str);
+
+// Hand written fast path equivalent of grammar::sim_cmd_eof_list. Appends one record per command
+// and returns the number of bytes consumed. If is_final is false, a command that could be cut off
+// by the end of sim_cmds_str is left unconsumed instead of being treated as an error.
+size_t scan_vcd_sim_cmds(std::string_view sim_cmds_str, const IDCodeTable &idcodes,
+                         std::vector<SimRecord> &records, bool is_final = true);
+
+// arenas: if not null, vector values too wide to inline go into (*arenas)[sig] instead of the heap,
+// see VCDTypes::Document::arenas. It has to hold one arena per signal.
+std::vector<VCDTypes::SimCmd> sim_cmds_from_records(std::string_view sim_cmds_str,
+                                                    const std::vector<SimRecord> &records,
+                                                    std::vector<VarBitArena> *arenas = nullptr);
+
+// arena: every value too wide to inline goes into this one arena, whatever its signal
+std::vector<VCDTypes::SimCmd> sim_cmds_from_records(std::string_view sim_cmds_str,
+                                                    const std::vector<SimRecord> &records,
+                                                    VarBitArena &arena);
+
+// arenas: as above, resized to the number of signals
+std::vector<VCDTypes::SimCmd> parse_vcd_sim_cmds_fast(std::string_view sim_cmds_str,
+                                                      const IDCodeTable &idcodes,
+                                                      std::vector<VarBitArena> *arenas = nullptr);
+
+// Offset of the next '#' at or after pos that starts a line and is followed by a digit, npos if
+// there are none.
+size_t find_line_tick(std::string_view str, size_t pos);
+
+// Splits sim_cmds_str into roughly equal chunks that each start on a '#tick' at the beginning of
+// a line. The chunks are contiguous and cover the entire input.
+std::vector<std::string_view> split_vcd_sim_cmds(std::string_view sim_cmds_str, size_t num_chunks);
+
+// Scans the chunks from split_vcd_sim_cmds on num_threads threads and concatenates their
+// commands in order. Falls back to a serial scan if a chunk fails to scan on its own.
+// arenas: as for parse_vcd_sim_cmds_fast. Chunks after the first are parsed into an arena of their
+// own and their wide values are copied into the per signal arenas as they are concatenated.
+// on_parsed: called on the calling thread with the length of the prefix of sim_cmds_str that is
+// parsed every time the chunks up to one more have completed, the last call is with its size.
+std::vector<VCDTypes::SimCmd>
+parse_vcd_sim_cmds_parallel(std::string_view sim_cmds_str, const IDCodeTable &idcodes,
+                            uint32_t num_threads, std::vector<VarBitArena> *arenas = nullptr,
+                            const std::function<void(size_t parsed)> &on_parsed = {});
+
+}; // namespace surf
@@ -0,0 +1,143 @@
+#include <surf/vcd-stream.h>
+
+#include "common-internal.h"
+#include "utils.h"
+#include "vcd-scanner.h"
+
+#include <cerrno>
+
+using namespace VCDTypes;
+
+namespace {
+
+SCA enddefinitions_kw = "$enddefinitions"sv;
+SCA end_kw            = "$end"sv;
+
+}; // namespace
+
+VCDStream::VCDStream(int fd, std::string name, size_t chunk_size)
+    : m_fd{fd}, m_name{std::move(name)}, m_chunk_size{chunk_size} {
+    if (!chunk_size) {
+        throw std::range_error("VCDStream: zero chunk size");
+    }
+}
+
+VCDStream::VCDStream(ChunkedFileReader &reader)
+    : m_fd{-1}, m_reader{&reader}, m_name{reader.path().string()},
+      m_chunk_size{reader.chunk_size()} {}
+
+size_t VCDStream::read_chunk() {
+    // the tail is a command cut off by the last read, move it to the front
+    if (m_head) {
+        std::copy(m_buf.begin() + (ptrdiff_t)m_head, m_buf.begin() + (ptrdiff_t)m_tail,
+                  m_buf.begin());
+        m_tail -= m_head;
+        m_head = 0;
+    }
+    // only grows past two chunks for a command longer than a chunk
+    if (m_buf.size() < m_tail + m_chunk_size) {
+        m_buf.resize(std::max(m_tail + m_chunk_size, 2 * m_chunk_size));
+    }
+    if (m_reader) {
+        const auto chunk = m_reader->next();
+        std::copy(chunk.data.begin(), chunk.data.end(), m_buf.begin() + (ptrdiff_t)m_tail);
+        m_tail += chunk.data.size();
+        m_bytes_read += chunk.data.size();
+        return chunk.data.size();
+    }
+    ssize_t num_read;
+    do {
+        num_read = read(m_fd, m_buf.data() + m_tail, m_chunk_size);
+    } while (num_read < 0 && errno == EINTR);
+    posix_check(num_read < 0 ? -1 : 0, "VCDStream read");
+    m_tail += (size_t)num_read;
+    m_bytes_read += (uint64_t)num_read;
+    return (size_t)num_read;
+}
+
+bool VCDStream::parse_declarations() {
+    const std::string_view buf{m_buf.data(), m_tail};
+    const auto kw_pos = buf.find(enddefinitions_kw, m_decls_search_pos);
+    if (kw_pos == std::string_view::npos) {
+        // the keyword may straddle the end of the buffer
+        m_decls_search_pos = m_tail - std::min(m_tail, enddefinitions_kw.size());
+        return false;
+    }
+    m_decls_search_pos = kw_pos;
+    const auto end_pos = buf.find(end_kw, kw_pos + enddefinitions_kw.size());
+    if (end_pos == std::string_view::npos) {
+        return false;
+    }
+    const auto decls_sz = end_pos + end_kw.size();
+    // the declarations' text fields point into it, the buffer gets reused
+    m_decls_str    = buf.substr(0, decls_sz);
+    m_decls        = scan_vcd_declarations(m_decls_str).decls;
+    m_head         = decls_sz;
+    m_arenas.resize(m_decls->idcodes.size());
+    return true;
+}
+
+const Declarations &VCDStream::declarations() {
+    while (!m_decls && !parse_declarations()) {
+        if (!read_chunk()) {
+            throw std::domain_error(
+                fmt::format("VCD stream '{:s}' ended before $enddefinitions", m_name));
+        }
+    }
+    return *m_decls;
+}
+
+const Declarations *VCDStream::try_declarations() {
+    while (!m_decls && !parse_declarations()) {
+        if (!read_chunk()) {
+            return nullptr;
+        }
+    }
+    return &*m_decls;
+}
+
+int VCDStream::timebase_power() {
+    return timebase_power_from_timescale(declarations().timescale);
+}
+
+void VCDStream::parse(const Sink &sink, bool is_final) {
+    const std::string_view str{m_buf.data() + m_head, m_tail - m_head};
+    std::vector<SimRecord> records;
+    const auto consumed = scan_vcd_sim_cmds(str, m_decls->idcodes, records, is_final);
+    if (!records.empty()) {
+        const auto cmds = sim_cmds_from_records(str, records, &m_arenas);
+        sink(cmds, m_arenas);
+        // only the arenas of the signals with vector changes were written to
+        for (const auto &rec : records) {
+            if (rec.kind() == SimRecordKind::vector) {
+                m_arenas[rec.sig].clear();
+            }
+        }
+    }
+    m_head += consumed;
+}
+
+bool VCDStream::poll(const Sink &sink) {
+    // a file that is still being written may not have all of its definitions yet
+    if (!try_declarations()) {
+        return false;
+    }
+    const auto num_read = read_chunk();
+    parse(sink, false);
+    return num_read != 0;
+}
+
+void VCDStream::finish(const Sink &sink) {
+    declarations();
+    parse(sink, true);
+}
+
+void VCDStream::run(const Sink &sink) {
+    while (poll(sink)) {
+    }
+    finish(sink);
+}
+
+uint64_t VCDStream::bytes_read() const {
+    return m_bytes_read;
+}
@@ -1,23 +1,82 @@
 #include <memory>
 #include <surf/vcd.h>
 
+#include <algorithm>
+#include <chrono>
+#include <future>
 #include <mutex>
 
 #include "common-internal.h"
+#include "surf/trace-writer.h"
 #include "surf/trace.h"
 #include "utils.h"
 #include "vcd-parser.h"
+#include "vcd-scanner.h"
+
+using namespace VCDTypes;
+
+namespace surf {
+
+int timebase_power_from_timescale(const std::optional<Timescale> &timescale) {
+    // no $timescale, the spec leaves the unit up to the tool so count plain seconds
+    if (!timescale) {
+        return 0;
+    }
+    int tbp = magic_enum::enum_integer(timescale->time_unit);
+    for (auto num = magic_enum::enum_integer(timescale->time_number); num > 1; num /= 10) {
+        ++tbp;
+    }
+    return tbp;
+}
+
+}; // namespace surf
+
+VCDFile::VCDFile(const fs::path &path, uint32_t num_threads, MapPolicy map_policy)
+    : m_mapped_file(path, map_policy), m_num_threads(num_threads ? num_threads : get_num_cores()) {
+    parse_declarations();
+}
+
+VCDFile::VCDFile(const fs::path &path, uint32_t num_threads,
+                 const ChunkedFileReader::Options &read_options)
+    : m_mapped_file(path, read_options),
+      m_num_threads(num_threads ? num_threads : get_num_cores()) {
+    parse_declarations();
+}
 
-VCDFile::VCDFile(const fs::path &path) : m_mapped_file(path) {
+void VCDFile::parse_declarations() {
     fmt::print("vcd sz: {:d} data: {:p}\n", size(), fmt::ptr(data()));
-    auto decls_ret          = parse_vcd_declarations(string_view(), m_mapped_file.path());
-    m_document.declarations = decls_from_decl_list(std::move(decls_ret.decls));
+    auto decls_ret          = scan_vcd_declarations(string_view());
+    m_document.declarations = std::move(decls_ret.decls);
     m_sim_cmds_str          = decls_ret.remaining;
+    if (const auto first_tick = TickSeekIndex::first_tick(m_sim_cmds_str)) {
+        m_start = Time{first_tick->tick, timebase_power()};
+        m_end   = Time{TickSeekIndex::last_tick(m_sim_cmds_str)->tick, timebase_power()};
+    }
+    m_seek_index = std::async(std::launch::async,
+                              [sim_cmds_str = m_sim_cmds_str, stop = m_index_stop.get_token()] {
+                                  return TickSeekIndex::build(
+                                      sim_cmds_str, TickSeekIndex::default_stride, stop);
+                              })
+                       .share();
+}
+
+VCDFile::~VCDFile() {
+    // m_seek_index's destructor waits for the index thread, cut its scan short
+    m_index_stop.request_stop();
 }
 
 const VCDTypes::Document &VCDFile::document() {
     std::call_once(m_parse_once_flag, [&] {
-        m_document.sim_cmds = parse_vcd_sim_cmds(m_sim_cmds_str, m_mapped_file.path());
+        // with MapPolicy::sequential the pages behind the chunks parsed so far are dropped while
+        // the later ones are still parsing. The document doesn't copy everything out of them,
+        // comment text is a view into the mapping, but dropped pages of a file mapping stay
+        // valid and are read back from the file when the views are read.
+        const auto sim_cmds_off = (size_t)(m_sim_cmds_str.data() - data());
+        m_document.sim_cmds     = parse_vcd_sim_cmds_parallel(
+            m_sim_cmds_str, m_document.declarations.idcodes, m_num_threads, &m_document.arenas,
+            [&](size_t parsed) {
+                m_mapped_file.advance(sim_cmds_off + parsed);
+            });
     });
     return m_document;
 }
@@ -36,6 +95,51 @@ const std::vector<VCDTypes::SimCmd> &VCDFile::sim_cmds() {
     return m_document.sim_cmds;
 }
 
+const TickSeekIndex &VCDFile::seek_index() const {
+    return m_seek_index.get();
+}
+
+bool VCDFile::seek_index_ready() const {
+    return m_seek_index.wait_for(std::chrono::seconds{0}) == std::future_status::ready;
+}
+
+std::vector<SimCmd> VCDFile::sim_cmds_window(uint64_t start, uint64_t end) const {
+    if (start > end) {
+        throw std::range_error(
+            fmt::format("VCDFile: window start #{:d} after end #{:d}", start, end));
+    }
+    const auto [begin, stop] = seek_index().byte_range(start, end);
+    return parse_vcd_sim_cmds_parallel(m_sim_cmds_str.substr(begin, stop - begin),
+                                       declarations().idcodes, m_num_threads);
+}
+
+const SignalColumns &VCDFile::columns() {
+    std::call_once(m_columns_once_flag, [&] {
+        m_columns = SignalColumns::from_document(document());
+    });
+    return m_columns;
+}
+
+const SignalPyramids &VCDFile::pyramids() {
+    std::call_once(m_pyramids_once_flag, [&] {
+        auto pyr_path = path();
+        pyr_path += ".pyr";
+        std::error_code ec;
+        const auto pyr_mtime = fs::last_write_time(pyr_path, ec);
+        if (!ec && pyr_mtime >= fs::last_write_time(path())) {
+            try {
+                m_pyramids = SignalPyramids::load(pyr_path);
+                m_pyramids.check(columns());
+                return;
+            } catch (const std::domain_error &) {
+                // fall through and rebuild
+            }
+        }
+        m_pyramids = SignalPyramids::build(columns(), m_num_threads);
+    });
+    return m_pyramids;
+}
+
 const fs::path &VCDFile::path() const {
     return m_mapped_file.path();
 }
@@ -52,13 +156,40 @@ std::string_view VCDFile::string_view() const {
     return m_mapped_file.string_view();
 }
 
-std::shared_ptr<Trace> VCDFile::surf_trace() const {
-    return std::make_shared<Trace>(m_mapped_file.path());
-    // return m_trace;
+std::string_view VCDFile::sim_cmds_string_view() const {
+    return m_sim_cmds_str;
+}
+
+std::shared_ptr<Trace> VCDFile::surf_trace() {
+    std::call_once(m_trace_once_flag, [&] {
+        auto surf_path = path();
+        surf_path += ".surf";
+        std::error_code ec;
+        const auto surf_mtime = fs::last_write_time(surf_path, ec);
+        if (!ec && surf_mtime >= fs::last_write_time(path())) {
+            try {
+                auto trace = std::make_shared<Trace>(surf_path);
+                // converted from some other VCD
+                if (trace->num_signals() == declarations().signals.size()) {
+                    m_trace = std::move(trace);
+                    return;
+                }
+            } catch (const std::domain_error &) {
+                // stale or partially written, convert again
+            }
+        }
+        // write next to the final path and rename so concurrent readers never see a partial file
+        auto tmp_path = surf_path;
+        tmp_path += fmt::format(".{:d}.tmp", getpid());
+        TraceWriter::write_document(document(), timebase_power(), tmp_path);
+        fs::rename(tmp_path, surf_path);
+        m_trace = std::make_shared<Trace>(surf_path);
+    });
+    return m_trace;
 }
 
 int VCDFile::timebase_power() const {
-    return m_trace->timebase_power();
+    return timebase_power_from_timescale(m_document.declarations.timescale);
 }
 
 Time VCDFile::start() const {
@@ -68,5 +199,3 @@ Time VCDFile::start() const {
 Time VCDFile::end() const {
     return m_end;
 }
-
-// TODO: huge pages on linux
@@ -0,0 +1,88 @@
+#include <surf/zone-map.h>
+
+#include "common-internal.h"
+#include "utils.h"
+
+#include <algorithm>
+
+namespace {
+
+SCA fib_mul = UINT64_C(0x9e3779b97f4a7c15);
+
+uint64_t low_u64(bitview bits) {
+    uint64_t key{};
+    memcpy(&key, bits.data(), std::min<size_t>(bits.bytesize(), sizeof(key)));
+    return key;
+}
+
+}; // namespace
+
+ZoneMap::ZoneMap(varbit::sz_t bitsize) : m_bitsize{bitsize} {}
+
+void ZoneMap::reserve(size_t num_changes) {
+    const auto blocks = (num_changes + block_changes - 1) / block_changes;
+    m_min.reserve(blocks);
+    m_max.reserve(blocks);
+    m_blooms.reserve(blocks * bloom_words);
+    m_has_xz.reserve(blocks);
+}
+
+std::pair<size_t, size_t> ZoneMap::bloom_pos(uint64_t key) const {
+    if (m_bitsize <= bloom_exact_bits) {
+        return {(size_t)key, (size_t)key};
+    }
+    const auto hash = key * fib_mul;
+    return {(size_t)(hash >> (64 - bloom_exact_bits)),
+            (size_t)(hash >> (64 - 2 * bloom_exact_bits)) % bloom_bits};
+}
+
+void ZoneMap::push_back(bitview bits, bool has_xz) {
+    if (m_size % block_changes == 0) {
+        // empty range until a value without X or Z bits arrives
+        m_min.push_back(UINT64_MAX);
+        m_max.push_back(0);
+        m_blooms.resize(m_blooms.size() + bloom_words);
+        m_has_xz.push_back(false);
+    }
+    ++m_size;
+    if (has_xz) {
+        m_has_xz.back() = true;
+        return;
+    }
+    const auto key    = low_u64(bits);
+    m_min.back()      = std::min(m_min.back(), key);
+    m_max.back()      = std::max(m_max.back(), key);
+    auto *bloom       = m_blooms.data() + m_blooms.size() - bloom_words;
+    const auto [a, b] = bloom_pos(key);
+    bloom[a / 64] |= UINT64_C(1) << (a % 64);
+    bloom[b / 64] |= UINT64_C(1) << (b % 64);
+}
+
+size_t ZoneMap::num_blocks() const {
+    return m_min.size();
+}
+
+size_t ZoneMap::size() const {
+    return m_size;
+}
+
+bool ZoneMap::may_be_in(size_t blk, uint64_t lo, uint64_t hi) const {
+    return m_min[blk] <= hi && m_max[blk] >= lo;
+}
+
+bool ZoneMap::may_equal(size_t blk, uint64_t key) const {
+    if (!may_be_in(blk, key, key)) {
+        return false;
+    }
+    const auto *bloom = m_blooms.data() + blk * bloom_words;
+    const auto [a, b] = bloom_pos(key);
+    return ((bloom[a / 64] >> (a % 64)) & 1) && ((bloom[b / 64] >> (b % 64)) & 1);
+}
+
+bool ZoneMap::has_xz(size_t blk) const {
+    return m_has_xz[blk];
+}
+
+size_t ZoneMap::memory_bytes() const {
+    return (m_min.size() + m_max.size() + m_blooms.size()) * sizeof(uint64_t) + m_has_xz.size();
+}
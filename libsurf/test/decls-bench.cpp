@@ -0,0 +1,81 @@
+// Times loading the declarations of a big synthetic VCD: decls-bench [num_vars] [iterations]
+// The header has num_vars vars (default 4M) in scopes of 1000, a quarter of them 8 bit, and a
+// single tick after it. Loading is timed end to end as VCDFile construction, page cache warm.
+
+#include <surf/surf.h>
+using namespace surf;
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include <fmt/format.h>
+
+namespace {
+
+constexpr size_t vars_per_scope = 1000;
+
+// printable id codes as VCD writers hand them out, '!' first
+std::string id_code(size_t idx) {
+    std::string code;
+    do {
+        code += (char)('!' + idx % 94);
+        idx /= 94;
+    } while (idx);
+    return code;
+}
+
+void write_header(const std::filesystem::path &path, size_t num_vars) {
+    const auto file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        throw std::runtime_error(fmt::format("can't create '{:s}'", path.string()));
+    }
+    fmt::print(file, "$date today $end\n$version decls-bench $end\n$timescale 1 ns $end\n"
+                     "$scope module top $end\n");
+    for (size_t var = 0; var < num_vars; ++var) {
+        if (var % vars_per_scope == 0) {
+            if (var) {
+                fmt::print(file, "$upscope $end\n");
+            }
+            fmt::print(file, "$scope module blk{:d} $end\n", var / vars_per_scope);
+        }
+        if (var % 4 == 0) {
+            fmt::print(file, "$var wire 8 {:s} bus{:d} [7:0] $end\n", id_code(var), var);
+        } else {
+            fmt::print(file, "$var wire 1 {:s} sig{:d} $end\n", id_code(var), var);
+        }
+    }
+    if (num_vars) {
+        fmt::print(file, "$upscope $end\n");
+    }
+    fmt::print(file, "$upscope $end\n$enddefinitions $end\n#0\n");
+    std::fclose(file);
+}
+
+}; // namespace
+
+int main(int argc, const char **argv) {
+    const auto num_vars   = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4'000'000;
+    const auto iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+    const auto path =
+        std::filesystem::temp_directory_path() / fmt::format("surf-decls-bench-{:d}.vcd", getpid());
+    write_header(path, num_vars);
+    const auto mib = (double)std::filesystem::file_size(path) / (1024 * 1024);
+
+    double best       = 0;
+    size_t num_loaded = 0;
+    for (int i = 0; i < iterations; ++i) {
+        const auto start                        = std::chrono::steady_clock::now();
+        VCDFile vcd{path};
+        const std::chrono::duration<double> dur = std::chrono::steady_clock::now() - start;
+        num_loaded = vcd.declarations().scopes.num_vars();
+        best       = i ? std::min(best, dur.count()) : dur.count();
+    }
+    std::filesystem::remove(path);
+
+    fmt::print("{:d} vars, {:.1f} MiB header, best of {:d}: {:.3f} s, {:.1f} M vars/s\n",
+               num_loaded, mib, iterations, best, (double)num_loaded / best / 1e6);
+    return 0;
+}
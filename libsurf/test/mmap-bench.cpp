@@ -0,0 +1,154 @@
+// Compares the MappedReadOnlyFile policies and the ChunkedFileReader backends on a big file,
+// ideally a multi-GB VCD: mmap-bench <path> [iterations]
+// Each one scans the file front to back, cold (page cache dropped first) and warm. VCDs are also
+// parsed, mappings with VCDFile on every core and readers with VCDStream.
+
+#include <surf/surf.h>
+using namespace surf;
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <functional>
+#include <unistd.h>
+
+#include <fmt/format.h>
+
+namespace {
+
+// keeps the scans from being optimized out
+volatile size_t num_lines_sink;
+
+// clean pages of the file are evicted, dirty ones need a sync first
+void drop_page_cache(const std::filesystem::path &path) {
+    const auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+#ifdef POSIX_FADV_DONTNEED
+    (void)fdatasync(fd);
+    (void)posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    close(fd);
+}
+
+double time_s(const std::function<void()> &func) {
+    const auto start                        = std::chrono::steady_clock::now();
+    func();
+    const std::chrono::duration<double> dur = std::chrono::steady_clock::now() - start;
+    return dur.count();
+}
+
+// counts lines so the compiler can't skip the reads, advancing the cursor every MiB
+size_t scan(MappedReadOnlyFile &file) {
+    constexpr size_t step = 1024 * 1024;
+    size_t num_lines      = 0;
+    const auto str        = file.string_view();
+    for (size_t off = 0; off < str.size(); off += step) {
+        const auto block = str.substr(off, step);
+        num_lines += (size_t)std::count(block.begin(), block.end(), '\n');
+        file.advance(off + block.size());
+    }
+    return num_lines;
+}
+
+size_t scan(ChunkedFileReader &reader) {
+    size_t num_lines = 0;
+    for (auto chunk = reader.next(); !chunk.data.empty(); chunk = reader.next()) {
+        num_lines += (size_t)std::count(chunk.data.begin(), chunk.data.end(), '\n');
+    }
+    return num_lines;
+}
+
+}; // namespace
+
+int main(int argc, const char **argv) {
+    if (argc < 2) {
+        fmt::print(stderr, "usage: {:s} <path> [iterations]\n", argv[0]);
+        return -1;
+    }
+    const std::filesystem::path path{argv[1]};
+    const auto iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 3;
+    const auto is_vcd     = path.extension() == ".vcd";
+    const auto mib        = (double)std::filesystem::file_size(path) / (1024 * 1024);
+
+    struct Config {
+        std::string name;
+        MapPolicy policy;
+        bool prefetch;
+    };
+    const std::vector<Config> configs{
+        {"normal", MapPolicy::normal, false},
+        {"sequential", MapPolicy::sequential, false},
+        {"random", MapPolicy::random, false},
+        {"huge_pages", MapPolicy::huge_pages, false},
+        {"normal+prefetch", MapPolicy::normal, true},
+    };
+
+    fmt::print("{:s}: {:.1f} MiB, best of {:d}\n", path, mib, iterations);
+    fmt::print("{:<16s} {:>14s} {:>14s}{:s}\n", "policy", "cold MiB/s", "warm MiB/s",
+               is_vcd ? fmt::format(" {:>14s}", "parse MiB/s") : "");
+    for (const auto &config : configs) {
+        double cold = 0, warm = 0, parse = 0;
+        for (int i = 0; i < iterations; ++i) {
+            drop_page_cache(path);
+            cold = std::max(cold, mib / time_s([&] {
+                                      MappedReadOnlyFile file{path, config.policy};
+                                      if (config.prefetch) {
+                                          file.prefetch_async();
+                                      }
+                                      num_lines_sink = scan(file);
+                                  }));
+            warm = std::max(warm, mib / time_s([&] {
+                                      MappedReadOnlyFile file{path, config.policy};
+                                      num_lines_sink = scan(file);
+                                  }));
+            if (is_vcd) {
+                drop_page_cache(path);
+                parse = std::max(parse, mib / time_s([&] {
+                                            VCDFile vcd{path, 0, config.policy};
+                                            (void)vcd.sim_cmds();
+                                        }));
+            }
+        }
+        fmt::print("{:<16s} {:>14.1f} {:>14.1f}{:s}\n", config.name, cold, warm,
+                   is_vcd ? fmt::format(" {:>14.1f}", parse) : "");
+    }
+
+    for (const auto backend :
+         {ChunkedFileReader::Backend::pread, ChunkedFileReader::Backend::io_uring}) {
+        double cold = 0, warm = 0, parse = 0;
+        std::string_view name;
+        for (int i = 0; i < iterations; ++i) {
+            drop_page_cache(path);
+            cold = std::max(cold, mib / time_s([&] {
+                                      ChunkedFileReader reader{path, {.backend = backend}};
+                                      name           = magic_enum::enum_name(reader.backend());
+                                      num_lines_sink = scan(reader);
+                                  }));
+            warm = std::max(warm, mib / time_s([&] {
+                                      ChunkedFileReader reader{
+                                          path, {.backend = backend, .drop_behind = false}};
+                                      num_lines_sink = scan(reader);
+                                  }));
+            if (is_vcd) {
+                drop_page_cache(path);
+                parse = std::max(parse, mib / time_s([&] {
+                                            ChunkedFileReader reader{path, {.backend = backend}};
+                                            VCDStream stream{reader};
+                                            size_t num_cmds = 0;
+                                            stream.run([&](std::span<const VCDTypes::SimCmd> cmds,
+                                                           std::span<const VarBitArena>) {
+                                                num_cmds += cmds.size();
+                                            });
+                                            num_lines_sink = num_cmds;
+                                        }));
+            }
+        }
+        // io_uring falls back to pread without liburing
+        fmt::print("{:<16s} {:>14.1f} {:>14.1f}{:s}\n", fmt::format("reader {:s}", name), cold,
+                   warm, is_vcd ? fmt::format(" {:>14.1f}", parse) : "");
+    }
+    return 0;
+}
@@ -1,6 +1,9 @@
 #include <surf/surf.h>
 using namespace surf;
 
+#include <charconv>
+#include <chrono>
+#include <fcntl.h>
 #include <string>
 #include <unistd.h>
 
@@ -14,6 +17,14 @@ int main(int argc, const char **argv) {
     argparse::ArgumentParser parser("surf-tool");
     parser.add_argument("-v", "--vcd-trace").help("input VCD file path");
     parser.add_argument("-t", "--surf-trace").help("input Surf file path");
+    parser.add_argument("-f", "--follow")
+        .help("follow a VCD that is still being written, re-rendering it as it grows");
+    parser.add_argument("-S", "--vcd-stream")
+        .help("input VCD read incrementally from a pipe or decompressor, - for stdin (needs -o)");
+    parser.add_argument("-R", "--reader")
+        .implicit_value(std::string{"io_uring"})
+        .help("read the --vcd-trace or --vcd-stream file with large async reads instead of "
+              "mapping it: pread or io_uring");
     parser.add_argument("-d", "--dump")
         .default_value(false)
         .implicit_value(true)
@@ -35,11 +46,53 @@ int main(int argc, const char **argv) {
         .default_value((uint32_t)128)
         .scan<'i', uint32_t>()
         .help("render height (pixels)");
+    parser.add_argument("-j", "--threads")
+        .default_value((uint32_t)0)
+        .scan<'i', uint32_t>()
+        .help("VCD parser, pyramid and render threads (0 for one per core)");
+    parser.add_argument("-m", "--map-policy")
+        .default_value(std::string{"normal"})
+        .help("VCD mapping policy: normal, sequential, random or huge_pages");
+    parser.add_argument("-p", "--parse")
+        .default_value(false)
+        .implicit_value(true)
+        .help("parse VCD value changes and report throughput");
+    parser.add_argument("-o", "--output")
+        .help("convert the VCD input to a Surf trace at this path");
+    parser.add_argument("-z", "--zstd")
+        .implicit_value(3)
+        .scan<'i', int>()
+        .help("zstd compress the converted Surf trace (level)");
     parser.add_argument("-l", "--loop")
         .default_value(false)
         .implicit_value(true)
         .help("loop for testing");
 
+    argparse::ArgumentParser find_cmd("find");
+    find_cmd.add_description("print the ticks at which a condition over the --vcd-trace signals "
+                             "holds, e.g. \"top.valid && top.addr == 0x4000\" or "
+                             "\"isx(top.data)\"");
+    find_cmd.add_argument("expr").help("condition to search for");
+    find_cmd.add_argument("-f", "--from")
+        .scan<'i', uint64_t>()
+        .help("tick to search from, inclusive going forward (default: the start, or the end "
+              "with --backward)");
+    find_cmd.add_argument("-b", "--backward")
+        .default_value(false)
+        .implicit_value(true)
+        .help("search towards earlier ticks");
+    find_cmd.add_argument("-n", "--limit")
+        .default_value((uint32_t)10)
+        .scan<'i', uint32_t>()
+        .help("stop after this many matches (0 for all)");
+    parser.add_subparser(find_cmd);
+
+    argparse::ArgumentParser pyramid_cmd("pyramid");
+    pyramid_cmd.add_description("build the render summary pyramid of the --vcd-trace or "
+                                "--surf-trace input and save it next to it as <input>.pyr, VCD "
+                                "renders pick it up from there");
+    parser.add_subparser(pyramid_cmd);
+
     try {
         parser.parse_args(argc, argv);
     } catch (const std::runtime_error &err) {
@@ -49,17 +102,173 @@ int main(int argc, const char **argv) {
 
     fmt::print("cwd is: {}\n", std::filesystem::current_path());
 
+    if (parser.is_subcommand_used(find_cmd) && !parser.present("--vcd-trace")) {
+        fmt::print(stderr, "find needs a --vcd-trace, Surf traces don't keep the scope tree.\n");
+        return -2;
+    }
+    if (parser.is_subcommand_used(pyramid_cmd) && !parser.present("--vcd-trace") &&
+        !parser.present("--surf-trace")) {
+        fmt::print(stderr, "pyramid needs a --vcd-trace or --surf-trace.\n");
+        return -2;
+    }
+
+    if (const auto follow_path = parser.present("--follow")) {
+        VCDFollower follower{*follow_path};
+        while (true) {
+            if (!follower.follow(std::chrono::seconds{1}) || !follower.has_declarations()) {
+                continue;
+            }
+            fmt::print("followed to {}\n", follower.end());
+            if (const auto png_path = parser.present("--render")) {
+                Renderer{follower.columns(), parser.get<uint32_t>("--threads")}.render(
+                    follower.start(), follower.end(), parser.get<uint32_t>("--width"),
+                    parser.get<uint32_t>("--height"), *png_path);
+            }
+        }
+    }
+
     std::shared_ptr<Trace> trace;
+    std::optional<VCDFile> vcd_file;
+    const auto writer_options = [&] {
+        TraceWriterOptions options;
+        if (const auto zstd_level = parser.present<int>("--zstd")) {
+            options.compress   = true;
+            options.zstd_level = *zstd_level;
+        }
+        return options;
+    };
 
     if (const auto vcd_path = parser.present("--vcd-trace")) {
-        VCDFile vcd_trace(*vcd_path);
+        const auto map_policy =
+            magic_enum::enum_cast<MapPolicy>(parser.get<std::string>("--map-policy"));
+        if (!map_policy) {
+            fmt::print(stderr, "Unknown map policy '{:s}'.\n",
+                       parser.get<std::string>("--map-policy"));
+            return -2;
+        }
+        std::optional<ChunkedFileReader::Backend> reader_backend;
+        if (const auto backend_name = parser.present("--reader")) {
+            reader_backend = magic_enum::enum_cast<ChunkedFileReader::Backend>(*backend_name);
+            if (!reader_backend) {
+                fmt::print(stderr, "Unknown reader backend '{:s}'.\n", *backend_name);
+                return -2;
+            }
+        }
+        auto &vcd_trace =
+            reader_backend
+                ? vcd_file.emplace(*vcd_path, parser.get<uint32_t>("--threads"),
+                                   ChunkedFileReader::Options{.backend = *reader_backend})
+                : vcd_file.emplace(*vcd_path, parser.get<uint32_t>("--threads"), *map_policy);
+        fmt::print("vcd time: {} to {}\n", vcd_trace.start(), vcd_trace.end());
+        if (parser.is_subcommand_used(find_cmd)) {
+            const auto &cols    = vcd_trace.columns();
+            const auto backward = find_cmd.get<bool>("--backward");
+            const SignalSearch search{find_cmd.get<std::string>("expr"),
+                                      vcd_trace.declarations(), cols};
+            const auto limit        = find_cmd.get<uint32_t>("--limit");
+            const auto from         = find_cmd.present<uint64_t>("--from").value_or(
+                backward ? cols.end() + 1 : cols.start());
+            const auto search_start = std::chrono::steady_clock::now();
+            std::optional<uint64_t> tick;
+            if (backward) {
+                tick = search.prev(from);
+            } else {
+                tick = search.holds_at(from) ? std::optional{from} : search.next(from);
+            }
+            uint32_t num_found = 0;
+            for (; tick && (!limit || num_found < limit);
+                 tick = backward ? search.prev(*tick) : search.next(*tick)) {
+                fmt::print("{:d} ({:g} s)\n", *tick,
+                           Time::ticks_to_seconds(*tick, vcd_trace.timebase_power()));
+                ++num_found;
+            }
+            const std::chrono::duration<double> search_dur =
+                std::chrono::steady_clock::now() - search_start;
+            fmt::print("found {:d} matches in {:.3f} s\n", num_found, search_dur.count());
+            return 0;
+        }
+        if (parser.is_subcommand_used(pyramid_cmd)) {
+            auto pyr_path = vcd_trace.path();
+            pyr_path += ".pyr";
+            SignalPyramids::build(vcd_trace.columns(), parser.get<uint32_t>("--threads"))
+                .save(pyr_path);
+            fmt::print("saved {}\n", pyr_path);
+            return 0;
+        }
+        if (parser.get<bool>("--parse")) {
+            const auto parse_start = std::chrono::steady_clock::now();
+            const auto &sim_cmds   = vcd_trace.sim_cmds();
+            const std::chrono::duration<double> parse_dur =
+                std::chrono::steady_clock::now() - parse_start;
+            fmt::print("parsed {:d} sim cmds in {:.3f} s ({:.1f} MB/s)\n", sim_cmds.size(),
+                       parse_dur.count(),
+                       vcd_trace.sim_cmds_string_view().size() / parse_dur.count() /
+                           (1024 * 1024));
+        }
         // vcd_trace.parse_test();
         // return 0;
-        trace = vcd_trace.surf_trace();
+        if (const auto out_path = parser.present("--output")) {
+            TraceWriter::write_document(vcd_trace.document(), vcd_trace.timebase_power(),
+                                        *out_path, writer_options());
+            trace = std::make_shared<Trace>(*out_path);
+        } else {
+            trace = vcd_trace.surf_trace();
+        }
         fmt::print("trace: {}\n", *trace);
+    } else if (const auto stream_path = parser.present("--vcd-stream")) {
+        const auto out_path = parser.present("--output");
+        if (!out_path) {
+            fmt::print(stderr, "--vcd-stream needs an --output Surf trace path.\n");
+            return -2;
+        }
+        const auto convert = [&](VCDStream &stream) {
+            TraceWriter writer{*out_path, stream.timebase_power(),
+                               TraceWriter::signals_from_declarations(stream.declarations()),
+                               writer_options()};
+            stream.run([&](std::span<const VCDTypes::SimCmd> cmds,
+                           std::span<const VarBitArena> arenas) {
+                writer.add_sim_cmds(cmds, arenas);
+            });
+            writer.finish();
+            fmt::print("streamed {:d} bytes\n", stream.bytes_read());
+        };
+        const auto is_stdin = *stream_path == "-";
+        if (const auto reader_backend = parser.present("--reader"); reader_backend && !is_stdin) {
+            const auto backend = magic_enum::enum_cast<ChunkedFileReader::Backend>(*reader_backend);
+            if (!backend) {
+                fmt::print(stderr, "Unknown reader backend '{:s}'.\n", *reader_backend);
+                return -2;
+            }
+            ChunkedFileReader reader{*stream_path, {.backend = *backend}};
+            fmt::print("reading with {:s}\n", magic_enum::enum_name(reader.backend()));
+            VCDStream stream{reader};
+            convert(stream);
+        } else {
+            const auto fd = is_stdin ? STDIN_FILENO : open(stream_path->c_str(), O_RDONLY);
+            if (fd < 0) {
+                fmt::print(stderr, "Opening '{:s}' failed: {:s}\n", *stream_path,
+                           strerror(errno));
+                return -2;
+            }
+            VCDStream stream{fd, *stream_path};
+            convert(stream);
+            if (!is_stdin) {
+                close(fd);
+            }
+        }
+        trace = std::make_shared<Trace>(*out_path);
     } else {
         if (const auto surf_path = parser.present("--surf-trace")) {
             trace = std::make_shared<Trace>(*surf_path);
+            if (parser.is_subcommand_used(pyramid_cmd)) {
+                auto pyr_path = trace->path();
+                pyr_path += ".pyr";
+                SignalPyramids::build(SignalColumns::from_trace(*trace),
+                                      parser.get<uint32_t>("--threads"))
+                    .save(pyr_path);
+                fmt::print("saved {}\n", pyr_path);
+                return 0;
+            }
         } else {
             fmt::print(stderr, "Missing input trace (VCD or Surf) file.\n");
             return -2;
@@ -83,28 +292,53 @@ int main(int argc, const char **argv) {
 
     ASSERT(trace);
 
-    if (parser.present("--start")) {
+    // ticks as an integer, seconds as a double rounded to the nearest tick at the timebase
+    const auto parse_time = [&](const std::string &str) -> std::optional<Time> {
+        const auto *end = str.data() + str.size();
         if (use_ticks) {
-            start_time = Time(parser.get<uint64_t>("--start"), trace->timebase_power());
-        } else {
-            start_time = Time(parser.get<double>("--start"), trace->timebase_power());
+            uint64_t ticks{};
+            if (const auto res = std::from_chars(str.data(), end, ticks);
+                res.ec != std::errc{} || res.ptr != end) {
+                return std::nullopt;
+            }
+            return Time{ticks, trace->timebase_power()};
         }
-    } else {
-        start_time = trace->start();
-    }
-    if (parser.present("--end")) {
-        if (use_ticks) {
-            end_time = Time(parser.get<uint64_t>("--end"), trace->timebase_power());
-        } else {
-            end_time = Time(parser.get<double>("--end"), trace->timebase_power());
+        double seconds{};
+        if (const auto res = std::from_chars(str.data(), end, seconds);
+            res.ec != std::errc{} || res.ptr != end) {
+            return std::nullopt;
+        }
+        try {
+            return Time{Time::seconds_to_ticks(seconds, trace->timebase_power()),
+                        trace->timebase_power()};
+        } catch (const std::range_error &) {
+            return std::nullopt;
+        }
+    };
+    start_time = trace->start();
+    end_time   = trace->end();
+    for (const auto &[arg, time] : {std::pair{"--start", &start_time}, {"--end", &end_time}}) {
+        if (const auto str = parser.present(arg)) {
+            const auto parsed = parse_time(*str);
+            if (!parsed) {
+                fmt::print(stderr, "{:s} '{:s}' is not a time in {:s}.\n", arg, *str,
+                           use_ticks ? "ticks" : "seconds");
+                return -2;
+            }
+            *time = *parsed;
         }
-    } else {
-        end_time = trace->end();
     }
 
     if (const auto png_path = parser.present("--render")) {
-        Renderer renderer(*trace);
-        renderer.render(start_time, end_time, width, height, *png_path);
+        if (vcd_file) {
+            // zoomed out renders read the pyramid, loaded from <input>.pyr when it is current
+            Renderer renderer(vcd_file->columns(), vcd_file->pyramids(),
+                              parser.get<uint32_t>("--threads"));
+            renderer.render(start_time, end_time, width, height, *png_path);
+        } else {
+            Renderer renderer(*trace, parser.get<uint32_t>("--threads"));
+            renderer.render(start_time, end_time, width, height, *png_path);
+        }
     }
 
     fmt::print("hello from surf-tool\n");
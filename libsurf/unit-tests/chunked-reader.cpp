@@ -0,0 +1,97 @@
+#include <surf/surf.h>
+using namespace surf;
+namespace fs = std::filesystem;
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <fstream>
+#include <unistd.h>
+
+#define TS "[ChunkedFileReader]"
+
+namespace {
+
+fs::path write_temp(std::string_view name, std::string_view contents) {
+    const auto path =
+        fs::temp_directory_path() / fmt::format("surf-unit-test-{:s}-{:d}", name, getpid());
+    std::ofstream{path} << contents;
+    return path;
+}
+
+}; // namespace
+
+TEST_CASE("chunks", TS) {
+    std::string contents;
+    for (size_t i = 0; contents.size() < 10 * ChunkedFileReader::alignment + 123; ++i) {
+        contents += fmt::format("#{:d}\nb{:b} #a\n", i, i);
+    }
+    const auto path = write_temp("chunks.vcd", contents);
+    for (const auto backend :
+         {ChunkedFileReader::Backend::pread, ChunkedFileReader::Backend::io_uring}) {
+        for (const uint32_t queue_depth : {1, 3}) {
+            for (const bool direct : {false, true}) {
+                INFO("queue depth " << queue_depth << " direct " << direct);
+                ChunkedFileReader reader{path, {.chunk_size  = 3000,
+                                                .queue_depth = queue_depth,
+                                                .backend     = backend,
+                                                .direct      = direct}};
+                REQUIRE(reader.chunk_size() == ChunkedFileReader::alignment);
+                REQUIRE(reader.size() == contents.size());
+                std::string read;
+                for (auto chunk = reader.next(); !chunk.data.empty(); chunk = reader.next()) {
+                    REQUIRE(chunk.offset == read.size());
+                    REQUIRE(chunk.data.size() <= reader.chunk_size());
+                    read += chunk.data;
+                }
+                REQUIRE(read == contents);
+                // stays at the end
+                REQUIRE(reader.next().data.empty());
+            }
+        }
+    }
+    fs::remove(path);
+    REQUIRE_THROWS_AS(ChunkedFileReader{path}, std::system_error);
+}
+
+#if defined(__linux__)
+TEST_CASE("no fd leak when setup throws", TS) {
+    const auto path    = write_temp("setup.vcd", "#0\n");
+    const auto num_fds = [] {
+        const auto it = fs::directory_iterator{"/proc/self/fd"};
+        return std::distance(fs::begin(it), fs::end(it));
+    };
+    const auto fds_before = num_fds();
+    for (const auto backend :
+         {ChunkedFileReader::Backend::pread, ChunkedFileReader::Backend::io_uring}) {
+        // the file and ring are set up before the buffers fail to allocate
+        REQUIRE_THROWS_AS((ChunkedFileReader{path, {.chunk_size  = size_t{1} << 60,
+                                                    .queue_depth = 2,
+                                                    .backend     = backend}}),
+                          std::bad_alloc);
+        REQUIRE(num_fds() == fds_before);
+    }
+    fs::remove(path);
+}
+#endif
+
+TEST_CASE("vcd stream", TS) {
+    const std::string header =
+        "$timescale 1ns $end\n$scope module top $end\n$var wire 1 ! clk $end\n"
+        "$var wire 12 #a bus $end\n$upscope $end\n$enddefinitions $end\n";
+    std::string body;
+    for (uint64_t tick = 0; tick < 1000; ++tick) {
+        body += fmt::format("#{:d}\n{:d}!\nb{:b} #a\n", tick * 5, tick % 2, tick * 13 % 4096);
+    }
+    const auto path = write_temp("stream.vcd", header + body);
+    ChunkedFileReader reader{path, {.chunk_size = 1}};
+    VCDStream stream{reader};
+    REQUIRE(stream.declarations().signals.size() == 2);
+    size_t num_cmds = 0;
+    stream.run([&](std::span<const VCDTypes::SimCmd> cmds, std::span<const VarBitArena>) {
+        num_cmds += cmds.size();
+    });
+    REQUIRE(stream.bytes_read() == header.size() + body.size());
+    REQUIRE(num_cmds == 3000);
+    fs::remove(path);
+}
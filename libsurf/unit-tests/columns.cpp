@@ -0,0 +1,177 @@
+#include <surf/surf.h>
+using namespace surf;
+using namespace VCDTypes;
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <thread>
+
+#define TS "[SignalColumns]"
+
+static uint16_t bits_u16(bitview bv) {
+    uint16_t res{};
+    memcpy(&res, bv.data(), bv.bytesize());
+    return res;
+}
+
+TEST_CASE("transpose", TS) {
+    Document doc;
+    doc.declarations.signals = {{1, VarType::wire}, {12, VarType::reg}, {64, VarType::real}};
+    doc.sim_cmds             = {
+        Change{ScalarValue{'x'}, 0},
+        Tick{10},
+        Change{ScalarValue{'1'}, 0},
+        Change{BinaryNum{0xabc}, 1},
+        Change{RealNum{1.5}, 2},
+        Tick{20},
+        Change{ScalarValue{'z'}, 0},
+        Tick{30},
+        Change{ScalarValue{'0'}, 0},
+        Change{BinaryNum{0xfff}, 1},
+    };
+    const auto cols = SignalColumns::from_document(doc);
+    REQUIRE(cols.size() == 3);
+    REQUIRE(cols.start() == 10);
+    REQUIRE(cols.end() == 30);
+
+    const auto &scalar = cols[0];
+    REQUIRE(scalar.kind() == SignalKind::scalar);
+    REQUIRE(scalar.ticks() == std::vector<uint64_t>{0, 10, 20, 30});
+    REQUIRE(scalar.logic(0) == Logic::vX);
+    REQUIRE(scalar.logic(1) == Logic::v1);
+    REQUIRE(scalar.logic(2) == Logic::vZ);
+    REQUIRE(scalar.logic(3) == Logic::v0);
+    REQUIRE(scalar.index_at(25) == 2);
+    REQUIRE(scalar.index_range(10, 20) == std::pair<size_t, size_t>{1, 3});
+
+    const auto &vec = cols[1];
+    REQUIRE(vec.kind() == SignalKind::vector);
+    REQUIRE(vec.size() == 2);
+    REQUIRE(bits_u16(vec.bits(0)) == 0xabc);
+    REQUIRE(bits_u16(vec.bits(1)) == 0xfff);
+    REQUIRE(!vec.index_at(5));
+
+    REQUIRE(cols[2].kind() == SignalKind::real);
+    REQUIRE(cols[2].real(0) == 1.5);
+}
+
+TEST_CASE("backwards", TS) {
+    Document doc;
+    doc.declarations.signals = {{1, VarType::wire}};
+    doc.sim_cmds             = {Tick{10}, Change{ScalarValue{'1'}, 0}, Tick{5}};
+    REQUIRE_THROWS_AS(SignalColumns::from_document(doc), std::domain_error);
+}
+
+TEST_CASE("queries", TS) {
+    Document doc;
+    doc.declarations.signals = {{1, VarType::wire}, {12, VarType::reg}};
+    for (uint64_t tick = 10; tick <= 1000; tick += 10) {
+        doc.sim_cmds.emplace_back(Tick{tick});
+        doc.sim_cmds.emplace_back(Change{ScalarValue{tick % 20 ? '1' : '0'}, 0});
+        if (tick % 100 == 0) {
+            doc.sim_cmds.emplace_back(Change{BinaryNum{tick}, 1});
+        }
+    }
+    const auto cols = SignalColumns::from_document(doc);
+
+    REQUIRE(!cols.value_at(0, 5));
+    REQUIRE(cols.value_at(0, 10)->tick() == 10);
+    REQUIRE(cols.value_at(0, 10)->logic() == Logic::v1);
+    REQUIRE(cols.value_at(0, 29)->logic() == Logic::v0);
+    REQUIRE(cols.value_at(0, 5000)->tick() == 1000);
+    REQUIRE(bits_u16(cols.value_at(1, 250)->bits()) == 200);
+
+    REQUIRE(cols.next_change(0, 5)->tick() == 10);
+    REQUIRE(cols.next_change(0, 10)->tick() == 20);
+    REQUIRE(cols.next_change(1, 101)->tick() == 200);
+    REQUIRE(!cols.next_change(1, 1000));
+    REQUIRE(cols.prev_change(0, 20)->tick() == 10);
+    REQUIRE(cols.prev_change(0, 21)->tick() == 20);
+    REQUIRE(!cols.prev_change(0, 10));
+    REQUIRE(cols.prev_change(1, 1000)->index() == 8);
+
+    const auto range = cols.changes_in(1, 150, 450);
+    REQUIRE(range.size() == 3);
+    std::vector<uint64_t> ticks;
+    for (const auto change : range) {
+        ticks.emplace_back(change.tick());
+        REQUIRE(bits_u16(change.bits()) == change.tick());
+    }
+    REQUIRE(ticks == std::vector<uint64_t>{200, 300, 400});
+    REQUIRE(cols.changes_in(0, 11, 19).empty());
+    REQUIRE(cols.changes_in(0, 0, 2000).size() == 100);
+
+    // read only, so any number of threads can query at once
+    std::vector<std::thread> threads;
+    std::atomic<size_t> num_bad{};
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for (uint64_t tick = (uint64_t)t; tick < 1010; tick += 3) {
+                const auto change = cols.value_at(0, tick);
+                if (tick >= 10 && (!change || change->tick() != tick / 10 * 10)) {
+                    ++num_bad;
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    REQUIRE(num_bad == 0);
+}
+
+TEST_CASE("edges", TS) {
+    Document doc;
+    doc.declarations.signals = {{1, VarType::wire}, {64, VarType::real}};
+    // rewrites of the same value are changes but not edges
+    const std::string logics = "0011101100";
+    for (size_t i = 0; i < logics.size(); ++i) {
+        doc.sim_cmds.emplace_back(Tick{i * 10});
+        doc.sim_cmds.emplace_back(Change{ScalarValue{logics[i]}, 0});
+        doc.sim_cmds.emplace_back(Change{RealNum{i < 5 ? 1.0 : 2.0}, 1});
+    }
+    const auto cols = SignalColumns::from_document(doc);
+    const auto &col = cols[0];
+    for (size_t i = 0; i < logics.size(); ++i) {
+        REQUIRE(col.is_edge(i) == (!i || logics[i] != logics[i - 1]));
+    }
+    REQUIRE(col.edges().num_ones() == 5);
+    REQUIRE(col.num_edges(1, 4) == 1);
+    REQUIRE(cols.edges_in(0, 0, 90) == 5);
+    REQUIRE(cols.edges_in(0, 25, 65) == 2);
+    REQUIRE(cols.edges_in(1, 0, 90) == 2);
+    REQUIRE(cols.next_edge(0, 0)->tick() == 20);
+    REQUIRE(cols.next_edge(0, 20)->tick() == 50);
+    REQUIRE(!cols.next_edge(0, 80));
+    REQUIRE(cols.prev_edge(0, 50)->tick() == 20);
+    REQUIRE(cols.prev_edge(0, 51)->tick() == 50);
+    REQUIRE(!cols.prev_edge(0, 0));
+    REQUIRE(cols.next_edge(1, 0)->tick() == 50);
+}
+
+TEST_CASE("x and z bits", TS) {
+    Document doc;
+    doc.declarations.signals = {{8, VarType::wire}};
+    doc.sim_cmds             = {
+        Change{BinaryNum::from_digits("x"), 0},
+        Tick{10},
+        Change{BinaryNum::from_digits("10z1"), 0},
+        Tick{20},
+        Change{BinaryNum{3}, 0},
+        Tick{30},
+        Change{ScalarValue{'z'}, 0},
+    };
+    const auto cols = SignalColumns::from_document(doc);
+    const auto &vec = cols[0];
+    REQUIRE(vec.size() == 4);
+    // a leading x or z fills the upper bits
+    REQUIRE(bits_u16(*vec.xz(0)) == 0xff);
+    REQUIRE(bits_u16(vec.bits(0)) == 0xff);
+    REQUIRE(bits_u16(*vec.xz(1)) == 0x02);
+    REQUIRE(bits_u16(vec.bits(1)) == 0x09);
+    REQUIRE(!vec.xz(2));
+    REQUIRE(bits_u16(*vec.xz(3)) == 0xff);
+    REQUIRE(bits_u16(vec.bits(3)) == 0x00);
+    REQUIRE(vec.num_edges(0, vec.size()) == 4);
+}
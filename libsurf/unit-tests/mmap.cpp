@@ -0,0 +1,44 @@
+#include <surf/surf.h>
+using namespace surf;
+namespace fs = std::filesystem;
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <fstream>
+#include <unistd.h>
+
+#define TS "[MappedReadOnlyFile]"
+
+TEST_CASE("policies", TS) {
+    const auto path =
+        fs::temp_directory_path() / fmt::format("surf-unit-test-mmap-{:d}.bin", getpid());
+    std::string contents;
+    for (size_t i = 0; contents.size() < 3 * MappedReadOnlyFile::readahead_window / 16; ++i) {
+        contents += fmt::format("#{:d}\n1!\n", i);
+    }
+    std::ofstream{path} << contents;
+
+    for (const auto policy : magic_enum::enum_values<MapPolicy>()) {
+        INFO("policy: " << magic_enum::enum_name(policy));
+        MappedReadOnlyFile file{path, policy};
+        REQUIRE(file.policy() == policy);
+        REQUIRE(file.string_view() == contents);
+        REQUIRE(file.data()[file.size()] == '\0');
+        // dropped pages read back the same
+        file.advance(file.size() / 2);
+        file.advance(file.size() / 4);
+        REQUIRE(file.string_view() == contents);
+        file.advance(file.size() + 1);
+        REQUIRE(file.string_view() == contents);
+    }
+
+    // destroyed while the prefetch may still be running
+    for (int i = 0; i < 4; ++i) {
+        MappedReadOnlyFile file{path};
+        file.prefetch_async();
+        file.prefetch_async();
+        REQUIRE(file.string_view().substr(0, 3) == "#0\n");
+    }
+    fs::remove(path);
+}
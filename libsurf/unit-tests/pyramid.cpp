@@ -0,0 +1,93 @@
+#include <surf/surf.h>
+using namespace surf;
+using namespace VCDTypes;
+namespace fs = std::filesystem;
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <fstream>
+
+#include <unistd.h>
+
+#define TS "[SignalPyramid]"
+
+static SignalColumns clock_columns() {
+    Document doc;
+    doc.declarations.signals = {{1, VarType::wire}, {8, VarType::reg}, {1, VarType::wire}};
+    for (uint64_t tick = 0; tick < 1024; ++tick) {
+        doc.sim_cmds.emplace_back(Tick{tick});
+        doc.sim_cmds.emplace_back(Change{ScalarValue{tick & 1 ? '1' : '0'}, 0});
+        doc.sim_cmds.emplace_back(Change{BinaryNum{tick % 3}, 1});
+    }
+    doc.sim_cmds.emplace_back(Change{ScalarValue{'x'}, 2});
+    return SignalColumns::from_document(doc);
+}
+
+TEST_CASE("pyramid levels", TS) {
+    const auto cols = clock_columns();
+    const auto clk  = SignalPyramid::build(cols[0]);
+    REQUIRE(!clk.levels().empty());
+    // one change per tick, so 4 tick buckets are the first to average 4 changes
+    REQUIRE(clk.levels().front().shift == 2);
+    REQUIRE(clk.levels().back().buckets.size() == 1);
+    const auto &top = clk.levels().back().buckets.front();
+    REQUIRE(top.num_changes == 1024);
+    REQUIRE(top.first_change == 0);
+    REQUIRE(top.logic_mask == 0b11);
+
+    const auto &level = *clk.level_for(64);
+    REQUIRE(level.bucket_ticks() == 64);
+    const auto &bucket = level.buckets[level.lower_bound(130)];
+    REQUIRE(bucket.bucket == 2);
+    REQUIRE(bucket.first_change == 128);
+    REQUIRE(bucket.num_changes == 64);
+    REQUIRE(!clk.level_for(2));
+
+    const auto bus = SignalPyramid::build(cols[1]);
+    REQUIRE(bus.levels().front().buckets.front().num_seen == 3);
+
+    // a single change doesn't get a summary
+    REQUIRE(SignalPyramid::build(cols[2]).levels().empty());
+}
+
+TEST_CASE("save load", TS) {
+    const auto pyramids = SignalPyramids::build(clock_columns(), 2);
+    const auto path =
+        fs::temp_directory_path() / fmt::format("surf-unit-test-{:d}.pyr", getpid());
+    pyramids.save(path);
+    const auto loaded = SignalPyramids::load(path);
+    fs::remove(path);
+    REQUIRE_NOTHROW(loaded.check(clock_columns()));
+    REQUIRE(loaded.size() == 3);
+    REQUIRE(loaded[0].levels().size() == pyramids[0].levels().size());
+    REQUIRE(loaded[1].levels().back().buckets.front().num_changes == 1024);
+}
+
+TEST_CASE("corrupt pyramid files", TS) {
+    const auto cols = clock_columns();
+    const auto path =
+        fs::temp_directory_path() / fmt::format("surf-unit-test-{:d}.pyr", getpid());
+    SignalPyramids::build(cols, 2).save(path);
+    std::vector<uint8_t> good(fs::file_size(path));
+    {
+        std::ifstream in{path, std::ios::binary};
+        in.read((char *)good.data(), (std::streamsize)good.size());
+    }
+    const auto load_patched = [&](size_t off, uint64_t val) {
+        auto buf = good;
+        std::memcpy(buf.data() + off, &val, sizeof(val));
+        std::ofstream{path, std::ios::binary}.write((const char *)buf.data(),
+                                                   (std::streamsize)buf.size());
+        return SignalPyramids::load(path);
+    };
+    // counts past the end of the file throw before anything is allocated
+    REQUIRE_THROWS_AS(load_patched(8, UINT64_MAX), std::domain_error);
+    REQUIRE_THROWS_AS(load_patched(16, UINT64_C(1) << 60), std::domain_error);
+    REQUIRE_THROWS_AS(load_patched(24, UINT64_MAX / 2), std::domain_error);
+    // a well formed file whose first bucket points past the column
+    const auto stale = load_patched(24 + 16 + 8, 1u << 20);
+    REQUIRE_THROWS_AS(stale.check(cols), std::domain_error);
+    // or whose bucket doesn't hold its changes' ticks
+    REQUIRE_THROWS_AS(load_patched(24 + 16, 12345).check(cols), std::domain_error);
+    fs::remove(path);
+}
@@ -0,0 +1,46 @@
+#include <surf/surf.h>
+using namespace surf;
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <random>
+
+#define TS "[RankSelect]"
+
+TEST_CASE("against naive", TS) {
+    std::mt19937_64 rng{42};
+    // dense, sparse and runs long enough to cross whole blocks
+    for (const double density : {0.5, 0.01, 0.999}) {
+        INFO("density " << density);
+        std::bernoulli_distribution dist{density};
+        RankSelect rs;
+        std::vector<bool> bits;
+        for (size_t i = 0; i < 3 * RankSelect::block_bits + 77; ++i) {
+            const bool bit = dist(rng);
+            bits.push_back(bit);
+            rs.push_back(bit);
+        }
+        REQUIRE(rs.size() == bits.size());
+        size_t rank = 0;
+        for (size_t pos = 0; pos <= bits.size(); ++pos) {
+            REQUIRE(rs.rank1(pos) == rank);
+            if (pos == bits.size()) {
+                break;
+            }
+            REQUIRE(rs[pos] == bits[pos]);
+            if (bits[pos]) {
+                REQUIRE(rs.select1(rank) == pos);
+                ++rank;
+            }
+        }
+        REQUIRE(rs.num_ones() == rank);
+        REQUIRE(rs.count1(100, 5000) == rs.rank1(5000) - rs.rank1(100));
+        REQUIRE_THROWS_AS(rs.select1(rank), std::out_of_range);
+        // a few percent over the raw bits
+        REQUIRE(rs.memory_bytes() < bits.size() / CHAR_BIT * 106 / 100);
+    }
+
+    RankSelect empty;
+    REQUIRE(empty.rank1(0) == 0);
+    REQUIRE_THROWS_AS(empty.select1(0), std::out_of_range);
+}
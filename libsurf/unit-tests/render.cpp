@@ -0,0 +1,132 @@
+#include <surf/surf.h>
+using namespace surf;
+using namespace VCDTypes;
+
+#include <catch2/catch_test_macros.hpp>
+
+#define TS "[Renderer]"
+
+TEST_CASE("pixel classes", TS) {
+    Document doc;
+    doc.declarations.signals = {{1, VarType::wire}};
+    doc.sim_cmds             = {
+        Tick{0},  Change{ScalarValue{'0'}, 0}, Tick{25}, Change{ScalarValue{'1'}, 0},
+        Tick{50}, Change{ScalarValue{'0'}, 0}, Tick{52}, Change{ScalarValue{'1'}, 0},
+        Tick{80}, Change{ScalarValue{'x'}, 0},
+    };
+    const auto cols = SignalColumns::from_document(doc);
+    const Renderer renderer{cols};
+    // 10 ticks per pixel, 8 rows so the lane has a 1 pixel margin: hi row 1, lo row 6
+    const uint32_t width = 10;
+    const auto fb        = renderer.render_rgba(Time{uint64_t{0}, -9}, Time{uint64_t{99}, -9},
+                                                width, 8);
+    const auto px        = [&](uint32_t x, uint32_t y) {
+        return fb[y * width + x];
+    };
+    REQUIRE(px(0, 0) == Renderer::bg_color);
+    // steady 0
+    REQUIRE(px(1, 6) == Renderer::value_color);
+    REQUIRE(px(1, 1) == Renderer::bg_color);
+    // single rising edge
+    REQUIRE(px(2, 1) == Renderer::value_color);
+    REQUIRE(px(2, 4) == Renderer::value_color);
+    // steady 1
+    REQUIRE(px(3, 1) == Renderer::value_color);
+    REQUIRE(px(3, 6) == Renderer::bg_color);
+    // two changes in one pixel
+    REQUIRE(px(5, 3) == Renderer::toggle_color);
+    // X after the last edge
+    REQUIRE(px(9, 3) == Renderer::x_color);
+
+    // a change right at the start is an edge of the first pixel if it changes the value
+    const auto at_edge = renderer.render_rgba(Time{uint64_t{25}, -9}, Time{uint64_t{124}, -9},
+                                              width, 8);
+    REQUIRE(at_edge[3 * width] == Renderer::value_color);
+    REQUIRE(at_edge[3 * width + 1] == Renderer::bg_color);
+}
+
+TEST_CASE("tiles match a serial render", TS) {
+    Document doc;
+    for (uint32_t sig = 0; sig < 40; ++sig) {
+        doc.declarations.signals.push_back({1, VarType::wire});
+    }
+    uint32_t lfsr = 0xACE1u;
+    for (uint64_t tick = 0; tick < 4000; ++tick) {
+        doc.sim_cmds.emplace_back(Tick{tick});
+        for (uint32_t sig = 0; sig < 40; ++sig) {
+            lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+            if (lfsr % (sig + 2) == 0) {
+                doc.sim_cmds.emplace_back(Change{ScalarValue{lfsr & 2 ? '1' : '0'}, sig});
+            }
+        }
+    }
+    const auto cols       = SignalColumns::from_document(doc);
+    const uint64_t start  = 3;
+    const uint64_t end    = 3998;
+    const uint32_t width  = Renderer::tile_width * 3 + 17;
+    const uint32_t lane_h = 5;
+    const auto height     = 40 * lane_h;
+    const auto fb         = Renderer{cols, 4}.render_rgba(Time{start, -9}, Time{end, -9}, width,
+                                                          height);
+    REQUIRE(fb == Renderer{cols, 1}.render_rgba(Time{start, -9}, Time{end, -9}, width, height));
+    // the middle row of a lane only shows edges, count them the slow way, changes to the same
+    // value don't count
+    const auto span = end - start + 1;
+    for (uint32_t sig = 0; sig < 40; ++sig) {
+        const auto &col   = cols[sig];
+        const auto &ticks = col.ticks();
+        for (uint32_t x = 0; x < width; ++x) {
+            const auto px_start = start + span * x / width;
+            const auto px_end   = start + span * (x + 1) / width;
+            size_t num          = 0;
+            for (size_t i = 0; i < ticks.size(); ++i) {
+                num += ticks[i] >= px_start && ticks[i] < px_end &&
+                       (!i || col.logic(i) != col.logic(i - 1));
+            }
+            const auto px = fb[(sig * lane_h + lane_h / 2) * width + x];
+            if (num >= 2) {
+                REQUIRE(px == Renderer::toggle_color);
+            } else if (num == 1) {
+                REQUIRE(px == Renderer::value_color);
+            } else {
+                REQUIRE(px == Renderer::bg_color);
+            }
+        }
+    }
+}
+
+TEST_CASE("pyramid render matches a raw render", TS) {
+    Document doc;
+    doc.declarations.signals = {{1, VarType::wire}, {1, VarType::wire}, {8, VarType::reg},
+                                {8, VarType::reg},  {1, VarType::wire}};
+    uint32_t lfsr = 0xACE1u;
+    for (uint64_t tick = 0; tick < 20000; ++tick) {
+        doc.sim_cmds.emplace_back(Tick{tick});
+        lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+        // clock, sparse random scalar, bus with two values, bus with many values
+        doc.sim_cmds.emplace_back(Change{ScalarValue{tick & 1 ? '1' : '0'}, 0});
+        if (lfsr % 7 == 0) {
+            doc.sim_cmds.emplace_back(Change{ScalarValue{"01xz"[lfsr % 4]}, 1});
+        }
+        if (lfsr % 3 == 0) {
+            doc.sim_cmds.emplace_back(Change{BinaryNum{uint64_t{lfsr % 5 == 0}}, 2});
+        }
+        doc.sim_cmds.emplace_back(Change{BinaryNum{uint64_t{lfsr & 0xff}}, 3});
+    }
+    doc.sim_cmds.emplace_back(Change{ScalarValue{'x'}, 4});
+    const auto cols     = SignalColumns::from_document(doc);
+    const auto pyramids = SignalPyramids::build(cols, 2);
+    const Renderer raw{cols, 2};
+    const Renderer pyr{cols, pyramids, 2};
+    // zoomed in past the finest level, at a level and far enough out for the coarsest level
+    for (const auto &[start, end, width] : {std::tuple{uint64_t{100}, uint64_t{500}, 800u},
+                                            std::tuple{uint64_t{0}, uint64_t{19999}, 613u},
+                                            std::tuple{uint64_t{37}, uint64_t{17001}, 1000u},
+                                            std::tuple{uint64_t{0}, uint64_t{30000}, 7u}}) {
+        const Time t0{start, -9};
+        const Time t1{end, -9};
+        REQUIRE(pyr.render_rgba(t0, t1, width, 50) == raw.render_rgba(t0, t1, width, 50));
+    }
+    REQUIRE(pyramids[0].level_for(20000 / 613));
+    REQUIRE(pyramids[3].level_for(16965 / 1000));
+}
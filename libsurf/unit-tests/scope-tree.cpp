@@ -0,0 +1,154 @@
+#include <surf/surf.h>
+using namespace surf;
+using namespace VCDTypes;
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <regex>
+
+#define TS "[ScopeTree]"
+
+namespace {
+
+std::vector<std::string> var_paths(const ScopeTree &tree,
+                                   const std::vector<ScopeTree::index_t> &vars) {
+    std::vector<std::string> res;
+    for (const auto var : vars) {
+        res.emplace_back(tree.var_path(var));
+    }
+    return res;
+}
+
+// top.clk, top.cpu.pc [31:0], top.cpu.alu.a, top.cpu.alu.b, top.mem.a
+ScopeTree small_tree() {
+    ScopeTree tree;
+    const auto top = tree.add_scope(ScopeTree::root, "top", ScopeType::module);
+    tree.add_var(top, {"!", "clk", 1, VarType::wire, 0});
+    const auto cpu = tree.add_scope(top, "cpu", ScopeType::module);
+    tree.add_var(cpu, {"\"", "pc [31:0]", 32, VarType::reg, 1});
+    const auto alu = tree.add_scope(cpu, "alu", ScopeType::module);
+    tree.add_var(alu, {"#", "a", 1, VarType::wire, 2});
+    tree.add_var(alu, {"$", "b", 1, VarType::wire, 3});
+    const auto mem = tree.add_scope(top, "mem", ScopeType::module);
+    tree.add_var(mem, {"%", "a", 1, VarType::wire, 4});
+    return tree;
+}
+
+}; // namespace
+
+TEST_CASE("lookup", TS) {
+    const auto tree = small_tree();
+    REQUIRE(tree.num_scopes() == 5);
+    REQUIRE(tree.num_vars() == 5);
+
+    const auto alu = tree.find_scope("top.cpu.alu");
+    REQUIRE(alu != ScopeTree::invalid);
+    REQUIRE(tree.name(alu) == "alu");
+    REQUIRE(tree.path(alu) == "top.cpu.alu");
+    REQUIRE(tree.type(alu) == ScopeType::module);
+    REQUIRE(tree.name(tree.parent(alu)) == "cpu");
+    REQUIRE(tree.find_scope("") == ScopeTree::root);
+    REQUIRE(tree.find_scope("top.alu") == ScopeTree::invalid);
+    REQUIRE(tree.find_scope("top.cpu.alu.a") == ScopeTree::invalid);
+
+    const auto pc = tree.find_var("top.cpu.pc");
+    REQUIRE(pc != ScopeTree::invalid);
+    REQUIRE(tree.var(pc).sig == 1);
+    REQUIRE(tree.var_path(pc) == "top.cpu.pc");
+    REQUIRE(tree.var_scope(pc) == tree.find_scope("top.cpu"));
+    REQUIRE(tree.var(tree.find_var("top.mem.a")).sig == 4);
+    REQUIRE(tree.var(tree.find_var("top.cpu.alu.a")).sig == 2);
+    REQUIRE(tree.find_var("top.cpu") == ScopeTree::invalid);
+    REQUIRE(tree.find_var("top.cpu.pc [31:0]") == ScopeTree::invalid);
+    REQUIRE(tree.find_var("clk") == ScopeTree::invalid);
+
+    std::vector<std::string_view> names;
+    for (auto var = tree.first_var(alu); var != ScopeTree::invalid; var = tree.next_var(var)) {
+        names.emplace_back(ScopeTree::var_name(tree.var(var)));
+    }
+    REQUIRE(names == std::vector<std::string_view>{"a", "b"});
+    const auto str = fmt::format("{}", tree);
+    REQUIRE(str.find(" alu vars: [<Var ") != std::string::npos);
+    REQUIRE(str.find(" 1 # a>, <Var ") != std::string::npos);
+}
+
+TEST_CASE("reopened scope", TS) {
+    auto tree      = small_tree();
+    const auto top = tree.find_scope("top");
+    const auto cpu = tree.add_scope(top, "cpu", ScopeType::module);
+    const auto irq = tree.add_var(cpu, {"&", "irq", 1, VarType::wire, 5});
+    REQUIRE(cpu == tree.find_scope("top.cpu"));
+    REQUIRE(tree.num_scopes() == 5);
+    REQUIRE(tree.find_var("top.cpu.irq") == irq);
+    REQUIRE(tree.find_var("top.cpu.pc") != ScopeTree::invalid);
+}
+
+TEST_CASE("glob", TS) {
+    using paths     = std::vector<std::string>;
+    const auto tree = small_tree();
+    REQUIRE(var_paths(tree, tree.glob("top.cpu.alu.*")) ==
+            paths{"top.cpu.alu.a", "top.cpu.alu.b"});
+    REQUIRE(var_paths(tree, tree.glob("top.*.a")) == paths{"top.mem.a"});
+    REQUIRE(var_paths(tree, tree.glob("top.**.a")) == paths{"top.cpu.alu.a", "top.mem.a"});
+    REQUIRE(var_paths(tree, tree.glob("**.?")) ==
+            paths{"top.cpu.alu.a", "top.cpu.alu.b", "top.mem.a"});
+    REQUIRE(tree.glob("**").size() == tree.num_vars());
+    REQUIRE(var_paths(tree, tree.glob("t*p.c*")) == paths{"top.clk"});
+    REQUIRE(tree.glob("top.nope.*").empty());
+}
+
+TEST_CASE("filter", TS) {
+    const auto tree = small_tree();
+    const std::regex re{R"(.*\.(a|pc)$)"};
+    const auto vars = tree.filter([&](std::string_view path) {
+        return std::regex_match(path.begin(), path.end(), re);
+    });
+    REQUIRE(var_paths(tree, vars) ==
+            std::vector<std::string>{"top.cpu.pc", "top.cpu.alu.a", "top.mem.a"});
+}
+
+TEST_CASE("many vars", TS) {
+    ScopeTree tree;
+    std::vector<std::string> names;
+    for (int i = 0; i < 1000; ++i) {
+        names.emplace_back(fmt::format("s{:d}", i));
+    }
+    for (int i = 0; i < 100; ++i) {
+        const auto scope = tree.add_scope(ScopeTree::root, names[i], ScopeType::module);
+        for (int j = 0; j < 1000; ++j) {
+            const auto sig = (IDCodeTable::sig_t)(i * 1000 + j);
+            tree.add_var(scope, {"!", names[j], 1, VarType::wire, sig});
+        }
+    }
+    for (int i = 0; i < 100; i += 7) {
+        for (int j = 0; j < 1000; j += 13) {
+            const auto var = tree.find_var(fmt::format("s{:d}.s{:d}", i, j));
+            REQUIRE(var != ScopeTree::invalid);
+            REQUIRE(tree.var(var).sig == (IDCodeTable::sig_t)(i * 1000 + j));
+        }
+    }
+}
+
+TEST_CASE("same name across var table growth", TS) {
+    ScopeTree tree;
+    const auto top   = tree.add_scope(ScopeTree::root, "top", ScopeType::module);
+    const auto other = tree.add_scope(top, "other", ScopeType::module);
+    std::vector<std::string> names;
+    for (int i = 0; i < 200; ++i) {
+        names.emplace_back(fmt::format("v{:d}", i % 70));
+    }
+    for (int i = 0; i < 200; ++i) {
+        tree.add_var(top, {"!", names[i], 1, VarType::wire, (IDCodeTable::sig_t)i});
+        // interleaved so the tables take turns outgrowing each other
+        tree.add_var(other, {"\"", names[i], 1, VarType::wire, (IDCodeTable::sig_t)(1000 + i)});
+        // the first var of each name, before and after its table grows
+        const auto var = tree.find_var(fmt::format("top.v{:d}", i % 70));
+        REQUIRE(var != ScopeTree::invalid);
+        REQUIRE(tree.var(var).sig == (IDCodeTable::sig_t)(i % 70));
+        const auto other_var = tree.find_var(fmt::format("top.other.v{:d}", i % 70));
+        REQUIRE(other_var != ScopeTree::invalid);
+        REQUIRE(tree.var(other_var).sig == (IDCodeTable::sig_t)(1000 + i % 70));
+    }
+    REQUIRE(tree.find_var("top.v70") == ScopeTree::invalid);
+    REQUIRE(tree.find_var("top.other.v70") == ScopeTree::invalid);
+}
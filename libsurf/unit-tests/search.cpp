@@ -0,0 +1,156 @@
+#include <surf/surf.h>
+using namespace surf;
+using namespace VCDTypes;
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <random>
+#include <set>
+
+#define TS "[SignalSearch]"
+
+// top.valid, top.ready, top.addr [15:0] and top.u.data [7:0] as signals 0 to 3
+static Document bus_doc() {
+    Document doc;
+    auto &decls    = doc.declarations;
+    decls.signals  = {{1, VarType::wire}, {1, VarType::wire}, {16, VarType::wire},
+                      {8, VarType::wire}};
+    const auto top = decls.scopes.add_scope(ScopeTree::root, "top", ScopeType::module);
+    decls.scopes.add_var(top, {"!", "valid", 1, VarType::wire, 0});
+    decls.scopes.add_var(top, {"\"", "ready", 1, VarType::wire, 1});
+    decls.scopes.add_var(top, {"#", "addr [15:0]", 16, VarType::wire, 2});
+    const auto u = decls.scopes.add_scope(top, "u", ScopeType::module);
+    decls.scopes.add_var(u, {"$", "data [7:0]", 8, VarType::wire, 3});
+    return doc;
+}
+
+TEST_CASE("compile", TS) {
+    const auto doc  = bus_doc();
+    const auto cols = SignalColumns::from_document(doc);
+
+    const SignalSearch search{"top.valid && top.ready && top.addr == 0x4000", doc.declarations,
+                              cols};
+    REQUIRE(search.signals() == std::vector<IDCodeTable::sig_t>{0, 1, 2});
+    REQUIRE(search.code().size() == 7);
+    REQUIRE(search.code().back().op == SignalSearch::Op::logical_and);
+
+    REQUIRE(SignalSearch{"isx(top.u.data) || !(top.addr >= 0b101_0000)", doc.declarations, cols}
+                .signals() == std::vector<IDCodeTable::sig_t>{3, 2});
+
+    REQUIRE_THROWS_AS(SignalSearch("top.valid &&", doc.declarations, cols), std::invalid_argument);
+    REQUIRE_THROWS_AS(SignalSearch("top.nope", doc.declarations, cols), std::invalid_argument);
+    REQUIRE_THROWS_AS(SignalSearch("top.addr == 0x1ffffffffffffffff", doc.declarations, cols),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(SignalSearch("(top.valid", doc.declarations, cols), std::invalid_argument);
+}
+
+TEST_CASE("next and prev", TS) {
+    auto doc = bus_doc();
+    // a handshake every 100 ticks, addr counts up by 0x1000 on each
+    for (uint64_t tick = 0; tick <= 1000; tick += 10) {
+        doc.sim_cmds.emplace_back(Tick{tick});
+        const auto phase = tick % 100;
+        if (tick == 0) {
+            doc.sim_cmds.emplace_back(Change{ScalarValue{'0'}, 0});
+            doc.sim_cmds.emplace_back(Change{ScalarValue{'0'}, 1});
+            doc.sim_cmds.emplace_back(Change{BinaryNum::from_digits("x"), 3});
+        }
+        if (phase == 50) {
+            doc.sim_cmds.emplace_back(Change{ScalarValue{'1'}, 0});
+            doc.sim_cmds.emplace_back(Change{BinaryNum{tick / 100 * 0x1000}, 2});
+        } else if (phase == 70) {
+            doc.sim_cmds.emplace_back(Change{ScalarValue{'1'}, 1});
+        } else if (phase == 80) {
+            doc.sim_cmds.emplace_back(Change{ScalarValue{'0'}, 0});
+            doc.sim_cmds.emplace_back(Change{ScalarValue{'0'}, 1});
+        }
+        // rewrites of the same value aren't matches
+        doc.sim_cmds.emplace_back(Change{ScalarValue{phase >= 70 && phase < 80 ? '1' : '0'}, 1});
+    }
+    doc.sim_cmds.emplace_back(Tick{1010});
+    doc.sim_cmds.emplace_back(Change{BinaryNum::from_digits("1010zzzz"), 3});
+    const auto cols = SignalColumns::from_document(doc);
+
+    const SignalSearch handshake{"top.valid && top.ready && top.addr == 0x4000",
+                                 doc.declarations, cols};
+    REQUIRE(handshake.next(0) == 470);
+    REQUIRE(handshake.next(470) == std::nullopt);
+    REQUIRE(handshake.prev(1000) == 470);
+    REQUIRE(handshake.prev(470) == std::nullopt);
+    REQUIRE(handshake.holds_at(475));
+    REQUIRE(!handshake.holds_at(480));
+
+    const SignalSearch any_handshake{"top.valid && top.ready", doc.declarations, cols};
+    REQUIRE(any_handshake.next(0) == 70);
+    REQUIRE(any_handshake.next(70) == 170);
+    REQUIRE(any_handshake.prev(170) == 70);
+
+    // the leading x fills every bit of the vector
+    const SignalSearch isx{"isx(top.u.data)", doc.declarations, cols};
+    REQUIRE(isx.holds_at(0));
+    REQUIRE(isx.next(0) == std::nullopt);
+    REQUIRE(isx.prev(10) == 0);
+    REQUIRE(!SignalSearch("top.u.data == 0", doc.declarations, cols).holds_at(0));
+    const SignalSearch isz{"isz(top.u.data) && !isx(top.u.data)", doc.declarations, cols};
+    REQUIRE(isz.next(0) == 1010);
+    REQUIRE(!isz.holds_at(1000));
+}
+
+TEST_CASE("matches brute force", TS) {
+    auto doc = bus_doc();
+    std::mt19937_64 rng{42};
+    for (uint64_t tick = 0; tick < 40000; tick += 1 + rng() % 7) {
+        doc.sim_cmds.emplace_back(Tick{tick});
+        for (uint32_t sig = 0; sig < 4; ++sig) {
+            if (rng() % 3) {
+                continue;
+            }
+            if (sig < 2) {
+                doc.sim_cmds.emplace_back(Change{ScalarValue{"01xz"[rng() % 4]}, sig});
+            } else if (rng() % 8) {
+                doc.sim_cmds.emplace_back(Change{BinaryNum{rng() % 4}, sig});
+            } else {
+                doc.sim_cmds.emplace_back(Change{BinaryNum::from_digits("1x"), sig});
+            }
+        }
+    }
+    const auto cols = SignalColumns::from_document(doc);
+
+    for (const auto *expr :
+         {"top.valid && top.ready", "top.valid && top.addr == 2 && top.u.data != 1",
+          "!top.ready && (top.addr > 1 || isx(top.u.data))", "isz(top.valid) || top.addr < 1",
+          "top.addr == top.u.data && top.valid", "3 == top.addr", "isx(top.u.data) && top.ready",
+          "top.u.data >= 2 && top.u.data < 3"}) {
+        const SignalSearch search{expr, doc.declarations, cols};
+        // only edges of the referenced signals are candidates
+        std::set<uint64_t> edge_ticks;
+        for (const auto sig : search.signals()) {
+            for (size_t i = 0; i < cols[sig].size(); ++i) {
+                if (cols[sig].is_edge(i)) {
+                    edge_ticks.insert(cols[sig].tick(i));
+                }
+            }
+        }
+        std::vector<uint64_t> expected;
+        for (const auto tick : edge_ticks) {
+            if (search.holds_at(tick)) {
+                expected.push_back(tick);
+            }
+        }
+        REQUIRE(!expected.empty());
+
+        std::vector<uint64_t> forward;
+        for (auto tick = search.next(0); tick; tick = search.next(*tick)) {
+            forward.push_back(*tick);
+        }
+        const auto from_zero = search.holds_at(0) && edge_ticks.contains(0);
+        REQUIRE(forward == std::vector<uint64_t>(expected.cbegin() + from_zero, expected.cend()));
+
+        std::vector<uint64_t> backward;
+        for (auto tick = search.prev(100000); tick; tick = search.prev(*tick)) {
+            backward.push_back(*tick);
+        }
+        std::reverse(backward.begin(), backward.end());
+        REQUIRE(backward == expected);
+    }
+}
@@ -0,0 +1,76 @@
+#include <surf/surf.h>
+using namespace surf;
+
+#include <catch2/catch_test_macros.hpp>
+
+#define TS "[TickSeekIndex]"
+
+TEST_CASE("windows", TS) {
+    std::string body = "$dumpvars\n0!\n$end\n";
+    for (uint64_t tick = 0; tick < 1000; ++tick) {
+        // ids may contain '#', only a '#' that starts a line is a tick
+        body += fmt::format("#{:d}\n1#\nb101 #{:d}\n", tick * 10, tick);
+    }
+    REQUIRE(TickSeekIndex::first_tick(body)->tick == 0);
+    REQUIRE(TickSeekIndex::first_tick(body)->offset == body.find("\n#0") + 1);
+    REQUIRE(TickSeekIndex::last_tick(body)->tick == 9990);
+    REQUIRE(!TickSeekIndex::first_tick("$comment #1 $end\n"));
+    REQUIRE(!TickSeekIndex::last_tick(""));
+
+    const auto index = TickSeekIndex::build(body, 256);
+    REQUIRE(index.complete());
+    REQUIRE(index.num_ticks() == 1000);
+    REQUIRE(index.entries().size() > 10);
+    for (const auto &entry : index.entries()) {
+        REQUIRE(body.substr(entry.offset, 1) == "#");
+        REQUIRE(std::stoull(body.substr(entry.offset + 1)) == entry.tick);
+    }
+    const auto [all_begin, all_end] = index.byte_range(0, 9990);
+    REQUIRE(all_begin == 0);
+    REQUIRE(all_end == body.size());
+    // a window holds its ticks and stays within a couple of strides of them
+    for (const auto &[start, end] : {std::pair<uint64_t, uint64_t>{5000, 5000}, {1234, 4321}}) {
+        const auto [begin, stop] = index.byte_range(start, end);
+        const auto window        = std::string_view{body}.substr(begin, stop - begin);
+        REQUIRE(window.starts_with("#"));
+        for (auto tick = (start + 9) / 10 * 10; tick <= end; tick += 10) {
+            REQUIRE(window.find(fmt::format("\n#{:d}\n", tick)) != std::string_view::npos);
+        }
+        REQUIRE(window.size() < (end - start) / 10 * 24 + 3 * 256);
+    }
+
+    std::stop_source stop;
+    stop.request_stop();
+    const auto stopped = TickSeekIndex::build(body, 256, stop.get_token());
+    REQUIRE(!stopped.complete());
+    REQUIRE(stopped.entries().empty());
+    REQUIRE_THROWS_AS(TickSeekIndex::build("#99999999999999999999999\n"), std::domain_error);
+}
+
+TEST_CASE("comments", TS) {
+    // '#' lines inside a $comment are text, not ticks
+    std::string body = "$comment\n#999999\n$end\n";
+    for (uint64_t tick = 0; tick < 100; ++tick) {
+        body += fmt::format("#{:d}\n1!\n", tick);
+        if (tick % 10 == 5) {
+            body += fmt::format("$comment note\n#{:d}\n#1\n$end\n", 1000000 + tick);
+        }
+    }
+    body += "$comment trailing\n#123456789\n$end\n";
+    REQUIRE(TickSeekIndex::first_tick(body)->tick == 0);
+    REQUIRE(TickSeekIndex::first_tick(body)->offset == body.find("\n#0") + 1);
+    REQUIRE(TickSeekIndex::last_tick(body)->tick == 99);
+    REQUIRE(!TickSeekIndex::first_tick("$comment\n#1\n$end\n"));
+    REQUIRE(!TickSeekIndex::last_tick("$comment\n#1\n$end\n"));
+    // an id starting with '$' isn't a command
+    REQUIRE(TickSeekIndex::first_tick("1$comment\n#7\n")->tick == 7);
+
+    const auto index = TickSeekIndex::build(body, 64);
+    REQUIRE(index.num_ticks() == 100);
+    for (const auto &entry : index.entries()) {
+        REQUIRE(entry.tick < 100);
+    }
+    const auto [begin, stop] = index.byte_range(50, 60);
+    REQUIRE(std::string_view{body}.substr(begin).starts_with("#"));
+    REQUIRE(std::stoull(body.substr(begin + 1)) <= 50);
+}
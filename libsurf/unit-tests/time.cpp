@@ -0,0 +1,55 @@
+#include <surf/surf.h>
+using namespace surf;
+
+#include <catch2/catch_test_macros.hpp>
+
+#define TS "[Time]"
+
+TEST_CASE("seconds round trip", TS) {
+    REQUIRE(Time::seconds_to_ticks(1.5e-6, -9) == 1500);
+    REQUIRE(Time::seconds_to_ticks(2.5e-15, -15) == 3);
+    REQUIRE(Time::seconds_to_ticks(250.0, 2) == 3);
+    REQUIRE(Time::ticks_to_seconds(1500, -9) == 1.5e-6);
+    REQUIRE(Time::ticks_to_seconds(3, 2) == 300.0);
+    REQUIRE(Time{0.001, -12}.ticks() == 1'000'000'000);
+    REQUIRE_THROWS_AS(Time::seconds_to_ticks(-1.0, -9), std::range_error);
+    REQUIRE_THROWS_AS(Time::seconds_to_ticks(1e12, -9), std::range_error);
+}
+
+TEST_CASE("viewport pixels", TS) {
+    const uint64_t start = 7;
+    const uint32_t width = 13;
+    for (const uint64_t end : {7u, 11u, 19u, 100u, 1'000'003u}) {
+        const Viewport viewport{start, end, width};
+        REQUIRE(viewport.pixel_tick(0) == start);
+        std::vector<uint64_t> ticks;
+        for (auto tick = start; tick <= end; tick += (end - start) / 50 + 1) {
+            ticks.push_back(tick);
+        }
+        ticks.push_back(end);
+        // out of order and out of range ticks
+        ticks.push_back(start + 1);
+        ticks.push_back(0);
+        ticks.push_back(end + 5);
+        std::vector<uint32_t> pixels(ticks.size());
+        viewport.pixels(ticks, pixels);
+        for (size_t i = 0; i < ticks.size(); ++i) {
+            const auto tick = std::min(ticks[i], end);
+            const auto x    = pixels[i];
+            REQUIRE(x == viewport.pixel(ticks[i]));
+            if (tick < start) {
+                REQUIRE(x == 0);
+                continue;
+            }
+            REQUIRE(viewport.pixel_tick(x) <= tick);
+            if (x + 1 < width) {
+                REQUIRE(viewport.pixel_tick(x + 1) > tick);
+            }
+        }
+        // a batch starting in the middle of the viewport
+        const auto half = ticks.size() / 2;
+        std::vector<uint32_t> tail(ticks.size() - half);
+        viewport.pixels(std::span{ticks}.subspan(half), tail);
+        REQUIRE(std::equal(tail.cbegin(), tail.cend(), pixels.cbegin() + (ptrdiff_t)half));
+    }
+}
@@ -0,0 +1,180 @@
+#include <surf/surf.h>
+using namespace surf;
+using namespace VCDTypes;
+namespace fs = std::filesystem;
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <fstream>
+#include <unistd.h>
+
+#define TS "[Trace]"
+
+TEST_CASE("round trip", TS) {
+    Document doc;
+    doc.declarations.signals = {{1, VarType::wire}, {12, VarType::reg}, {64, VarType::real}};
+    doc.sim_cmds             = {
+        Change{ScalarValue{'x'}, 0},
+        Tick{0},
+        Change{BinaryNum{0xabc}, 1},
+        Tick{10},
+        Change{ScalarValue{'1'}, 0},
+        Change{RealNum{1.5}, 2},
+        Change{BinaryNum{0x1fff}, 1},
+        Tick{20},
+        Tick{30},
+        Change{ScalarValue{'z'}, 0},
+        Change{BinaryNum::from_digits("z1"), 1},
+    };
+    const auto path =
+        fs::temp_directory_path() / fmt::format("surf-unit-test-{:d}.surf", getpid());
+    TraceWriter::write_document(doc, -9, path);
+    {
+        const Trace trace{path};
+        REQUIRE(trace.timebase_power() == -9);
+        REQUIRE(trace.start().ticks() == 0);
+        REQUIRE(trace.end().ticks() == 30);
+        REQUIRE(trace.num_signals() == 3);
+        REQUIRE(trace.signals()[1].bitsize == 12);
+        REQUIRE(trace.signals()[2].kind == SignalKind::real);
+        REQUIRE(trace.num_ticks() == 4);
+
+        const auto t0 = trace.tick_log(0);
+        REQUIRE(t0.tick() == 0);
+        REQUIRE(t0.num_changes() == 2);
+        REQUIRE(t0.logic(0) == Logic::vX);
+        REQUIRE(t0.sig(1) == 1);
+        uint16_t val{};
+        memcpy(&val, t0.bits(1).data(), t0.bits(1).bytesize());
+        REQUIRE(val == 0xabc);
+        REQUIRE(!t0.xz(1));
+
+        const auto t10 = trace.tick_log(1);
+        REQUIRE(t10.logic(0) == Logic::v1);
+        REQUIRE(t10.real(1) == 1.5);
+        memcpy(&val, t10.bits(2).data(), t10.bits(2).bytesize());
+        // truncated to the declared 12 bits
+        REQUIRE(val == 0xfff);
+
+        REQUIRE(trace.tick_log(2).num_changes() == 0);
+        const auto t30 = trace.tick_log(3);
+        REQUIRE(t30.logic(0) == Logic::vZ);
+        // the leading Z extends to the declared 12 bits
+        memcpy(&val, t30.bits(1).data(), t30.bits(1).bytesize());
+        REQUIRE(val == 0x001);
+        REQUIRE(t30.xz(1));
+        memcpy(&val, t30.xz(1)->data(), t30.xz(1)->bytesize());
+        REQUIRE(val == 0xffe);
+
+        REQUIRE(trace.tick_log_index(25) == 2);
+        REQUIRE(trace.tick_log_index(30) == 3);
+
+        REQUIRE(trace.columns().value_at(0, 25)->logic() == Logic::v1);
+        REQUIRE(trace.columns().next_change(0, 10)->tick() == 30);
+        REQUIRE(trace.columns().changes_in(1, 0, 30).size() == 3);
+    }
+    fs::remove(path);
+}
+
+TEST_CASE("incomplete", TS) {
+    const auto path =
+        fs::temp_directory_path() / fmt::format("surf-unit-test-incomplete-{:d}.surf", getpid());
+    {
+        TraceWriter writer{path, 0, {TraceSignal{.bitsize = 1, .kind = SignalKind::scalar}}};
+        writer.add_tick(1);
+        writer.add_logic(0, Logic::v1);
+    }
+    REQUIRE_THROWS_AS(Trace{path}, std::domain_error);
+    fs::remove(path);
+}
+
+TEST_CASE("corrupt", TS) {
+    const auto path =
+        fs::temp_directory_path() / fmt::format("surf-unit-test-corrupt-{:d}.surf", getpid());
+    {
+        TraceWriter writer{path,
+                           0,
+                           {TraceSignal{.bitsize = 1, .kind = SignalKind::scalar},
+                            TraceSignal{.bitsize = 12, .kind = SignalKind::vector}}};
+        writer.add_tick(1);
+        writer.add_logic(0, Logic::v1);
+        writer.add_bits(1, bitview{uint64_t{0xabc}, 12});
+        writer.finish();
+    }
+    std::string good;
+    {
+        std::ifstream in{path, std::ios::binary};
+        good.assign(std::istreambuf_iterator<char>{in}, {});
+    }
+    const auto corrupt = [&](auto &&patch) {
+        auto bytes      = good;
+        const auto *hdr = (const trace_format::FileHeader *)bytes.data();
+        auto *index     = (trace_format::TickIndexEntry *)(bytes.data() + hdr->index_offset);
+        auto *log       = (uint8_t *)bytes.data() + index[0].offset;
+        patch(index[0], (uint32_t *)(log + sizeof(trace_format::TickLogHeader)));
+        std::ofstream{path, std::ios::binary}.write(bytes.data(), (std::streamsize)bytes.size());
+    };
+
+    // a signal the trace doesn't have
+    corrupt([](trace_format::TickIndexEntry &, uint32_t *sigs) {
+        sigs[1] = 7;
+    });
+    {
+        const Trace trace{path};
+        REQUIRE_THROWS_AS(trace.tick_log(0), std::domain_error);
+        REQUIRE_THROWS_AS(SignalColumns::from_trace(trace), std::domain_error);
+    }
+    // a value past the end of the value buffer
+    corrupt([](trace_format::TickIndexEntry &, uint32_t *sigs) {
+        sigs[2 + 1] = 1024;
+    });
+    REQUIRE_THROWS_AS(Trace{path}.tick_log(0), std::domain_error);
+    // a tick_log past the end of the file
+    corrupt([](trace_format::TickIndexEntry &entry, uint32_t *) {
+        entry.offset = 1 << 20;
+    });
+    REQUIRE_THROWS_AS(Trace{path}.tick_log(0), std::domain_error);
+    fs::remove(path);
+}
+
+#ifdef SURF_HAS_ZSTD
+TEST_CASE("compressed", TS) {
+    Document doc;
+    doc.declarations.signals = {{1, VarType::wire}, {12, VarType::reg}, {64, VarType::real}};
+    for (uint64_t tick = 0; tick < 1000; ++tick) {
+        doc.sim_cmds.emplace_back(Tick{tick * 10});
+        doc.sim_cmds.emplace_back(Change{ScalarValue{tick & 1 ? '1' : '0'}, 0});
+        if (tick % 7 == 0) {
+            doc.sim_cmds.emplace_back(Change{BinaryNum{tick}, 1});
+        }
+        if (tick == 3) {
+            doc.sim_cmds.emplace_back(Change{RealNum{3.5}, 2});
+        }
+    }
+    const auto path =
+        fs::temp_directory_path() / fmt::format("surf-unit-test-zstd-{:d}.surf", getpid());
+    TraceWriter::write_document(doc, -12, path, {.compress = true, .block_size = 512});
+    {
+        const Trace trace{path, 4};
+        REQUIRE(trace.compressed());
+        REQUIRE(trace.num_blocks() > 1);
+        REQUIRE(trace.num_ticks() == 1000);
+        REQUIRE(trace.end().ticks() == 9990);
+        for (size_t i = 0; i < trace.num_ticks(); ++i) {
+            const auto log = trace.tick_log(i);
+            REQUIRE(log.tick() == i * 10);
+            REQUIRE(log.logic(0) == (i & 1 ? Logic::v1 : Logic::v0));
+        }
+        REQUIRE(trace.tick_log_index(5) == 0);
+        REQUIRE(trace.tick_log_index(4321) == 432);
+        REQUIRE(trace.tick_log_range(15, 45) == std::pair<size_t, size_t>{2, 5});
+
+        // the last block's snapshot carries the values from before it
+        const auto snapshot = trace.block_snapshot(trace.num_blocks() - 1);
+        REQUIRE(snapshot.num_changes() == 3);
+        REQUIRE(snapshot.sig(2) == 2);
+        REQUIRE(snapshot.real(2) == 3.5);
+    }
+    fs::remove(path);
+}
+#endif
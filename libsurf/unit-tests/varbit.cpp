@@ -13,3 +13,134 @@ TEST_CASE("build", TS) {
     fmt::print("VarBit: {}\n", vb);
     REQUIRE(fmt::format("{}", vb) == "<VarBit[4] 1010>");
 }
+
+TEST_CASE("copy and move", TS) {
+    std::array<uint8_t, 16> buf;
+    for (size_t i = 0; i < buf.size(); ++i) {
+        buf[i] = (uint8_t)(i * 17);
+    }
+    const VarBit heap{bitview{buf.data(), 128}};
+    VarBit copy{heap};
+    REQUIRE(copy.data() != heap.data());
+    REQUIRE(!memcmp(copy.data(), buf.data(), buf.size()));
+    const VarBit moved{std::move(copy)};
+    REQUIRE(moved.bitsize() == 128);
+    REQUIRE(!memcmp(moved.data(), buf.data(), buf.size()));
+    VarBit small{bitview{buf[1], 1}};
+    REQUIRE(small.bitsize() == 1);
+    REQUIRE((*small.data() & 1) == 1);
+    small = heap;
+    REQUIRE(small.bitsize() == 128);
+    auto zeroed = VarBit::zeroed(100);
+    REQUIRE(zeroed.bitsize() == 100);
+    REQUIRE(std::all_of(zeroed.data(), zeroed.data() + zeroed.bytesize(), [](uint8_t b) {
+        return b == 0;
+    }));
+}
+
+TEST_CASE("arena", TS) {
+    std::array<uint8_t, 16> buf;
+    for (size_t i = 0; i < buf.size(); ++i) {
+        buf[i] = (uint8_t)(i * 13 + 1);
+    }
+    VarBitArena arena;
+    const VarBit small{bitview{buf.data(), 40}, arena};
+    REQUIRE(!small.is_arena());
+    REQUIRE(arena.size() == 0);
+    const VarBit wide{bitview{buf.data(), 100}, arena};
+    REQUIRE(wide.is_arena());
+    REQUIRE(wide.bitsize() == 100);
+    // later allocations may move the arena, offsets stay valid
+    for (int i = 0; i < 64; ++i) {
+        const VarBit filler{bitview{buf.data(), 128}, arena};
+        REQUIRE(filler.is_arena());
+    }
+    REQUIRE(arena.size() == 65 * 16);
+    const VarBit copy{wide};
+    REQUIRE(copy.data(arena) == wide.data(arena));
+    REQUIRE(!memcmp(wide.data(arena), buf.data(), 12));
+    REQUIRE((wide.data(arena)[12] & 0xf) == (buf[12] & 0xf));
+    REQUIRE(bitview2string(wide.bitview(arena)) == bitview2string(bitview{buf.data(), 100}));
+}
+
+TEST_CASE("to string", TS) {
+    std::array<uint8_t, 37> buf;
+    for (size_t i = 0; i < buf.size(); ++i) {
+        buf[i] = (uint8_t)(i * 37 + 11);
+    }
+    for (varbit::sz_t bitsz = 1; bitsz <= buf.size() * CHAR_BIT; ++bitsz) {
+        const bitview bv{(const uint8_t *)buf.data(), bitsz};
+        std::string bin;
+        for (auto i = bitsz; i-- > 0;) {
+            bin.push_back((buf[i / CHAR_BIT] >> (i % CHAR_BIT)) & 1 ? '1' : '0');
+        }
+        REQUIRE(bitview2string(bv) == bin);
+        std::string hex;
+        for (auto i = (varbit::sz_t)((bitsz + 3) / 4); i-- > 0;) {
+            unsigned nibble = 0;
+            for (unsigned b = 0; b < 4 && i * 4u + b < bitsz; ++b) {
+                nibble |= ((buf[(i * 4 + b) / CHAR_BIT] >> ((i * 4 + b) % CHAR_BIT)) & 1) << b;
+            }
+            hex.push_back("0123456789abcdef"[nibble]);
+        }
+        REQUIRE(bitview2hex(bv) == hex);
+    }
+}
+
+TEST_CASE("bulk operations", TS) {
+    std::array<uint8_t, 37> buf_a;
+    std::array<uint8_t, 37> buf_b;
+    for (size_t i = 0; i < buf_a.size(); ++i) {
+        buf_a[i] = (uint8_t)(i * 37 + 11);
+        buf_b[i] = (uint8_t)(i * 101 + 3);
+    }
+    const auto padding_clear = [](const VarBit &vb) {
+        const auto partial_bits = vb.bitsize() % CHAR_BIT;
+        return !partial_bits || !(vb.data()[vb.bytesize() - 1] >> partial_bits);
+    };
+    // checked against the already tested binary strings, most significant bit first
+    for (varbit::sz_t bitsz = 1; bitsz <= buf_a.size() * CHAR_BIT; ++bitsz) {
+        const bitview a{buf_a.data(), bitsz};
+        const bitview b{buf_b.data(), bitsz};
+        const auto str_a = bitview2string(a);
+        const auto str_b = bitview2string(b);
+
+        REQUIRE(bitview_equal(a, a));
+        REQUIRE(bitview_equal(a, bitview{VarBit{a}.data(), bitsz}));
+        REQUIRE(bitview_equal(a, b) == (str_a == str_b));
+        REQUIRE(bitview_popcount(a) == std::count(str_a.cbegin(), str_a.cend(), '1'));
+
+        std::string str_xor;
+        for (size_t i = 0; i < str_a.size(); ++i) {
+            str_xor.push_back(str_a[i] == str_b[i] ? '0' : '1');
+        }
+        const auto xored = bitview_xor(a, b);
+        REQUIRE(bitview2string(xored.bitview()) == str_xor);
+        REQUIRE(padding_clear(xored));
+        REQUIRE(bitview_hamming(a, b) == std::count(str_xor.cbegin(), str_xor.cend(), '1'));
+
+        const auto reversed = bitview_reverse(a);
+        REQUIRE(bitview2string(reversed.bitview()) == std::string{str_a.crbegin(), str_a.crend()});
+        REQUIRE(padding_clear(reversed));
+
+        const auto lo_bits = (varbit::sz_t)(bitsz / 3 + 1);
+        const auto joined  = bitview_concat(a, bitview{buf_b.data(), lo_bits});
+        REQUIRE(bitview2string(joined.bitview()) ==
+                str_a + bitview2string(bitview{buf_b.data(), lo_bits}));
+        REQUIRE(padding_clear(joined));
+
+        for (const varbit::sz_t lsb : {0, 1, 7, 9, bitsz / 3}) {
+            if (lsb >= bitsz) {
+                continue;
+            }
+            const auto width = (varbit::sz_t)(bitsz - lsb - (bitsz - lsb) / 4);
+            const auto slice = bitview_slice(a, lsb, width);
+            REQUIRE(bitview2string(slice.bitview()) == str_a.substr(bitsz - lsb - width, width));
+            REQUIRE(padding_clear(slice));
+        }
+    }
+    const bitview bv{buf_a.data(), 100};
+    REQUIRE(!bitview_equal(bv, bitview{buf_a.data(), 99}));
+    REQUIRE_THROWS_AS(bitview_slice(bv, 90, 11), std::range_error);
+    REQUIRE_THROWS_AS(bitview_xor(bv, bitview{buf_b.data(), 99}), std::range_error);
+}
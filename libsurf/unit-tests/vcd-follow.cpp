@@ -0,0 +1,92 @@
+#include <surf/surf.h>
+using namespace surf;
+namespace fs = std::filesystem;
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <fstream>
+#include <unistd.h>
+
+#define TS "[VCDFollower]"
+
+TEST_CASE("growing file", TS) {
+    const auto path =
+        fs::temp_directory_path() / fmt::format("surf-unit-test-follow-{:d}.vcd", getpid());
+    std::ofstream out{path};
+    const auto append = [&](std::string_view str) {
+        out << str;
+        out.flush();
+    };
+    append("$timescale 1ns $end\n$scope module top $end\n$var wire 1 ! clk $end\n");
+    VCDFollower follower{path};
+    REQUIRE(!follower.has_declarations());
+
+    append("$var wire 12 #a bus $end\n$upscope $end\n$enddefinitions $end\n#0\n0!\nb101 #a\n#5\n1");
+    REQUIRE(follower.follow(std::chrono::seconds{1}));
+    REQUIRE(follower.has_declarations());
+    REQUIRE(follower.columns().size() == 2);
+    REQUIRE(follower.columns()[0].size() == 1);
+    REQUIRE(follower.columns()[1].size() == 1);
+    REQUIRE(follower.end().ticks() == 5);
+
+    // the cut off change completes, earlier changes aren't parsed again
+    append("!\nb111 #a\n#10\n0!\n#15");
+    REQUIRE(follower.follow(std::chrono::seconds{1}));
+    REQUIRE(follower.columns()[0].size() == 3);
+    REQUIRE(follower.columns()[0].logic(1) == Logic::v1);
+    REQUIRE(follower.columns()[1].size() == 2);
+    REQUIRE(follower.end().ticks() == 10);
+    REQUIRE(!follower.follow(std::chrono::milliseconds{10}));
+
+    follower.finish();
+    REQUIRE(follower.end().ticks() == 15);
+    REQUIRE(follower.start().ticks() == 0);
+    fs::remove(path);
+}
+
+TEST_CASE("follow wide values", TS) {
+    const auto path =
+        fs::temp_directory_path() / fmt::format("surf-unit-test-follow-wide-{:d}.vcd", getpid());
+    const std::string wide0(80, '1');
+    const auto wide1 = "1" + std::string(78, '0') + "1";
+    {
+        std::ofstream out{path};
+        out << "$timescale 1ns $end\n$scope module top $end\n$var wire 80 w wide $end\n"
+               "$upscope $end\n$enddefinitions $end\n#0\nb"
+            << wide0 << " w\n#5\nb" << wide1 << " w\n#6\n";
+    }
+    VCDFollower follower{path};
+    REQUIRE(follower.has_declarations());
+    // the values were parsed into the stream's arenas, the columns keep their own copies
+    const auto &col = follower.columns()[0];
+    REQUIRE(col.size() == 2);
+    REQUIRE(bitview2string(col.bits(0)) ==
+            bitview2string(VCDTypes::BinaryNum::from_digits(wide0).bits_view()));
+    REQUIRE(bitview2string(col.bits(1)) ==
+            bitview2string(VCDTypes::BinaryNum::from_digits(wide1).bits_view()));
+    fs::remove(path);
+}
+
+#if defined(__linux__)
+TEST_CASE("no fd leak on a bad file", TS) {
+    const auto path =
+        fs::temp_directory_path() / fmt::format("surf-unit-test-follow-bad-{:d}.vcd", getpid());
+    {
+        std::ofstream out{path};
+        out << "$timescale 1ns $end\n$scope module top $end\n$var wire 1 ! clk $end\n"
+               "$upscope $end\n$enddefinitions $end\n#0\n$bogus $end\n#1\n";
+    }
+    const auto num_fds = [] {
+        const auto it = fs::directory_iterator{"/proc/self/fd"};
+        return std::distance(fs::begin(it), fs::end(it));
+    };
+    const auto fds_before = num_fds();
+    // the first update throws from the constructor
+    REQUIRE_THROWS(VCDFollower{path});
+    REQUIRE(num_fds() == fds_before);
+    REQUIRE_THROWS(VCDFollower{path.string() + ".missing"});
+    REQUIRE(num_fds() == fds_before);
+    fs::remove(path);
+}
+#endif
@@ -0,0 +1,341 @@
+#include <surf/surf.h>
+using namespace surf;
+
+#include "vcd-parser.h"
+#include "vcd-scanner.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#define TS "[VCDScanner]"
+
+static std::vector<fs::path> vcd_corpus() {
+    std::vector<fs::path> paths;
+    for (const auto dir : {SURF_TEST_VCD_DIR, SURF_TEST_WAVEFORMS_DIR}) {
+        if (!fs::is_directory(dir)) {
+            continue;
+        }
+        for (const auto &entry : fs::recursive_directory_iterator(dir)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".vcd") {
+                paths.emplace_back(entry.path());
+            }
+        }
+    }
+    return paths;
+}
+
+static void require_same_cmds(const std::vector<VCDTypes::SimCmd> &cmds,
+                              const std::vector<VCDTypes::SimCmd> &ref_cmds) {
+    REQUIRE(cmds.size() == ref_cmds.size());
+    for (size_t i = 0; i < cmds.size(); ++i) {
+        REQUIRE(fmt::format("{}", cmds[i]) == fmt::format("{}", ref_cmds[i]));
+    }
+}
+
+TEST_CASE("differential", TS) {
+    size_t num_compared = 0;
+    for (const auto &path : vcd_corpus()) {
+        INFO("VCD: " << path);
+        MappedReadOnlyFile vcd_file{path};
+        VCDParserDeclRet decls_ret;
+        VCDTypes::Declarations decls;
+        try {
+            decls_ret = parse_vcd_declarations(vcd_file.string_view(), path);
+            decls     = decls_from_decl_list(std::move(decls_ret.decls));
+        } catch (const std::exception &) {
+            // header uses declarations the reference grammar doesn't support yet
+            continue;
+        }
+        std::optional<std::vector<VCDTypes::SimCmd>> ref_cmds;
+        try {
+            ref_cmds = parse_vcd_sim_cmds(decls_ret.remaining, decls.idcodes, path);
+        } catch (const std::exception &) {
+        }
+        if (!ref_cmds) {
+            REQUIRE_THROWS(parse_vcd_sim_cmds_fast(decls_ret.remaining, decls.idcodes));
+            continue;
+        }
+        const auto fast_cmds = parse_vcd_sim_cmds_fast(decls_ret.remaining, decls.idcodes);
+        REQUIRE(fast_cmds.size() == ref_cmds->size());
+        for (size_t i = 0; i < fast_cmds.size(); ++i) {
+            REQUIRE(fmt::format("{}", fast_cmds[i]) == fmt::format("{}", (*ref_cmds)[i]));
+        }
+        ++num_compared;
+    }
+    // the skips above mustn't hide a reference grammar that parses nothing
+    REQUIRE(num_compared > 0);
+}
+
+// the reference grammar on its own, so a broken grammar fails here instead of being skipped
+TEST_CASE("reference grammar", TS) {
+    const auto path = fs::path{SURF_TEST_VCD_DIR} / "parse-test.vcd";
+    MappedReadOnlyFile vcd_file{path};
+    auto decls_ret   = parse_vcd_declarations(vcd_file.string_view(), path);
+    const auto decls = decls_from_decl_list(std::move(decls_ret.decls));
+    REQUIRE(decls.comments);
+    REQUIRE(*decls.comments == std::vector<std::string_view>{"decl comment", "decl comment dos"});
+    REQUIRE(decls.version);
+    REQUIRE(*decls.version == "Hand Mk I");
+    REQUIRE(decls.scopes.num_vars() == 10);
+    REQUIRE(decls.signals.size() == 10);
+    const auto nibble = decls.scopes.find_var("TOP.nibble");
+    REQUIRE(nibble != VCDTypes::ScopeTree::invalid);
+    REQUIRE(decls.scopes.var(nibble).id == "F!");
+    REQUIRE(decls.scopes.var(nibble).ref == "nibble [3:0]");
+    REQUIRE(decls.scopes.var(nibble).size == 4);
+    REQUIRE(decls.scopes.var(nibble).sig == decls.idcodes.lookup("F!"));
+    REQUIRE(decls.scopes.find_var("TOP.cpu2.pc2_addr") != VCDTypes::ScopeTree::invalid);
+
+    const auto cmds = parse_vcd_sim_cmds(decls_ret.remaining, decls.idcodes, path);
+    REQUIRE(cmds.size() == 12);
+    REQUIRE(std::get<VCDTypes::Tick>(cmds[0]).tick == 10);
+    REQUIRE(std::get<VCDTypes::Change>(cmds[1]).sig == decls.idcodes.lookup("a"));
+    REQUIRE(std::get<VCDTypes::Comment>(cmds[2]).comment == "lol hai");
+    REQUIRE(std::get<VCDTypes::Change>(cmds[7]).sig == decls.idcodes.lookup("F!"));
+    REQUIRE(std::get<VCDTypes::RealNum>(std::get<VCDTypes::Change>(cmds[10]).value).num ==
+            243.1337);
+    require_same_cmds(cmds, parse_vcd_sim_cmds_fast(decls_ret.remaining, decls.idcodes));
+
+    // x/z digits, an empty comment and an undeclared id code
+    const auto body = "#20\nbx1z0 F!\n$comment $end\nb1 a\n#21\n"sv;
+    const auto more = parse_vcd_sim_cmds(body, decls.idcodes);
+    REQUIRE(more.size() == 5);
+    REQUIRE(std::get<VCDTypes::Comment>(more[2]).comment.empty());
+    require_same_cmds(more, parse_vcd_sim_cmds_fast(body, decls.idcodes));
+    REQUIRE_THROWS(parse_vcd_sim_cmds("#1\n1 nope\n"sv, decls.idcodes));
+}
+
+static void require_same_decls(const VCDTypes::Declarations &decls,
+                               const VCDTypes::Declarations &ref_decls) {
+    REQUIRE(decls.comments == ref_decls.comments);
+    REQUIRE(decls.date == ref_decls.date);
+    REQUIRE(decls.version == ref_decls.version);
+    REQUIRE(fmt::format("{}", decls.timescale) == fmt::format("{}", ref_decls.timescale));
+    REQUIRE(fmt::format("{}", decls.scopes) == fmt::format("{}", ref_decls.scopes));
+    REQUIRE(decls.scopes.num_vars() == ref_decls.scopes.num_vars());
+    for (VCDTypes::ScopeTree::index_t var = 0; var < decls.scopes.num_vars(); ++var) {
+        REQUIRE(decls.scopes.var_path(var) == ref_decls.scopes.var_path(var));
+        REQUIRE(decls.scopes.var(var).sig == ref_decls.scopes.var(var).sig);
+    }
+    REQUIRE(decls.signals.size() == ref_decls.signals.size());
+    for (size_t sig = 0; sig < decls.signals.size(); ++sig) {
+        REQUIRE(decls.signals[sig].size == ref_decls.signals[sig].size);
+        REQUIRE(decls.signals[sig].type == ref_decls.signals[sig].type);
+    }
+}
+
+TEST_CASE("declarations differential", TS) {
+    size_t num_compared = 0;
+    for (const auto &path : vcd_corpus()) {
+        INFO("VCD: " << path);
+        MappedReadOnlyFile vcd_file{path};
+        VCDParserDeclRet decls_ret;
+        VCDTypes::Declarations ref_decls;
+        try {
+            decls_ret = parse_vcd_declarations(vcd_file.string_view(), path);
+            ref_decls = decls_from_decl_list(std::move(decls_ret.decls));
+        } catch (const std::exception &) {
+            continue;
+        }
+        const auto scan_ret = scan_vcd_declarations(vcd_file.string_view());
+        require_same_decls(scan_ret.decls, ref_decls);
+        REQUIRE(scan_ret.remaining.data() == decls_ret.remaining.data());
+        REQUIRE(scan_ret.remaining.size() == decls_ret.remaining.size());
+        ++num_compared;
+    }
+    REQUIRE(num_compared > 0);
+}
+
+TEST_CASE("declaration scanner", TS) {
+    const auto path = fs::path{SURF_TEST_VCD_DIR} / "parse-test.vcd";
+    MappedReadOnlyFile vcd_file{path};
+    const auto scan_ret = scan_vcd_declarations(vcd_file.string_view());
+    const auto &decls   = scan_ret.decls;
+    REQUIRE(decls.comments);
+    REQUIRE(*decls.comments == std::vector<std::string_view>{"decl comment", "decl comment dos"});
+    REQUIRE(decls.version);
+    REQUIRE(*decls.version == "Hand Mk I");
+    REQUIRE(!decls.date);
+    REQUIRE(decls.timescale);
+    REQUIRE(decls.timescale->time_number == VCDTypes::TimeNumber::n10);
+    REQUIRE(decls.timescale->time_unit == VCDTypes::TimeUnit::ns);
+    REQUIRE(decls.scopes.num_scopes() == 4);
+    REQUIRE(decls.scopes.num_vars() == 10);
+    REQUIRE(decls.signals.size() == 10);
+    const auto nibble = decls.scopes.find_var("TOP.nibble");
+    REQUIRE(nibble != VCDTypes::ScopeTree::invalid);
+    REQUIRE(decls.scopes.var(nibble).id == "F!");
+    REQUIRE(decls.scopes.var(nibble).ref == "nibble [3:0]");
+    REQUIRE(decls.scopes.var(nibble).size == 4);
+    REQUIRE(decls.scopes.var(nibble).type == VCDTypes::VarType::wire);
+    REQUIRE(decls.scopes.var(nibble).sig == decls.idcodes.lookup("F!"));
+    const auto temp = decls.scopes.find_var("TOP.temp");
+    REQUIRE(temp != VCDTypes::ScopeTree::invalid);
+    REQUIRE(decls.signals[decls.scopes.var(temp).sig].kind() == SignalKind::real);
+    REQUIRE(decls.scopes.find_var("TOP.cpu2.pc2_addr") != VCDTypes::ScopeTree::invalid);
+    REQUIRE(scan_ret.remaining.starts_with("#10\n"));
+
+    // aliases share a signal, the header may end the file
+    const auto alias = scan_vcd_declarations("$scope module top $end $var wire 1 ! a $end "
+                                             "$var wire 1 ! b $end $upscope $end "
+                                             "$enddefinitions $end"sv);
+    REQUIRE(alias.decls.scopes.num_vars() == 2);
+    REQUIRE(alias.decls.signals.size() == 1);
+    REQUIRE(alias.remaining.empty());
+
+    REQUIRE_THROWS_AS(scan_vcd_declarations("$bogus $end $enddefinitions $end"sv),
+                      std::logic_error);
+    REQUIRE_THROWS_AS(scan_vcd_declarations("$var wire x ! a $end $enddefinitions $end"sv),
+                      std::logic_error);
+    REQUIRE_THROWS_AS(scan_vcd_declarations("$var wire 1 ! a"sv), std::logic_error);
+    REQUIRE_THROWS_AS(scan_vcd_declarations("$timescale 3 ns $end $enddefinitions $end"sv),
+                      std::logic_error);
+    REQUIRE_THROWS_AS(scan_vcd_declarations("$upscope $end $enddefinitions $end"sv),
+                      std::range_error);
+    REQUIRE_THROWS_AS(scan_vcd_declarations("$scope module top $end $enddefinitions $end"sv),
+                      std::domain_error);
+}
+
+TEST_CASE("parallel", TS) {
+    for (const auto &path : vcd_corpus()) {
+        INFO("VCD: " << path);
+        MappedReadOnlyFile vcd_file{path};
+        VCDParserDeclRet decls_ret;
+        VCDTypes::Declarations decls;
+        std::vector<VCDTypes::SimCmd> ref_cmds;
+        try {
+            decls_ret = parse_vcd_declarations(vcd_file.string_view(), path);
+            decls     = decls_from_decl_list(std::move(decls_ret.decls));
+            ref_cmds  = parse_vcd_sim_cmds(decls_ret.remaining, decls.idcodes, path);
+        } catch (const std::exception &) {
+            continue;
+        }
+        require_same_cmds(parse_vcd_sim_cmds_parallel(decls_ret.remaining, decls.idcodes, 4),
+                          ref_cmds);
+    }
+
+    // big enough for several chunks per thread, with ids containing '#' and, in the middle, a
+    // $comment full of lines that look like ticks for chunk boundaries to fall into
+    IDCodeTable idcodes;
+    for (const auto idcode : {"!", "#a", "a#", "#1"}) {
+        idcodes.intern(idcode);
+    }
+    std::string body;
+    for (uint64_t tick = 0; body.size() < 12 * 1024 * 1024; ++tick) {
+        body += fmt::format("#{:d}\n{:d}!\nb{:b} #a\n{:d}a#\nb{:b} #1\n", tick * 5, tick % 2,
+                            tick * 13 % 4096, (tick + 1) % 2, tick % 7);
+        if (tick == 100000) {
+            body += "$comment\n";
+            for (uint64_t i = 0; i < 300000; ++i) {
+                body += fmt::format("#{:d}\n1!\n", i);
+            }
+            body += "$end\n";
+        }
+    }
+    const auto chunks = split_vcd_sim_cmds(body, 16);
+    REQUIRE(chunks.size() == 16);
+    size_t chunks_sz = 0;
+    for (const auto chunk : chunks) {
+        REQUIRE(chunk.starts_with('#'));
+        chunks_sz += chunk.size();
+    }
+    REQUIRE(chunks_sz == body.size());
+    const auto ref_cmds = parse_vcd_sim_cmds(body, idcodes);
+    for (const uint32_t num_threads : {1, 2, 3, 8}) {
+        INFO("threads: " << num_threads);
+        require_same_cmds(parse_vcd_sim_cmds_parallel(body, idcodes, num_threads), ref_cmds);
+    }
+    // and without the $comment, so the chunks actually parse on their own
+    const auto comment_pos = body.find("$comment");
+    const auto no_comment =
+        body.substr(0, comment_pos) + body.substr(body.find("$end\n", comment_pos) + 5);
+    require_same_cmds(parse_vcd_sim_cmds_parallel(no_comment, idcodes, 4),
+                      parse_vcd_sim_cmds(no_comment, idcodes));
+}
+
+TEST_CASE("partial", TS) {
+    const auto body = "#10\n0!\n$comment hi $end\nb1010 #a\nr-1.5 %\n#11\n1!\n"sv;
+    IDCodeTable idcodes;
+    for (const auto idcode : {"!", "#a", "%"}) {
+        idcodes.intern(idcode);
+    }
+    std::vector<SimRecord> all_records;
+    REQUIRE(scan_vcd_sim_cmds(body, idcodes, all_records) == body.size());
+    REQUIRE(all_records.size() == 7);
+    for (size_t n = 0; n <= body.size(); ++n) {
+        std::vector<SimRecord> records;
+        const auto consumed = scan_vcd_sim_cmds(body.substr(0, n), idcodes, records, false);
+        scan_vcd_sim_cmds(body.substr(consumed), idcodes, records);
+        REQUIRE(records.size() == all_records.size());
+    }
+}
+
+TEST_CASE("wide binary values", TS) {
+    std::string digits;
+    for (size_t i = 0; i < 512; ++i) {
+        digits.push_back("0110x1z0101"[i % 11]);
+    }
+    const auto bnum = VCDTypes::BinaryNum::from_digits(digits);
+    REQUIRE(bnum.bits.bitsize() == 512);
+    REQUIRE(bnum.xz);
+    REQUIRE(bnum.digits() == digits);
+    // digit 511 is the least significant bit
+    REQUIRE((bnum.bits.data()[0] & 1) == (digits.back() == '1'));
+    REQUIRE(VCDTypes::BinaryNum::from_digits("0001011").digits() == "0001011");
+    REQUIRE(VCDTypes::BinaryNum::from_digits("z").logic() == Logic::vZ);
+    REQUIRE(!VCDTypes::BinaryNum::from_digits("1010101010101").xz);
+    REQUIRE_THROWS_AS(VCDTypes::BinaryNum::from_digits("10102010"), std::domain_error);
+
+    VarBitArena arena;
+    const auto arena_bnum = VCDTypes::BinaryNum::from_digits(digits, &arena);
+    REQUIRE(arena_bnum.bits.is_arena());
+    REQUIRE(arena_bnum.xz->is_arena());
+    REQUIRE(arena.size() == 2 * 512 / CHAR_BIT);
+    REQUIRE(arena_bnum.digits(&arena) == digits);
+}
+
+TEST_CASE("parallel arenas", TS) {
+    IDCodeTable idcodes;
+    for (const auto idcode : {"!", "w"}) {
+        idcodes.intern(idcode);
+    }
+    // a little over 4 chunks of wide values, X every third tick
+    std::string body;
+    for (uint64_t tick = 0; body.size() < 5 * 1024 * 1024; ++tick) {
+        auto digits = fmt::format("{:b}", tick * 0x9E3779B97F4A7C15ull);
+        digits.resize(100, tick % 3 ? '0' : 'x');
+        body += fmt::format("#{:d}\n{:d}!\nb{:s} w\n", tick, tick % 2, digits);
+    }
+    const auto ref_cmds = parse_vcd_sim_cmds_fast(body, idcodes);
+    std::vector<VarBitArena> arenas;
+    std::vector<size_t> parsed;
+    const auto cmds = parse_vcd_sim_cmds_parallel(body, idcodes, 4, &arenas, [&](size_t off) {
+        parsed.push_back(off);
+    });
+    // progress is reported at every chunk end, in order
+    REQUIRE(parsed.size() > 1);
+    REQUIRE(std::is_sorted(parsed.cbegin(), parsed.cend()));
+    REQUIRE(parsed.back() == body.size());
+    for (const auto off : parsed) {
+        REQUIRE((off == body.size() || body.substr(off, 1) == "#"));
+    }
+    REQUIRE(arenas.size() == 2);
+    REQUIRE(!arenas[0].size());
+    REQUIRE(cmds.size() == ref_cmds.size());
+    size_t num_wide = 0;
+    for (size_t i = 0; i < cmds.size(); ++i) {
+        const auto *change = std::get_if<VCDTypes::Change>(&cmds[i]);
+        const auto *bnum   = change ? std::get_if<VCDTypes::BinaryNum>(&change->value) : nullptr;
+        if (!bnum) {
+            REQUIRE(fmt::format("{}", cmds[i]) == fmt::format("{}", ref_cmds[i]));
+            continue;
+        }
+        // every value of every chunk ends up in the arena of its signal
+        REQUIRE(bnum->bits.is_arena());
+        const auto &ref =
+            std::get<VCDTypes::BinaryNum>(std::get<VCDTypes::Change>(ref_cmds[i]).value);
+        REQUIRE(bnum->digits(&arenas[change->sig]) == ref.digits());
+        ++num_wide;
+    }
+    REQUIRE(arenas[1].size() >= num_wide * 100 / CHAR_BIT);
+}
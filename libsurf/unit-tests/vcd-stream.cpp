@@ -0,0 +1,120 @@
+#include <surf/surf.h>
+using namespace surf;
+namespace fs = std::filesystem;
+
+#include "vcd-scanner.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <fcntl.h>
+#include <fstream>
+#include <unistd.h>
+
+#define TS "[VCDStream]"
+
+TEST_CASE("chunk boundaries", TS) {
+    const auto header = "$timescale 1ns $end\n$scope module top $end\n$var wire 1 ! clk $end\n"
+                        "$var wire 12 #a bus $end\n$upscope $end\n$enddefinitions $end\n"s;
+    std::string body;
+    for (uint64_t tick = 0; tick < 300; ++tick) {
+        body += fmt::format("#{:d}\n{:d}!\nb{:b} #a\n", tick * 5, tick % 2, tick * 13 % 4096);
+        if (tick % 50 == 0) {
+            body += "$comment split me $end\n";
+        }
+    }
+    IDCodeTable idcodes;
+    for (const auto idcode : {"!", "#a"}) {
+        idcodes.intern(idcode);
+    }
+    const auto ref_cmds = parse_vcd_sim_cmds_fast(body, idcodes);
+    for (const size_t chunk_size : {1, 7, 64, 4096}) {
+        INFO("chunk size " << chunk_size);
+        int fds[2];
+        REQUIRE(!pipe(fds));
+        const auto vcd = header + body;
+        // fits in the pipe buffer, so it can all be written up front
+        REQUIRE(write(fds[1], vcd.data(), vcd.size()) == (ssize_t)vcd.size());
+        close(fds[1]);
+        VCDStream stream{fds[0], "pipe", chunk_size};
+        REQUIRE(stream.declarations().signals.size() == 2);
+        REQUIRE(stream.timebase_power() == -9);
+        // comments point into the stream's buffer, format them while they are valid
+        std::vector<std::string> cmds;
+        stream.run([&](std::span<const VCDTypes::SimCmd> chunk_cmds,
+                       std::span<const VarBitArena>) {
+            for (const auto &cmd : chunk_cmds) {
+                cmds.emplace_back(fmt::format("{}", cmd));
+            }
+        });
+        close(fds[0]);
+        REQUIRE(stream.bytes_read() == vcd.size());
+        REQUIRE(cmds.size() == ref_cmds.size());
+        for (size_t i = 0; i < cmds.size(); ++i) {
+            REQUIRE(cmds[i] == fmt::format("{}", ref_cmds[i]));
+        }
+    }
+}
+
+TEST_CASE("wide values", TS) {
+    const auto header = "$timescale 1ns $end\n$scope module top $end\n$var wire 1 ! clk $end\n"
+                        "$var wire 100 w wide $end\n$upscope $end\n$enddefinitions $end\n"s;
+    std::string body;
+    std::vector<std::string> ref_digits;
+    for (uint64_t tick = 0; tick < 200; ++tick) {
+        auto digits = fmt::format("{:b}", tick * 0x9E3779B97F4A7C15ull);
+        digits.resize(100, tick % 3 ? '0' : 'x');
+        body += fmt::format("#{:d}\n{:d}!\nb{:s} w\n", tick, tick % 2, digits);
+        ref_digits.emplace_back(digits);
+    }
+    int fds[2];
+    REQUIRE(!pipe(fds));
+    const auto vcd = header + body;
+    REQUIRE(write(fds[1], vcd.data(), vcd.size()) == (ssize_t)vcd.size());
+    close(fds[1]);
+    VCDStream stream{fds[0], "pipe", 777};
+    REQUIRE(stream.declarations().signals.size() == 2);
+    // wide values are only readable through the arena of their signal
+    std::vector<std::string> digits;
+    stream.run([&](std::span<const VCDTypes::SimCmd> cmds, std::span<const VarBitArena> arenas) {
+        REQUIRE(arenas.size() == 2);
+        for (const auto &cmd : cmds) {
+            const auto *change = std::get_if<VCDTypes::Change>(&cmd);
+            if (!change || change->sig != 1) {
+                continue;
+            }
+            const auto &bnum = std::get<VCDTypes::BinaryNum>(change->value);
+            REQUIRE(bnum.bits.is_arena());
+            digits.emplace_back(bnum.digits(&arenas[change->sig]));
+        }
+    });
+    close(fds[0]);
+    REQUIRE(digits == ref_digits);
+}
+
+TEST_CASE("poll before the definitions", TS) {
+    const auto path =
+        fs::temp_directory_path() / fmt::format("surf-unit-test-stream-{:d}.vcd", getpid());
+    std::ofstream out{path};
+    out << "$timescale 1ns $end\n$scope module top $end\n$var wire 1 ! clk $end\n" << std::flush;
+    const auto fd = open(path.c_str(), O_RDONLY);
+    REQUIRE(fd >= 0);
+    VCDStream stream{fd, path.string(), 16};
+    size_t num_cmds = 0;
+    const auto sink = [&](std::span<const VCDTypes::SimCmd> cmds, std::span<const VarBitArena>) {
+        num_cmds += cmds.size();
+    };
+    // a partial header isn't an error yet, there is just nothing to parse
+    REQUIRE(!stream.poll(sink));
+    REQUIRE(!stream.try_declarations());
+
+    out << "$var wire 12 #a bus $end\n$upscope $end\n$enddefinitions $end\n#0\n1!\n#5\n0!\n"
+        << std::flush;
+    while (stream.poll(sink)) {
+    }
+    stream.finish(sink);
+    REQUIRE(stream.declarations().signals.size() == 2);
+    REQUIRE(num_cmds == 4);
+    close(fd);
+    fs::remove(path);
+}
@@ -0,0 +1,197 @@
+#include <surf/surf.h>
+using namespace surf;
+namespace fs = std::filesystem;
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <fstream>
+#include <unistd.h>
+
+#define TS "[VCDFile]"
+
+static const std::string header =
+    "$timescale 1ns $end\n$scope module top $end\n$var wire 1 ! clk $end\n"
+    "$var wire 12 #a bus $end\n$upscope $end\n$enddefinitions $end\n";
+
+static fs::path write_vcd(std::string_view name, std::string_view body) {
+    const auto path =
+        fs::temp_directory_path() / fmt::format("surf-unit-test-{:s}-{:d}.vcd", name, getpid());
+    std::ofstream out{path, std::ios::binary};
+    out << header << body;
+    return path;
+}
+
+static std::vector<std::string> format_cmds(std::span<const VCDTypes::SimCmd> cmds) {
+    std::vector<std::string> res;
+    res.reserve(cmds.size());
+    for (const auto &cmd : cmds) {
+        res.emplace_back(fmt::format("{}", cmd));
+    }
+    return res;
+}
+
+TEST_CASE("sim_cmds windows", TS) {
+    // changes ahead of the first tick
+    std::string body = "0!\nb0 #a\n";
+    for (uint64_t tick = 0; tick < 4000; ++tick) {
+        body += fmt::format("#{:d}\n{:d}!\nb{:b} #a\n", tick * 10, tick % 2, tick * 13 % 4096);
+    }
+    const auto path = write_vcd("windows", body);
+    VCDFile vcd{path, 2};
+    // known from the head and tail of the file before anything is parsed
+    REQUIRE(vcd.start().ticks() == 0);
+    REQUIRE(vcd.end().ticks() == 39990);
+    const auto all = format_cmds(vcd.sim_cmds());
+    REQUIRE(vcd.start().ticks() == 0);
+    REQUIRE(vcd.end().ticks() == 39990);
+    REQUIRE(vcd.seek_index().complete());
+
+    for (const auto &[start, end] : {std::pair<uint64_t, uint64_t>{0, 39990},
+                                     {5000, 5000},
+                                     {1234, 4321},
+                                     {39990, 39990},
+                                     {50000, 60000}}) {
+        INFO("window [" << start << ", " << end << "]");
+        // the commands of the full parse with start <= tick <= end
+        std::vector<std::string> in_window;
+        std::optional<uint64_t> tick;
+        for (size_t i = 0; i < vcd.sim_cmds().size(); ++i) {
+            if (const auto *t = std::get_if<VCDTypes::Tick>(&vcd.sim_cmds()[i])) {
+                tick = t->tick;
+            }
+            if (tick && *tick >= start && *tick <= end) {
+                in_window.emplace_back(all[i]);
+            }
+        }
+        // the window is a run of the full parse, give or take an index stride, holding them all
+        const auto window = format_cmds(vcd.sim_cmds_window(start, end));
+        REQUIRE(std::search(all.cbegin(), all.cend(), window.cbegin(), window.cend()) !=
+                all.cend());
+        REQUIRE(std::search(window.cbegin(), window.cend(), in_window.cbegin(),
+                            in_window.cend()) != window.cend());
+        REQUIRE(window.size() >= in_window.size());
+    }
+    REQUIRE_THROWS_AS(vcd.sim_cmds_window(10, 9), std::range_error);
+    fs::remove(path);
+}
+
+TEST_CASE("destroy while indexing", TS) {
+    // a few index strides so that the index thread is still scanning when the file is dropped
+    std::string body;
+    for (uint64_t tick = 0; body.size() < 3 * TickSeekIndex::default_stride; ++tick) {
+        body += fmt::format("#{:d}\n{:d}!\nb{:b} #a\n", tick, tick % 2, tick % 4096);
+    }
+    const auto path = write_vcd("destroy", body);
+    for (int i = 0; i < 4; ++i) {
+        // the destructor stops the index thread rather than waiting for its whole scan
+        VCDFile vcd{path};
+        REQUIRE(vcd.start().ticks() == 0);
+    }
+    VCDFile vcd{path};
+    REQUIRE(vcd.seek_index().complete());
+    REQUIRE(vcd.seek_index().entries().size() >= 3);
+    fs::remove(path);
+}
+
+TEST_CASE("read backends", TS) {
+    std::string body;
+    for (uint64_t tick = 0; tick < 3000; ++tick) {
+        body += fmt::format("#{:d}\n{:d}!\nb{:b} #a\n", tick * 3, tick % 2, tick % 4096);
+    }
+    const auto path = write_vcd("backends", body);
+    VCDFile mapped{path, 2};
+    const auto ref = format_cmds(mapped.sim_cmds());
+    for (const auto backend :
+         {ChunkedFileReader::Backend::pread, ChunkedFileReader::Backend::io_uring}) {
+        // chunks much smaller than the file, the last one partial
+        VCDFile read{path, 2, {.chunk_size = 4096, .backend = backend}};
+        REQUIRE(read.string_view() == mapped.string_view());
+        REQUIRE(read.data()[read.size()] == '\0');
+        REQUIRE(read.end().ticks() == 8997);
+        REQUIRE(format_cmds(read.sim_cmds()) == ref);
+    }
+    fs::remove(path);
+}
+
+TEST_CASE("document views after advance", TS) {
+    std::string body;
+    for (uint64_t tick = 0; tick < 20000; ++tick) {
+        body += fmt::format("#{:d}\n{:d}!\n", tick, tick % 2);
+        if (tick % 1000 == 0) {
+            body += fmt::format("$comment note {:d} $end\n", tick);
+        }
+    }
+    const auto path = write_vcd("views", body);
+    VCDFile vcd{path, 2, MapPolicy::sequential};
+    // parsing advances the mapping to its end, dropping every page of the changes
+    const auto &doc = vcd.document();
+    uint64_t tick   = 0;
+    size_t num      = 0;
+    for (const auto &cmd : doc.sim_cmds) {
+        if (const auto *t = std::get_if<VCDTypes::Tick>(&cmd)) {
+            tick = t->tick;
+        }
+        const auto *comment = std::get_if<VCDTypes::Comment>(&cmd);
+        if (!comment) {
+            continue;
+        }
+        // not a copy, a view into the dropped pages that reads back from the file
+        REQUIRE(comment->comment.data() >= vcd.data());
+        REQUIRE(comment->comment.data() + comment->comment.size() <= vcd.data() + vcd.size());
+        REQUIRE(comment->comment.find(fmt::format("note {:d}", tick)) != std::string_view::npos);
+        ++num;
+    }
+    REQUIRE(num == 20);
+    fs::remove(path);
+}
+
+TEST_CASE("stale pyramid sidecar", TS) {
+    std::string long_body, short_body;
+    for (uint64_t tick = 0; tick < 1000; ++tick) {
+        long_body += fmt::format("#{:d}\n{:d}!\n", tick, tick % 2);
+        if (tick < 100) {
+            short_body += fmt::format("#{:d}\n{:d}!\n", tick, tick % 2);
+        }
+    }
+    const auto long_path  = write_vcd("pyr-long", long_body);
+    const auto short_path = write_vcd("pyr-short", short_body);
+    auto pyr_path         = short_path;
+    pyr_path += ".pyr";
+    // newer than the VCD and the same number of signals, but the buckets are past its columns
+    VCDFile{long_path, 2}.pyramids().save(pyr_path);
+    VCDFile vcd{short_path, 2};
+    const auto &pyramids = vcd.pyramids();
+    REQUIRE_NOTHROW(pyramids.check(vcd.columns()));
+    REQUIRE(!pyramids[0].levels().empty());
+    fs::remove(pyr_path);
+    fs::remove(short_path);
+    fs::remove(long_path);
+}
+
+TEST_CASE("tick lines in comments", TS) {
+    std::string body = "$comment\n#777777\n$end\n";
+    for (uint64_t tick = 0; tick < 3000; ++tick) {
+        body += fmt::format("#{:d}\n{:d}!\n", tick + 5, tick % 2);
+        if (tick % 100 == 50) {
+            body += fmt::format("$comment\n#{:d}\n$end\n", 900000 + tick);
+        }
+    }
+    body += "$comment\n#888888\n$end\n";
+    const auto path = write_vcd("comment-ticks", body);
+    VCDFile vcd{path, 2};
+    REQUIRE(vcd.start().ticks() == 5);
+    REQUIRE(vcd.end().ticks() == 3004);
+    const auto cmds = format_cmds(vcd.sim_cmds());
+    // every window starts on a command, never inside a comment
+    for (const auto &[start, end] : {std::pair<uint64_t, uint64_t>{5, 3004}, {1000, 1100}}) {
+        const auto window = format_cmds(vcd.sim_cmds_window(start, end));
+        REQUIRE(!window.empty());
+        REQUIRE(std::search(cmds.cbegin(), cmds.cend(), window.cbegin(), window.cend()) !=
+                cmds.cend());
+    }
+    REQUIRE(vcd.start().ticks() == 5);
+    REQUIRE(vcd.end().ticks() == 3004);
+    fs::remove(path);
+}
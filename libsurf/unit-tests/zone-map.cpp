@@ -0,0 +1,94 @@
+#include <surf/surf.h>
+using namespace surf;
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <random>
+
+#define TS "[ZoneMap]"
+
+TEST_CASE("blocks", TS) {
+    ZoneMap zones{16};
+    for (uint64_t i = 0; i < ZoneMap::block_changes * 2 + 10; ++i) {
+        const uint64_t v = i < ZoneMap::block_changes ? 100 + i % 10 : 5000 + i;
+        zones.push_back(bitview{v, 16}, i == ZoneMap::block_changes * 2 + 3);
+    }
+    REQUIRE(zones.num_blocks() == 3);
+    REQUIRE(zones.size() == ZoneMap::block_changes * 2 + 10);
+
+    REQUIRE(zones.may_be_in(0, 0, 100));
+    REQUIRE(zones.may_be_in(0, 109, 200));
+    REQUIRE(!zones.may_be_in(0, 110, 200));
+    REQUIRE(zones.may_equal(0, 105));
+    // in range but never seen
+    REQUIRE(!zones.may_equal(0, 0));
+    REQUIRE(!zones.may_be_in(1, 0, 5000));
+    REQUIRE(!zones.has_xz(1));
+    REQUIRE(zones.has_xz(2));
+    REQUIRE(zones.memory_bytes() > 0);
+
+    // exact sets for narrow vectors
+    ZoneMap narrow{8};
+    for (uint64_t v = 0; v < 256; v += 2) {
+        narrow.push_back(bitview{v, 8}, false);
+    }
+    for (uint64_t v = 0; v < 256; ++v) {
+        REQUIRE(narrow.may_equal(0, v) == !(v % 2));
+    }
+}
+
+TEST_CASE("find in range", TS) {
+    std::mt19937_64 rng{7};
+    for (const varbit::sz_t bitsize : {4, 8, 12, 16, 24, 32, 40, 64}) {
+        SignalColumn col{SignalKind::vector, bitsize};
+        const auto num_changes = ZoneMap::block_changes * 5 + 77;
+        for (uint64_t i = 0; i < num_changes; ++i) {
+            // mostly a counter, with the odd random value and a stretch of X
+            uint64_t v = (i * 3) % 200;
+            if (rng() % 64 == 0) {
+                v = rng();
+            }
+            if (i / ZoneMap::block_changes == 3 && i % 50 == 0) {
+                const uint64_t xz_bits = 1;
+                col.append_bits(i, bitview{v | 1, bitsize}, bitview{xz_bits, 1});
+            } else {
+                col.append_bits(i, bitview{v, bitsize});
+            }
+        }
+        REQUIRE(col.zones().size() == num_changes);
+
+        const auto value = [&](size_t idx) {
+            uint64_t v{};
+            memcpy(&v, col.bits(idx).data(), col.bits(idx).bytesize());
+            return v;
+        };
+        const auto brute = [&](size_t first, uint64_t lo, uint64_t hi) -> std::optional<size_t> {
+            for (auto idx = first; idx < col.size(); ++idx) {
+                if (!col.xz(idx) && value(idx) >= lo && value(idx) <= hi) {
+                    return idx;
+                }
+            }
+            return std::nullopt;
+        };
+        for (const auto &[lo, hi] :
+             std::vector<std::pair<uint64_t, uint64_t>>{{7, 7},
+                                                        {199, 199},
+                                                        {0, 0},
+                                                        {150, 160},
+                                                        {201, UINT64_MAX},
+                                                        {UINT64_MAX, UINT64_MAX},
+                                                        {5, 1}}) {
+            for (const size_t first : {size_t{0}, size_t{1000}, ZoneMap::block_changes * 3 + 1,
+                                       num_changes - 3}) {
+                REQUIRE(col.find_in_range(first, lo, hi) == brute(first, lo, hi));
+            }
+        }
+        // multiples of 50 in block 3
+        REQUIRE(col.find_xz(0) == 3100);
+        REQUIRE(col.find_xz(3101) == 3150);
+        REQUIRE(!col.find_xz(ZoneMap::block_changes * 4));
+    }
+
+    SignalColumn scalar{SignalKind::scalar, 1};
+    REQUIRE_THROWS_AS(scalar.find_in_range(0, 0, 1), std::domain_error);
+}